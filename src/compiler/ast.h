@@ -3,6 +3,7 @@
 
 #include <stdio.h>
 #include "str.h"
+#include "arena.h"
 
 typedef enum {
 	RHO_NODE_EMPTY,
@@ -130,10 +131,12 @@ struct rho_ast_list {
 	struct rho_ast_list *next;
 };
 
-RhoAST *rho_ast_new(RhoNodeType type, RhoAST *left, RhoAST *right, unsigned int lineno);
-struct rho_ast_list *rho_ast_list_new(void);
-void rho_ast_list_free(struct rho_ast_list *block);
-void rho_ast_free(RhoAST *ast);
+/*
+ * Nodes, lists and the strings they hold all live in the given arena
+ * and are freed along with it; there is no freeing them one by one.
+ */
+RhoAST *rho_ast_new(RhoArena *arena, RhoNodeType type, RhoAST *left, RhoAST *right, unsigned int lineno);
+struct rho_ast_list *rho_ast_list_new(RhoArena *arena);
 
 #define RHO_NODE_TYPE_IS_ASSIGNMENT(type) (RHO_NODE_ASSIGNMENTS_START < (type) && (type) < RHO_NODE_ASSIGNMENTS_END)
 #define RHO_NODE_TYPE_IS_CALL(type)       ((type) == RHO_NODE_CALL)
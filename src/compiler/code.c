@@ -68,6 +68,21 @@ void rho_code_write_uint16_at(RhoCode *code, const size_t n, const size_t pos)
 	rho_util_write_uint16_to_stream(code->bc + pos, n);
 }
 
+/*
+ * Like `rho_code_write_uint16`, for the sizes that may
+ * exceed 16 bits (see doc/rhoc_spec.md).
+ */
+void rho_code_write_uint32(RhoCode *code, const size_t n)
+{
+	if (n > 0xFFFFFFFF) {
+		RHO_INTERNAL_ERROR();
+	}
+
+	rho_code_ensure_capacity(code, code->size + 4);
+	rho_util_write_uint32_to_stream(code->bc + code->size, n);
+	code->size += 4;
+}
+
 void rho_code_write_int(RhoCode *code, const int n)
 {
 	rho_code_ensure_capacity(code, code->size + RHO_INT_SIZE);
@@ -124,6 +139,14 @@ unsigned int rho_code_read_uint16(RhoCode *code)
 	return ret;
 }
 
+size_t rho_code_read_uint32(RhoCode *code)
+{
+	code->size -= 4;
+	const size_t ret = rho_util_read_uint32_from_stream(code->bc);
+	code->bc += 4;
+	return ret;
+}
+
 double rho_code_read_double(RhoCode *code)
 {
 	code->size -= RHO_DOUBLE_SIZE;
@@ -138,6 +161,7 @@ const char *rho_code_read_str(RhoCode *code)
 
 	while (*(code->bc++) != '\0');
 
+	code->size -= (code->bc - (byte *)start);
 	return start;
 }
 
@@ -10,6 +10,7 @@
 #include "opcodes.h"
 #include "code.h"
 #include "util.h"
+#include "peephole.h"
 #include "compiler.h"
 
 struct metadata {
@@ -26,33 +27,39 @@ static void write_byte(RhoCompiler *compiler, const byte p)
 	rho_code_write_byte(&compiler->code, p);
 }
 
-static void write_ins(RhoCompiler *compiler, const RhoOpcode p, unsigned int lineno)
+void rho_lno_write(RhoCode *lno_table, size_t pos_delta, unsigned int line_delta)
 {
-#define WB(p) rho_code_write_byte(&compiler->lno_table, p)
+	/* the position has to be reached before the line goes up */
+	while (pos_delta > 0xff) {
+		rho_code_write_byte(lno_table, 0xff);
+		rho_code_write_byte(lno_table, 0);
+		pos_delta -= 0xff;
+	}
 
-	const unsigned int curr_lineno = compiler->last_lineno;
+	while (line_delta > 0xff) {
+		rho_code_write_byte(lno_table, pos_delta);
+		rho_code_write_byte(lno_table, 0xff);
+		pos_delta = 0;
+		line_delta -= 0xff;
+	}
 
-	if (lineno > curr_lineno) {
-		unsigned int ins_delta = compiler->last_ins_idx - compiler->first_ins_on_line_idx;
-		unsigned int lineno_delta = lineno - curr_lineno;
-		compiler->first_ins_on_line_idx = compiler->last_ins_idx;
+	rho_code_write_byte(lno_table, pos_delta);
+	rho_code_write_byte(lno_table, line_delta);
+}
 
-		while (lineno_delta || ins_delta) {
-			byte x = ins_delta < 0xff ? ins_delta : 0xff;
-			byte y = lineno_delta < 0xff ? lineno_delta : 0xff;
-			WB(x);
-			WB(y);
-			ins_delta -= x;
-			lineno_delta -= y;
-		}
+static void write_ins(RhoCompiler *compiler, const RhoOpcode p, unsigned int lineno)
+{
+	const unsigned int curr_lineno = compiler->last_lineno;
+	const size_t pos = compiler->code.size;
 
+	if (lineno > curr_lineno) {
+		rho_lno_write(&compiler->lno_table, pos - compiler->line_start, lineno - curr_lineno);
+		compiler->line_start = pos;
 		compiler->last_lineno = lineno;
 	}
 
-	++compiler->last_ins_idx;
+	compiler->last_op_pos = pos;
 	write_byte(compiler, p);
-
-#undef WB
 }
 
 static void write_int(RhoCompiler *compiler, const int n)
@@ -60,9 +67,31 @@ static void write_int(RhoCompiler *compiler, const int n)
 	rho_code_write_int(&compiler->code, n);
 }
 
+/*
+ * The first argument of an instruction may take more than 16 bits,
+ * in which case an EXTENDED_ARG prefix holding its high bits is
+ * inserted before the instruction.
+ */
 static void write_uint16(RhoCompiler *compiler, const size_t n)
 {
-	rho_code_write_uint16(&compiler->code, n);
+	RhoCode *code = &compiler->code;
+
+	if (n > 0xFFFF && code->size == compiler->last_op_pos + 1) {
+		const RhoOpcode opcode = code->bc[code->size - 1];
+
+		if (rho_opcode_extended_arg(opcode) != 0) {
+			RHO_INTERNAL_ERROR();
+		}
+
+		--code->size;
+		write_ins(compiler, RHO_INS_EXTENDED_ARG, compiler->last_lineno);
+		rho_code_write_uint16(code, n >> 16);
+		write_ins(compiler, opcode, compiler->last_lineno);
+		rho_code_write_uint16(code, n & 0xFFFF);
+		return;
+	}
+
+	rho_code_write_uint16(code, n);
 }
 
 static void write_uint16_at(RhoCompiler *compiler, const size_t n, const size_t pos)
@@ -70,6 +99,52 @@ static void write_uint16_at(RhoCompiler *compiler, const size_t n, const size_t
 	rho_code_write_uint16_at(&compiler->code, n, pos);
 }
 
+static void write_uint32(RhoCompiler *compiler, const size_t n)
+{
+	rho_code_write_uint32(&compiler->code, n);
+}
+
+/*
+ * Jumps are written behind an EXTENDED_ARG prefix so that their
+ * offsets can be filled in by `set_jump_target` once known, however
+ * far they reach; the peephole optimizer drops the prefixes that
+ * turn out not to be needed. The jump's arguments are written by
+ * the caller (with 0 in place of the offset), and the returned
+ * position identifies the jump.
+ */
+static size_t write_jump(RhoCompiler *compiler, const RhoOpcode opcode, unsigned int lineno)
+{
+	const size_t jump_pos = compiler->code.size;
+	write_ins(compiler, RHO_INS_EXTENDED_ARG, lineno);
+	rho_code_write_uint16(&compiler->code, 0);
+	write_ins(compiler, opcode, lineno);
+	return jump_pos;
+}
+
+static void set_jump_target(RhoCompiler *compiler, const size_t jump_pos, const size_t target)
+{
+	const RhoOpcode opcode = compiler->code.bc[jump_pos + 3];
+	const size_t args_pos = jump_pos + 4;
+	const size_t next = args_pos + rho_opcode_arg_size(opcode);
+	size_t offset;
+
+	switch (opcode) {
+	case RHO_INS_JMP_BACK:
+	case RHO_INS_JMP_BACK_IF_TRUE:
+	case RHO_INS_JMP_BACK_IF_FALSE:
+		assert(target <= next);
+		offset = next - target;
+		break;
+	default:
+		assert(target >= next);
+		offset = target - next;
+		break;
+	}
+
+	write_uint16_at(compiler, offset >> 16, jump_pos + 1);
+	write_uint16_at(compiler, offset & 0xFFFF, args_pos + 2*rho_opcode_extended_arg(opcode));
+}
+
 static void write_double(RhoCompiler *compiler, const double d)
 {
 	rho_code_write_double(&compiler->code, d);
@@ -85,7 +160,7 @@ static void append(RhoCompiler *compiler, const RhoCode *code)
 	rho_code_append(&compiler->code, code);
 }
 
-const byte rho_magic[] = {0xFE, 0xED, 0xF0, 0x0D};
+const byte rho_magic[] = {0xFE, 0xED, 0xF0, RHO_RHOC_VERSION};
 const size_t rho_magic_size = sizeof(rho_magic);
 
 /*
@@ -107,28 +182,47 @@ static RhoCompiler *compiler_new(const char *filename, unsigned int first_lineno
 	rho_code_init(&compiler->code, DEFAULT_BC_CAPACITY);
 	compiler->lbi = NULL;
 	compiler->st = st;
-	compiler->ct = rho_ct_new();
+	compiler->ct = rho_ct_new(st->arena);
 	compiler->try_catch_depth = 0;
 	compiler->try_catch_depth_max = 0;
+	compiler->last_op_pos = 0;
 	rho_code_init(&compiler->lno_table, DEFAULT_LNO_TABLE_CAPACITY);
 	compiler->first_lineno = first_lineno;
-	compiler->first_ins_on_line_idx = 0;
-	compiler->last_ins_idx = 0;
+	compiler->line_start = 0;
 	compiler->last_lineno = first_lineno;
+	compiler->reg_temp_base = 0;
+	compiler->reg_temps = 0;
+	compiler->reg_temps_used = 0;
+	compiler->hoist_base = 0;
+	compiler->n_hoisted = 0;
+	compiler->hoisted = NULL;
+	compiler->hoist_live = NULL;
+	compiler->local_types = NULL;
+	compiler->n_local_types = 0;
+	compiler->inlines = NULL;
+	compiler->n_inlines = 0;
+	compiler->inline_ids = NULL;
+	compiler->n_inline_ids = 0;
+	compiler->inline_base = 0;
+	compiler->inline_temps = 0;
+	compiler->inline_temps_used = 0;
+	compiler->times = NULL;
 	compiler->in_generator = 0;
+	compiler->registers = 0;
+	compiler->hoist_globals = 0;
 
 	return compiler;
 }
 
 /*
- * Note: this does not deallocate the compiler's code field.
+ * Note: the symbol and constant tables are left to the
+ * program's arena.
  */
-static void compiler_free(RhoCompiler *compiler, bool free_st)
+static void compiler_free(RhoCompiler *compiler)
 {
-	if (free_st) {
-		rho_st_free(compiler->st);
-	}
-	rho_ct_free(compiler->ct);
+	free(compiler->hoisted);
+	free(compiler->hoist_live);
+	free(compiler->local_types);
 	rho_code_dealloc(&compiler->code);
 	rho_code_dealloc(&compiler->lno_table);
 	free(compiler);
@@ -178,8 +272,7 @@ static void compiler_pop_loop(RhoCompiler *compiler)
 	const size_t end_index = compiler->code.size;
 
 	for (size_t i = 0; i < break_indices_size; i++) {
-		const size_t break_index = break_indices[i];
-		write_uint16_at(compiler, end_index - break_index - 2, break_index);
+		set_jump_target(compiler, break_indices[i], end_index);
 	}
 
 	compiler->lbi = lbi->prev;
@@ -226,8 +319,52 @@ static void compile_export(RhoCompiler *compiler, RhoAST *ast);
 
 static void compile_get_attr(RhoCompiler *compiler, RhoAST *ast);
 
+static void reg_reserve_temps(RhoCompiler *compiler, RhoProgram *program);
+static bool compile_reg_assignment(RhoCompiler *compiler, RhoAST *ast);
+static size_t compile_cond_jump(RhoCompiler *compiler, RhoAST *cond, const unsigned int lineno);
+
+static void hoist_reserve(RhoCompiler *compiler, RhoProgram *program);
+static bool hoist_begin(RhoCompiler *compiler, RhoAST *loop, const unsigned int lineno);
+static void hoist_end(RhoCompiler *compiler);
+static int hoist_slot(RhoCompiler *compiler, const RhoSTSymbol *sym);
+
+static void inline_find(RhoCompiler *compiler, RhoProgram *program);
+static void inline_reserve(RhoCompiler *compiler, RhoProgram *program);
+static int inline_call_type(RhoCompiler *compiler, RhoAST *call);
+static const struct rho_inline_func *inline_target(RhoCompiler *compiler, RhoAST *call);
+static bool compile_inline_call(RhoCompiler *compiler, RhoAST *call);
+
 static int max_stack_depth(byte *bc, size_t len);
 
+/*
+ * Writes the checkpoint index of the (terminated) line number table
+ * `lno_table`: the running byte position and line offset before
+ * every RHO_LNO_CHECKPOINT_INTERVAL-th pair, along with where that
+ * pair is in the table, so that lookups can start from the nearest
+ * checkpoint rather than the beginning (see `get_lineno` in vm.c).
+ */
+static void write_lno_checkpoints(RhoCode *out, const RhoCode *lno_table, const size_t n_checkpoints)
+{
+	const byte *table = lno_table->bc;
+	size_t pos = 0;
+	size_t line_offset = 0;
+
+	rho_code_write_uint32(out, n_checkpoints);
+
+	for (size_t i = 1; i <= n_checkpoints; i++) {
+		const size_t pair = i * RHO_LNO_CHECKPOINT_INTERVAL;
+
+		for (size_t j = (i - 1) * RHO_LNO_CHECKPOINT_INTERVAL; j < pair; j++) {
+			pos += table[2*j];
+			line_offset += table[2*j + 1];
+		}
+
+		rho_code_write_uint32(out, 2*pair);
+		rho_code_write_uint32(out, pos);
+		rho_code_write_uint32(out, line_offset);
+	}
+}
+
 static struct metadata compile_raw(RhoCompiler *compiler, RhoProgram *program, bool is_single_expr)
 {
 	if (is_single_expr) {
@@ -235,10 +372,19 @@ static struct metadata compile_raw(RhoCompiler *compiler, RhoProgram *program, b
 	}
 
 	fill_ct(compiler, program);
+
+	if (compiler->registers) {
+		reg_reserve_temps(compiler, program);
+	}
+
+	hoist_reserve(compiler, program);
+	inline_reserve(compiler, program);
+
 	write_sym_table(compiler);
 	write_const_table(compiler);
 
 	const size_t start_size = compiler->code.size;
+	compiler->line_start = start_size;
 
 	for (struct rho_ast_list *node = program; node != NULL; node = node->next) {
 		compile_node(compiler, node->ast, !is_single_expr);
@@ -256,13 +402,21 @@ static struct metadata compile_raw(RhoCompiler *compiler, RhoProgram *program, b
 	RhoCode *code = &compiler->code;
 	RhoCode *lno_table = &compiler->lno_table;
 
+	rho_peephole_optimize(code, start_size, lno_table, compiler->first_lineno);
+
 	/* two zeros mark the end of the line number table */
 	rho_code_write_byte(lno_table, 0);
 	rho_code_write_byte(lno_table, 0);
 
 	const size_t final_size = code->size;
 	const size_t bc_size = final_size - start_size;
+	const double stack_start = (compiler->times != NULL) ? rho_util_time() : 0;
 	unsigned int max_vstack_depth = max_stack_depth(code->bc, code->size);
+
+	if (compiler->times != NULL) {
+		compiler->times->stack += rho_util_time() - stack_start;
+	}
+
 	unsigned int max_try_catch_depth = compiler->try_catch_depth_max;
 
 	/*
@@ -273,11 +427,14 @@ static struct metadata compile_raw(RhoCompiler *compiler, RhoProgram *program, b
 	 * instance and use that as our finished product.
 	 */
 	const size_t lno_table_size = lno_table->size;
+	const size_t n_checkpoints = (lno_table_size/2 - 1) / RHO_LNO_CHECKPOINT_INTERVAL;
 	RhoCode complete;
-	rho_code_init(&complete, 2 + 2 + lno_table_size + final_size);
-	rho_code_write_uint16(&complete, compiler->first_lineno);
-	rho_code_write_uint16(&complete, lno_table_size);
+	rho_code_init(&complete,
+	              4 + 4 + lno_table_size + 4 + n_checkpoints*RHO_LNO_CHECKPOINT_SIZE + final_size);
+	rho_code_write_uint32(&complete, compiler->first_lineno);
+	rho_code_write_uint32(&complete, lno_table_size);
 	rho_code_append(&complete, lno_table);
+	write_lno_checkpoints(&complete, lno_table, n_checkpoints);
 	rho_code_append(&complete, code);
 	rho_code_dealloc(code);
 	compiler->code = complete;
@@ -293,7 +450,14 @@ static struct metadata compile_raw(RhoCompiler *compiler, RhoProgram *program, b
 
 static struct metadata compile_program(RhoCompiler *compiler, RhoProgram *program)
 {
+	const double start = (compiler->times != NULL) ? rho_util_time() : 0;
 	rho_st_populate(compiler->st, program);
+
+	if (compiler->times != NULL) {
+		compiler->times->symtab += rho_util_time() - start;
+	}
+
+	inline_find(compiler, program);
 	return compile_raw(compiler, program, false);
 }
 
@@ -315,145 +479,1918 @@ static void compile_const(RhoCompiler *compiler, RhoAST *ast)
 		value.type = RHO_CT_STRING;
 		value.value.s = ast->v.str_val;
 		break;
-	case RHO_NODE_DEF:
-	case RHO_NODE_GEN:
-	case RHO_NODE_ACT:
-	case RHO_NODE_LAMBDA: {
-		const unsigned int const_id = rho_ct_poll_codeobj(compiler->ct);
-		write_ins(compiler, RHO_INS_LOAD_CONST, lineno);
-		write_uint16(compiler, const_id);
-		return;
-	}
+	case RHO_NODE_DEF:
+	case RHO_NODE_GEN:
+	case RHO_NODE_ACT:
+	case RHO_NODE_LAMBDA: {
+		const unsigned int const_id = rho_ct_poll_codeobj(compiler->ct);
+		write_ins(compiler, RHO_INS_LOAD_CONST, lineno);
+		write_uint16(compiler, const_id);
+		return;
+	}
+	default:
+		RHO_INTERNAL_ERROR();
+	}
+
+	const unsigned int const_id = rho_ct_id_for_const(compiler->ct, value);
+	write_ins(compiler, RHO_INS_LOAD_CONST, lineno);
+	write_uint16(compiler, const_id);
+}
+
+static void compile_load(RhoCompiler *compiler, RhoAST *ast)
+{
+	RHO_AST_TYPE_ASSERT(ast, RHO_NODE_IDENT);
+
+	const unsigned int lineno = ast->lineno;
+	const RhoSTSymbol *sym = rho_ste_get_symbol(compiler->st->ste_current, ast->v.ident);
+
+	if (sym == NULL) {
+		RHO_INTERNAL_ERROR();
+	}
+
+	const int hoisted = hoist_slot(compiler, sym);
+
+	if (hoisted >= 0) {
+		write_ins(compiler, RHO_INS_LOAD, lineno);
+		write_uint16(compiler, hoisted);
+		return;
+	}
+
+	if (sym->bound_here) {
+		write_ins(compiler, RHO_INS_LOAD, lineno);
+	} else if (sym->global_var) {
+		write_ins(compiler, RHO_INS_LOAD_GLOBAL, lineno);
+	} else {
+		assert(sym->free_var);
+		write_ins(compiler, RHO_INS_LOAD_NAME, lineno);
+	}
+
+	write_uint16(compiler, sym->id);
+}
+
+static unsigned int ast_list_length(struct rho_ast_list *list)
+{
+	unsigned int length = 0;
+	for (struct rho_ast_list *node = list; node != NULL; node = node->next) {
+		++length;
+	}
+	return length;
+}
+
+/*
+ * Stores the `count` values on top of the stack, as left there by
+ * SEQ_EXPAND, in the given identifiers.
+ */
+static void compile_seq_store(RhoCompiler *compiler,
+                              struct rho_ast_list *targets,
+                              const unsigned int count,
+                              const unsigned int lineno)
+{
+	/* sequence is expanded left-to-right, so we have to store in reverse */
+	for (int i = count-1; i >= 0; i--) {
+		struct rho_ast_list *node = targets;
+		for (int j = 0; j < i; j++) {
+			node = node->next;
+		}
+
+		RHO_AST_TYPE_ASSERT(node->ast, RHO_NODE_IDENT);
+		const RhoSTSymbol *sym = rho_ste_get_symbol(compiler->st->ste_current, node->ast->v.ident);
+
+		if (sym == NULL) {
+			RHO_INTERNAL_ERROR();
+		}
+
+		write_ins(compiler, sym->bound_here ? RHO_INS_STORE : RHO_INS_STORE_GLOBAL, lineno);
+		write_uint16(compiler, sym->id);
+	}
+}
+
+static void compile_assignment(RhoCompiler *compiler, RhoAST *ast)
+{
+	const RhoNodeType type = ast->type;
+	if (!RHO_NODE_TYPE_IS_ASSIGNMENT(type)) {
+		RHO_INTERNAL_ERROR();
+	}
+
+	if (compiler->registers && compile_reg_assignment(compiler, ast)) {
+		return;
+	}
+
+	const unsigned int lineno = ast->lineno;
+
+	RhoAST *lhs = ast->left;
+	RhoAST *rhs = ast->right;
+
+	/*
+	 *         (assign)
+	 *        /       \
+	 *       .        rhs
+	 *      / \
+	 *    id  attr
+	 */
+	if (lhs->type == RHO_NODE_DOT) {
+		const RhoSTSymbol *sym = rho_ste_get_attr_symbol(compiler->st->ste_current, lhs->right->v.ident);
+		const unsigned int sym_id = sym->id;
+
+		if (sym == NULL) {
+			RHO_INTERNAL_ERROR();
+		}
+
+		if (type == RHO_NODE_ASSIGN) {
+			compile_node(compiler, rhs, false);
+			compile_node(compiler, lhs->left, false);
+			write_ins(compiler, RHO_INS_SET_ATTR, lineno);
+			write_uint16(compiler, sym_id);
+		} else {
+			/* compound assignment */
+			compile_node(compiler, lhs->left, false);
+			write_ins(compiler, RHO_INS_DUP, lineno);
+			write_ins(compiler, RHO_INS_LOAD_ATTR, lineno);
+			write_uint16(compiler, sym_id);
+			compile_node(compiler, rhs, false);
+			write_ins(compiler, to_opcode(type), lineno);
+			write_ins(compiler, RHO_INS_ROT, lineno);
+			write_ins(compiler, RHO_INS_SET_ATTR, lineno);
+			write_uint16(compiler, sym_id);
+		}
+	} else if (lhs->type == RHO_NODE_INDEX) {
+		if (type == RHO_NODE_ASSIGN) {
+			compile_node(compiler, rhs, false);
+			compile_node(compiler, lhs->left, false);
+			compile_node(compiler, lhs->right, false);
+			write_ins(compiler, RHO_INS_SET_INDEX, lineno);
+		} else {
+			/* compound assignment */
+			compile_node(compiler, lhs->left, false);
+			compile_node(compiler, lhs->right, false);
+			write_ins(compiler, RHO_INS_DUP_TWO, lineno);
+			write_ins(compiler, RHO_INS_LOAD_INDEX, lineno);
+			compile_node(compiler, rhs, false);
+			write_ins(compiler, to_opcode(type), lineno);
+			write_ins(compiler, RHO_INS_ROT_THREE, lineno);
+			write_ins(compiler, RHO_INS_SET_INDEX, lineno);
+		}
+	} else if (lhs->type == RHO_NODE_TUPLE) {
+		assert(type == RHO_NODE_ASSIGN);
+
+		const unsigned int count = ast_list_length(lhs->v.list);
+
+		/*
+		 * In something like `(a, b) = (b, a)`, the tuple on the right
+		 * is never needed as such: its elements are left on the stack
+		 * just as SEQ_EXPAND would leave them.
+		 */
+		if (rhs->type == RHO_NODE_TUPLE && ast_list_length(rhs->v.list) == count) {
+			for (struct rho_ast_list *node = rhs->v.list; node != NULL; node = node->next) {
+				compile_node(compiler, node->ast, false);
+			}
+		} else {
+			compile_node(compiler, rhs, false);
+			write_ins(compiler, RHO_INS_SEQ_EXPAND, lineno);
+			write_uint16(compiler, count);
+		}
+
+		compile_seq_store(compiler, lhs->v.list, count, lineno);
+	} else {
+		const RhoSTSymbol *sym = rho_ste_get_symbol(compiler->st->ste_current, lhs->v.ident);
+
+		if (sym == NULL) {
+			RHO_INTERNAL_ERROR();
+		}
+
+		const unsigned int sym_id = sym->id;
+		assert(sym->bound_here || sym->global_var);
+
+		if (type == RHO_NODE_ASSIGN) {
+			compile_node(compiler, rhs, false);
+		} else {
+			/* compound assignment */
+			compile_load(compiler, lhs);
+			compile_node(compiler, rhs, false);
+			write_ins(compiler, to_opcode(type), lineno);
+		}
+
+		byte store_ins;
+		if (sym->bound_here) {
+			store_ins = RHO_INS_STORE;
+		} else if (sym->global_var) {
+			store_ins = RHO_INS_STORE_GLOBAL;
+		} else {
+			RHO_INTERNAL_ERROR();
+		}
+
+		write_ins(compiler, store_ins, lineno);
+		write_uint16(compiler, sym_id);
+	}
+}
+
+/*
+ * Register mode
+ * -------------
+ * When compiling with RHO_RHOC_FLAG_REGISTERS, assignments to locals
+ * and branch conditions that consist only of locals, constants and
+ * binary operators are compiled to three-address instructions that
+ * read and write frame slots directly (REG_MOVE, REG_BINOP and
+ * REG_CMP_BRANCH), rather than to a sequence of stack instructions.
+ * Anything else is compiled to stack code as usual, and the two
+ * forms can be mixed freely within a code object.
+ *
+ * Intermediate results are kept in temporaries, which are extra
+ * local slots placed after the named locals. They're allocated in
+ * a stack-like fashion, so the number of slots needed is just the
+ * deepest nesting of temporaries in any one statement, which we
+ * compute up front (reg_reserve_temps) since the symbol table has
+ * to be written before any code. The register allocator proper is
+ * therefore trivial: named locals live in their own slots, and
+ * temporaries are handed out and reclaimed in LIFO order.
+ *
+ * Note that operands are only read once the instruction executes,
+ * so e.g. in `x = a + b*c` an unbound `a` is reported after `b*c`
+ * is computed. This can only matter if `b*c` itself fails.
+ */
+
+#define REG_TEMP_NAME "<temp>"
+
+static bool reg_is_binop(const RhoNodeType type)
+{
+	switch (type) {
+	case RHO_NODE_ADD:
+	case RHO_NODE_SUB:
+	case RHO_NODE_MUL:
+	case RHO_NODE_DIV:
+	case RHO_NODE_MOD:
+	case RHO_NODE_POW:
+	case RHO_NODE_BITAND:
+	case RHO_NODE_BITOR:
+	case RHO_NODE_XOR:
+	case RHO_NODE_SHIFTL:
+	case RHO_NODE_SHIFTR:
+	case RHO_NODE_EQUAL:
+	case RHO_NODE_NOTEQ:
+	case RHO_NODE_LT:
+	case RHO_NODE_GT:
+	case RHO_NODE_LE:
+	case RHO_NODE_GE:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static bool reg_is_comparison(const RhoNodeType type)
+{
+	switch (type) {
+	case RHO_NODE_EQUAL:
+	case RHO_NODE_NOTEQ:
+	case RHO_NODE_LT:
+	case RHO_NODE_GT:
+	case RHO_NODE_LE:
+	case RHO_NODE_GE:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static bool reg_is_compound_assignment(const RhoNodeType type)
+{
+	return RHO_NODE_TYPE_IS_ASSIGNMENT(type) &&
+	       type != RHO_NODE_ASSIGN &&
+	       type != RHO_NODE_ASSIGN_APPLY;
+}
+
+/*
+ * Returns the slot of the given identifier if it's a local that can
+ * be used as a register, or -1 otherwise.
+ */
+static int reg_local_slot(RhoCompiler *compiler, RhoAST *ast)
+{
+	if (ast->type != RHO_NODE_IDENT) {
+		return -1;
+	}
+
+	const RhoSTSymbol *sym = rho_ste_get_symbol(compiler->st->ste_current, ast->v.ident);
+
+	if (sym == NULL || !sym->bound_here || sym->id > RHO_REG_INDEX_MASK) {
+		return -1;
+	}
+
+	return sym->id;
+}
+
+/*
+ * Computes the operand for a leaf (local or constant) node, returning
+ * false if the node can't be used as a register operand.
+ */
+static bool reg_leaf_operand(RhoCompiler *compiler, RhoAST *ast, unsigned int *operand)
+{
+	RhoCTConst value;
+
+	switch (ast->type) {
+	case RHO_NODE_IDENT: {
+		const int slot = reg_local_slot(compiler, ast);
+
+		if (slot < 0) {
+			return false;
+		}
+
+		*operand = slot;
+		return true;
+	}
+	case RHO_NODE_INT:
+		value.type = RHO_CT_INT;
+		value.value.i = ast->v.int_val;
+		break;
+	case RHO_NODE_FLOAT:
+		value.type = RHO_CT_DOUBLE;
+		value.value.d = ast->v.float_val;
+		break;
+	case RHO_NODE_STRING:
+		value.type = RHO_CT_STRING;
+		value.value.s = ast->v.str_val;
+		break;
+	default:
+		return false;
+	}
+
+	const unsigned int const_id = rho_ct_id_for_const(compiler->ct, value);
+
+	if (const_id > RHO_REG_INDEX_MASK) {
+		return false;
+	}
+
+	*operand = const_id | RHO_REG_CONST;
+	return true;
+}
+
+static bool reg_is_leaf(RhoAST *ast)
+{
+	switch (ast->type) {
+	case RHO_NODE_IDENT:
+	case RHO_NODE_INT:
+	case RHO_NODE_FLOAT:
+	case RHO_NODE_STRING:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static bool reg_expr_ok(RhoCompiler *compiler, RhoAST *ast)
+{
+	if (reg_is_leaf(ast)) {
+		unsigned int operand;
+		return reg_leaf_operand(compiler, ast, &operand);
+	}
+
+	return reg_is_binop(ast->type) &&
+	       reg_expr_ok(compiler, ast->left) &&
+	       reg_expr_ok(compiler, ast->right);
+}
+
+static bool reg_assignment_ok(RhoCompiler *compiler, RhoAST *ast)
+{
+	const RhoNodeType type = ast->type;
+
+	if (!(type == RHO_NODE_ASSIGN || reg_is_compound_assignment(type))) {
+		return false;
+	}
+
+	return reg_local_slot(compiler, ast->left) >= 0 && reg_expr_ok(compiler, ast->right);
+}
+
+static bool reg_cond_ok(RhoCompiler *compiler, RhoAST *cond)
+{
+	return reg_is_comparison(cond->type) &&
+	       reg_expr_ok(compiler, cond->left) &&
+	       reg_expr_ok(compiler, cond->right);
+}
+
+/*
+ * Number of temporaries needed to compute the given (non-leaf)
+ * expression into some destination slot, and to compute any
+ * expression as an operand, respectively.
+ */
+static unsigned int reg_temps_for_expr(RhoAST *ast);
+
+static unsigned int reg_temps_for_operand(RhoAST *ast)
+{
+	return reg_is_leaf(ast) ? 0 : 1 + reg_temps_for_expr(ast);
+}
+
+static unsigned int reg_temps_for_operands(RhoAST *left, RhoAST *right)
+{
+	const unsigned int left_needs = reg_temps_for_operand(left);
+	const unsigned int right_needs = (reg_is_leaf(left) ? 0 : 1) + reg_temps_for_operand(right);
+	return (left_needs > right_needs) ? left_needs : right_needs;
+}
+
+static unsigned int reg_temps_for_expr(RhoAST *ast)
+{
+	return reg_is_leaf(ast) ? 0 : reg_temps_for_operands(ast->left, ast->right);
+}
+
+static unsigned int reg_temps_for_stmt(RhoCompiler *compiler, RhoAST *ast);
+
+static unsigned int reg_temps_for_block(RhoCompiler *compiler, RhoBlock *block)
+{
+	unsigned int max = 0;
+
+	for (struct rho_ast_list *node = block; node != NULL; node = node->next) {
+		const unsigned int n = reg_temps_for_stmt(compiler, node->ast);
+		if (n > max) {
+			max = n;
+		}
+	}
+
+	return max;
+}
+
+static unsigned int reg_temps_for_stmt(RhoCompiler *compiler, RhoAST *ast)
+{
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+
+	if (ast == NULL) {
+		return 0;
+	}
+
+	switch (ast->type) {
+	case RHO_NODE_ASSIGN:
+	case RHO_NODE_ASSIGN_ADD:
+	case RHO_NODE_ASSIGN_SUB:
+	case RHO_NODE_ASSIGN_MUL:
+	case RHO_NODE_ASSIGN_DIV:
+	case RHO_NODE_ASSIGN_MOD:
+	case RHO_NODE_ASSIGN_POW:
+	case RHO_NODE_ASSIGN_BITAND:
+	case RHO_NODE_ASSIGN_BITOR:
+	case RHO_NODE_ASSIGN_XOR:
+	case RHO_NODE_ASSIGN_SHIFTL:
+	case RHO_NODE_ASSIGN_SHIFTR:
+		if (!reg_assignment_ok(compiler, ast)) {
+			return 0;
+		}
+
+		return (ast->type == RHO_NODE_ASSIGN) ? reg_temps_for_expr(ast->right) :
+		                                        reg_temps_for_operand(ast->right);
+	case RHO_NODE_IF:
+	case RHO_NODE_ELIF: {
+		/* elif chains can be long, so aren't walked recursively */
+		unsigned int max = 0;
+		RhoAST *node = ast;
+
+		for (; node != NULL && (node->type == RHO_NODE_IF || node->type == RHO_NODE_ELIF); node = node->v.middle) {
+			const unsigned int cond = reg_cond_ok(compiler, node->left) ?
+			                          reg_temps_for_operands(node->left->left, node->left->right) : 0;
+			const unsigned int body = reg_temps_for_stmt(compiler, node->right);
+			max = MAX(max, MAX(cond, body));
+		}
+
+		const unsigned int rest = reg_temps_for_stmt(compiler, node);
+		return MAX(max, rest);
+	}
+	case RHO_NODE_ELSE:
+		return reg_temps_for_stmt(compiler, ast->left);
+	case RHO_NODE_WHILE: {
+		const unsigned int cond = (ast->left != NULL && reg_cond_ok(compiler, ast->left)) ?
+		                          reg_temps_for_operands(ast->left->left, ast->left->right) : 0;
+		const unsigned int body = reg_temps_for_stmt(compiler, ast->right);
+		return MAX(cond, body);
+	}
+	case RHO_NODE_FOR:
+		return reg_temps_for_stmt(compiler, ast->v.middle);
+	case RHO_NODE_TRY_CATCH: {
+		const unsigned int try_body = reg_temps_for_stmt(compiler, ast->left);
+		const unsigned int catch_body = reg_temps_for_stmt(compiler, ast->right);
+		return MAX(try_body, catch_body);
+	}
+	case RHO_NODE_BLOCK:
+		return reg_temps_for_block(compiler, ast->v.block);
+	default:
+		return 0;
+	}
+
+#undef MAX
+}
+
+static void reg_reserve_temps(RhoCompiler *compiler, RhoProgram *program)
+{
+	const unsigned int base = compiler->st->ste_current->next_local_id;
+	const unsigned int temps = reg_temps_for_block(compiler, program);
+
+	if (base + temps > RHO_REG_INDEX_MASK + 1) {
+		/* too many slots to address; fall back to stack code */
+		compiler->registers = 0;
+		return;
+	}
+
+	compiler->reg_temp_base = base;
+	compiler->reg_temps = temps;
+	compiler->reg_temps_used = 0;
+}
+
+static unsigned int reg_temp_alloc(RhoCompiler *compiler)
+{
+	assert(compiler->reg_temps_used < compiler->reg_temps);
+	return compiler->reg_temp_base + compiler->reg_temps_used++;
+}
+
+static void reg_operand_free(RhoCompiler *compiler, const unsigned int operand)
+{
+	if (operand & RHO_REG_TEMP) {
+		assert(compiler->reg_temps_used > 0);
+		--compiler->reg_temps_used;
+	}
+}
+
+static void compile_reg_expr(RhoCompiler *compiler, RhoAST *ast, const unsigned int dst);
+
+static unsigned int compile_reg_operand(RhoCompiler *compiler, RhoAST *ast)
+{
+	unsigned int operand;
+
+	if (reg_is_leaf(ast)) {
+		if (!reg_leaf_operand(compiler, ast, &operand)) {
+			RHO_INTERNAL_ERROR();
+		}
+		return operand;
+	}
+
+	const unsigned int temp = reg_temp_alloc(compiler);
+	compile_reg_expr(compiler, ast, temp);
+	return temp | RHO_REG_TEMP;
+}
+
+/*
+ * Compiles the given binary operator node into slot `dst`.
+ */
+static void compile_reg_expr(RhoCompiler *compiler, RhoAST *ast, const unsigned int dst)
+{
+	const unsigned int a = compile_reg_operand(compiler, ast->left);
+	const unsigned int b = compile_reg_operand(compiler, ast->right);
+
+	write_ins(compiler, RHO_INS_REG_BINOP, ast->lineno);
+	write_uint16(compiler, to_opcode(ast->type));
+	write_uint16(compiler, dst);
+	write_uint16(compiler, a);
+	write_uint16(compiler, b);
+
+	reg_operand_free(compiler, b);
+	reg_operand_free(compiler, a);
+}
+
+static bool compile_reg_assignment(RhoCompiler *compiler, RhoAST *ast)
+{
+	if (!reg_assignment_ok(compiler, ast)) {
+		return false;
+	}
+
+	const unsigned int lineno = ast->lineno;
+	const unsigned int dst = reg_local_slot(compiler, ast->left);
+	RhoAST *rhs = ast->right;
+
+	if (ast->type == RHO_NODE_ASSIGN) {
+		if (reg_is_leaf(rhs)) {
+			const unsigned int src = compile_reg_operand(compiler, rhs);
+			write_ins(compiler, RHO_INS_REG_MOVE, lineno);
+			write_uint16(compiler, dst);
+			write_uint16(compiler, src);
+		} else {
+			compile_reg_expr(compiler, rhs, dst);
+		}
+	} else {
+		const unsigned int b = compile_reg_operand(compiler, rhs);
+		write_ins(compiler, RHO_INS_REG_BINOP, lineno);
+		write_uint16(compiler, to_opcode(ast->type));
+		write_uint16(compiler, dst);
+		write_uint16(compiler, dst);
+		write_uint16(compiler, b);
+		reg_operand_free(compiler, b);
+	}
+
+	assert(compiler->reg_temps_used == 0);
+	return true;
+}
+
+/*
+ * Compiles the given condition followed by a jump that's taken if
+ * the condition is false, and returns that jump (see `write_jump`),
+ * whose target must be set by the caller.
+ */
+static size_t compile_cond_jump(RhoCompiler *compiler, RhoAST *cond, const unsigned int lineno)
+{
+	size_t jmp;
+
+	if (compiler->registers && reg_cond_ok(compiler, cond)) {
+		const unsigned int a = compile_reg_operand(compiler, cond->left);
+		const unsigned int b = compile_reg_operand(compiler, cond->right);
+
+		jmp = write_jump(compiler, RHO_INS_REG_CMP_BRANCH, cond->lineno);
+		write_uint16(compiler, to_opcode(cond->type));
+		write_uint16(compiler, a);
+		write_uint16(compiler, b);
+
+		reg_operand_free(compiler, b);
+		reg_operand_free(compiler, a);
+		assert(compiler->reg_temps_used == 0);
+	} else {
+		compile_node(compiler, cond, false);
+		jmp = write_jump(compiler, RHO_INS_JMP_IF_FALSE, lineno);
+	}
+
+	write_uint16(compiler, 0);
+	return jmp;
+}
+
+/*
+ * Loop-invariant loads
+ * --------------------
+ * Builtins (LOAD_NAME) never change once the VM is up, and globals
+ * (LOAD_GLOBAL) are only assigned to by module-level code and by
+ * compound assignments in functions (STORE_GLOBAL). So within a
+ * function, a global that no function assigns to cannot change while
+ * a loop runs -- unless module-level code gets to run in the meantime,
+ * as it can between the PRODUCEs of a generator or concurrently with
+ * an actor, which is why these only hoist builtins.
+ *
+ * Ahead of each outermost loop, every such name used in the loop is
+ * loaded into a hidden local slot by HOIST_GLOBAL or HOIST_NAME (which
+ * leave the slot empty if the name is unbound), and the loop then uses
+ * a plain LOAD of that slot instead. The hidden slots come after any
+ * register temporaries and are named after the name they hold, so an
+ * unbound name is still reported, as such, where it is used.
+ */
+
+#define HOIST_MAX_SLOTS 0xffff
+
+static bool hoistable(RhoCompiler *compiler, const RhoSTSymbol *sym)
+{
+	if (sym->bound_here) {
+		return false;
+	}
+
+	if (sym->global_var) {
+		if (!compiler->hoist_globals) {
+			return false;
+		}
+
+		const RhoSTSymbol *global = rho_ste_get_symbol(compiler->st->ste_module, sym->key);
+		return global != NULL && !global->global_store;
+	}
+
+	return sym->free_var;
+}
+
+static int hoist_index(RhoCompiler *compiler, const RhoSTSymbol *sym)
+{
+	for (unsigned int i = 0; i < compiler->n_hoisted; i++) {
+		if (compiler->hoisted[i] == sym) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+/*
+ * Finds the hoistable names used in `ast`. If `activate` is false,
+ * they are assigned slots; otherwise, those that have slots are
+ * marked as live for the loop being compiled.
+ */
+static void hoist_scan(RhoCompiler *compiler, RhoAST *ast, const bool activate);
+
+static void hoist_scan_list(RhoCompiler *compiler, struct rho_ast_list *list, const bool activate)
+{
+	for (struct rho_ast_list *node = list; node != NULL; node = node->next) {
+		hoist_scan(compiler, node->ast, activate);
+	}
+}
+
+static void hoist_scan(RhoCompiler *compiler, RhoAST *ast, const bool activate)
+{
+	if (ast == NULL) {
+		return;
+	}
+
+	switch (ast->type) {
+	case RHO_NODE_INT:
+	case RHO_NODE_FLOAT:
+	case RHO_NODE_STRING:
+	case RHO_NODE_LAMBDA:
+		return;
+	case RHO_NODE_IDENT: {
+		RhoSTSymbol *sym = rho_ste_get_symbol(compiler->st->ste_current, ast->v.ident);
+
+		if (sym == NULL || !hoistable(compiler, sym)) {
+			return;
+		}
+
+		const int index = hoist_index(compiler, sym);
+
+		if (activate) {
+			if (index >= 0) {
+				compiler->hoist_live[index] = true;
+			}
+		} else if (index < 0 &&
+		           sym->id <= 0xffff &&  /* HOIST_* can't extend their second argument */
+		           compiler->hoist_base + compiler->n_hoisted < HOIST_MAX_SLOTS) {
+			const unsigned int n = compiler->n_hoisted++;
+			compiler->hoisted = rho_realloc(compiler->hoisted, (n + 1) * sizeof(RhoSTSymbol *));
+			compiler->hoisted[n] = sym;
+		}
+		return;
+	}
+	case RHO_NODE_DOT:
+		hoist_scan(compiler, ast->left, activate);
+		return;
+	case RHO_NODE_DEF:
+	case RHO_NODE_GEN:
+	case RHO_NODE_ACT:
+		/* only default argument values are evaluated here */
+		for (struct rho_ast_list *param = ast->v.params; param != NULL; param = param->next) {
+			if (param->ast->type == RHO_NODE_ASSIGN) {
+				hoist_scan(compiler, param->ast->right, activate);
+			}
+		}
+		return;
+	case RHO_NODE_IF:
+		/* elif chains can be long, so aren't walked recursively */
+		for (RhoAST *node = ast; node != NULL; node = node->v.middle) {
+			hoist_scan(compiler, node->left, activate);
+			hoist_scan(compiler, node->right, activate);
+		}
+		return;
+	case RHO_NODE_FOR:
+	case RHO_NODE_COND_EXPR:
+		hoist_scan(compiler, ast->v.middle, activate);
+		break;
+	case RHO_NODE_BLOCK:
+		hoist_scan_list(compiler, ast->v.block, activate);
+		break;
+	case RHO_NODE_LIST:
+	case RHO_NODE_TUPLE:
+	case RHO_NODE_SET:
+	case RHO_NODE_DICT:
+		hoist_scan_list(compiler, ast->v.list, activate);
+		break;
+	case RHO_NODE_CALL:
+		hoist_scan_list(compiler, ast->v.params, activate);
+
+		if (inline_target(compiler, ast) != NULL) {
+			return;  // the callee isn't loaded
+		}
+		break;
+	case RHO_NODE_TRY_CATCH:
+		hoist_scan_list(compiler, ast->v.excs, activate);
+		break;
+	default:
+		break;
+	}
+
+	hoist_scan(compiler, ast->left, activate);
+	hoist_scan(compiler, ast->right, activate);
+}
+
+static void hoist_scan_loop(RhoCompiler *compiler, RhoAST *loop, const bool activate)
+{
+	if (loop->type == RHO_NODE_WHILE) {
+		hoist_scan(compiler, loop->left, activate);   // condition
+		hoist_scan(compiler, loop->right, activate);  // body
+	} else {
+		RHO_AST_TYPE_ASSERT(loop, RHO_NODE_FOR);
+		hoist_scan(compiler, loop->v.middle, activate);  // body (the iterable is evaluated once)
+	}
+}
+
+static void hoist_reserve_stmt(RhoCompiler *compiler, RhoAST *ast)
+{
+	if (ast == NULL) {
+		return;
+	}
+
+	switch (ast->type) {
+	case RHO_NODE_WHILE:
+	case RHO_NODE_FOR:
+		hoist_scan_loop(compiler, ast, false);
+		break;
+	case RHO_NODE_IF:
+		/* elif chains can be long, so aren't walked recursively */
+		for (RhoAST *node = ast; node != NULL; node = node->v.middle) {
+			hoist_reserve_stmt(compiler, (node->type == RHO_NODE_ELSE) ? node->left : node->right);
+		}
+		break;
+	case RHO_NODE_TRY_CATCH:
+		hoist_reserve_stmt(compiler, ast->left);
+		hoist_reserve_stmt(compiler, ast->right);
+		break;
+	case RHO_NODE_BLOCK:
+		for (struct rho_ast_list *node = ast->v.block; node != NULL; node = node->next) {
+			hoist_reserve_stmt(compiler, node->ast);
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+static void hoist_reserve(RhoCompiler *compiler, RhoProgram *program)
+{
+	compiler->hoist_base = compiler->st->ste_current->next_local_id + compiler->reg_temps;
+
+	for (struct rho_ast_list *node = program; node != NULL; node = node->next) {
+		hoist_reserve_stmt(compiler, node->ast);
+	}
+
+	compiler->hoist_live = rho_calloc(compiler->n_hoisted, sizeof(bool));
+}
+
+/*
+ * Emits the hoisted loads for the given loop, if it is an outermost
+ * one. Returns whether anything was hoisted, in which case the names
+ * stay live until hoist_end() is called after the loop.
+ */
+static bool hoist_begin(RhoCompiler *compiler, RhoAST *loop, const unsigned int lineno)
+{
+	if (compiler->n_hoisted == 0 || compiler->lbi != NULL) {
+		return false;
+	}
+
+	hoist_scan_loop(compiler, loop, true);
+	bool hoisted = false;
+
+	for (unsigned int i = 0; i < compiler->n_hoisted; i++) {
+		if (!compiler->hoist_live[i]) {
+			continue;
+		}
+
+		const RhoSTSymbol *sym = compiler->hoisted[i];
+		write_ins(compiler, sym->global_var ? RHO_INS_HOIST_GLOBAL : RHO_INS_HOIST_NAME, lineno);
+		write_uint16(compiler, compiler->hoist_base + i);
+		write_uint16(compiler, sym->id);
+		hoisted = true;
+	}
+
+	return hoisted;
+}
+
+static void hoist_end(RhoCompiler *compiler)
+{
+	memset(compiler->hoist_live, 0, compiler->n_hoisted * sizeof(bool));
+}
+
+/* local slot holding `sym` in the loop being compiled, or -1 */
+static int hoist_slot(RhoCompiler *compiler, const RhoSTSymbol *sym)
+{
+	const int index = hoist_index(compiler, sym);
+
+	if (index < 0 || !compiler->hoist_live[index]) {
+		return -1;
+	}
+
+	return compiler->hoist_base + index;
+}
+
+/*
+ * Typed arithmetic
+ * ----------------
+ * A parameter hinted as `Int` or `Float` is checked against its hint
+ * whenever the function is called (see rho_codeobj_load_args), so
+ * together with literals, such parameters give us values of a known
+ * type. From these we infer the types of locals: a local is an Int
+ * (say) if every assignment to it in the function body assigns an Int
+ * given that all the locals we've assumed to be Ints are, which is
+ * found by starting from the assumption that every local is an Int and
+ * dropping the ones that violate it until nothing changes. Loop
+ * variables of `for` loops over ranges (`a..b`) are always Ints.
+ *
+ * Binary operations whose operands are all Ints (or all Floats) are
+ * then compiled to INT_BINOP or FLOAT_BINOP, which compute the result
+ * directly rather than dispatching on the operands' classes. The hint
+ * checks at call time are the only guards needed: a local is only ever
+ * read through LOAD, which fails if it's unbound, so a typed operation
+ * never sees anything else. Only the builtin `Int` and `Float` count,
+ * so a hint naming something that shadows them is ignored.
+ */
+
+#define STATIC_TYPE_ANY   0
+#define STATIC_TYPE_INT   1
+#define STATIC_TYPE_FLOAT 2
+#define STATIC_TYPE_NONE  3  /* no assignment seen */
+
+static int static_type(RhoCompiler *compiler, RhoAST *ast);
+
+/*
+ * Returns the type of the result of binary operator `type` applied to
+ * two values of static type `operands`.
+ */
+static int binop_result_type(const RhoNodeType type, const int operands)
+{
+	switch (type) {
+	case RHO_NODE_ADD:
+	case RHO_NODE_SUB:
+	case RHO_NODE_MUL:
+	case RHO_NODE_DIV:
+	case RHO_NODE_ASSIGN_ADD:
+	case RHO_NODE_ASSIGN_SUB:
+	case RHO_NODE_ASSIGN_MUL:
+	case RHO_NODE_ASSIGN_DIV:
+		return operands;
+	case RHO_NODE_MOD:
+	case RHO_NODE_BITAND:
+	case RHO_NODE_BITOR:
+	case RHO_NODE_XOR:
+	case RHO_NODE_SHIFTL:
+	case RHO_NODE_SHIFTR:
+	case RHO_NODE_ASSIGN_MOD:
+	case RHO_NODE_ASSIGN_BITAND:
+	case RHO_NODE_ASSIGN_BITOR:
+	case RHO_NODE_ASSIGN_XOR:
+	case RHO_NODE_ASSIGN_SHIFTL:
+	case RHO_NODE_ASSIGN_SHIFTR:
+		return (operands == STATIC_TYPE_INT) ? operands : STATIC_TYPE_ANY;
+	default:
+		return STATIC_TYPE_ANY;
+	}
+}
+
+/*
+ * Returns the type for which the binary operation `ast` can be
+ * compiled to typed arithmetic, or STATIC_TYPE_ANY if it can't.
+ */
+static int typed_binop(RhoCompiler *compiler, RhoAST *ast)
+{
+	if (compiler->local_types == NULL) {
+		return STATIC_TYPE_ANY;
+	}
+
+	switch (ast->type) {
+	case RHO_NODE_ADD:
+	case RHO_NODE_SUB:
+	case RHO_NODE_MUL:
+	case RHO_NODE_DIV:
+	case RHO_NODE_BITAND:
+	case RHO_NODE_BITOR:
+	case RHO_NODE_XOR:
+	case RHO_NODE_SHIFTL:
+	case RHO_NODE_SHIFTR:
+	case RHO_NODE_EQUAL:
+	case RHO_NODE_NOTEQ:
+	case RHO_NODE_LT:
+	case RHO_NODE_GT:
+	case RHO_NODE_LE:
+	case RHO_NODE_GE:
+		break;
+	default:
+		return STATIC_TYPE_ANY;
+	}
+
+	const int type = static_type(compiler, ast->left);
+
+	if (type == STATIC_TYPE_ANY || static_type(compiler, ast->right) != type) {
+		return STATIC_TYPE_ANY;
+	}
+
+	switch (ast->type) {
+	case RHO_NODE_DIV:
+		/* Int division has to check for zero */
+		return (type == STATIC_TYPE_FLOAT) ? type : STATIC_TYPE_ANY;
+	case RHO_NODE_BITAND:
+	case RHO_NODE_BITOR:
+	case RHO_NODE_XOR:
+	case RHO_NODE_SHIFTL:
+	case RHO_NODE_SHIFTR:
+		return (type == STATIC_TYPE_INT) ? type : STATIC_TYPE_ANY;
+	default:
+		return type;
+	}
+}
+
+static int static_type(RhoCompiler *compiler, RhoAST *ast)
+{
+	switch (ast->type) {
+	case RHO_NODE_INT:
+		return STATIC_TYPE_INT;
+	case RHO_NODE_FLOAT:
+		return STATIC_TYPE_FLOAT;
+	case RHO_NODE_IDENT: {
+		const RhoSTSymbol *sym = rho_ste_get_symbol(compiler->st->ste_current, ast->v.ident);
+
+		if (sym == NULL || !sym->bound_here || sym->id >= compiler->n_local_types) {
+			return STATIC_TYPE_ANY;
+		}
+
+		return compiler->local_types[sym->id];
+	}
+	case RHO_NODE_UPLUS:
+	case RHO_NODE_UMINUS:
+		return static_type(compiler, ast->left);
+	case RHO_NODE_CALL:
+		return inline_call_type(compiler, ast);
+	default: {
+		if (compiler->local_types == NULL || ast->left == NULL || ast->right == NULL) {
+			return STATIC_TYPE_ANY;
+		}
+
+		const int type = static_type(compiler, ast->left);
+
+		if (type == STATIC_TYPE_ANY || static_type(compiler, ast->right) != type) {
+			return STATIC_TYPE_ANY;
+		}
+
+		return binop_result_type(ast->type, type);
+	}
+	}
+}
+
+static void typed_locals_bind(RhoCompiler *compiler, RhoAST *ident, const int type, unsigned char *assigned)
+{
+	const RhoSTSymbol *sym = rho_ste_get_symbol(compiler->st->ste_current, ident->v.ident);
+
+	if (sym == NULL || !sym->bound_here || sym->id >= compiler->n_local_types) {
+		return;
+	}
+
+	const unsigned int id = sym->id;
+
+	if (assigned[id] == STATIC_TYPE_NONE) {
+		assigned[id] = type;
+	} else if (assigned[id] != type) {
+		assigned[id] = STATIC_TYPE_ANY;
+	}
+}
+
+/*
+ * Records the types of the values assigned to locals in `ast` (not
+ * counting nested functions) in `assigned`.
+ */
+static void typed_locals_scan(RhoCompiler *compiler, RhoAST *ast, unsigned char *assigned);
+
+static void typed_locals_scan_list(RhoCompiler *compiler, struct rho_ast_list *list, unsigned char *assigned)
+{
+	for (struct rho_ast_list *node = list; node != NULL; node = node->next) {
+		typed_locals_scan(compiler, node->ast, assigned);
+	}
+}
+
+static void typed_locals_scan(RhoCompiler *compiler, RhoAST *ast, unsigned char *assigned)
+{
+	if (ast == NULL) {
+		return;
+	}
+
+	if (RHO_NODE_TYPE_IS_ASSIGNMENT(ast->type) && ast->left->type == RHO_NODE_IDENT) {
+		int type;
+
+		if (ast->type == RHO_NODE_ASSIGN) {
+			type = static_type(compiler, ast->right);
+		} else {
+			const int operands = static_type(compiler, ast->left);
+			type = (operands == static_type(compiler, ast->right)) ?
+			         binop_result_type(ast->type, operands) : STATIC_TYPE_ANY;
+		}
+
+		typed_locals_bind(compiler, ast->left, type, assigned);
+		typed_locals_scan(compiler, ast->right, assigned);
+		return;
+	}
+
+	if (ast->type == RHO_NODE_ASSIGN && ast->left->type == RHO_NODE_TUPLE) {
+		/* (a, b) = (x, y) assigns elementwise; anything else is unknown */
+		struct rho_ast_list *value = (ast->right->type == RHO_NODE_TUPLE &&
+		                              ast_list_length(ast->left->v.list) ==
+		                                ast_list_length(ast->right->v.list)) ? ast->right->v.list : NULL;
+
+		for (struct rho_ast_list *node = ast->left->v.list; node != NULL; node = node->next) {
+			const int type = (value != NULL) ? static_type(compiler, value->ast) : STATIC_TYPE_ANY;
+			typed_locals_bind(compiler, node->ast, type, assigned);
+
+			if (value != NULL) {
+				value = value->next;
+			}
+		}
+
+		typed_locals_scan(compiler, ast->right, assigned);
+		return;
+	}
+
+	switch (ast->type) {
+	case RHO_NODE_INT:
+	case RHO_NODE_FLOAT:
+	case RHO_NODE_STRING:
+	case RHO_NODE_IDENT:
+	case RHO_NODE_LAMBDA:
+		return;
+	case RHO_NODE_RECEIVE:
+	case RHO_NODE_IMPORT:
+		typed_locals_bind(compiler, ast->left, STATIC_TYPE_ANY, assigned);
+		return;
+	case RHO_NODE_DEF:
+	case RHO_NODE_GEN:
+	case RHO_NODE_ACT:
+		typed_locals_bind(compiler, ast->left, STATIC_TYPE_ANY, assigned);
+		return;
+	case RHO_NODE_FOR:
+		if (ast->left->type == RHO_NODE_IDENT) {
+			const int type = (ast->right->type == RHO_NODE_DOTDOT) ? STATIC_TYPE_INT : STATIC_TYPE_ANY;
+			typed_locals_bind(compiler, ast->left, type, assigned);
+		} else {
+			for (struct rho_ast_list *node = ast->left->v.list; node != NULL; node = node->next) {
+				typed_locals_bind(compiler, node->ast, STATIC_TYPE_ANY, assigned);
+			}
+		}
+
+		typed_locals_scan(compiler, ast->right, assigned);
+		typed_locals_scan(compiler, ast->v.middle, assigned);
+		return;
+	case RHO_NODE_IF:
+		/* elif chains can be long, so aren't walked recursively */
+		for (RhoAST *node = ast; node != NULL; node = node->v.middle) {
+			typed_locals_scan(compiler, node->left, assigned);
+			typed_locals_scan(compiler, node->right, assigned);
+		}
+		return;
+	case RHO_NODE_COND_EXPR:
+		typed_locals_scan(compiler, ast->v.middle, assigned);
+		break;
+	case RHO_NODE_BLOCK:
+		typed_locals_scan_list(compiler, ast->v.block, assigned);
+		return;
+	case RHO_NODE_LIST:
+	case RHO_NODE_TUPLE:
+	case RHO_NODE_SET:
+	case RHO_NODE_DICT:
+		typed_locals_scan_list(compiler, ast->v.list, assigned);
+		return;
+	case RHO_NODE_CALL:
+		for (struct rho_ast_list *param = ast->v.params; param != NULL; param = param->next) {
+			/* named arguments look like assignments, but aren't */
+			RhoAST *arg = (param->ast->type == RHO_NODE_ASSIGN) ? param->ast->right : param->ast;
+			typed_locals_scan(compiler, arg, assigned);
+		}
+		typed_locals_scan(compiler, ast->left, assigned);
+		return;
+	case RHO_NODE_TRY_CATCH:
+		typed_locals_scan_list(compiler, ast->v.excs, assigned);
+		break;
+	default:
+		break;
+	}
+
+	typed_locals_scan(compiler, ast->left, assigned);
+	typed_locals_scan(compiler, ast->right, assigned);
+}
+
+/*
+ * Infers the static types of the locals of the function `ast`, whose
+ * scope is the current one. `parent` is the enclosing scope, in which
+ * the parameters' hints are evaluated.
+ */
+static void typed_locals_init(RhoCompiler *compiler, RhoAST *ast, RhoSTEntry *parent)
+{
+	const unsigned int n = compiler->st->ste_current->next_local_id;
+
+	if (n == 0) {
+		return;
+	}
+
+	unsigned char *types = rho_calloc(n, sizeof(unsigned char));
+	unsigned char *hints = rho_calloc(n, sizeof(unsigned char));
+	unsigned char *assigned = rho_malloc(n * sizeof(unsigned char));
+	unsigned int nparams = 0;
+
+	for (struct rho_ast_list *param = ast->v.params; param != NULL; param = param->next, nparams++) {
+		RhoAST *v = (param->ast->type == RHO_NODE_ASSIGN) ? param->ast->left : param->ast;
+		RhoAST *hint = v->left;
+
+		if (hint == NULL) {
+			continue;
+		}
+
+		const RhoSTSymbol *hint_sym = rho_ste_get_symbol(parent, hint->v.ident);
+
+		if (hint_sym == NULL || hint_sym->bound_here || hint_sym->global_var || !hint_sym->free_var) {
+			continue;
+		}
+
+		assert(rho_ste_get_symbol(compiler->st->ste_current, v->v.ident)->id == nparams);
+
+		if (strcmp(hint->v.ident->value, "Int") == 0) {
+			hints[nparams] = STATIC_TYPE_INT;
+		} else if (strcmp(hint->v.ident->value, "Float") == 0) {
+			hints[nparams] = STATIC_TYPE_FLOAT;
+		}
+	}
+
+	compiler->local_types = types;
+	compiler->n_local_types = n;
+
+	static const unsigned char passes[] = {STATIC_TYPE_INT, STATIC_TYPE_FLOAT};
+	bool any = false;
+
+	for (size_t p = 0; p < sizeof(passes); p++) {
+		const unsigned char type = passes[p];
+
+		for (unsigned int i = 0; i < n; i++) {
+			if (types[i] == STATIC_TYPE_ANY && (i >= nparams || hints[i] == type)) {
+				types[i] = type;
+			}
+		}
+
+		bool changed;
+		do {
+			memset(assigned, STATIC_TYPE_NONE, n);
+			typed_locals_scan(compiler, ast->right, assigned);
+			changed = false;
+
+			for (unsigned int i = 0; i < n; i++) {
+				if (types[i] == type && assigned[i] != STATIC_TYPE_NONE && assigned[i] != type) {
+					types[i] = STATIC_TYPE_ANY;
+					changed = true;
+				}
+			}
+		} while (changed);
+
+		for (unsigned int i = 0; i < n; i++) {
+			if (types[i] == type) {
+				any = true;
+			}
+		}
+	}
+
+	free(assigned);
+	free(hints);
+
+	if (!any) {
+		free(types);
+		compiler->local_types = NULL;
+		compiler->n_local_types = 0;
+	}
+}
+
+/*
+ * Inlining
+ * --------
+ * A call to a small function defined at module level, like
+ *
+ *     def sq(x) { return x * x }
+ *
+ * is compiled to the function's body, with the arguments held in
+ * temporary locals, when nothing about the call could tell the two
+ * apart. This requires that:
+ *
+ *   - the function's name is bound only by its `def`, which is a
+ *     top-level statement, and the call is on a later line than the
+ *     body. A top-level statement can't contain another, so the call
+ *     then belongs to a later statement (or a function defined by
+ *     one), and can only run once the name is bound to the function.
+ *
+ *   - the body is a single `return` of arithmetic on the parameters
+ *     and numeric literals which, given the static types of the
+ *     arguments (see "Typed arithmetic"), compiles to typed operations
+ *     only. Such a body can't fail, so no traceback ever misses the
+ *     function's frame, and the inlined code carries the line number
+ *     of the call.
+ *
+ *   - the arguments, counting named ones and literal defaults, match
+ *     the parameters, and they and the result satisfy the function's
+ *     `Int` or `Float` hints.
+ *
+ * Arguments are evaluated in the order they're written, just as for a
+ * real call, except that literal ones are substituted directly.
+ */
+
+#define INLINE_MAX_PARAMS 8
+#define INLINE_MAX_NODES  32
+#define INLINE_UNSAFE     (-1)
+
+struct rho_inline_func {
+	RhoStr *name;
+	RhoAST *def;
+	RhoAST *body;      /* the returned expression */
+	unsigned int nparams;
+	RhoAST *params[INLINE_MAX_PARAMS];
+	RhoAST *defaults[INLINE_MAX_PARAMS];
+	unsigned char hints[INLINE_MAX_PARAMS];
+	unsigned char ret_hint;
+};
+
+struct inline_call {
+	const struct rho_inline_func *func;
+	RhoAST *args[INLINE_MAX_PARAMS];   /* argument of each parameter */
+	unsigned char types[INLINE_MAX_PARAMS];
+	unsigned int order[INLINE_MAX_PARAMS];  /* parameter of each argument, as written */
+	unsigned int nargs;
+	unsigned int temps;    /* number of non-literal arguments */
+	int type;              /* static type of the result */
+};
+
+static bool is_numeric_literal(RhoAST *ast)
+{
+	return ast->type == RHO_NODE_INT || ast->type == RHO_NODE_FLOAT;
+}
+
+static int inline_param_index(const struct rho_inline_func *func, RhoStr *name)
+{
+	for (unsigned int i = 0; i < func->nparams; i++) {
+		if (rho_str_eq(func->params[i]->v.ident, name)) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+/*
+ * Returns the number of nodes in the expression `ast`, or 0 if it
+ * contains anything other than parameters of `func`, numeric literals
+ * and operators that have typed counterparts.
+ */
+static unsigned int inline_body_size(const struct rho_inline_func *func, RhoAST *ast)
+{
+	switch (ast->type) {
+	case RHO_NODE_INT:
+	case RHO_NODE_FLOAT:
+		return 1;
+	case RHO_NODE_IDENT:
+		return (inline_param_index(func, ast->v.ident) >= 0) ? 1 : 0;
+	case RHO_NODE_UPLUS:
+	case RHO_NODE_UMINUS: {
+		const unsigned int size = inline_body_size(func, ast->left);
+		return size ? size + 1 : 0;
+	}
+	case RHO_NODE_ADD:
+	case RHO_NODE_SUB:
+	case RHO_NODE_MUL:
+	case RHO_NODE_DIV:
+	case RHO_NODE_BITAND:
+	case RHO_NODE_BITOR:
+	case RHO_NODE_XOR:
+	case RHO_NODE_SHIFTL:
+	case RHO_NODE_SHIFTR:
+	case RHO_NODE_EQUAL:
+	case RHO_NODE_NOTEQ:
+	case RHO_NODE_LT:
+	case RHO_NODE_GT:
+	case RHO_NODE_LE:
+	case RHO_NODE_GE: {
+		const unsigned int left = inline_body_size(func, ast->left);
+		const unsigned int right = inline_body_size(func, ast->right);
+		return (left && right) ? left + right + 1 : 0;
+	}
+	default:
+		return 0;
+	}
+}
+
+/*
+ * Returns the static type of `ast`, part of the body of `func`, given
+ * the static types of the parameters, or INLINE_UNSAFE if it can't be
+ * compiled to typed operations.
+ */
+static int inline_type(const struct rho_inline_func *func, RhoAST *ast, const unsigned char *types)
+{
+	switch (ast->type) {
+	case RHO_NODE_INT:
+		return STATIC_TYPE_INT;
+	case RHO_NODE_FLOAT:
+		return STATIC_TYPE_FLOAT;
+	case RHO_NODE_IDENT:
+		return types[inline_param_index(func, ast->v.ident)];
+	case RHO_NODE_UPLUS:
+	case RHO_NODE_UMINUS: {
+		const int type = inline_type(func, ast->left, types);
+		return (type == STATIC_TYPE_INT || type == STATIC_TYPE_FLOAT) ? type : INLINE_UNSAFE;
+	}
+	default:
+		break;
+	}
+
+	const int type = inline_type(func, ast->left, types);
+
+	if ((type != STATIC_TYPE_INT && type != STATIC_TYPE_FLOAT) || inline_type(func, ast->right, types) != type) {
+		return INLINE_UNSAFE;
+	}
+
+	switch (ast->type) {
+	case RHO_NODE_EQUAL:
+	case RHO_NODE_NOTEQ:
+	case RHO_NODE_LT:
+	case RHO_NODE_GT:
+	case RHO_NODE_LE:
+	case RHO_NODE_GE:
+		return STATIC_TYPE_ANY;
+	case RHO_NODE_DIV:
+		/* Int division has to check for zero */
+		return (type == STATIC_TYPE_FLOAT) ? type : INLINE_UNSAFE;
+	default: {
+		const int result = binop_result_type(ast->type, type);
+		return (result == STATIC_TYPE_ANY) ? INLINE_UNSAFE : result;
+	}
+	}
+}
+
+/*
+ * Counts the bindings of each module-level variable in module-level
+ * code (i.e. not within functions, where assignments bind locals),
+ * adding them to `counts`, which is indexed by symbol ID.
+ */
+static void inline_bindings(RhoCompiler *compiler, RhoAST *ast, unsigned int *counts);
+
+static void inline_bindings_list(RhoCompiler *compiler, struct rho_ast_list *list, unsigned int *counts)
+{
+	for (struct rho_ast_list *node = list; node != NULL; node = node->next) {
+		inline_bindings(compiler, node->ast, counts);
+	}
+}
+
+static void inline_binds(RhoCompiler *compiler, RhoAST *target, unsigned int *counts)
+{
+	if (target->type == RHO_NODE_IDENT) {
+		const RhoSTSymbol *sym = rho_ste_get_symbol(compiler->st->ste_module, target->v.ident);
+
+		if (sym != NULL && sym->bound_here) {
+			++counts[sym->id];
+		}
+	} else if (target->type == RHO_NODE_TUPLE) {
+		inline_bindings_list(compiler, target->v.list, counts);
+	}
+}
+
+static void inline_bindings(RhoCompiler *compiler, RhoAST *ast, unsigned int *counts)
+{
+	if (ast == NULL) {
+		return;
+	}
+
+	if (RHO_NODE_TYPE_IS_ASSIGNMENT(ast->type)) {
+		inline_binds(compiler, ast->left, counts);
+		inline_bindings(compiler, ast->right, counts);
+		return;
+	}
+
+	switch (ast->type) {
+	case RHO_NODE_IDENT:
+	case RHO_NODE_LAMBDA:
+		break;
+	case RHO_NODE_DEF:
+	case RHO_NODE_GEN:
+	case RHO_NODE_ACT:
+	case RHO_NODE_IMPORT:
+	case RHO_NODE_RECEIVE:
+		inline_binds(compiler, ast->left, counts);
+		break;
+	case RHO_NODE_FOR:
+		inline_binds(compiler, ast->left, counts);
+		inline_bindings(compiler, ast->right, counts);
+		inline_bindings(compiler, ast->v.middle, counts);
+		break;
+	case RHO_NODE_IF:
+		/* elif chains can be long, so aren't walked recursively */
+		for (RhoAST *node = ast; node != NULL; node = node->v.middle) {
+			inline_bindings(compiler, node->left, counts);
+			inline_bindings(compiler, node->right, counts);
+		}
+		break;
+	case RHO_NODE_COND_EXPR:
+		inline_bindings(compiler, ast->left, counts);
+		inline_bindings(compiler, ast->right, counts);
+		inline_bindings(compiler, ast->v.middle, counts);
+		break;
+	case RHO_NODE_BLOCK:
+		inline_bindings_list(compiler, ast->v.block, counts);
+		break;
+	case RHO_NODE_LIST:
+	case RHO_NODE_TUPLE:
+	case RHO_NODE_SET:
+	case RHO_NODE_DICT:
+		inline_bindings_list(compiler, ast->v.list, counts);
+		break;
+	case RHO_NODE_CALL:
+		inline_bindings(compiler, ast->left, counts);
+		inline_bindings_list(compiler, ast->v.params, counts);
+		break;
+	case RHO_NODE_TRY_CATCH:
+		inline_bindings(compiler, ast->left, counts);
+		inline_bindings(compiler, ast->right, counts);
+		inline_bindings_list(compiler, ast->v.excs, counts);
+		break;
+	default:
+		inline_bindings(compiler, ast->left, counts);
+		inline_bindings(compiler, ast->right, counts);
+		break;
+	}
+}
+
+/*
+ * Sets `type` to the type named by the hint `hint` (which may be NULL,
+ * for no hint). As in typed_locals_init, only the builtin `Int` and
+ * `Float` are understood; returns false for anything else.
+ */
+static bool inline_hint(RhoCompiler *compiler, RhoAST *hint, unsigned char *type)
+{
+	*type = STATIC_TYPE_ANY;
+
+	if (hint == NULL) {
+		return true;
+	}
+
+	const RhoSTSymbol *hint_sym = rho_ste_get_symbol(compiler->st->ste_module, hint->v.ident);
+
+	if (hint_sym == NULL || hint_sym->bound_here || hint_sym->global_var || !hint_sym->free_var) {
+		return false;
+	}
+
+	if (strcmp(hint->v.ident->value, "Int") == 0) {
+		*type = STATIC_TYPE_INT;
+	} else if (strcmp(hint->v.ident->value, "Float") == 0) {
+		*type = STATIC_TYPE_FLOAT;
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * Fills in `func` for the top-level statement `ast` if it defines a
+ * function whose calls can be inlined, and returns whether it does.
+ */
+static bool inline_candidate(RhoCompiler *compiler, RhoAST *ast, const unsigned int *bindings, struct rho_inline_func *func)
+{
+	if (ast->type != RHO_NODE_DEF) {
+		return false;
+	}
+
+	RhoBlock *block = ast->right->v.block;
+
+	if (block == NULL || block->next != NULL ||
+	    block->ast->type != RHO_NODE_RETURN || block->ast->left == NULL) {
+		return false;
+	}
+
+	func->name = ast->left->v.ident;
+	func->def = ast;
+	func->body = block->ast->left;
+	func->nparams = 0;
+
+	for (struct rho_ast_list *param = ast->v.params; param != NULL; param = param->next) {
+		if (func->nparams == INLINE_MAX_PARAMS) {
+			return false;
+		}
+
+		const unsigned int i = func->nparams++;
+		RhoAST *v = (param->ast->type == RHO_NODE_ASSIGN) ? param->ast->left : param->ast;
+		RhoAST *hint = v->left;
+
+		func->params[i] = v;
+		func->defaults[i] = (param->ast->type == RHO_NODE_ASSIGN) ? param->ast->right : NULL;
+		if (!inline_hint(compiler, hint, &func->hints[i])) {
+			return false;
+		}
+	}
+
+	if (!inline_hint(compiler, ast->left->left, &func->ret_hint)) {
+		return false;
+	}
+
+	if (inline_body_size(func, func->body) == 0 || inline_body_size(func, func->body) > INLINE_MAX_NODES) {
+		return false;
+	}
+
+	const RhoSTSymbol *sym = rho_ste_get_symbol(compiler->st->ste_module, func->name);
+	return sym != NULL && !sym->global_store && bindings[sym->id] == 1;
+}
+
+/*
+ * Candidates are found by their module-level symbol IDs, so that
+ * neither this nor resolving calls scans the program or the list of
+ * candidates once per function.
+ */
+static void inline_find(RhoCompiler *compiler, RhoProgram *program)
+{
+	RhoArena *arena = compiler->st->arena;
+	const unsigned int n_ids = compiler->st->ste_module->next_local_id;
+	unsigned int *bindings = rho_arena_calloc(arena, n_ids * sizeof(unsigned int));
+	inline_bindings_list(compiler, program, bindings);
+
+	compiler->inline_ids = rho_arena_calloc(arena, n_ids * sizeof(unsigned int));
+	compiler->n_inline_ids = n_ids;
+	unsigned int capacity = 0;
+
+	for (struct rho_ast_list *node = program; node != NULL; node = node->next) {
+		struct rho_inline_func func;
+
+		if (inline_candidate(compiler, node->ast, bindings, &func)) {
+			if (compiler->n_inlines == capacity) {
+				capacity = (capacity == 0) ? 8 : 2 * capacity;
+				compiler->inlines = rho_realloc(compiler->inlines, capacity * sizeof(struct rho_inline_func));
+			}
+
+			const unsigned int n = compiler->n_inlines++;
+			compiler->inlines[n] = func;
+			compiler->inline_ids[rho_ste_get_symbol(compiler->st->ste_module, func.name)->id] = n + 1;
+		}
+	}
+}
+
+/*
+ * Determines whether the call `call` can be inlined, filling in `ic`
+ * if so.
+ */
+static bool inline_resolve(RhoCompiler *compiler, RhoAST *call, struct inline_call *ic)
+{
+	RhoAST *callee = call->left;
+
+	if (compiler->n_inlines == 0 || callee->type != RHO_NODE_IDENT) {
+		return false;
+	}
+
+	RhoSTEntry *ste = compiler->st->ste_current;
+	const RhoSTSymbol *sym = rho_ste_get_symbol(ste, callee->v.ident);
+
+	if (sym == NULL || !sym->global_var || (sym->bound_here && ste != compiler->st->ste_module)) {
+		return false;
+	}
+
+	const RhoSTSymbol *global = rho_ste_get_symbol(compiler->st->ste_module, callee->v.ident);
+
+	if (global == NULL || !global->bound_here ||
+	    global->id >= compiler->n_inline_ids || compiler->inline_ids[global->id] == 0) {
+		return false;
+	}
+
+	const struct rho_inline_func *func = &compiler->inlines[compiler->inline_ids[global->id] - 1];
+
+	if (call->lineno <= func->body->lineno) {
+		return false;
+	}
+
+	ic->func = func;
+	ic->nargs = 0;
+	ic->temps = 0;
+
+	for (unsigned int i = 0; i < func->nparams; i++) {
+		ic->args[i] = NULL;
+	}
+
+	for (struct rho_ast_list *param = call->v.params; param != NULL; param = param->next) {
+		RhoAST *arg = param->ast;
+		int i;
+
+		if (arg->type == RHO_NODE_ASSIGN) {
+			i = inline_param_index(func, arg->left->v.ident);
+			arg = arg->right;
+		} else {
+			i = (ic->nargs < func->nparams) ? (int)ic->nargs : -1;
+		}
+
+		if (i < 0 || ic->args[i] != NULL) {
+			return false;
+		}
+
+		ic->args[i] = arg;
+		ic->order[ic->nargs++] = i;
+
+		if (!is_numeric_literal(arg)) {
+			++ic->temps;
+		}
+	}
+
+	for (unsigned int i = 0; i < func->nparams; i++) {
+		if (ic->args[i] == NULL) {
+			RhoAST *def = func->defaults[i];
+
+			if (def == NULL || !is_numeric_literal(def)) {
+				return false;
+			}
+
+			ic->args[i] = def;
+		}
+
+		const int type = static_type(compiler, ic->args[i]);
+
+		if (type == STATIC_TYPE_ANY || (func->hints[i] != STATIC_TYPE_ANY && func->hints[i] != type)) {
+			return false;
+		}
+
+		ic->types[i] = type;
+	}
+
+	ic->type = inline_type(func, func->body, ic->types);
+	return ic->type != INLINE_UNSAFE && (func->ret_hint == STATIC_TYPE_ANY || func->ret_hint == ic->type);
+}
+
+static int inline_call_type(RhoCompiler *compiler, RhoAST *call)
+{
+	struct inline_call ic;
+	return inline_resolve(compiler, call, &ic) ? ic.type : STATIC_TYPE_ANY;
+}
+
+/* the function that `call` would be compiled inline from, or NULL */
+static const struct rho_inline_func *inline_target(RhoCompiler *compiler, RhoAST *call)
+{
+	struct inline_call ic;
+	return inline_resolve(compiler, call, &ic) ? ic.func : NULL;
+}
+
+/*
+ * Returns the number of temporaries needed by the inlined calls in
+ * `ast` (not counting nested functions other than their defaults).
+ */
+static unsigned int inline_temps_for(RhoCompiler *compiler, RhoAST *ast);
+
+static unsigned int inline_temps_for_list(RhoCompiler *compiler, struct rho_ast_list *list)
+{
+	unsigned int max = 0;
+	for (struct rho_ast_list *node = list; node != NULL; node = node->next) {
+		const unsigned int temps = inline_temps_for(compiler, node->ast);
+		if (temps > max) {
+			max = temps;
+		}
+	}
+	return max;
+}
+
+static unsigned int inline_temps_for(RhoCompiler *compiler, RhoAST *ast)
+{
+	if (ast == NULL) {
+		return 0;
+	}
+
+	unsigned int temps = 0;
+	unsigned int more;
+
+	switch (ast->type) {
+	case RHO_NODE_INT:
+	case RHO_NODE_FLOAT:
+	case RHO_NODE_STRING:
+	case RHO_NODE_IDENT:
+	case RHO_NODE_LAMBDA:
+		return 0;
+	case RHO_NODE_DEF:
+	case RHO_NODE_GEN:
+	case RHO_NODE_ACT:
+		return inline_temps_for_list(compiler, ast->v.params);
+	case RHO_NODE_CALL: {
+		/* an inlined call's own temporaries are taken before its arguments are evaluated */
+		struct inline_call ic;
+		if (inline_resolve(compiler, ast, &ic)) {
+			return ic.temps + inline_temps_for_list(compiler, ast->v.params);
+		}
+
+		temps = inline_temps_for_list(compiler, ast->v.params);
+		break;
+	}
+	case RHO_NODE_IF:
+		/* elif chains can be long, so aren't walked recursively */
+		for (RhoAST *node = ast; node != NULL; node = node->v.middle) {
+			if ((more = inline_temps_for(compiler, node->left)) > temps) {
+				temps = more;
+			}
+
+			if ((more = inline_temps_for(compiler, node->right)) > temps) {
+				temps = more;
+			}
+		}
+		return temps;
+	case RHO_NODE_FOR:
+	case RHO_NODE_COND_EXPR:
+		temps = inline_temps_for(compiler, ast->v.middle);
+		break;
+	case RHO_NODE_BLOCK:
+		temps = inline_temps_for_list(compiler, ast->v.block);
+		break;
+	case RHO_NODE_LIST:
+	case RHO_NODE_TUPLE:
+	case RHO_NODE_SET:
+	case RHO_NODE_DICT:
+		temps = inline_temps_for_list(compiler, ast->v.list);
+		break;
+	case RHO_NODE_TRY_CATCH:
+		temps = inline_temps_for_list(compiler, ast->v.excs);
+		break;
 	default:
-		RHO_INTERNAL_ERROR();
+		break;
 	}
 
-	const unsigned int const_id = rho_ct_id_for_const(compiler->ct, value);
-	write_ins(compiler, RHO_INS_LOAD_CONST, lineno);
-	write_uint16(compiler, const_id);
-}
-
-static void compile_load(RhoCompiler *compiler, RhoAST *ast)
-{
-	RHO_AST_TYPE_ASSERT(ast, RHO_NODE_IDENT);
-
-	const unsigned int lineno = ast->lineno;
-	const RhoSTSymbol *sym = rho_ste_get_symbol(compiler->st->ste_current, ast->v.ident);
-
-	if (sym == NULL) {
-		RHO_INTERNAL_ERROR();
+	if ((more = inline_temps_for(compiler, ast->left)) > temps) {
+		temps = more;
 	}
 
-	if (sym->bound_here) {
-		write_ins(compiler, RHO_INS_LOAD, lineno);
-	} else if (sym->global_var) {
-		write_ins(compiler, RHO_INS_LOAD_GLOBAL, lineno);
-	} else {
-		assert(sym->free_var);
-		write_ins(compiler, RHO_INS_LOAD_NAME, lineno);
+	if ((more = inline_temps_for(compiler, ast->right)) > temps) {
+		temps = more;
 	}
 
-	write_uint16(compiler, sym->id);
+	return temps;
 }
 
-static void compile_assignment(RhoCompiler *compiler, RhoAST *ast)
+static void inline_reserve(RhoCompiler *compiler, RhoProgram *program)
 {
-	const RhoNodeType type = ast->type;
-	if (!RHO_NODE_TYPE_IS_ASSIGNMENT(type)) {
-		RHO_INTERNAL_ERROR();
-	}
-
-	const unsigned int lineno = ast->lineno;
-
-	RhoAST *lhs = ast->left;
-	RhoAST *rhs = ast->right;
+	compiler->inline_base = compiler->hoist_base + compiler->n_hoisted;
 
-	/*
-	 *         (assign)
-	 *        /       \
-	 *       .        rhs
-	 *      / \
-	 *    id  attr
-	 */
-	if (lhs->type == RHO_NODE_DOT) {
-		const RhoSTSymbol *sym = rho_ste_get_attr_symbol(compiler->st->ste_current, lhs->right->v.ident);
-		const unsigned int sym_id = sym->id;
+	if (compiler->n_inlines > 0) {
+		const unsigned int temps = inline_temps_for_list(compiler, program);
+		compiler->inline_temps = (compiler->inline_base + temps <= HOIST_MAX_SLOTS) ? temps : 0;
+	}
+}
 
-		if (sym == NULL) {
-			RHO_INTERNAL_ERROR();
-		}
+static void compile_inline_expr(RhoCompiler *compiler,
+                                struct inline_call *ic,
+                                RhoAST *ast,
+                                const unsigned int *slots,
+                                const unsigned int lineno)
+{
+	switch (ast->type) {
+	case RHO_NODE_INT:
+	case RHO_NODE_FLOAT: {
+		RhoCTConst value;
 
-		if (type == RHO_NODE_ASSIGN) {
-			compile_node(compiler, rhs, false);
-			compile_node(compiler, lhs->left, false);
-			write_ins(compiler, RHO_INS_SET_ATTR, lineno);
-			write_uint16(compiler, sym_id);
+		if (ast->type == RHO_NODE_INT) {
+			value.type = RHO_CT_INT;
+			value.value.i = ast->v.int_val;
 		} else {
-			/* compound assignment */
-			compile_node(compiler, lhs->left, false);
-			write_ins(compiler, RHO_INS_DUP, lineno);
-			write_ins(compiler, RHO_INS_LOAD_ATTR, lineno);
-			write_uint16(compiler, sym_id);
-			compile_node(compiler, rhs, false);
-			write_ins(compiler, to_opcode(type), lineno);
-			write_ins(compiler, RHO_INS_ROT, lineno);
-			write_ins(compiler, RHO_INS_SET_ATTR, lineno);
-			write_uint16(compiler, sym_id);
+			value.type = RHO_CT_DOUBLE;
+			value.value.d = ast->v.float_val;
 		}
-	} else if (lhs->type == RHO_NODE_INDEX) {
-		if (type == RHO_NODE_ASSIGN) {
-			compile_node(compiler, rhs, false);
-			compile_node(compiler, lhs->left, false);
-			compile_node(compiler, lhs->right, false);
-			write_ins(compiler, RHO_INS_SET_INDEX, lineno);
+
+		write_ins(compiler, RHO_INS_LOAD_CONST, lineno);
+		write_uint16(compiler, rho_ct_id_for_const(compiler->ct, value));
+		break;
+	}
+	case RHO_NODE_IDENT: {
+		const int i = inline_param_index(ic->func, ast->v.ident);
+
+		if (is_numeric_literal(ic->args[i])) {
+			compile_inline_expr(compiler, ic, ic->args[i], slots, lineno);
 		} else {
-			/* compound assignment */
-			compile_node(compiler, lhs->left, false);
-			compile_node(compiler, lhs->right, false);
-			write_ins(compiler, RHO_INS_DUP_TWO, lineno);
-			write_ins(compiler, RHO_INS_LOAD_INDEX, lineno);
-			compile_node(compiler, rhs, false);
-			write_ins(compiler, to_opcode(type), lineno);
-			write_ins(compiler, RHO_INS_ROT_THREE, lineno);
-			write_ins(compiler, RHO_INS_SET_INDEX, lineno);
+			write_ins(compiler, RHO_INS_LOAD, lineno);
+			write_uint16(compiler, slots[i]);
 		}
-	} else {
-		const RhoSTSymbol *sym = rho_ste_get_symbol(compiler->st->ste_current, lhs->v.ident);
+		break;
+	}
+	case RHO_NODE_UPLUS:
+	case RHO_NODE_UMINUS:
+		compile_inline_expr(compiler, ic, ast->left, slots, lineno);
+		write_ins(compiler, to_opcode(ast->type), lineno);
+		break;
+	default: {
+		const int type = inline_type(ic->func, ast->left, ic->types);
+		compile_inline_expr(compiler, ic, ast->left, slots, lineno);
+		compile_inline_expr(compiler, ic, ast->right, slots, lineno);
+		write_ins(compiler, (type == STATIC_TYPE_INT) ? RHO_INS_INT_BINOP : RHO_INS_FLOAT_BINOP, lineno);
+		write_uint16(compiler, to_opcode(ast->type));
+		break;
+	}
+	}
+}
 
-		if (sym == NULL) {
-			RHO_INTERNAL_ERROR();
-		}
+/*
+ * Compiles `call` inline if possible, and returns whether it did.
+ */
+static bool compile_inline_call(RhoCompiler *compiler, RhoAST *call)
+{
+	struct inline_call ic;
 
-		const unsigned int sym_id = sym->id;
-		assert(sym->bound_here || sym->global_var);
+	if (!inline_resolve(compiler, call, &ic) ||
+	    compiler->inline_temps_used + ic.temps > compiler->inline_temps) {
+		return false;
+	}
 
-		if (type == RHO_NODE_ASSIGN) {
-			compile_node(compiler, rhs, false);
-		} else {
-			/* compound assignment */
-			compile_load(compiler, lhs);
-			compile_node(compiler, rhs, false);
-			write_ins(compiler, to_opcode(type), lineno);
-		}
+	const unsigned int lineno = call->lineno;
+	unsigned int slots[INLINE_MAX_PARAMS];
+	unsigned int next = compiler->inline_base + compiler->inline_temps_used;
 
-		byte store_ins;
-		if (sym->bound_here) {
-			store_ins = RHO_INS_STORE;
-		} else if (sym->global_var) {
-			store_ins = RHO_INS_STORE_GLOBAL;
-		} else {
-			RHO_INTERNAL_ERROR();
+	for (unsigned int i = 0; i < ic.func->nparams; i++) {
+		if (!is_numeric_literal(ic.args[i])) {
+			slots[i] = next++;
 		}
+	}
 
-		write_ins(compiler, store_ins, lineno);
-		write_uint16(compiler, sym_id);
+	compiler->inline_temps_used += ic.temps;
+
+	for (unsigned int j = 0; j < ic.nargs; j++) {
+		const unsigned int i = ic.order[j];
+
+		if (!is_numeric_literal(ic.args[i])) {
+			compile_node(compiler, ic.args[i], false);
+			write_ins(compiler, RHO_INS_STORE, lineno);
+			write_uint16(compiler, slots[i]);
+		}
 	}
+
+	compile_inline_expr(compiler, &ic, ic.func->body, slots, lineno);
+	compiler->inline_temps_used -= ic.temps;
+	return true;
 }
 
 static void compile_call(RhoCompiler *compiler, RhoAST *ast)
 {
 	RHO_AST_TYPE_ASSERT(ast, RHO_NODE_CALL);
 
+	if (compile_inline_call(compiler, ast)) {
+		return;
+	}
+
 	const unsigned int lineno = ast->lineno;
 
 	unsigned int unnamed_args = 0;
@@ -484,11 +2421,12 @@ static void compile_call(RhoCompiler *compiler, RhoAST *ast)
 		}
 	}
 
-	assert(unnamed_args <= 0xff && named_args <= 0xff);
+	assert(named_args <= 0xffff);
 
 	compile_node(compiler, ast->left, false);  // callable
 	write_ins(compiler, RHO_INS_CALL, lineno);
-	write_uint16(compiler, (named_args << 8) | unnamed_args);
+	write_uint16(compiler, unnamed_args);
+	write_uint16(compiler, named_args);
 }
 
 static void compile_cond_expr(RhoCompiler *compiler, RhoAST *ast)
@@ -498,42 +2436,38 @@ static void compile_cond_expr(RhoCompiler *compiler, RhoAST *ast)
 	const unsigned int lineno = ast->lineno;
 
 	compile_node(compiler, ast->v.middle, false);  // condition
-	write_ins(compiler, RHO_INS_JMP_IF_FALSE, lineno);
-	const size_t jmp_to_false_index = compiler->code.size;
+	const size_t jmp_to_false = write_jump(compiler, RHO_INS_JMP_IF_FALSE, lineno);
 	write_uint16(compiler, 0);
 
 	compile_node(compiler, ast->left, false);  // true branch
-	write_ins(compiler, RHO_INS_JMP, lineno);
-	const size_t jmp_out_index = compiler->code.size;
+	const size_t jmp_out = write_jump(compiler, RHO_INS_JMP, lineno);
 	write_uint16(compiler, 0);
 
-	write_uint16_at(compiler, compiler->code.size - jmp_to_false_index - 2, jmp_to_false_index);
+	set_jump_target(compiler, jmp_to_false, compiler->code.size);
 
 	compile_node(compiler, ast->right, false);  // false branch
 
-	write_uint16_at(compiler, compiler->code.size - jmp_out_index - 2, jmp_out_index);
+	set_jump_target(compiler, jmp_out, compiler->code.size);
 }
 
 static void compile_and(RhoCompiler *compiler, RhoAST *ast)
 {
 	RHO_AST_TYPE_ASSERT(ast, RHO_NODE_AND);
 	compile_node(compiler, ast->left, false);
-	write_ins(compiler, RHO_INS_JMP_IF_FALSE_ELSE_POP, ast->left->lineno);
-	size_t jump_index = compiler->code.size;
+	const size_t jump = write_jump(compiler, RHO_INS_JMP_IF_FALSE_ELSE_POP, ast->left->lineno);
 	write_uint16(compiler, 0);  // placeholder for jump offset
 	compile_node(compiler, ast->right, false);
-	write_uint16_at(compiler, compiler->code.size - jump_index - 2, jump_index);
+	set_jump_target(compiler, jump, compiler->code.size);
 }
 
 static void compile_or(RhoCompiler *compiler, RhoAST *ast)
 {
 	RHO_AST_TYPE_ASSERT(ast, RHO_NODE_OR);
 	compile_node(compiler, ast->left, false);
-	write_ins(compiler, RHO_INS_JMP_IF_TRUE_ELSE_POP, ast->left->lineno);
-	size_t jump_index = compiler->code.size;
+	const size_t jump = write_jump(compiler, RHO_INS_JMP_IF_TRUE_ELSE_POP, ast->left->lineno);
 	write_uint16(compiler, 0);  // placeholder for jump offset
 	compile_node(compiler, ast->right, false);
-	write_uint16_at(compiler, compiler->code.size - jump_index - 2, jump_index);
+	set_jump_target(compiler, jump, compiler->code.size);
 }
 
 
@@ -635,9 +2569,9 @@ static void compile_if(RhoCompiler *compiler, RhoAST *ast)
 	}
 
 	/*
-	 * Placeholder indices for jump offsets following the ELSE/ELIF bodies.
+	 * Jumps out of the IF/ELIF bodies.
 	 */
-	size_t *jmp_placeholder_indices = rho_malloc((1 + n_elifs) * sizeof(size_t));
+	size_t *jmps_out = rho_malloc((1 + n_elifs) * sizeof(size_t));
 	size_t node_index = 0;
 
 	for (RhoAST *node = ast; node != NULL; node = node->v.middle) {
@@ -647,18 +2581,13 @@ static void compile_if(RhoCompiler *compiler, RhoAST *ast)
 		switch (type) {
 		case RHO_NODE_IF:
 		case RHO_NODE_ELIF: {
-			compile_node(compiler, node->left, false);  // condition
-			write_ins(compiler, RHO_INS_JMP_IF_FALSE, lineno);
-			const size_t jmp_to_next_index = compiler->code.size;
-			write_uint16(compiler, 0);
+			const size_t jmp_to_next = compile_cond_jump(compiler, node->left, lineno);  // condition
 
 			compile_node(compiler, node->right, true);  // body
-			write_ins(compiler, RHO_INS_JMP, lineno);
-			const size_t jmp_out_index = compiler->code.size;
+			jmps_out[node_index++] = write_jump(compiler, RHO_INS_JMP, lineno);
 			write_uint16(compiler, 0);
 
-			jmp_placeholder_indices[node_index++] = jmp_out_index;
-			write_uint16_at(compiler, compiler->code.size - jmp_to_next_index - 2, jmp_to_next_index);
+			set_jump_target(compiler, jmp_to_next, compiler->code.size);
 			break;
 		}
 		case RHO_NODE_ELSE: {
@@ -673,37 +2602,53 @@ static void compile_if(RhoCompiler *compiler, RhoAST *ast)
 	const size_t final_size = compiler->code.size;
 
 	for (size_t i = 0; i <= n_elifs; i++) {
-		const size_t jmp_placeholder_index = jmp_placeholder_indices[i];
-		write_uint16_at(compiler, final_size - jmp_placeholder_index - 2, jmp_placeholder_index);
+		set_jump_target(compiler, jmps_out[i], final_size);
 	}
 
-	free(jmp_placeholder_indices);
+	free(jmps_out);
 }
 
 static void compile_while(RhoCompiler *compiler, RhoAST *ast)
 {
 	RHO_AST_TYPE_ASSERT(ast, RHO_NODE_WHILE);
 
+	/* a null condition (see opt.c) means the condition is always true */
+	const bool has_condition = (ast->left != NULL);
+
+	const bool hoisted = hoist_begin(compiler, ast, ast->lineno);
+
 	const size_t loop_start_index = compiler->code.size;
-	compile_node(compiler, ast->left, false);  // condition
-	write_ins(compiler, RHO_INS_JMP_IF_FALSE, 0);
+	size_t jump_out = 0;
 
-	// jump placeholder:
-	const size_t jump_index = compiler->code.size;
-	write_uint16(compiler, 0);
+	if (has_condition) {
+		jump_out = compile_cond_jump(compiler, ast->left, 0);  // condition
+	}
 
 	compiler_push_loop(compiler, loop_start_index);
 	compile_node(compiler, ast->right, true);  // body
 
-	write_ins(compiler, RHO_INS_JMP_BACK, 0);
-	write_uint16(compiler, compiler->code.size - loop_start_index + 2);
+	const size_t jump_back = write_jump(compiler, RHO_INS_JMP_BACK, 0);
+	write_uint16(compiler, 0);
+	set_jump_target(compiler, jump_back, loop_start_index);
 
-	// fill in placeholder:
-	write_uint16_at(compiler, compiler->code.size - jump_index - 2, jump_index);
+	if (has_condition) {
+		set_jump_target(compiler, jump_out, compiler->code.size);
+	}
 
 	compiler_pop_loop(compiler);
+
+	if (hoisted) {
+		hoist_end(compiler);
+	}
 }
 
+/*
+ * A `for` loop over a range literal, like `for i in 0..n`, doesn't
+ * create the range (or an iterator over it): RANGE_INIT leaves the
+ * current and final values of the loop variable on the stack, and
+ * FOR_RANGE counts from one to the other, storing into the loop
+ * variable directly.
+ */
 static void compile_for(RhoCompiler *compiler, RhoAST *ast)
 {
 	RHO_AST_TYPE_ASSERT(ast, RHO_NODE_FOR);
@@ -713,68 +2658,76 @@ static void compile_for(RhoCompiler *compiler, RhoAST *ast)
 	RhoAST *iter = ast->right;
 	RhoAST *body = ast->v.middle;
 
-	compile_node(compiler, iter, false);
-	write_ins(compiler, RHO_INS_GET_ITER, lineno);
-
-	const size_t loop_start_index = compiler->code.size;
-	compiler_push_loop(compiler, loop_start_index);
-	write_ins(compiler, RHO_INS_LOOP_ITER, iter->lineno);
-
-	// jump placeholder:
-	const size_t jump_index = compiler->code.size;
-	write_uint16(compiler, 0);
+	const RhoSTSymbol *lcv_sym = NULL;
 
 	if (lcv->type == RHO_NODE_IDENT) {
-		const RhoSTSymbol *sym = rho_ste_get_symbol(compiler->st->ste_current, lcv->v.ident);
+		lcv_sym = rho_ste_get_symbol(compiler->st->ste_current, lcv->v.ident);
 
-		if (sym == NULL) {
+		if (lcv_sym == NULL) {
 			RHO_INTERNAL_ERROR();
 		}
+	}
 
-		write_ins(compiler, RHO_INS_STORE, lineno);
-		write_uint16(compiler, sym->id);
-	} else {
-		RHO_AST_TYPE_ASSERT(lcv, RHO_NODE_TUPLE);
-
-		write_ins(compiler, RHO_INS_SEQ_EXPAND, lcv->lineno);
+	/* FOR_RANGE's loop variable argument can't be extended (see `write_uint16`) */
+	const bool range = (lcv_sym != NULL && lcv_sym->id <= 0xFFFF && iter->type == RHO_NODE_DOTDOT);
 
-		unsigned int count = 0;
-		for (struct rho_ast_list *node = lcv->v.list; node != NULL; node = node->next) {
-			++count;
-		}
+	if (range) {
+		compile_node(compiler, iter->left, false);
+		compile_node(compiler, iter->right, false);
+		write_ins(compiler, RHO_INS_RANGE_INIT, iter->lineno);
+	} else {
+		compile_node(compiler, iter, false);
+		write_ins(compiler, RHO_INS_GET_ITER, lineno);
+	}
 
-		write_uint16(compiler, count);
+	const bool hoisted = hoist_begin(compiler, ast, lineno);
 
-		/* sequence is expanded left-to-right, so we have to store in reverse */
-		for (int i = count-1; i >= 0; i--) {
-			struct rho_ast_list *node = lcv->v.list;
-			for (int j = 0; j < i; j++) {
-				node = node->next;
-			}
+	const size_t loop_start_index = compiler->code.size;
+	compiler_push_loop(compiler, loop_start_index);
 
-			RHO_AST_TYPE_ASSERT(node->ast, RHO_NODE_IDENT);
-			const RhoSTSymbol *sym = rho_ste_get_symbol(compiler->st->ste_current, node->ast->v.ident);
+	size_t jump_out;
 
-			if (sym == NULL) {
-				RHO_INTERNAL_ERROR();
-			}
+	if (range) {
+		jump_out = write_jump(compiler, RHO_INS_FOR_RANGE, iter->lineno);
+		write_uint16(compiler, 0);  // jump placeholder
+		write_uint16(compiler, lcv_sym->id);
+	} else {
+		jump_out = write_jump(compiler, RHO_INS_LOOP_ITER, iter->lineno);
+		write_uint16(compiler, 0);  // jump placeholder
 
+		if (lcv_sym != NULL) {
 			write_ins(compiler, RHO_INS_STORE, lineno);
-			write_uint16(compiler, sym->id);
+			write_uint16(compiler, lcv_sym->id);
+		} else {
+			RHO_AST_TYPE_ASSERT(lcv, RHO_NODE_TUPLE);
+
+			write_ins(compiler, RHO_INS_SEQ_EXPAND, lcv->lineno);
+			const unsigned int count = ast_list_length(lcv->v.list);
+			write_uint16(compiler, count);
+			compile_seq_store(compiler, lcv->v.list, count, lineno);
 		}
 	}
 
 	compile_node(compiler, body, true);
 
-	write_ins(compiler, RHO_INS_JMP_BACK, 0);
-	write_uint16(compiler, compiler->code.size - loop_start_index + 2);
-
-	// fill in placeholder:
-	write_uint16_at(compiler, compiler->code.size - jump_index - 2, jump_index);
+	const size_t jump_back = write_jump(compiler, RHO_INS_JMP_BACK, 0);
+	write_uint16(compiler, 0);
+	set_jump_target(compiler, jump_back, loop_start_index);
+	set_jump_target(compiler, jump_out, compiler->code.size);
 
 	compiler_pop_loop(compiler);
 
-	write_ins(compiler, RHO_INS_POP, 0);  // pop the iterator left behind by GET_ITER
+	if (hoisted) {
+		hoist_end(compiler);
+	}
+
+	if (range) {
+		/* pop the loop variable's current and final values */
+		write_ins(compiler, RHO_INS_POP, 0);
+		write_ins(compiler, RHO_INS_POP, 0);
+	} else {
+		write_ins(compiler, RHO_INS_POP, 0);  // pop the iterator left behind by GET_ITER
+	}
 }
 
 #define COMPILE_DEF 0
@@ -911,8 +2864,7 @@ static void compile_break(RhoCompiler *compiler, RhoAST *ast)
 		RHO_INTERNAL_ERROR();
 	}
 
-	write_ins(compiler, RHO_INS_JMP, lineno);
-	const size_t break_index = compiler->code.size;
+	const size_t break_index = write_jump(compiler, RHO_INS_JMP, lineno);
 	write_uint16(compiler, 0);
 
 	/*
@@ -932,9 +2884,9 @@ static void compile_continue(RhoCompiler *compiler, RhoAST *ast)
 		RHO_INTERNAL_ERROR();
 	}
 
-	write_ins(compiler, RHO_INS_JMP_BACK, lineno);
-	const size_t start_index = compiler->lbi->start_index;
-	write_uint16(compiler, compiler->code.size - start_index + 2);
+	const size_t jump = write_jump(compiler, RHO_INS_JMP_BACK, lineno);
+	write_uint16(compiler, 0);
+	set_jump_target(compiler, jump, compiler->lbi->start_index);
 }
 
 static void compile_return(RhoCompiler *compiler, RhoAST *ast)
@@ -998,10 +2950,8 @@ static void compile_try_catch(RhoCompiler *compiler, RhoAST *ast)
 	assert(exc_count == 1);  // TODO: handle 2+ exceptions (this is currently valid syntactically)
 
 	/* === Try Block === */
-	write_ins(compiler, RHO_INS_TRY_BEGIN, try_lineno);
-	const size_t try_block_size_index = compiler->code.size;
+	const size_t try_begin = write_jump(compiler, RHO_INS_TRY_BEGIN, try_lineno);
 	write_uint16(compiler, 0);  /* placeholder for try-length */
-	const size_t handler_offset_index = compiler->code.size;
 	write_uint16(compiler, 0);  /* placeholder for handler offset */
 
 	compiler->try_catch_depth += exc_count;
@@ -1014,19 +2964,19 @@ static void compile_try_catch(RhoCompiler *compiler, RhoAST *ast)
 	compiler->try_catch_depth -= exc_count;
 
 	write_ins(compiler, RHO_INS_TRY_END, catch_lineno);
-	write_uint16_at(compiler, compiler->code.size - try_block_size_index - 4, try_block_size_index);
+	const size_t try_end = compiler->code.size;
+	set_jump_target(compiler, try_begin, try_end);
 
-	write_ins(compiler, RHO_INS_JMP, catch_lineno);  /* jump past exception handlers if no exception was thrown */
-	const size_t jmp_over_handlers_index = compiler->code.size;
+	const size_t jmp_over_handlers = write_jump(compiler, RHO_INS_JMP, catch_lineno);  /* jump past exception handlers if no exception was thrown */
 	write_uint16(compiler, 0);  /* placeholder for jump offset */
 
-	write_uint16_at(compiler, compiler->code.size - handler_offset_index - 2, handler_offset_index);
+	/* the handler offset is relative to the end of the try block */
+	write_uint16_at(compiler, compiler->code.size - try_end, try_begin + 6);
 
 	/* === Handler === */
 	write_ins(compiler, RHO_INS_DUP, catch_lineno);
 	compile_node(compiler, ast->v.excs->ast, false);
-	write_ins(compiler, RHO_INS_JMP_IF_EXC_MISMATCH, catch_lineno);
-	const size_t exc_mismatch_jmp_index = compiler->code.size;
+	const size_t exc_mismatch_jmp = write_jump(compiler, RHO_INS_JMP_IF_EXC_MISMATCH, catch_lineno);
 	write_uint16(compiler, 0);  /* placeholder for jump offset */
 
 	write_ins(compiler, RHO_INS_POP, catch_lineno);
@@ -1036,11 +2986,11 @@ static void compile_try_catch(RhoCompiler *compiler, RhoAST *ast)
 	write_ins(compiler, RHO_INS_JMP, catch_lineno);
 	write_uint16(compiler, 1);
 
-	write_uint16_at(compiler, compiler->code.size - exc_mismatch_jmp_index - 2, exc_mismatch_jmp_index);
+	set_jump_target(compiler, exc_mismatch_jmp, compiler->code.size);
 
 	write_ins(compiler, RHO_INS_THROW, catch_lineno);
 
-	write_uint16_at(compiler, compiler->code.size - jmp_over_handlers_index - 2, jmp_over_handlers_index);
+	set_jump_target(compiler, jmp_over_handlers, compiler->code.size);
 }
 
 static void compile_import(RhoCompiler *compiler, RhoAST *ast)
@@ -1235,11 +3185,19 @@ static void compile_node(RhoCompiler *compiler, RhoAST *ast, bool toplevel)
 	case RHO_NODE_GE:
 	case RHO_NODE_APPLY:
 	case RHO_NODE_DOTDOT:
-	case RHO_NODE_IN:
+	case RHO_NODE_IN: {
+		const int type = typed_binop(compiler, ast);
 		compile_node(compiler, ast->left, false);
 		compile_node(compiler, ast->right, false);
-		write_ins(compiler, to_opcode(ast->type), lineno);
+
+		if (type == STATIC_TYPE_ANY) {
+			write_ins(compiler, to_opcode(ast->type), lineno);
+		} else {
+			write_ins(compiler, (type == STATIC_TYPE_INT) ? RHO_INS_INT_BINOP : RHO_INS_FLOAT_BINOP, lineno);
+			write_uint16(compiler, to_opcode(ast->type));
+		}
 		break;
+	}
 	case RHO_NODE_AND:
 		compile_and(compiler, ast);
 		break;
@@ -1362,10 +3320,10 @@ static void compile_node(RhoCompiler *compiler, RhoAST *ast, bool toplevel)
  * Symbol table format:
  *
  * - ST_ENTRY_BEGIN
- * - 4-byte int: no. of locals (N)
+ * - uint32: no. of locals (N)
  * - N null-terminated strings representing local variable names
  *   ...
- * - 4-byte int: no. of attributes (M)
+ * - uint32: no. of attributes (M)
  * - M null-terminated strings representing attribute names
  *   ...
  * - ST_ENTRY_END
@@ -1404,17 +3362,33 @@ static void write_sym_table(RhoCompiler *compiler)
 
 	write_byte(compiler, RHO_ST_ENTRY_BEGIN);
 
-	write_uint16(compiler, n_locals);
+	/* register mode temporaries come right after the named locals */
+	const RhoStr temp_name = RHO_STR_INIT(REG_TEMP_NAME, strlen(REG_TEMP_NAME), 0);
+
+	write_uint32(compiler, n_locals + compiler->reg_temps + compiler->n_hoisted + compiler->inline_temps);
 	for (size_t i = 0; i < n_locals; i++) {
 		write_str(compiler, locals_sorted[i]);
 	}
+	for (size_t i = 0; i < compiler->reg_temps; i++) {
+		write_str(compiler, &temp_name);
+	}
+
+	/* followed by hoisted loads (see hoist_reserve) */
+	for (size_t i = 0; i < compiler->n_hoisted; i++) {
+		write_str(compiler, compiler->hoisted[i]->key);
+	}
 
-	write_uint16(compiler, n_attrs);
+	/* and temporaries for inlined calls (see inline_reserve) */
+	for (size_t i = 0; i < compiler->inline_temps; i++) {
+		write_str(compiler, &temp_name);
+	}
+
+	write_uint32(compiler, n_attrs);
 	for (size_t i = 0; i < n_attrs; i++) {
 		write_str(compiler, attrs_sorted[i]);
 	}
 
-	write_uint16(compiler, n_free);
+	write_uint32(compiler, n_free);
 	for (size_t i = 0; i < n_free; i++) {
 		write_str(compiler, frees_sorted[i]);
 	}
@@ -1432,7 +3406,7 @@ static void write_const_table(RhoCompiler *compiler)
 	const size_t size = ct->table_size + ct->codeobjs_size;
 
 	write_byte(compiler, RHO_CT_ENTRY_BEGIN);
-	write_uint16(compiler, size);
+	write_uint32(compiler, size);
 
 	RhoCTConst *sorted = rho_malloc(size * sizeof(RhoCTConst));
 
@@ -1475,7 +3449,7 @@ static void write_const_table(RhoCompiler *compiler)
 			 * Write size of actual CodeObject bytecode, excluding
 			 * metadata (name, argcount, stack_depth, try_catch_depth):
 			 */
-			write_uint16(compiler, co_code->size - (name_len + 1) - 2 - 2 - 2);
+			write_uint32(compiler, co_code->size - (name_len + 1) - 2 - 4 - 2);
 
 			append(compiler, co_code);
 			rho_code_dealloc(co_code);
@@ -1541,7 +3515,7 @@ static void fill_ct_from_ast(RhoCompiler *compiler, RhoAST *ast)
 		if (def_or_gen_or_act) {
 			body = ast->right->v.block;
 		} else {
-			body = rho_ast_list_new();
+			body = rho_ast_list_new(st->arena);
 			body->ast = ast->left;
 		}
 
@@ -1557,6 +3531,17 @@ static void fill_ct_from_ast(RhoCompiler *compiler, RhoAST *ast)
 		if (ast->type == RHO_NODE_GEN) {
 			sub->in_generator = 1;
 		}
+		sub->hoist_globals = (ast->type == RHO_NODE_DEF || ast->type == RHO_NODE_LAMBDA);
+		sub->registers = compiler->registers;
+		sub->inlines = compiler->inlines;
+		sub->n_inlines = compiler->n_inlines;
+		sub->inline_ids = compiler->inline_ids;
+		sub->n_inline_ids = compiler->n_inline_ids;
+		sub->times = compiler->times;
+
+		if (def_or_gen_or_act) {
+			typed_locals_init(sub, ast, parent);
+		}
 
 		struct metadata metadata = compile_raw(sub, body, (ast->type == RHO_NODE_LAMBDA));
 		st->ste_current = parent;
@@ -1572,20 +3557,16 @@ static void fill_ct_from_ast(RhoCompiler *compiler, RhoAST *ast)
 		RhoStr name = (def_or_gen_or_act ? *ast->left->v.ident : RHO_STR_INIT(LAMBDA, strlen(LAMBDA), 0));
 #undef LAMBDA
 
-		rho_code_init(fncode, (name.len + 1) + 2 + 2 + 2 + subcode->size);  // total size
+		rho_code_init(fncode, (name.len + 1) + 2 + 4 + 2 + subcode->size);  // total size
 		rho_code_write_str(fncode, &name);                                  // name
 		rho_code_write_uint16(fncode, nargs);                               // argument count
-		rho_code_write_uint16(fncode, max_vstack_depth);                    // max stack depth
+		rho_code_write_uint32(fncode, max_vstack_depth);                    // max stack depth
 		rho_code_write_uint16(fncode, max_try_catch_depth);                 // max try-catch depth
 		rho_code_append(fncode, subcode);
 
-		compiler_free(sub, false);
+		compiler_free(sub);
 		value.value.c = fncode;
 
-		if (!def_or_gen_or_act) {
-			free(body);
-		}
-
 		break;
 	}
 	case RHO_NODE_IF:
@@ -1612,7 +3593,18 @@ static void fill_ct_from_ast(RhoCompiler *compiler, RhoAST *ast)
 			fill_ct_from_ast(compiler, node->ast);
 		}
 		goto end;
-	case RHO_NODE_CALL:
+	case RHO_NODE_CALL: {
+		const struct rho_inline_func *func = inline_target(compiler, ast);
+
+		if (func != NULL) {
+			/* constants of the inlined body */
+			fill_ct_from_ast(compiler, func->body);
+
+			for (unsigned int i = 0; i < func->nparams; i++) {
+				fill_ct_from_ast(compiler, func->defaults[i]);
+			}
+		}
+
 		for (struct rho_ast_list *node = ast->v.params; node != NULL; node = node->next) {
 			RhoAST *ast = node->ast;
 			if (ast->type == RHO_NODE_ASSIGN) {
@@ -1626,6 +3618,7 @@ static void fill_ct_from_ast(RhoCompiler *compiler, RhoAST *ast)
 			}
 		}
 		goto end;
+	}
 	case RHO_NODE_TRY_CATCH:
 		for (struct rho_ast_list *node = ast->v.excs; node != NULL; node = node->next) {
 			fill_ct_from_ast(compiler, node->ast);
@@ -1653,8 +3646,8 @@ static void fill_ct(RhoCompiler *compiler, RhoProgram *program)
 	}
 }
 
-static int stack_delta(RhoOpcode opcode, int arg);
-static int read_arg(RhoOpcode opcode, byte **bc);
+static int stack_delta(RhoOpcode opcode, const unsigned int *args);
+static void read_args(RhoOpcode opcode, byte **bc, unsigned int *args);
 
 static int max_stack_depth(byte *bc, size_t len)
 {
@@ -1667,22 +3660,22 @@ static int max_stack_depth(byte *bc, size_t len)
 
 	if (*bc == RHO_ST_ENTRY_BEGIN) {
 		++bc;  // ST_ENTRY_BEGIN
-		const size_t n_locals = rho_util_read_uint16_from_stream(bc);
-		bc += 2;
+		const size_t n_locals = rho_util_read_uint32_from_stream(bc);
+		bc += 4;
 
 		for (size_t i = 0; i < n_locals; i++) {
 			while (*bc++ != '\0');
 		}
 
-		const size_t n_attrs = rho_util_read_uint16_from_stream(bc);
-		bc += 2;
+		const size_t n_attrs = rho_util_read_uint32_from_stream(bc);
+		bc += 4;
 
 		for (size_t i = 0; i < n_attrs; i++) {
 			while (*bc++ != '\0');
 		}
 
-		const size_t n_frees = rho_util_read_uint16_from_stream(bc);
-		bc += 2;
+		const size_t n_frees = rho_util_read_uint32_from_stream(bc);
+		bc += 4;
 
 		for (size_t i = 0; i < n_frees; i++) {
 			while (*bc++ != '\0');
@@ -1693,8 +3686,8 @@ static int max_stack_depth(byte *bc, size_t len)
 
 	if (*bc == RHO_CT_ENTRY_BEGIN) {
 		++bc;  // CT_ENTRY_BEGIN
-		const size_t ct_size = rho_util_read_uint16_from_stream(bc);
-		bc += 2;
+		const size_t ct_size = rho_util_read_uint32_from_stream(bc);
+		bc += 4;
 
 		for (size_t i = 0; i < ct_size; i++) {
 			switch (*bc++) {
@@ -1709,12 +3702,12 @@ static int max_stack_depth(byte *bc, size_t len)
 				break;
 			}
 			case RHO_CT_ENTRY_CODEOBJ: {
-				size_t colen = rho_util_read_uint16_from_stream(bc);
-				bc += 2;
+				size_t colen = rho_util_read_uint32_from_stream(bc);
+				bc += 4;
 
 				while (*bc++ != '\0');  // name
 				bc += 2;  // arg count
-				bc += 2;  // stack depth
+				bc += 4;  // stack depth
 				bc += 2;  // try-catch depth
 
 				for (size_t i = 0; i < colen; i++) {
@@ -1734,12 +3727,23 @@ static int max_stack_depth(byte *bc, size_t len)
 
 	int depth = 0;
 	int max_depth = 0;
+	unsigned int ext = 0;
 
 	while (bc != end) {
 		byte opcode = *bc++;
+		unsigned int args[4];
+
+		read_args(opcode, &bc, args);
+
+		if (opcode == RHO_INS_EXTENDED_ARG) {
+			ext = args[0] << 16;
+			continue;
+		}
+
+		args[rho_opcode_extended_arg(opcode)] |= ext;
+		ext = 0;
 
-		int arg = read_arg(opcode, &bc);
-		int delta = stack_delta(opcode, arg);
+		int delta = stack_delta(opcode, args);
 
 		depth += delta;
 		if (depth < 0) {
@@ -1825,8 +3829,9 @@ int rho_opcode_arg_size(RhoOpcode opcode)
 	case RHO_INS_JMP_BACK_IF_FALSE:
 	case RHO_INS_JMP_IF_TRUE_ELSE_POP:
 	case RHO_INS_JMP_IF_FALSE_ELSE_POP:
-	case RHO_INS_CALL:
 		return 2;
+	case RHO_INS_CALL:
+		return 4;
 	case RHO_INS_RETURN:
 	case RHO_INS_THROW:
 	case RHO_INS_PRODUCE:
@@ -1865,52 +3870,84 @@ int rho_opcode_arg_size(RhoOpcode opcode)
 	case RHO_INS_ROT:
 	case RHO_INS_ROT_THREE:
 		return 0;
+	case RHO_INS_LOAD_LOAD:
+	case RHO_INS_LOAD_ADD_CONST:
+	case RHO_INS_LOAD_ATTR_LOCAL:
+	case RHO_INS_INC_LOCAL_BY_CONST:
+	case RHO_INS_COMPARE_AND_BRANCH:
+	case RHO_INS_FOR_ITER_STORE:
+		return 4;
+	case RHO_INS_REG_MOVE:
+		return 4;
+	case RHO_INS_REG_BINOP:
+	case RHO_INS_REG_CMP_BRANCH:
+		return 8;
+	case RHO_INS_HOIST_GLOBAL:
+	case RHO_INS_HOIST_NAME:
+		return 4;
+	case RHO_INS_INT_BINOP:
+	case RHO_INS_FLOAT_BINOP:
+		return 2;
+	case RHO_INS_RANGE_INIT:
+		return 0;
+	case RHO_INS_FOR_RANGE:
+		return 4;
+	case RHO_INS_EXTENDED_ARG:
+		return 2;
 	default:
 		return -1;
 	}
 }
 
-static int read_arg(RhoOpcode opcode, byte **bc)
+/*
+ * An EXTENDED_ARG prefix supplies the high 16 bits of one argument
+ * of the instruction that follows it: the jump offset of a jump, and
+ * the first argument of anything else. This returns the index of
+ * that argument.
+ */
+unsigned int rho_opcode_extended_arg(RhoOpcode opcode)
 {
-	int size = rho_opcode_arg_size(opcode);
-
-	if (size < 0) {
-		RHO_INTERNAL_ERROR();
+	switch (opcode) {
+	case RHO_INS_COMPARE_AND_BRANCH:
+		return 1;
+	case RHO_INS_REG_CMP_BRANCH:
+		return 3;
+	default:
+		return 0;
 	}
+}
 
-	int arg;
+/*
+ * Reads the (up to 4) uint16 arguments of the given opcode
+ * into `args`, and sets the rest of `args` to 0.
+ */
+static void read_args(RhoOpcode opcode, byte **bc, unsigned int *args)
+{
+	const int size = rho_opcode_arg_size(opcode);
 
-	switch (size) {
-	case 0:
-		arg = 0;
-		break;
-	case 1:
-		arg = *(*bc++);
-		break;
-	case 2:
-	case 4:  /* only return the first 2 bytes */
-		arg = rho_util_read_uint16_from_stream(*bc);
-		*bc += size;
-		break;
-	default:
+	if (size < 0 || size % 2 != 0 || size > 8) {
 		RHO_INTERNAL_ERROR();
-		arg = 0;
-		break;
 	}
 
-	return arg;
+	for (int k = 0; k < 4; k++) {
+		args[k] = (2*k < size) ? rho_util_read_uint16_from_stream(*bc + 2*k) : 0;
+	}
+
+	*bc += size;
 }
 
 /*
  * Calculates the value stack depth change resulting from
- * executing the given opcode with the given argument.
+ * executing the given opcode with the given arguments.
  *
  * The use of this function relies on the assumption that
  * individual statements, upon completion, leave the stack
  * depth unchanged (i.e. at 0).
  */
-static int stack_delta(RhoOpcode opcode, int arg)
+static int stack_delta(RhoOpcode opcode, const unsigned int *args)
 {
+	const int arg = args[0];
+
 	switch (opcode) {
 	case RHO_INS_NOP:
 		return 0;
@@ -1994,7 +4031,7 @@ static int stack_delta(RhoOpcode opcode, int arg)
 	case RHO_INS_JMP_IF_FALSE_ELSE_POP:
 		return 0;  // -1 if jump not taken
 	case RHO_INS_CALL:
-		return -((arg & 0xff) + 2*(arg >> 8));
+		return -(arg + 2*(int)args[1]);
 	case RHO_INS_RETURN:
 	case RHO_INS_THROW:
 	case RHO_INS_PRODUCE:
@@ -2037,17 +4074,54 @@ static int stack_delta(RhoOpcode opcode, int arg)
 	case RHO_INS_ROT:
 	case RHO_INS_ROT_THREE:
 		return 0;
+	case RHO_INS_LOAD_LOAD:
+		return 2;
+	case RHO_INS_LOAD_ADD_CONST:
+	case RHO_INS_LOAD_ATTR_LOCAL:
+		return 1;
+	case RHO_INS_INC_LOCAL_BY_CONST:
+		return 0;
+	case RHO_INS_COMPARE_AND_BRANCH:
+		return -2;
+	case RHO_INS_FOR_ITER_STORE:
+		return 0;
+	case RHO_INS_REG_MOVE:
+	case RHO_INS_REG_BINOP:
+	case RHO_INS_REG_CMP_BRANCH:
+		return 0;
+	case RHO_INS_HOIST_GLOBAL:
+	case RHO_INS_HOIST_NAME:
+		return 0;
+	case RHO_INS_INT_BINOP:
+	case RHO_INS_FLOAT_BINOP:
+		return -1;
+	case RHO_INS_RANGE_INIT:
+	case RHO_INS_FOR_RANGE:
+		return 0;
+	case RHO_INS_EXTENDED_ARG:
+		return 0;
 	}
 
 	RHO_INTERNAL_ERROR();
 	return 0;
 }
 
-void rho_compile(const char *name, RhoProgram *prog, FILE *out)
+void rho_compile(const char *name,
+                 RhoProgram *prog,
+                 RhoArena *arena,
+                 const unsigned int flags,
+                 struct rho_compile_times *times,
+                 FILE *out)
 {
-	RhoCompiler *compiler = compiler_new(name, 1, rho_st_new(name));
+	const double start = (times != NULL) ? rho_util_time() : 0;
+	const double others = (times != NULL) ? times->symtab + times->stack : 0;
+
+	RhoCompiler *compiler = compiler_new(name, 1, rho_st_new(name, arena));
+	compiler->registers = ((flags & RHO_RHOC_FLAG_REGISTERS) != 0);
+	compiler->times = times;
 
 	struct metadata metadata = compile_program(compiler, prog);
+	free(compiler->inlines);
 
 	/*
 	 * Every rhoc file should start with the
@@ -2061,17 +4135,22 @@ void rho_compile(const char *name, RhoProgram *prog, FILE *out)
 	 * Directly after the magic bytes, we write
 	 * the maximum value stack depth at module
 	 * level, followed by the maximum try-catch
-	 * depth:
+	 * depth and the flags we compiled with:
 	 */
-	byte buf[2];
+	byte buf[4];
 
-	rho_util_write_uint16_to_stream(buf, metadata.max_vstack_depth);
-	for (size_t i = 0; i < sizeof(buf); i++) {
+	rho_util_write_uint32_to_stream(buf, metadata.max_vstack_depth);
+	for (size_t i = 0; i < 4; i++) {
 		fputc(buf[i], out);
 	}
 
 	rho_util_write_uint16_to_stream(buf, metadata.max_try_catch_depth);
-	for (size_t i = 0; i < sizeof(buf); i++) {
+	for (size_t i = 0; i < 2; i++) {
+		fputc(buf[i], out);
+	}
+
+	rho_util_write_uint16_to_stream(buf, flags);
+	for (size_t i = 0; i < 2; i++) {
 		fputc(buf[i], out);
 	}
 
@@ -2080,5 +4159,9 @@ void rho_compile(const char *name, RhoProgram *prog, FILE *out)
 	 */
 	fwrite(compiler->code.bc, 1, compiler->code.size, out);
 
-	compiler_free(compiler, true);
+	compiler_free(compiler);
+
+	if (times != NULL) {
+		times->codegen += (rho_util_time() - start) - (times->symtab + times->stack - others);
+	}
 }
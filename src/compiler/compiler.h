@@ -2,6 +2,7 @@
 #define RHO_COMPILER_H
 
 #include <stdio.h>
+#include <stdbool.h>
 #include "code.h"
 #include "symtab.h"
 #include "consttab.h"
@@ -10,6 +11,38 @@
 extern const byte rho_magic[];
 extern const size_t rho_magic_size;
 
+/*
+ * The last of the magic bytes is the version of the rhoc
+ * format, which changes whenever old files can no longer
+ * be read (see doc/rhoc_spec.md).
+ */
+#define RHO_RHOC_VERSION 0x0F
+
+/*
+ * Flags stored in the rhoc header (see doc/rhoc_spec.md).
+ */
+#define RHO_RHOC_FLAG_REGISTERS 0x0001  // compiled in register mode
+
+/*
+ * Line number tables (see doc/rhoc_spec.md) are indexed by a
+ * checkpoint every this many (d_pos, d_line) pairs.
+ */
+#define RHO_LNO_CHECKPOINT_INTERVAL 32
+#define RHO_LNO_CHECKPOINT_SIZE     12
+
+struct rho_inline_func;
+
+/*
+ * Seconds spent in each phase of compiling a module, as reported by
+ * --compile-time; `codegen` is everything not counted by the others.
+ */
+struct rho_compile_times {
+	double parse;    // parsing and AST optimization
+	double symtab;   // building the symbol table
+	double codegen;  // generating (and peephole optimizing) bytecode
+	double stack;    // computing maximum stack depths
+};
+
 /*
  * The following structure is used for
  * continue/break bookkeeping.
@@ -34,17 +67,66 @@ typedef struct {
 	unsigned int try_catch_depth;
 	unsigned int try_catch_depth_max;
 
+	size_t last_op_pos;  // where the last opcode was written
+
 	RhoCode lno_table;
 	unsigned int first_lineno;
-	unsigned int first_ins_on_line_idx;
-	unsigned int last_ins_idx;
+	size_t line_start;  // where the first instruction on `last_lineno` was written
 	unsigned int last_lineno;
 
-	unsigned in_generator : 1;
+	/* register mode: temporaries are locals reg_temp_base and up */
+	unsigned int reg_temp_base;
+	unsigned int reg_temps;
+	unsigned int reg_temps_used;
+
+	/* loop-invariant loads: hoisted[i] is held in local hoist_base + i */
+	unsigned int hoist_base;
+	unsigned int n_hoisted;
+	RhoSTSymbol **hoisted;
+	bool *hoist_live;
+
+	/* typed arithmetic: static types of the first n_local_types locals */
+	unsigned char *local_types;
+	unsigned int n_local_types;
+
+	/* inlining: candidate functions (shared with nested compilers) and
+	   temporaries for their arguments at locals inline_base and up */
+	struct rho_inline_func *inlines;
+	unsigned int n_inlines;
+	unsigned int *inline_ids;  // 1 + index into `inlines` of each module-level symbol ID, or 0
+	unsigned int n_inline_ids;
+	unsigned int inline_base;
+	unsigned int inline_temps;
+	unsigned int inline_temps_used;
+
+	/* phase timings (shared with nested compilers), or NULL */
+	struct rho_compile_times *times;
+
+	unsigned in_generator  : 1;
+	unsigned registers     : 1;
+	unsigned hoist_globals : 1;
 } RhoCompiler;
 
-void rho_compile(const char *name, RhoProgram *prog, FILE *out);
+/*
+ * Compiles `prog` into `out`. Unless `times` is NULL, the time spent
+ * in each phase other than parsing is added to it.
+ */
+void rho_compile(const char *name,
+                 RhoProgram *prog,
+                 RhoArena *arena,
+                 const unsigned int flags,
+                 struct rho_compile_times *times,
+                 FILE *out);
+
+/*
+ * Appends to `lno_table` the (d_pos, d_line) pairs saying that the
+ * line number goes up by `line_delta` (> 0) at the instruction
+ * `pos_delta` bytes past where the previous line began.
+ */
+void rho_lno_write(RhoCode *lno_table, size_t pos_delta, unsigned int line_delta);
 
 int rho_opcode_arg_size(RhoOpcode opcode);
 
+unsigned int rho_opcode_extended_arg(RhoOpcode opcode);
+
 #endif /* RHO_COMPILER_H */
@@ -4,12 +4,13 @@
 #include <assert.h>
 #include "str.h"
 #include "util.h"
+#include "arena.h"
 #include "err.h"
 #include "consttab.h"
 
 static int const_hash(RhoCTConst *key);
 static bool const_eq(RhoCTConst *key1, RhoCTConst *key2);
-static RhoConstTable *ct_new_specific(const size_t capacity, const float load_factor);
+static RhoConstTable *ct_new_specific(RhoArena *arena, const size_t capacity, const float load_factor);
 static void ct_grow(RhoConstTable *ct, const size_t new_capacity);
 
 static int const_hash(RhoCTConst *key)
@@ -50,12 +51,12 @@ static bool const_eq(RhoCTConst *key1, RhoCTConst *key2)
 	return 0;
 }
 
-RhoConstTable *rho_ct_new(void)
+RhoConstTable *rho_ct_new(RhoArena *arena)
 {
-	return ct_new_specific(RHO_CT_CAPACITY, RHO_CT_LOADFACTOR);
+	return ct_new_specific(arena, RHO_CT_CAPACITY, RHO_CT_LOADFACTOR);
 }
 
-static RhoConstTable *ct_new_specific(const size_t capacity, const float load_factor)
+static RhoConstTable *ct_new_specific(RhoArena *arena, const size_t capacity, const float load_factor)
 {
 	// the capacity should be a power of 2:
 	size_t capacity_real;
@@ -70,11 +71,9 @@ static RhoConstTable *ct_new_specific(const size_t capacity, const float load_fa
 		}
 	}
 
-	RhoConstTable *ct = rho_malloc(sizeof(RhoConstTable));
-	ct->table = rho_malloc(capacity_real * sizeof(RhoCTEntry *));
-	for (size_t i = 0; i < capacity_real; i++) {
-		ct->table[i] = NULL;
-	}
+	RhoConstTable *ct = rho_arena_alloc(arena, sizeof(RhoConstTable));
+	ct->arena = arena;
+	ct->table = rho_arena_calloc(arena, capacity_real * sizeof(RhoCTEntry *));
 	ct->table_size = 0;
 	ct->capacity = capacity_real;
 	ct->load_factor = load_factor;
@@ -90,7 +89,7 @@ static RhoConstTable *ct_new_specific(const size_t capacity, const float load_fa
 unsigned int rho_ct_id_for_const(RhoConstTable *ct, RhoCTConst key)
 {
 	if (key.type == RHO_CT_CODEOBJ) {
-		RhoCTEntry *new = rho_malloc(sizeof(RhoCTEntry));
+		RhoCTEntry *new = rho_arena_alloc(ct->arena, sizeof(RhoCTEntry));
 		new->key = key;
 		new->value = ct->next_id++;
 		new->hash = 0;
@@ -121,7 +120,7 @@ unsigned int rho_ct_id_for_const(RhoConstTable *ct, RhoCTConst key)
 		}
 	}
 
-	RhoCTEntry *new = rho_malloc(sizeof(RhoCTEntry));
+	RhoCTEntry *new = rho_arena_alloc(ct->arena, sizeof(RhoCTEntry));
 	new->key = key;
 	new->value = ct->next_id++;
 	new->hash = hash;
@@ -143,7 +142,6 @@ unsigned int rho_ct_poll_codeobj(RhoConstTable *ct)
 	assert(head != NULL);
 	unsigned int value = head->value;
 	ct->codeobjs_head = head->next;
-	free(head);
 
 	if (ct->codeobjs_head == NULL) {
 		ct->codeobjs_tail = NULL;
@@ -172,10 +170,7 @@ void ct_grow(RhoConstTable *ct, const size_t new_capacity)
 		}
 	}
 
-	RhoCTEntry **new_table = rho_malloc(capacity_real * sizeof(RhoCTEntry *));
-	for (size_t i = 0; i < capacity_real; i++) {
-		new_table[i] = NULL;
-	}
+	RhoCTEntry **new_table = rho_arena_calloc(ct->arena, capacity_real * sizeof(RhoCTEntry *));
 	const size_t capacity = ct->capacity;
 
 	for (size_t i = 0; i < capacity; i++) {
@@ -190,33 +185,7 @@ void ct_grow(RhoConstTable *ct, const size_t new_capacity)
 		}
 	}
 
-	free(ct->table);
 	ct->table = new_table;
 	ct->capacity = capacity_real;
 	ct->threshold = (size_t)(capacity_real * ct->load_factor);
 }
-
-static void ct_entry_free(RhoCTEntry *entry)
-{
-	free(entry);
-}
-
-void rho_ct_free(RhoConstTable *ct)
-{
-	assert(ct->codeobjs_size == 0);
-
-	const size_t capacity = ct->capacity;
-
-	for (size_t i = 0; i < capacity; i++) {
-		RhoCTEntry *entry = ct->table[i];
-
-		while (entry != NULL) {
-			RhoCTEntry *temp = entry;
-			entry = entry->next;
-			ct_entry_free(temp);
-		}
-	}
-
-	free(ct->table);
-	free(ct);
-}
@@ -4,6 +4,7 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include "str.h"
+#include "arena.h"
 #include "code.h"
 
 #define RHO_CT_CAPACITY 16
@@ -36,9 +37,12 @@ typedef struct rho_ct_entry {
 } RhoCTEntry;
 
 /*
- * Simple constant table
+ * Simple constant table, allocated in the arena of
+ * the program being compiled
  */
 typedef struct {
+	RhoArena *arena;
+
 	RhoCTEntry **table;
 	size_t table_size;
 	size_t capacity;
@@ -57,9 +61,8 @@ typedef struct {
 	size_t codeobjs_size;
 } RhoConstTable;
 
-RhoConstTable *rho_ct_new(void);
+RhoConstTable *rho_ct_new(RhoArena *arena);
 unsigned int rho_ct_id_for_const(RhoConstTable *ct, RhoCTConst key);
 unsigned int rho_ct_poll_codeobj(RhoConstTable *ct);
-void rho_ct_free(RhoConstTable *ct);
 
 #endif /* RHO_CONSTTAB_H */
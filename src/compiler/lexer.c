@@ -13,10 +13,14 @@
  * Parser structure pertaining to lexical analysis.)
  *
  * The lexical analysis stage consists of splitting the input source
- * into tokens. The source is fully tokenized upon the creation of a
- * Parser instance, which can then be queried to retrieve the tokens in
- * succession. A "Lexer" can, therefore, be thought of as a simple queue
- * of tokens.
+ * into tokens. Tokens are read from the source as the parser asks for
+ * them, and are kept in a queue of fixed-size blocks so that pointers
+ * to them stay valid while the parser holds them. Once a top-level
+ * statement has been parsed, none of its tokens are needed anymore,
+ * and their blocks are reused (see `parser_release_tokens`), so only
+ * as many tokens as there are in the largest statement are ever kept
+ * around. A "Lexer" can, therefore, be thought of as a simple queue of
+ * tokens.
  *
  * Specifically, the following operations are supported:
  *
@@ -416,7 +420,7 @@ static RhoToken next_string(RhoParser *p, const char delim)
 		const char c = currc(p);
 
 		if (c == '\n') {
-			RHO_PARSER_SET_ERROR_TYPE(p, RHO_PARSE_ERR_NEWLINE_IN_STRING);
+			p->lex_error_type = RHO_PARSE_ERR_NEWLINE_IN_STRING;
 			static RhoToken x;
 			return x;
 		}
@@ -589,7 +593,7 @@ static RhoToken next_dollar_ident(RhoParser *p)
 
 	if (!isdigit(nextc(p)) || nextc(p) == '0') {
 		fwd(p);
-		RHO_PARSER_SET_ERROR_TYPE(p, RHO_PARSE_ERR_UNEXPECTED_CHAR);
+		p->lex_error_type = RHO_PARSE_ERR_UNEXPECTED_CHAR;
 		static RhoToken x;
 		return x;
 	}
@@ -637,19 +641,35 @@ static void pass_comment(RhoParser *p)
 
 static void add_token(RhoParser *p, RhoToken *tok)
 {
-	const size_t size = p->tok_count;
-	const size_t capacity = p->tok_capacity;
+	if (p->tok_count == RHO_TOKEN_BLOCK_SIZE) {
+		struct rho_token_block *block = p->tok_free;
 
-	if (size == capacity) {
-		const size_t new_capacity = (capacity * 3) / 2 + 1;
-		p->tok_capacity = new_capacity;
-		p->tokens = rho_realloc(p->tokens, new_capacity * sizeof(RhoToken));
+		if (block != NULL) {
+			p->tok_free = block->next;
+		} else {
+			block = rho_malloc(sizeof(struct rho_token_block));
+		}
+
+		block->next = NULL;
+		p->tok_tail->next = block;
+		p->tok_tail = block;
+		p->tok_count = 0;
 	}
 
-	p->tokens[p->tok_count++] = *tok;
+	p->tok_tail->tokens[p->tok_count++] = *tok;
+
+	if (tok->type != RHO_TOK_NEWLINE && tok->type != RHO_TOK_EOF) {
+		p->tok_last = *tok;
+	}
 }
 
-void rho_parser_tokenize(RhoParser *p)
+/*
+ * Reads the next token from the source and adds it to the
+ * token queue. On error, an EOF token is added instead and
+ * the rest of the source is skipped; `parse` then reports
+ * the error.
+ */
+static void read_token(RhoParser *p)
 {
 	while (true) {
 		skip_spaces(p);
@@ -716,11 +736,12 @@ void rho_parser_tokenize(RhoParser *p)
 			}
 		}
 
-		if (RHO_PARSER_ERROR(p)) {
+		if (p->lex_error_type != RHO_PARSE_ERR_NONE) {
 			goto err;
 		}
 
 		add_token(p, &tok);
+		return;
 	}
 
 	RhoToken eof = eof_token();
@@ -730,10 +751,29 @@ void rho_parser_tokenize(RhoParser *p)
 
 	err:
 	lex_err_unexpected_char(p, p->pos);
-	free(p->tokens);
-	p->tokens = NULL;
-	p->tok_count = 0;
-	p->tok_capacity = 0;
+	p->pos += strlen(p->pos);
+	eof = eof_token();
+	eof.lineno = p->lineno;
+	add_token(p, &eof);
+}
+
+/*
+ * Returns the token at the given position in the token queue,
+ * reading more of the source if need be. The position is moved
+ * on to the next block if it is at the end of its own.
+ */
+static RhoToken *token_at(RhoParser *p, struct rho_token_block **block, size_t *pos)
+{
+	while (*block == p->tok_tail && *pos == p->tok_count) {
+		read_token(p);
+	}
+
+	if (*pos == RHO_TOKEN_BLOCK_SIZE) {
+		*block = (*block)->next;
+		*pos = 0;
+	}
+
+	return &(*block)->tokens[*pos];
 }
 
 /*
@@ -758,7 +798,7 @@ RhoToken *rho_parser_next_token_direct(RhoParser *p)
 {
 	p->peek = NULL;
 
-	RhoToken *next = &p->tokens[p->tok_pos];
+	RhoToken *next = token_at(p, &p->tok_block, &p->tok_pos);
 
 	if (next->type != RHO_TOK_EOF) {
 		++p->tok_pos;
@@ -773,41 +813,64 @@ RhoToken *rho_parser_peek_token(RhoParser *p)
 		return p->peek;
 	}
 
-	RhoToken *tokens = p->tokens;
+	struct rho_token_block *block = p->tok_block;
+	size_t pos = p->tok_pos;
+	RhoToken *tok;
 
-	const size_t tok_count = p->tok_count;
-	const size_t tok_pos = p->tok_pos;
-	size_t offset = 0;
+	while ((tok = token_at(p, &block, &pos))->type == RHO_TOK_NEWLINE) {
+		++pos;
+	}
 
-	while (tok_pos + offset < tok_count &&
-	       tokens[tok_pos + offset].type == RHO_TOK_NEWLINE) {
+	return p->peek = tok;
+}
 
-		++offset;
-	}
+RhoToken *rho_parser_peek_token_direct(RhoParser *p)
+{
+	return token_at(p, &p->tok_block, &p->tok_pos);
+}
+
+/*
+ * Returns the token `n` tokens past the next one, newlines
+ * included, without consuming anything. Stops at EOF.
+ */
+RhoToken *rho_parser_peek_token_ahead(RhoParser *p, size_t n)
+{
+	struct rho_token_block *block = p->tok_block;
+	size_t pos = p->tok_pos;
+	RhoToken *tok = token_at(p, &block, &pos);
 
-	while (tok_pos + offset >= tok_count) {
-		--offset;
+	while (n-- > 0 && tok->type != RHO_TOK_EOF) {
+		++pos;
+		tok = token_at(p, &block, &pos);
 	}
 
-	return p->peek = &tokens[tok_pos + offset];
+	return tok;
 }
 
-RhoToken *rho_parser_peek_token_direct(RhoParser *p)
+bool rho_parser_has_next_token(RhoParser *p)
 {
-	return &p->tokens[p->tok_pos];
+	return rho_parser_peek_token_direct(p)->type != RHO_TOK_EOF;
 }
 
-bool rho_parser_has_next_token(RhoParser *p)
+/*
+ * Puts the blocks holding only tokens before the current one
+ * up for reuse. No pointers to those tokens may be in use.
+ */
+void rho_parser_release_tokens(RhoParser *p)
 {
-	return p->tokens[p->tok_pos].type != RHO_TOK_EOF;
+	while (p->tok_head != p->tok_block) {
+		struct rho_token_block *block = p->tok_head;
+		p->tok_head = block->next;
+		block->next = p->tok_free;
+		p->tok_free = block;
+	}
 }
 
 static void lex_err_unexpected_char(RhoParser *p, const char *c)
 {
 	const char *tok_err = rho_err_on_char(c, p->code, p->end, p->lineno);
-	RHO_PARSER_SET_ERROR_MSG(p,
-	                         rho_util_str_format(RHO_SYNTAX_ERROR " unexpected character: %c\n\n%s",
-	                                             p->name, p->lineno, *c, tok_err));
+	p->lex_error_msg = rho_util_str_format(RHO_SYNTAX_ERROR " unexpected character: %c\n\n%s",
+	                                       p->name, p->lineno, *c, tok_err);
 	RHO_FREE(tok_err);
-	RHO_PARSER_SET_ERROR_TYPE(p, RHO_PARSE_ERR_UNEXPECTED_CHAR);
+	p->lex_error_type = RHO_PARSE_ERR_UNEXPECTED_CHAR;
 }
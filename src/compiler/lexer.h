@@ -9,8 +9,9 @@ RhoToken *rho_parser_next_token(RhoParser *p);
 RhoToken *rho_parser_next_token_direct(RhoParser *p);
 RhoToken *rho_parser_peek_token(RhoParser *p);
 RhoToken *rho_parser_peek_token_direct(RhoParser *p);
+RhoToken *rho_parser_peek_token_ahead(RhoParser *p, size_t n);
 bool rho_parser_has_next_token(RhoParser *p);
-void rho_parser_tokenize(RhoParser *p);
+void rho_parser_release_tokens(RhoParser *p);
 const char *rho_type_to_str(RhoTokType type);
 
 #endif /* RHO_LEXER_H */
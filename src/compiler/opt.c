@@ -0,0 +1,603 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <math.h>
+#include "ast.h"
+#include "str.h"
+#include "opt.h"
+
+/*
+ * AST optimization
+ *
+ * Constant folding mirrors the runtime semantics of the
+ * corresponding operations on Int, Float and Str values
+ * exactly; an expression is only folded if it is certain
+ * to succeed at runtime and its result can be represented
+ * in the AST (i.e. the constant table). In particular, Int
+ * results must fit in an `int`, and `==`, `!=` and `not`
+ * (which produce Bools) are only evaluated where nothing
+ * but their truth value matters, namely in conditions.
+ *
+ * A branch is only removed if it doesn't bind any names,
+ * since that would change which variables are local.
+ */
+
+#define TRUTH_UNKNOWN (-1)
+
+static RhoAST *opt_node(RhoAST *ast, RhoArena *arena);
+
+static void opt_list(struct rho_ast_list *list, RhoArena *arena)
+{
+	for (struct rho_ast_list *node = list; node != NULL; node = node->next) {
+		node->ast = opt_node(node->ast, arena);
+	}
+}
+
+static bool is_number(RhoAST *ast)
+{
+	return ast != NULL && (ast->type == RHO_NODE_INT || ast->type == RHO_NODE_FLOAT);
+}
+
+static bool is_const(RhoAST *ast)
+{
+	return is_number(ast) || (ast != NULL && ast->type == RHO_NODE_STRING);
+}
+
+static double number_value(RhoAST *ast)
+{
+	return (ast->type == RHO_NODE_INT) ? ast->v.int_val : ast->v.float_val;
+}
+
+static bool binds_names(RhoAST *ast);
+
+static bool list_binds_names(struct rho_ast_list *list)
+{
+	for (struct rho_ast_list *node = list; node != NULL; node = node->next) {
+		if (binds_names(node->ast)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool binds_names(RhoAST *ast)
+{
+	if (ast == NULL) {
+		return false;
+	}
+
+	if (RHO_NODE_TYPE_IS_ASSIGNMENT(ast->type)) {
+		return true;
+	}
+
+	switch (ast->type) {
+	case RHO_NODE_INT:
+	case RHO_NODE_FLOAT:
+	case RHO_NODE_STRING:
+	case RHO_NODE_IDENT:
+		return false;
+	case RHO_NODE_FOR:
+	case RHO_NODE_RECEIVE:
+	case RHO_NODE_IMPORT:
+	case RHO_NODE_DEF:
+	case RHO_NODE_GEN:
+	case RHO_NODE_ACT:
+		return true;
+	case RHO_NODE_IF:
+	case RHO_NODE_ELIF:
+		/* elif chains can be long, so aren't walked recursively */
+		for (RhoAST *node = ast; node != NULL; node = node->v.middle) {
+			if (binds_names(node->left) || binds_names(node->right)) {
+				return true;
+			}
+		}
+		return false;
+	case RHO_NODE_COND_EXPR:
+		if (binds_names(ast->v.middle)) {
+			return true;
+		}
+		break;
+	case RHO_NODE_BLOCK:
+		return list_binds_names(ast->v.block);
+	case RHO_NODE_LIST:
+	case RHO_NODE_TUPLE:
+	case RHO_NODE_SET:
+	case RHO_NODE_DICT:
+		return list_binds_names(ast->v.list);
+	case RHO_NODE_CALL:
+		if (list_binds_names(ast->v.params)) {
+			return true;
+		}
+		break;
+	case RHO_NODE_TRY_CATCH:
+		if (list_binds_names(ast->v.excs)) {
+			return true;
+		}
+		break;
+	default:
+		break;
+	}
+
+	return binds_names(ast->left) || binds_names(ast->right);
+}
+
+/*
+ * Nodes dropped below needn't be freed, since they're
+ * allocated in the program's arena (see ast.h).
+ */
+
+static void clear_children(RhoAST *ast)
+{
+	ast->left = NULL;
+	ast->right = NULL;
+}
+
+static RhoAST *make_nothing(RhoAST *ast)
+{
+	clear_children(ast);
+	ast->type = RHO_NODE_BLOCK;
+	ast->v.block = NULL;
+	return ast;
+}
+
+static RhoAST *make_int(RhoAST *ast, const long n)
+{
+	clear_children(ast);
+	ast->type = RHO_NODE_INT;
+	ast->v.int_val = (int)n;
+	return ast;
+}
+
+static RhoAST *make_float(RhoAST *ast, const double d)
+{
+	clear_children(ast);
+	ast->type = RHO_NODE_FLOAT;
+	ast->v.float_val = d;
+	return ast;
+}
+
+static RhoAST *make_str(RhoAST *ast, RhoStr *str)
+{
+	clear_children(ast);
+	ast->type = RHO_NODE_STRING;
+	ast->v.str_val = str;
+	return ast;
+}
+
+/*
+ * Replaces `ast` by its child `child` (which must be
+ * either its left or right child).
+ */
+static RhoAST *replace_by_child(RhoAST *ast, RhoAST *child)
+{
+	if (ast->left == child) {
+		ast->left = NULL;
+	} else {
+		ast->right = NULL;
+	}
+
+	return child;
+}
+
+static bool fits_int(const long n)
+{
+	return INT_MIN <= n && n <= INT_MAX;
+}
+
+static int cmp_result(RhoNodeType type, const int cmp)
+{
+	switch (type) {
+	case RHO_NODE_LT:
+		return cmp < 0;
+	case RHO_NODE_GT:
+		return cmp > 0;
+	case RHO_NODE_LE:
+		return cmp <= 0;
+	case RHO_NODE_GE:
+		return cmp >= 0;
+	default:
+		return TRUTH_UNKNOWN;
+	}
+}
+
+/*
+ * Returns 1 if `ast` is a constant expression whose truth value
+ * is true, 0 if it's one whose truth value is false, or
+ * TRUTH_UNKNOWN otherwise.
+ */
+static int const_truth(RhoAST *ast)
+{
+	if (ast == NULL) {
+		return TRUTH_UNKNOWN;
+	}
+
+	switch (ast->type) {
+	case RHO_NODE_INT:
+		return ast->v.int_val != 0;
+	case RHO_NODE_FLOAT:
+		return ast->v.float_val != 0;
+	case RHO_NODE_STRING:
+		return ast->v.str_val->len != 0;
+	case RHO_NODE_NOT: {
+		const int truth = const_truth(ast->left);
+		return (truth == TRUTH_UNKNOWN) ? TRUTH_UNKNOWN : !truth;
+	}
+	case RHO_NODE_AND:
+	case RHO_NODE_OR: {
+		const int t1 = const_truth(ast->left);
+		const int t2 = const_truth(ast->right);
+
+		if (t1 == TRUTH_UNKNOWN || t2 == TRUTH_UNKNOWN) {
+			return TRUTH_UNKNOWN;
+		}
+
+		return (ast->type == RHO_NODE_AND) ? (t1 && t2) : (t1 || t2);
+	}
+	case RHO_NODE_EQUAL:
+	case RHO_NODE_NOTEQ: {
+		RhoAST *a = ast->left;
+		RhoAST *b = ast->right;
+		int eq;
+
+		if (!is_const(a) || !is_const(b)) {
+			return TRUTH_UNKNOWN;
+		}
+
+		if (a->type == RHO_NODE_INT && b->type == RHO_NODE_INT) {
+			eq = (a->v.int_val == b->v.int_val);
+		} else if (is_number(a) && is_number(b)) {
+			eq = (number_value(a) == number_value(b));
+		} else if (a->type == RHO_NODE_STRING && b->type == RHO_NODE_STRING) {
+			eq = rho_str_eq(a->v.str_val, b->v.str_val);
+		} else {
+			eq = 0;  /* numbers and strings are never equal */
+		}
+
+		return (ast->type == RHO_NODE_EQUAL) ? eq : !eq;
+	}
+	default:
+		return TRUTH_UNKNOWN;
+	}
+}
+
+static RhoAST *fold_unary(RhoAST *ast)
+{
+	RhoAST *x = ast->left;
+
+	if (!is_number(x)) {
+		return ast;
+	}
+
+	const bool is_int = (x->type == RHO_NODE_INT);
+
+	switch (ast->type) {
+	case RHO_NODE_UPLUS:
+		return replace_by_child(ast, x);
+	case RHO_NODE_UMINUS:
+		if (is_int) {
+			const long n = -(long)x->v.int_val;
+			return fits_int(n) ? make_int(ast, n) : ast;
+		} else {
+			return make_float(ast, -x->v.float_val);
+		}
+	case RHO_NODE_BITNOT:
+		return is_int ? make_int(ast, ~(long)x->v.int_val) : ast;
+	default:
+		return ast;
+	}
+}
+
+static RhoAST *fold_binary_int(RhoAST *ast, const long x, const long y)
+{
+	long n;
+
+	switch (ast->type) {
+	case RHO_NODE_ADD:
+		n = x + y;
+		break;
+	case RHO_NODE_SUB:
+		n = x - y;
+		break;
+	case RHO_NODE_MUL:
+		n = x * y;
+		break;
+	case RHO_NODE_DIV:
+		if (y == 0) {
+			return ast;
+		}
+		n = x / y;
+		break;
+	case RHO_NODE_MOD:
+		if (y == 0) {
+			return ast;
+		}
+		n = x % y;
+		break;
+	case RHO_NODE_POW: {
+		const double d = pow(x, y);
+
+		if (!(INT_MIN <= d && d <= INT_MAX)) {
+			return ast;
+		}
+
+		n = (long)d;
+		break;
+	}
+	case RHO_NODE_BITAND:
+		n = x & y;
+		break;
+	case RHO_NODE_BITOR:
+		n = x | y;
+		break;
+	case RHO_NODE_XOR:
+		n = x ^ y;
+		break;
+	case RHO_NODE_SHIFTL:
+		if (y < 0 || y >= 32) {
+			return ast;
+		}
+		n = x * (1L << y);
+		break;
+	case RHO_NODE_SHIFTR:
+		if (y < 0 || y >= (long)(sizeof(long) * CHAR_BIT)) {
+			return ast;
+		}
+		n = x >> y;
+		break;
+	case RHO_NODE_LT:
+	case RHO_NODE_GT:
+	case RHO_NODE_LE:
+	case RHO_NODE_GE:
+		n = cmp_result(ast->type, (x < y) ? -1 : ((x == y) ? 0 : 1));
+		break;
+	default:
+		return ast;
+	}
+
+	return fits_int(n) ? make_int(ast, n) : ast;
+}
+
+static RhoAST *fold_binary_float(RhoAST *ast, const double x, const double y)
+{
+	switch (ast->type) {
+	case RHO_NODE_ADD:
+		return make_float(ast, x + y);
+	case RHO_NODE_SUB:
+		return make_float(ast, x - y);
+	case RHO_NODE_MUL:
+		return make_float(ast, x * y);
+	case RHO_NODE_DIV:
+		return (y != 0) ? make_float(ast, x / y) : ast;
+	case RHO_NODE_POW:
+		return make_float(ast, pow(x, y));
+	case RHO_NODE_LT:
+	case RHO_NODE_GT:
+	case RHO_NODE_LE:
+	case RHO_NODE_GE:
+		return make_int(ast, cmp_result(ast->type, (x < y) ? -1 : ((x == y) ? 0 : 1)));
+	default:
+		return ast;
+	}
+}
+
+static RhoAST *fold_binary_str(RhoAST *ast, RhoStr *x, RhoStr *y, RhoArena *arena)
+{
+	switch (ast->type) {
+	case RHO_NODE_ADD:
+		return make_str(ast, rho_str_cat_arena(arena, x, y));
+	case RHO_NODE_LT:
+	case RHO_NODE_GT:
+	case RHO_NODE_LE:
+	case RHO_NODE_GE:
+		return make_int(ast, cmp_result(ast->type, rho_str_cmp(x, y)));
+	default:
+		return ast;
+	}
+}
+
+static RhoAST *fold_binary(RhoAST *ast, RhoArena *arena)
+{
+	RhoAST *a = ast->left;
+	RhoAST *b = ast->right;
+
+	if (a->type == RHO_NODE_INT && b->type == RHO_NODE_INT) {
+		return fold_binary_int(ast, a->v.int_val, b->v.int_val);
+	} else if (is_number(a) && is_number(b)) {
+		return fold_binary_float(ast, number_value(a), number_value(b));
+	} else if (a->type == RHO_NODE_STRING && b->type == RHO_NODE_STRING) {
+		return fold_binary_str(ast, a->v.str_val, b->v.str_val, arena);
+	} else {
+		return ast;
+	}
+}
+
+/*
+ * `a and b` evaluates to `a` if `a` is false and to `b`
+ * otherwise; `a or b` evaluates to `a` if `a` is true and
+ * to `b` otherwise.
+ */
+static RhoAST *fold_and_or(RhoAST *ast)
+{
+	RhoAST *a = ast->left;
+	RhoAST *b = ast->right;
+	const int truth = const_truth(a);
+
+	if (truth == TRUTH_UNKNOWN) {
+		return ast;
+	}
+
+	const bool pick_a = (ast->type == RHO_NODE_AND) ? !truth : truth;
+
+	if (!pick_a) {
+		return replace_by_child(ast, b);
+	}
+
+	/* `a` might not be representable (e.g. if it's a comparison) */
+	return is_const(a) ? replace_by_child(ast, a) : ast;
+}
+
+static RhoAST *fold_cond_expr(RhoAST *ast)
+{
+	const int truth = const_truth(ast->v.middle);
+
+	if (truth == TRUTH_UNKNOWN) {
+		return ast;
+	}
+
+	return replace_by_child(ast, truth ? ast->left : ast->right);
+}
+
+static RhoAST *opt_if(RhoAST *ast, RhoArena *arena)
+{
+	for (RhoAST *node = ast; node != NULL; node = node->v.middle) {
+		node->left = opt_node(node->left, arena);
+		node->right = opt_node(node->right, arena);
+	}
+
+	/* rebuild the if-elif-else chain without the dead branches */
+	RhoAST *head = NULL;
+	RhoAST **link = &head;
+	RhoAST *node = ast;
+
+	while (node != NULL) {
+		RhoAST *next = node->v.middle;
+		node->v.middle = NULL;
+
+		if (node->type != RHO_NODE_ELSE) {
+			const int truth = const_truth(node->left);
+
+			if (truth == 0 && !binds_names(node->right)) {
+				node = next;
+				continue;
+			}
+
+			if (truth == 1 && !binds_names(next)) {
+				/* this branch is always taken, so it's effectively an `else` */
+				next = NULL;
+				node->type = RHO_NODE_ELSE;
+				node->left = node->right;
+				node->right = NULL;
+			}
+		}
+
+		*link = node;
+		link = &node->v.middle;
+		node = next;
+	}
+
+	if (head == NULL) {
+		return make_nothing(ast);
+	}
+
+	if (head->type == RHO_NODE_ELSE) {
+		RhoAST *body = head->left;
+		head->left = NULL;
+
+		if (body == NULL) {
+			return make_nothing(head);
+		}
+
+		return body;
+	}
+
+	head->type = RHO_NODE_IF;
+	return head;
+}
+
+static RhoAST *opt_while(RhoAST *ast, RhoArena *arena)
+{
+	ast->left = opt_node(ast->left, arena);
+	ast->right = opt_node(ast->right, arena);
+
+	const int truth = const_truth(ast->left);
+
+	if (truth == 0 && !binds_names(ast->right)) {
+		return make_nothing(ast);
+	}
+
+	if (truth == 1) {
+		/* a null condition means the loop only ends through `break` */
+		ast->left = NULL;
+	}
+
+	return ast;
+}
+
+static RhoAST *opt_node(RhoAST *ast, RhoArena *arena)
+{
+	if (ast == NULL) {
+		return NULL;
+	}
+
+	switch (ast->type) {
+	case RHO_NODE_IF:
+		return opt_if(ast, arena);
+	case RHO_NODE_WHILE:
+		return opt_while(ast, arena);
+	case RHO_NODE_FOR:
+	case RHO_NODE_COND_EXPR:
+		ast->v.middle = opt_node(ast->v.middle, arena);
+		break;
+	case RHO_NODE_BLOCK:
+		opt_list(ast->v.block, arena);
+		break;
+	case RHO_NODE_LIST:
+	case RHO_NODE_TUPLE:
+	case RHO_NODE_SET:
+	case RHO_NODE_DICT:
+		opt_list(ast->v.list, arena);
+		break;
+	case RHO_NODE_DEF:
+	case RHO_NODE_GEN:
+	case RHO_NODE_ACT:
+	case RHO_NODE_CALL:
+		opt_list(ast->v.params, arena);
+		break;
+	case RHO_NODE_TRY_CATCH:
+		opt_list(ast->v.excs, arena);
+		break;
+	default:
+		break;
+	}
+
+	ast->left = opt_node(ast->left, arena);
+	ast->right = opt_node(ast->right, arena);
+
+	switch (ast->type) {
+	case RHO_NODE_UPLUS:
+	case RHO_NODE_UMINUS:
+	case RHO_NODE_BITNOT:
+		return fold_unary(ast);
+	case RHO_NODE_ADD:
+	case RHO_NODE_SUB:
+	case RHO_NODE_MUL:
+	case RHO_NODE_DIV:
+	case RHO_NODE_MOD:
+	case RHO_NODE_POW:
+	case RHO_NODE_BITAND:
+	case RHO_NODE_BITOR:
+	case RHO_NODE_XOR:
+	case RHO_NODE_SHIFTL:
+	case RHO_NODE_SHIFTR:
+	case RHO_NODE_LT:
+	case RHO_NODE_GT:
+	case RHO_NODE_LE:
+	case RHO_NODE_GE:
+		return fold_binary(ast, arena);
+	case RHO_NODE_AND:
+	case RHO_NODE_OR:
+		return fold_and_or(ast);
+	case RHO_NODE_COND_EXPR:
+		return fold_cond_expr(ast);
+	default:
+		return ast;
+	}
+}
+
+void rho_opt_program(RhoProgram *program, RhoArena *arena)
+{
+	opt_list(program, arena);
+}
+
+#undef TRUTH_UNKNOWN
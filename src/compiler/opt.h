@@ -0,0 +1,16 @@
+#ifndef RHO_OPT_H
+#define RHO_OPT_H
+
+#include "ast.h"
+
+/*
+ * Optimizes the given program in place, before it's handed to
+ * the compiler: constant expressions are folded and branches
+ * that can never be taken are removed. Any expression whose
+ * evaluation could fail at runtime (e.g. a division by zero)
+ * is left as is, so that it still fails at runtime. New strings
+ * are allocated in `arena`, that of the program.
+ */
+void rho_opt_program(RhoProgram *program, RhoArena *arena);
+
+#endif /* RHO_OPT_H */
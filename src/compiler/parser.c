@@ -10,41 +10,14 @@
 
 #define ERROR_CHECK(p) do { if (RHO_PARSER_ERROR(p)) return NULL; } while (0)
 
-#define ERROR_CHECK_AST(p, should_be_null, free_me) \
-	do { \
-		if (RHO_PARSER_ERROR(p)) { \
-			assert((should_be_null) == NULL); \
-			rho_ast_free(free_me); \
-			return NULL; \
-		} \
-	} while (0)
-
-#define ERROR_CHECK_AST2(p, should_be_null, free_me1, free_me2) \
-	do { \
-		if (RHO_PARSER_ERROR(p)) { \
-			assert((should_be_null) == NULL); \
-			rho_ast_free(free_me1); \
-			rho_ast_free(free_me2); \
-			return NULL; \
-		} \
-	} while (0)
-
-#define ERROR_CHECK_AST3(p, should_be_null, free_me1, free_me2, free_me3) \
-	do { \
-		if (RHO_PARSER_ERROR(p)) { \
-			assert((should_be_null) == NULL); \
-			rho_ast_free(free_me1); \
-			rho_ast_free(free_me2); \
-			rho_ast_free(free_me3); \
-			return NULL; \
-		} \
-	} while (0)
-
-#define ERROR_CHECK_LIST(p, should_be_null, free_me) \
+/*
+ * Nodes of a failed parse need not be freed here; they go
+ * along with the rest of the parser's arena.
+ */
+#define ERROR_CHECK_AST(p, should_be_null) \
 	do { \
 		if (RHO_PARSER_ERROR(p)) { \
 			assert((should_be_null) == NULL); \
-			rho_ast_list_free(free_me); \
 			return NULL; \
 		} \
 	} while (0)
@@ -173,21 +146,25 @@ static void parse_err_inconsistent_dict_elements(RhoParser *p, RhoToken *tok);
 static void parse_err_empty_for_params(RhoParser *p, RhoToken *tok);
 static void parse_err_return_val_in_gen(RhoParser *p, RhoToken *tok);
 
-RhoParser *rho_parser_new(char *str, const char *name)
+RhoParser *rho_parser_new(char *str, const char *name, RhoArena *arena)
 {
-#define INITIAL_TOKEN_ARRAY_CAPACITY 5
 	RhoParser *p = rho_malloc(sizeof(RhoParser));
 	p->code = str;
 	p->end = &str[strlen(str) - 1];
 	p->pos = &str[0];
 	p->mark = 0;
-	p->tokens = rho_malloc(INITIAL_TOKEN_ARRAY_CAPACITY * sizeof(RhoToken));
+	p->tok_head = rho_malloc(sizeof(struct rho_token_block));
+	p->tok_head->next = NULL;
+	p->tok_tail = p->tok_head;
 	p->tok_count = 0;
-	p->tok_capacity = INITIAL_TOKEN_ARRAY_CAPACITY;
+	p->tok_free = NULL;
+	p->tok_block = p->tok_head;
 	p->tok_pos = 0;
+	p->tok_last.type = RHO_TOK_NONE;
 	p->lineno = 1;
 	p->peek = NULL;
 	p->name = name;
+	p->arena = arena;
 	p->in_function = 0;
 	p->in_lambda = 0;
 	p->in_generator = 0;
@@ -196,28 +173,61 @@ RhoParser *rho_parser_new(char *str, const char *name)
 	p->in_args = 0;
 	p->error_type = RHO_PARSE_ERR_NONE;
 	p->error_msg = NULL;
-
-	rho_parser_tokenize(p);
+	p->lex_error_type = RHO_PARSE_ERR_NONE;
+	p->lex_error_msg = NULL;
 
 	return p;
-#undef INITIAL_TOKEN_ARRAY_CAPACITY
+}
+
+static void free_token_blocks(struct rho_token_block *block)
+{
+	while (block != NULL) {
+		struct rho_token_block *next = block->next;
+		free(block);
+		block = next;
+	}
 }
 
 void rho_parser_free(RhoParser *p)
 {
-	free(p->tokens);
+	free_token_blocks(p->tok_head);
+	free_token_blocks(p->tok_free);
 	RHO_FREE(p->error_msg);
+	RHO_FREE(p->lex_error_msg);
 	free(p);
 }
 
+/*
+ * Makes an error that came up while reading tokens the one that is
+ * reported, since the parser was given an EOF token at that point.
+ */
+static bool lex_error_check(RhoParser *p)
+{
+	if (p->lex_error_type == RHO_PARSE_ERR_NONE) {
+		return false;
+	}
+
+	RHO_FREE(p->error_msg);
+	RHO_PARSER_SET_ERROR_MSG(p, p->lex_error_msg);
+	RHO_PARSER_SET_ERROR_TYPE(p, p->lex_error_type);
+	p->lex_error_msg = NULL;
+	return true;
+}
+
 RhoProgram *rho_parse(RhoParser *p)
 {
-	RhoProgram *head = rho_ast_list_new();
+	RhoProgram *head = rho_ast_list_new(p->arena);
 	struct rho_ast_list *node = head;
 
 	while (rho_parser_has_next_token(p)) {
 		RhoAST *stmt = parse_stmt(p);
-		ERROR_CHECK_LIST(p, stmt, head);
+
+		if (lex_error_check(p)) {
+			return NULL;
+		}
+
+		ERROR_CHECK_AST(p, stmt);
+		rho_parser_release_tokens(p);
 
 		if (stmt == NULL) {
 			break;
@@ -228,18 +238,21 @@ RhoProgram *rho_parse(RhoParser *p)
 		 * in the syntax tree.
 		 */
 		if (stmt->type == RHO_NODE_EMPTY) {
-			free(stmt);
 			continue;
 		}
 
 		if (node->ast != NULL) {
-			node->next = rho_ast_list_new();
+			node->next = rho_ast_list_new(p->arena);
 			node = node->next;
 		}
 
 		node->ast = stmt;
 	}
 
+	if (lex_error_check(p)) {
+		return NULL;
+	}
+
 	return head;
 }
 
@@ -321,7 +334,6 @@ static RhoAST *parse_stmt(RhoParser *p)
 		 */
 		if (!RHO_NODE_TYPE_IS_EXPR_STMT(type)) {
 			parse_err_not_a_statement(p, tok);
-			rho_ast_free(expr_stmt);
 			return NULL;
 		}
 
@@ -335,7 +347,6 @@ static RhoAST *parse_stmt(RhoParser *p)
 
 	if (!RHO_TOK_TYPE_IS_STMT_TERM(stmt_end_type)) {
 		parse_err_unexpected_token(p, stmt_end);
-		rho_ast_free(stmt);
 		return NULL;
 	}
 
@@ -346,6 +357,66 @@ static RhoAST *parse_expr_helper(RhoParser *p, const bool allow_assigns);
 
 static RhoAST *parse_expr_min_prec(RhoParser *p, unsigned int min_prec, bool allow_assigns);
 
+/*
+ * Whether the given expression is a tuple of identifiers, like
+ * `(a, b)`, which can be the target of a (non-compound) assignment.
+ */
+static bool is_tuple_target(RhoAST *ast)
+{
+	if (ast->type != RHO_NODE_TUPLE || ast->v.list == NULL) {
+		return false;
+	}
+
+	for (struct rho_ast_list *node = ast->v.list; node != NULL; node = node->next) {
+		if (node->ast->type != RHO_NODE_IDENT) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Whether the upcoming tokens are a newline followed by a tuple
+ * assignment target, i.e. `(`, identifiers separated by commas,
+ * `)` and then `=`.
+ */
+static bool tuple_assign_on_next_line(RhoParser *p)
+{
+	if (rho_parser_peek_token_direct(p)->type != RHO_TOK_NEWLINE) {
+		return false;
+	}
+
+	size_t n = 0;
+	unsigned int idents = 0;
+	bool comma = true;  /* whether an identifier may come next */
+	RhoTokType type;
+
+	while ((type = rho_parser_peek_token_ahead(p, n++)->type) == RHO_TOK_NEWLINE);
+
+	if (type != RHO_TOK_PAREN_OPEN) {
+		return false;
+	}
+
+	while (true) {
+		while ((type = rho_parser_peek_token_ahead(p, n++)->type) == RHO_TOK_NEWLINE);
+
+		if (type == RHO_TOK_IDENT && comma) {
+			++idents;
+			comma = false;
+		} else if (type == RHO_TOK_COMMA && !comma) {
+			comma = true;
+		} else if (type == RHO_TOK_PAREN_CLOSE && idents > 0) {
+			break;
+		} else {
+			return false;
+		}
+	}
+
+	while ((type = rho_parser_peek_token_ahead(p, n++)->type) == RHO_TOK_NEWLINE);
+	return type == RHO_TOK_ASSIGN;
+}
+
 static RhoAST *parse_expr(RhoParser *p)
 {
 	return parse_expr_helper(p, true);
@@ -397,9 +468,9 @@ static RhoAST *parse_expr_min_prec(RhoParser *p, unsigned int min_prec, bool all
 		}
 
 		if (RHO_TOK_TYPE_IS_ASSIGNMENT_TOK(op.type) &&
-		    (!allow_assigns || min_prec != 1 || !RHO_NODE_TYPE_IS_ASSIGNABLE(lhs->type))) {
+		    (!allow_assigns || min_prec != 1 ||
+		     !(RHO_NODE_TYPE_IS_ASSIGNABLE(lhs->type) || (op.type == RHO_TOK_ASSIGN && is_tuple_target(lhs))))) {
 			parse_err_invalid_assign(p, tok);
-			rho_ast_free(lhs);
 			return NULL;
 		}
 
@@ -413,14 +484,14 @@ static RhoAST *parse_expr_min_prec(RhoParser *p, unsigned int min_prec, bool all
 		if (ternary) {  /* ternary operator */
 			cond = parse_expr_no_assign(p);
 			expect(p, RHO_TOK_ELSE);
-			ERROR_CHECK_AST2(p, NULL, cond, lhs);
+			ERROR_CHECK(p);
 		}
 
 		RhoAST *rhs = parse_expr_min_prec(p, next_min_prec, false);
-		ERROR_CHECK_AST2(p, rhs, lhs, cond);
+		ERROR_CHECK_AST(p, rhs);
 
 		RhoNodeType node_type = nodetype_from_op(op);
-		RhoAST *ast = rho_ast_new(node_type, lhs, rhs, tok->lineno);
+		RhoAST *ast = rho_ast_new(p->arena, node_type, lhs, rhs, tok->lineno);
 
 		if (ternary) {
 			ast->v.middle = cond;
@@ -552,13 +623,22 @@ static RhoAST *parse_atom(RhoParser *p)
 	 * Deal with cases like `foo[7].bar(42)`...
 	 */
 	while (tok->type == RHO_TOK_DOT || tok->type == RHO_TOK_PAREN_OPEN || tok->type == RHO_TOK_BRACK_OPEN) {
+		/*
+		 * A parenthesis at the start of a line normally continues the
+		 * expression as a call, unless it begins a tuple assignment
+		 * like `(a, b) = (b, a)`.
+		 */
+		if (tok->type == RHO_TOK_PAREN_OPEN && tuple_assign_on_next_line(p)) {
+			break;
+		}
+
 		switch (tok->type) {
 		case RHO_TOK_DOT: {
 			RhoToken *dot_tok = expect(p, RHO_TOK_DOT);
-			ERROR_CHECK_AST(p, dot_tok, ast);
+			ERROR_CHECK_AST(p, dot_tok);
 			RhoAST *ident = parse_ident(p);
-			ERROR_CHECK_AST(p, ident, ast);
-			RhoAST *dot = rho_ast_new(RHO_NODE_DOT, ast, ident, dot_tok->lineno);
+			ERROR_CHECK_AST(p, ident);
+			RhoAST *dot = rho_ast_new(p->arena, RHO_NODE_DOT, ast, ident, dot_tok->lineno);
 			ast = dot;
 			break;
 		}
@@ -569,7 +649,7 @@ static RhoAST *parse_atom(RhoParser *p)
 			                                                  parse_expr,
 			                                                  &nargs);
 
-			ERROR_CHECK_AST(p, params, ast);
+			ERROR_CHECK_AST(p, params);
 
 			/* argument syntax check */
 			for (struct rho_ast_list *param = params; param != NULL; param = param->next) {
@@ -577,16 +657,12 @@ static RhoAST *parse_atom(RhoParser *p)
 				      (param->ast->type != RHO_NODE_ASSIGN ||
 				       param->ast->left->type != RHO_NODE_IDENT)) {
 					parse_err_malformed_args(p, tok);
-					rho_ast_list_free(params);
-					rho_ast_free(ast);
 					return NULL;
 				}
 			}
 
 			if (nargs > FUNCTION_MAX_PARAMS) {
 				parse_err_too_many_args(p, tok);
-				rho_ast_list_free(params);
-				rho_ast_free(ast);
 				return NULL;
 			}
 
@@ -597,8 +673,6 @@ static RhoAST *parse_atom(RhoParser *p)
 					named = true;
 				} else if (named) {
 					parse_err_unnamed_after_named(p, tok);
-					rho_ast_list_free(params);
-					rho_ast_free(ast);
 					return NULL;
 				}
 			}
@@ -618,26 +692,24 @@ static RhoAST *parse_atom(RhoParser *p)
 
 					if (rho_str_eq(ast1->v.ident, ast2->v.ident)) {
 						parse_err_dup_named_args(p, tok, ast1->v.ident->value);
-						rho_ast_list_free(params);
-						rho_ast_free(ast);
 						return NULL;
 					}
 				}
 			}
 
-			RhoAST *call = rho_ast_new(RHO_NODE_CALL, ast, NULL, tok->lineno);
+			RhoAST *call = rho_ast_new(p->arena, RHO_NODE_CALL, ast, NULL, tok->lineno);
 			call->v.params = params;
 			ast = call;
 			break;
 		}
 		case RHO_TOK_BRACK_OPEN: {
 			expect(p, RHO_TOK_BRACK_OPEN);
-			ERROR_CHECK_AST(p, NULL, ast);
+			ERROR_CHECK(p);
 			RhoAST *index = parse_expr_no_assign(p);
-			ERROR_CHECK_AST(p, index, ast);
+			ERROR_CHECK_AST(p, index);
 			expect(p, RHO_TOK_BRACK_CLOSE);
-			ERROR_CHECK_AST2(p, NULL, ast, index);
-			RhoAST *index_expr = rho_ast_new(RHO_NODE_INDEX, ast, index, tok->lineno);
+			ERROR_CHECK(p);
+			RhoAST *index_expr = rho_ast_new(p->arena, RHO_NODE_INDEX, ast, index, tok->lineno);
 			ast = index_expr;
 			break;
 		}
@@ -669,7 +741,7 @@ static RhoAST *parse_parens(RhoParser *p)
 
 		expect(p, RHO_TOK_PAREN_CLOSE);
 		ERROR_CHECK(p);
-		RhoAST *ast = rho_ast_new(RHO_NODE_TUPLE, NULL, NULL, lineno);
+		RhoAST *ast = rho_ast_new(p->arena, RHO_NODE_TUPLE, NULL, NULL, lineno);
 		ast->v.list = NULL;
 		return ast;
 	}
@@ -687,8 +759,8 @@ static RhoAST *parse_parens(RhoParser *p)
 		/* we have a non-empty tuple */
 
 		expect(p, RHO_TOK_COMMA);
-		ERROR_CHECK_AST(p, NULL, ast);
-		struct rho_ast_list *list_head = rho_ast_list_new();
+		ERROR_CHECK(p);
+		struct rho_ast_list *list_head = rho_ast_list_new(p->arena);
 		list_head->ast = ast;
 		struct rho_ast_list *list = list_head;
 
@@ -697,35 +769,35 @@ static RhoAST *parse_parens(RhoParser *p)
 
 			if (next->type == RHO_TOK_EOF) {
 				parse_err_unclosed(p, paren_open);
-				ERROR_CHECK_LIST(p, NULL, list_head);
+				ERROR_CHECK(p);
 			}
 
 			if (next->type == RHO_TOK_PAREN_CLOSE) {
 				break;
 			}
 
-			list->next = rho_ast_list_new();
+			list->next = rho_ast_list_new(p->arena);
 			list = list->next;
 			list->ast = parse_expr_no_assign(p);
-			ERROR_CHECK_LIST(p, list->ast, list_head);
+			ERROR_CHECK_AST(p, list->ast);
 
 			next = rho_parser_peek_token(p);
 
 			if (next->type == RHO_TOK_COMMA) {
 				expect(p, RHO_TOK_COMMA);
-				ERROR_CHECK_LIST(p, NULL, list_head);
+				ERROR_CHECK(p);
 			} else if (next->type != RHO_TOK_PAREN_CLOSE) {
 				parse_err_unexpected_token(p, next);
-				ERROR_CHECK_LIST(p, NULL, list_head);
+				ERROR_CHECK(p);
 			}
 		} while (true);
 
-		ast = rho_ast_new(RHO_NODE_TUPLE, NULL, NULL, lineno);
+		ast = rho_ast_new(p->arena, RHO_NODE_TUPLE, NULL, NULL, lineno);
 		ast->v.list = list_head;
 	}
 
 	expect(p, RHO_TOK_PAREN_CLOSE);
-	ERROR_CHECK_AST(p, NULL, ast);
+	ERROR_CHECK(p);
 
 	return ast;
 }
@@ -756,7 +828,7 @@ static RhoAST *parse_unop(RhoParser *p)
 
 	RhoAST *atom = parse_atom(p);
 	ERROR_CHECK(p);
-	RhoAST *ast = rho_ast_new(type, atom, NULL, tok->lineno);
+	RhoAST *ast = rho_ast_new(p->arena, type, atom, NULL, tok->lineno);
 	return ast;
 }
 
@@ -764,7 +836,7 @@ static RhoAST *parse_null(RhoParser *p)
 {
 	RhoToken *tok = expect(p, RHO_TOK_NULL);
 	ERROR_CHECK(p);
-	RhoAST *ast = rho_ast_new(RHO_NODE_NULL, NULL, NULL, tok->lineno);
+	RhoAST *ast = rho_ast_new(p->arena, RHO_NODE_NULL, NULL, NULL, tok->lineno);
 	return ast;
 }
 
@@ -772,7 +844,7 @@ static RhoAST *parse_int(RhoParser *p)
 {
 	RhoToken *tok = expect(p, RHO_TOK_INT);
 	ERROR_CHECK(p);
-	RhoAST *ast = rho_ast_new(RHO_NODE_INT, NULL, NULL, tok->lineno);
+	RhoAST *ast = rho_ast_new(p->arena, RHO_NODE_INT, NULL, NULL, tok->lineno);
 	ast->v.int_val = atoi(tok->value);
 	return ast;
 }
@@ -781,7 +853,7 @@ static RhoAST *parse_float(RhoParser *p)
 {
 	RhoToken *tok = expect(p, RHO_TOK_FLOAT);
 	ERROR_CHECK(p);
-	RhoAST *ast = rho_ast_new(RHO_NODE_FLOAT, NULL, NULL, tok->lineno);
+	RhoAST *ast = rho_ast_new(p->arena, RHO_NODE_FLOAT, NULL, NULL, tok->lineno);
 	ast->v.float_val = atof(tok->value);
 	return ast;
 }
@@ -790,10 +862,10 @@ static RhoAST *parse_str(RhoParser *p)
 {
 	RhoToken *tok = expect(p, RHO_TOK_STR);
 	ERROR_CHECK(p);
-	RhoAST *ast = rho_ast_new(RHO_NODE_STRING, NULL, NULL, tok->lineno);
+	RhoAST *ast = rho_ast_new(p->arena, RHO_NODE_STRING, NULL, NULL, tok->lineno);
 
 	// deal with quotes appropriately:
-	ast->v.str_val = rho_str_new_copy(tok->value + 1, tok->length - 2);
+	ast->v.str_val = rho_str_new_copy_arena(p->arena, tok->value + 1, tok->length - 2);
 
 	return ast;
 }
@@ -802,8 +874,8 @@ static RhoAST *parse_ident(RhoParser *p)
 {
 	RhoToken *tok = expect(p, RHO_TOK_IDENT);
 	ERROR_CHECK(p);
-	RhoAST *ast = rho_ast_new(RHO_NODE_IDENT, NULL, NULL, tok->lineno);
-	ast->v.ident = rho_str_new_copy(tok->value, tok->length);
+	RhoAST *ast = rho_ast_new(p->arena, RHO_NODE_IDENT, NULL, NULL, tok->lineno);
+	ast->v.ident = rho_str_new_copy_arena(p->arena, tok->value, tok->length);
 	return ast;
 }
 
@@ -829,8 +901,8 @@ static RhoAST *parse_dollar_ident(RhoParser *p)
 		p->max_dollar_ident = value;
 	}
 
-	RhoAST *ast = rho_ast_new(RHO_NODE_IDENT, NULL, NULL, tok->lineno);
-	ast->v.ident = rho_str_new_copy(tok->value, tok->length);
+	RhoAST *ast = rho_ast_new(p->arena, RHO_NODE_IDENT, NULL, NULL, tok->lineno);
+	ast->v.ident = rho_str_new_copy_arena(p->arena, tok->value, tok->length);
 	return ast;
 }
 
@@ -840,7 +912,7 @@ static RhoAST *parse_print(RhoParser *p)
 	ERROR_CHECK(p);
 	RhoAST *expr = parse_expr_no_assign(p);
 	ERROR_CHECK(p);
-	RhoAST *ast = rho_ast_new(RHO_NODE_PRINT, expr, NULL, tok->lineno);
+	RhoAST *ast = rho_ast_new(p->arena, RHO_NODE_PRINT, expr, NULL, tok->lineno);
 	return ast;
 }
 
@@ -851,8 +923,8 @@ static RhoAST *parse_if(RhoParser *p)
 	RhoAST *condition = parse_expr_no_assign(p);
 	ERROR_CHECK(p);
 	RhoAST *body = parse_block(p);
-	ERROR_CHECK_AST(p, body, condition);
-	RhoAST *ast = rho_ast_new(RHO_NODE_IF, condition, body, tok->lineno);
+	ERROR_CHECK_AST(p, body);
+	RhoAST *ast = rho_ast_new(p->arena, RHO_NODE_IF, condition, body, tok->lineno);
 	ast->v.middle = NULL;
 
 	RhoAST *else_chain_base = NULL;
@@ -860,12 +932,12 @@ static RhoAST *parse_if(RhoParser *p)
 
 	while ((tok = rho_parser_peek_token(p))->type == RHO_TOK_ELIF) {
 		expect(p, RHO_TOK_ELIF);
-		ERROR_CHECK_AST2(p, NULL, ast, else_chain_base);
+		ERROR_CHECK(p);
 		RhoAST *elif_condition = parse_expr_no_assign(p);
-		ERROR_CHECK_AST2(p, elif_condition, ast, else_chain_base);
+		ERROR_CHECK_AST(p, elif_condition);
 		RhoAST *elif_body = parse_block(p);
-		ERROR_CHECK_AST3(p, elif_body, ast, else_chain_base, elif_condition);
-		RhoAST *elif = rho_ast_new(RHO_NODE_ELIF, elif_condition, elif_body, tok->lineno);
+		ERROR_CHECK_AST(p, elif_body);
+		RhoAST *elif = rho_ast_new(p->arena, RHO_NODE_ELIF, elif_condition, elif_body, tok->lineno);
 		elif->v.middle = NULL;
 
 		if (else_chain_base == NULL) {
@@ -878,10 +950,10 @@ static RhoAST *parse_if(RhoParser *p)
 
 	if ((tok = rho_parser_peek_token(p))->type == RHO_TOK_ELSE) {
 		expect(p, RHO_TOK_ELSE);
-		ERROR_CHECK_AST2(p, NULL, ast, else_chain_base);
+		ERROR_CHECK(p);
 		RhoAST *else_body = parse_block(p);
-		ERROR_CHECK_AST2(p, else_body, ast, else_chain_base);
-		RhoAST *else_ast = rho_ast_new(RHO_NODE_ELSE, else_body, NULL, tok->lineno);
+		ERROR_CHECK_AST(p, else_body);
+		RhoAST *else_ast = rho_ast_new(p->arena, RHO_NODE_ELSE, else_body, NULL, tok->lineno);
 
 		if (else_chain_base == NULL) {
 			else_chain_base = else_chain_last = else_ast;
@@ -911,9 +983,9 @@ static RhoAST *parse_while(RhoParser *p)
 	p->in_loop = 1;
 	RhoAST *body = parse_block(p);
 	p->in_loop = old_in_loop;
-	ERROR_CHECK_AST(p, body, condition);
+	ERROR_CHECK_AST(p, body);
 
-	RhoAST *ast = rho_ast_new(RHO_NODE_WHILE, condition, body, tok->lineno);
+	RhoAST *ast = rho_ast_new(p->arena, RHO_NODE_WHILE, condition, body, tok->lineno);
 	return ast;
 }
 
@@ -930,14 +1002,14 @@ static RhoAST *parse_for(RhoParser *p)
 		struct rho_ast_list *vars = parse_comma_separated_list(p,
 		                                                       RHO_TOK_PAREN_OPEN, RHO_TOK_PAREN_CLOSE,
 		                                                       parse_ident, &count);
-		ERROR_CHECK_LIST(p, NULL, vars);
+		ERROR_CHECK(p);
 
 		if (vars == NULL) {
 			parse_err_empty_for_params(p, peek);
 			ERROR_CHECK(p);
 		}
 
-		lcv = rho_ast_new(RHO_NODE_TUPLE, NULL, NULL, peek->lineno);
+		lcv = rho_ast_new(p->arena, RHO_NODE_TUPLE, NULL, NULL, peek->lineno);
 		lcv->v.list = vars;
 	} else {
 		lcv = parse_ident(p);  // loop-control variable
@@ -946,18 +1018,18 @@ static RhoAST *parse_for(RhoParser *p)
 	ERROR_CHECK(p);
 
 	expect(p, RHO_TOK_IN);
-	ERROR_CHECK_AST(p, NULL, lcv);
+	ERROR_CHECK(p);
 
 	RhoAST *iter = parse_expr_no_assign(p);
-	ERROR_CHECK_AST(p, iter, lcv);
+	ERROR_CHECK_AST(p, iter);
 
 	const unsigned old_in_loop = p->in_loop;
 	p->in_loop = 1;
 	RhoAST *body = parse_block(p);
 	p->in_loop = old_in_loop;
-	ERROR_CHECK_AST2(p, body, lcv, iter);
+	ERROR_CHECK_AST(p, body);
 
-	RhoAST *ast = rho_ast_new(RHO_NODE_FOR, lcv, iter, tok->lineno);
+	RhoAST *ast = rho_ast_new(p->arena, RHO_NODE_FOR, lcv, iter, tok->lineno);
 	ast->v.middle = body;
 	return ast;
 }
@@ -997,23 +1069,19 @@ static RhoAST *parse_def_or_gen_or_act(RhoParser *p, const int select)
 	                                                  parse_expr,
 	                                                  &nargs);
 	p->in_args = old_in_args;
-	ERROR_CHECK_AST(p, params, name);
+	ERROR_CHECK_AST(p, params);
 
 	/* parameter syntax check */
 	for (struct rho_ast_list *param = params; param != NULL; param = param->next) {
 		if (!((param->ast->type == RHO_NODE_ASSIGN && param->ast->left->type == RHO_NODE_IDENT) ||
 		       param->ast->type == RHO_NODE_IDENT)) {
 			parse_err_malformed_params(p, name_tok);
-			rho_ast_list_free(params);
-			rho_ast_free(name);
 			return NULL;
 		}
 	}
 
 	if (nargs > FUNCTION_MAX_PARAMS) {
 		parse_err_too_many_params(p, name_tok);
-		rho_ast_list_free(params);
-		rho_ast_free(name);
 		return NULL;
 	}
 
@@ -1024,8 +1092,6 @@ static RhoAST *parse_def_or_gen_or_act(RhoParser *p, const int select)
 			dflt = true;
 		} else if (dflt) {
 			parse_err_non_default_after_default(p, name_tok);
-			rho_ast_list_free(params);
-			rho_ast_free(name);
 			return NULL;
 		}
 	}
@@ -1037,8 +1103,6 @@ static RhoAST *parse_def_or_gen_or_act(RhoParser *p, const int select)
 			RhoAST *ast2 = (check->ast->type == RHO_NODE_ASSIGN) ? check->ast->left : check->ast;
 			if (rho_str_eq(ast1->v.ident, ast2->v.ident)) {
 				parse_err_dup_params(p, name_tok, ast1->v.ident->value);
-				rho_ast_free(name);
-				rho_ast_list_free(params);
 				return NULL;
 			}
 		}
@@ -1051,8 +1115,6 @@ static RhoAST *parse_def_or_gen_or_act(RhoParser *p, const int select)
 
 		if (RHO_PARSER_ERROR(p)) {
 			assert(ret_hint == NULL);
-			rho_ast_free(name);
-			rho_ast_list_free(params);
 			return NULL;
 		}
 
@@ -1097,8 +1159,6 @@ static RhoAST *parse_def_or_gen_or_act(RhoParser *p, const int select)
 
 	if (RHO_PARSER_ERROR(p)) {
 		assert(body == NULL);
-		rho_ast_free(name);
-		rho_ast_list_free(params);
 		return NULL;
 	}
 
@@ -1106,13 +1166,13 @@ static RhoAST *parse_def_or_gen_or_act(RhoParser *p, const int select)
 
 	switch (select) {
 	case PARSE_DEF:
-		ast = rho_ast_new(RHO_NODE_DEF, name, body, tok->lineno);
+		ast = rho_ast_new(p->arena, RHO_NODE_DEF, name, body, tok->lineno);
 		break;
 	case PARSE_GEN:
-		ast = rho_ast_new(RHO_NODE_GEN, name, body, tok->lineno);
+		ast = rho_ast_new(p->arena, RHO_NODE_GEN, name, body, tok->lineno);
 		break;
 	case PARSE_ACT:
-		ast = rho_ast_new(RHO_NODE_ACT, name, body, tok->lineno);
+		ast = rho_ast_new(p->arena, RHO_NODE_ACT, name, body, tok->lineno);
 		break;
 	default:
 		RHO_INTERNAL_ERROR();
@@ -1151,7 +1211,7 @@ static RhoAST *parse_break(RhoParser *p)
 		return NULL;
 	}
 
-	RhoAST *ast = rho_ast_new(RHO_NODE_BREAK, NULL, NULL, tok->lineno);
+	RhoAST *ast = rho_ast_new(p->arena, RHO_NODE_BREAK, NULL, NULL, tok->lineno);
 	return ast;
 }
 
@@ -1165,7 +1225,7 @@ static RhoAST *parse_continue(RhoParser *p)
 		return NULL;
 	}
 
-	RhoAST *ast = rho_ast_new(RHO_NODE_CONTINUE, NULL, NULL, tok->lineno);
+	RhoAST *ast = rho_ast_new(p->arena, RHO_NODE_CONTINUE, NULL, NULL, tok->lineno);
 	return ast;
 }
 
@@ -1183,7 +1243,7 @@ static RhoAST *parse_return(RhoParser *p)
 	RhoAST *ast;
 
 	if (RHO_TOK_TYPE_IS_STMT_TERM(next->type)) {
-		ast = rho_ast_new(RHO_NODE_RETURN, NULL, NULL, tok->lineno);
+		ast = rho_ast_new(p->arena, RHO_NODE_RETURN, NULL, NULL, tok->lineno);
 	} else {
 		if (p->in_generator) {
 			parse_err_return_val_in_gen(p, tok);
@@ -1192,7 +1252,7 @@ static RhoAST *parse_return(RhoParser *p)
 
 		RhoAST *expr = parse_expr_no_assign(p);
 		ERROR_CHECK(p);
-		ast = rho_ast_new(RHO_NODE_RETURN, expr, NULL, tok->lineno);
+		ast = rho_ast_new(p->arena, RHO_NODE_RETURN, expr, NULL, tok->lineno);
 	}
 
 	return ast;
@@ -1204,7 +1264,7 @@ static RhoAST *parse_throw(RhoParser *p)
 	ERROR_CHECK(p);
 	RhoAST *expr = parse_expr_no_assign(p);
 	ERROR_CHECK(p);
-	RhoAST *ast = rho_ast_new(RHO_NODE_THROW, expr, NULL, tok->lineno);
+	RhoAST *ast = rho_ast_new(p->arena, RHO_NODE_THROW, expr, NULL, tok->lineno);
 	return ast;
 }
 
@@ -1220,7 +1280,7 @@ static RhoAST *parse_produce(RhoParser *p)
 
 	RhoAST *expr = parse_expr_no_assign(p);
 	ERROR_CHECK(p);
-	RhoAST *ast = rho_ast_new(RHO_NODE_PRODUCE, expr, NULL, tok->lineno);
+	RhoAST *ast = rho_ast_new(p->arena, RHO_NODE_PRODUCE, expr, NULL, tok->lineno);
 	return ast;
 }
 
@@ -1236,7 +1296,7 @@ static RhoAST *parse_receive(RhoParser *p)
 
 	RhoAST *ident = parse_ident(p);
 	ERROR_CHECK(p);
-	RhoAST *ast = rho_ast_new(RHO_NODE_RECEIVE, ident, NULL, tok->lineno);
+	RhoAST *ast = rho_ast_new(p->arena, RHO_NODE_RECEIVE, ident, NULL, tok->lineno);
 	return ast;
 }
 
@@ -1247,7 +1307,7 @@ static RhoAST *parse_try_catch(RhoParser *p)
 	RhoAST *try_body = parse_block(p);
 	ERROR_CHECK(p);
 	RhoToken *catch = expect(p, RHO_TOK_CATCH);
-	ERROR_CHECK_AST(p, catch, try_body);
+	ERROR_CHECK_AST(p, catch);
 
 	unsigned int count;
 	struct rho_ast_list *exc_list = parse_comma_separated_list(p,
@@ -1256,12 +1316,10 @@ static RhoAST *parse_try_catch(RhoParser *p)
 	                                                           parse_expr,
 	                                                           &count);
 
-	ERROR_CHECK_AST(p, exc_list, try_body);
+	ERROR_CHECK_AST(p, exc_list);
 
 	if (count == 0) {
 		parse_err_empty_catch(p, catch);
-		rho_ast_free(try_body);
-		rho_ast_list_free(exc_list);
 		return NULL;
 	}
 
@@ -1269,11 +1327,9 @@ static RhoAST *parse_try_catch(RhoParser *p)
 
 	if (RHO_PARSER_ERROR(p)) {
 		assert(catch_body == NULL);
-		rho_ast_free(try_body);
-		rho_ast_list_free(exc_list);
 	}
 
-	RhoAST *ast = rho_ast_new(RHO_NODE_TRY_CATCH, try_body, catch_body, tok->lineno);
+	RhoAST *ast = rho_ast_new(p->arena, RHO_NODE_TRY_CATCH, try_body, catch_body, tok->lineno);
 	ast->v.excs = exc_list;
 	return ast;
 }
@@ -1284,7 +1340,7 @@ static RhoAST *parse_import(RhoParser *p)
 	ERROR_CHECK(p);
 	RhoAST *ident = parse_ident(p);
 	ERROR_CHECK(p);
-	RhoAST *ast = rho_ast_new(RHO_NODE_IMPORT, ident, NULL, tok->lineno);
+	RhoAST *ast = rho_ast_new(p->arena, RHO_NODE_IMPORT, ident, NULL, tok->lineno);
 	return ast;
 }
 
@@ -1294,7 +1350,7 @@ static RhoAST *parse_export(RhoParser *p)
 	ERROR_CHECK(p);
 	RhoAST *ident = parse_ident(p);
 	ERROR_CHECK(p);
-	RhoAST *ast = rho_ast_new(RHO_NODE_EXPORT, ident, NULL, tok->lineno);
+	RhoAST *ast = rho_ast_new(p->arena, RHO_NODE_EXPORT, ident, NULL, tok->lineno);
 	return ast;
 }
 
@@ -1309,9 +1365,9 @@ static RhoAST *parse_block(RhoParser *p)
 	if (peek->type == RHO_TOK_COLON) {
 		brace_open = expect(p, RHO_TOK_COLON);
 		ERROR_CHECK(p);
-		block_head = rho_ast_list_new();
+		block_head = rho_ast_list_new(p->arena);
 		block_head->ast = parse_stmt(p);
-		ERROR_CHECK_LIST(p, block_head->ast, block_head);
+		ERROR_CHECK_AST(p, block_head->ast);
 	} else {
 		brace_open = expect(p, RHO_TOK_BRACE_OPEN);
 		ERROR_CHECK(p);
@@ -1330,24 +1386,23 @@ static RhoAST *parse_block(RhoParser *p)
 			}
 
 			RhoAST *stmt = parse_stmt(p);
-			ERROR_CHECK_LIST(p, stmt, block_head);
+			ERROR_CHECK_AST(p, stmt);
 
 			/*
 			 * We don't include empty statements
 			 * in the syntax tree.
 			 */
 			if (stmt->type == RHO_NODE_EMPTY) {
-				free(stmt);
 				continue;
 			}
 
 			if (block_head == NULL) {
-				block_head = rho_ast_list_new();
+				block_head = rho_ast_list_new(p->arena);
 				block = block_head;
 			}
 
 			if (block->ast != NULL) {
-				block->next = rho_ast_list_new();
+				block->next = rho_ast_list_new(p->arena);
 				block = block->next;
 			}
 
@@ -1355,10 +1410,10 @@ static RhoAST *parse_block(RhoParser *p)
 		} while (true);
 
 		expect(p, RHO_TOK_BRACE_CLOSE);
-		ERROR_CHECK_LIST(p, NULL, block_head);
+		ERROR_CHECK(p);
 	}
 
-	RhoAST *ast = rho_ast_new(RHO_NODE_BLOCK, NULL, NULL, brace_open->lineno);
+	RhoAST *ast = rho_ast_new(p->arena, RHO_NODE_BLOCK, NULL, NULL, brace_open->lineno);
 	ast->v.block = block_head;
 	return ast;
 }
@@ -1372,7 +1427,7 @@ static RhoAST *parse_list(RhoParser *p)
 	                                                            parse_expr,
 	                                                            NULL);
 	ERROR_CHECK(p);
-	RhoAST *ast = rho_ast_new(RHO_NODE_LIST, NULL, NULL, brack_open->lineno);
+	RhoAST *ast = rho_ast_new(p->arena, RHO_NODE_LIST, NULL, NULL, brack_open->lineno);
 	ast->v.list = list_head;
 	return ast;
 }
@@ -1388,8 +1443,8 @@ static RhoAST *parse_dict_or_set_sub_element(RhoParser *p)
 		/* dict */
 		expect(p, RHO_TOK_COLON);
 		RhoAST *v = parse_expr(p);
-		ERROR_CHECK_AST(p, v, k);
-		return rho_ast_new(RHO_NODE_DICT_ELEM, k, v, k->lineno);
+		ERROR_CHECK_AST(p, v);
+		return rho_ast_new(p->arena, RHO_NODE_DICT_ELEM, k, v, k->lineno);
 	} else {
 		/* set */
 		return k;
@@ -1416,13 +1471,13 @@ static RhoAST *parse_set_or_dict(RhoParser *p)
 		for (struct rho_ast_list *node = head; node != NULL; node = node->next) {
 			if (is_dict ^ (node->ast->type == RHO_NODE_DICT_ELEM)) {
 				parse_err_inconsistent_dict_elements(p, brace_open);
-				ERROR_CHECK_LIST(p, NULL, head);
+				ERROR_CHECK(p);
 			}
 		}
 
-		ast = rho_ast_new(is_dict ? RHO_NODE_DICT : RHO_NODE_SET, NULL, NULL, lineno);
+		ast = rho_ast_new(p->arena, is_dict ? RHO_NODE_DICT : RHO_NODE_SET, NULL, NULL, lineno);
 	} else {
-		ast = rho_ast_new(RHO_NODE_DICT, NULL, NULL, lineno);
+		ast = rho_ast_new(p->arena, RHO_NODE_DICT, NULL, NULL, lineno);
 	}
 
 	ast->v.list = head;
@@ -1461,7 +1516,7 @@ static RhoAST *parse_lambda(RhoParser *p)
 
 	ERROR_CHECK(p);
 
-	RhoAST *ast = rho_ast_new(RHO_NODE_LAMBDA, body, NULL, colon->lineno);
+	RhoAST *ast = rho_ast_new(p->arena, RHO_NODE_LAMBDA, body, NULL, colon->lineno);
 	ast->v.max_dollar_ident = max_dollar_ident;
 	return ast;
 }
@@ -1470,7 +1525,7 @@ static RhoAST *parse_empty(RhoParser *p)
 {
 	RhoToken *tok = expect(p, RHO_TOK_SEMICOLON);
 	ERROR_CHECK(p);
-	RhoAST *ast = rho_ast_new(RHO_NODE_EMPTY, NULL, NULL, tok->lineno);
+	RhoAST *ast = rho_ast_new(p->arena, RHO_NODE_EMPTY, NULL, NULL, tok->lineno);
 	return ast;
 }
 
@@ -1495,7 +1550,7 @@ static struct rho_ast_list *parse_comma_separated_list(RhoParser *p,
 
 		if (next->type == RHO_TOK_EOF) {
 			parse_err_unclosed(p, tok_open);
-			ERROR_CHECK_LIST(p, NULL, list_head);
+			ERROR_CHECK(p);
 		}
 
 		if (next->type == close_type) {
@@ -1503,32 +1558,32 @@ static struct rho_ast_list *parse_comma_separated_list(RhoParser *p,
 		}
 
 		if (list_head == NULL) {
-			list_head = rho_ast_list_new();
+			list_head = rho_ast_list_new(p->arena);
 			list = list_head;
 		}
 
 		if (list->ast != NULL) {
-			list->next = rho_ast_list_new();
+			list->next = rho_ast_list_new(p->arena);
 			list = list->next;
 		}
 
 		list->ast = sub_element_parse_routine(p);
-		ERROR_CHECK_LIST(p, list->ast, list_head);
+		ERROR_CHECK_AST(p, list->ast);
 		++nelements;
 
 		next = rho_parser_peek_token(p);
 
 		if (next->type == RHO_TOK_COMMA) {
 			expect(p, RHO_TOK_COMMA);
-			ERROR_CHECK_LIST(p, NULL, list_head);
+			ERROR_CHECK(p);
 		} else if (next->type != close_type) {
 			parse_err_unexpected_token(p, next);
-			ERROR_CHECK_LIST(p, NULL, list_head);
+			ERROR_CHECK(p);
 		}
 	} while (true);
 
 	expect(p, close_type);
-	ERROR_CHECK_LIST(p, NULL, list_head);
+	ERROR_CHECK(p);
 
 	if (count != NULL) {
 		*count = nelements;
@@ -1670,28 +1725,14 @@ static void parse_err_unexpected_token(RhoParser *p, RhoToken *tok)
 		 * since we shouldn't have an unexpected
 		 * token in an empty file.
 		 */
-		if (p->tok_count > 1) {
-			const char *tok_err = "";
-			bool free_tok_err = false;
-			RhoToken *tokens = p->tokens;
-			size_t last = p->tok_count - 2;
-
-			while (last > 0 && tokens[last].type == RHO_TOK_NEWLINE) {
-				--last;
-			}
-
-			if (tokens[last].type != RHO_TOK_NEWLINE) {
-				tok_err = err_on_tok(p, &tokens[last]);
-				free_tok_err = true;
-			}
+		if (p->tok_last.type != RHO_TOK_NONE) {
+			const char *tok_err = err_on_tok(p, &p->tok_last);
 
 			RHO_PARSER_SET_ERROR_MSG(p,
 			                         rho_util_str_format(RHO_SYNTAX_ERROR " unexpected end-of-file after token\n\n%s",
 			                            p->name, tok->lineno, tok_err));
 
-			if (free_tok_err) {
-				RHO_FREE(tok_err);
-			}
+			RHO_FREE(tok_err);
 		} else {
 			RHO_PARSER_SET_ERROR_MSG(p,
 			                         rho_util_str_format(RHO_SYNTAX_ERROR " unexpected end-of-file after token\n\n",
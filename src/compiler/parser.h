@@ -114,6 +114,14 @@ typedef struct {
 	unsigned int lineno;  // 1-based line number
 } RhoToken;
 
+#define RHO_TOKEN_BLOCK_SIZE 128
+
+/* tokens are read on demand into a queue of these (see lexer.c) */
+struct rho_token_block {
+	RhoToken tokens[RHO_TOKEN_BLOCK_SIZE];
+	struct rho_token_block *next;
+};
+
 typedef struct {
 	/* source code to parse */
 	const char *code;
@@ -127,28 +135,44 @@ typedef struct {
 	/* increases to consume token */
 	unsigned int mark;
 
-	/* tokens that have been read */
-	RhoToken *tokens;
+	/* tokens that have been read and may still be in use,
+	   and how many of them are in the last block */
+	struct rho_token_block *tok_head;
+	struct rho_token_block *tok_tail;
 	size_t tok_count;
-	size_t tok_capacity;
+
+	/* blocks no longer in use, to be reused */
+	struct rho_token_block *tok_free;
 
 	/* the "peek-token" is somewhat complicated to
 	   compute, so we cache it */
 	RhoToken *peek;
 
-	/* where we are in the tokens array */
+	/* where we are in the token queue */
+	struct rho_token_block *tok_block;
 	size_t tok_pos;
 
+	/* last token read other than a newline or EOF */
+	RhoToken tok_last;
+
 	/* the line number/position we are currently on */
 	unsigned int lineno;
 
 	/* name of the file out of which the source was read */
 	const char *name;
 
+	/* where the syntax tree is allocated */
+	RhoArena *arena;
+
 	/* if an error occurred... */
 	const char *error_msg;
 	int error_type;
 
+	/* ...or while reading tokens, in which case the parser
+	   was given an EOF token and this error takes precedence */
+	const char *lex_error_msg;
+	int lex_error_type;
+
 	/* maximum $N identifier in lambda */
 	unsigned int max_dollar_ident;
 
@@ -189,7 +213,7 @@ enum {
 	RHO_PARSE_ERR_RETURN_VALUE_IN_GENERATOR
 };
 
-RhoParser *rho_parser_new(char *str, const char *name);
+RhoParser *rho_parser_new(char *str, const char *name, RhoArena *arena);
 void rho_parser_free(RhoParser *p);
 RhoProgram *rho_parse(RhoParser *p);
 
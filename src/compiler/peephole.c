@@ -0,0 +1,860 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include "code.h"
+#include "opcodes.h"
+#include "compiler.h"
+#include "err.h"
+#include "util.h"
+#include "peephole.h"
+
+/*
+ * Bytecode peephole optimization
+ *
+ * The instructions are decoded into an array in which jumps
+ * refer to their targets by instruction index rather than by
+ * byte offset, so that instructions can be removed or rewritten
+ * freely; jump offsets are recomputed when the array is encoded
+ * again. Jumps are also stored in a direction-independent form
+ * (e.g. JMP_BACK is stored as JMP), and get the forward or the
+ * backward opcode as appropriate when they're encoded.
+ *
+ * Removed instructions are only marked as such, and a jump to a
+ * removed instruction lands on the next live one. Hence, when a
+ * sequence of instructions is rewritten, the rewritten sequence
+ * must behave the same as the original one when jumped into at
+ * its first instruction, and no other instruction of the original
+ * sequence may be a jump target.
+ *
+ * Once nothing more can be simplified, common sequences are fused
+ * into superinstructions (see `fuse`), which the other rewrites
+ * don't know about and hence must come last.
+ *
+ * EXTENDED_ARG prefixes are folded into the argument they extend
+ * (see `rho_opcode_extended_arg`), so arguments may take 32 bits;
+ * when encoding, a prefix is only emitted where one is needed. The
+ * compiler writes every jump with a prefix, since it can't tell how
+ * far the jump reaches, so this is what gets rid of most of them.
+ *
+ * If the result can't be encoded (e.g. an argument that can't be
+ * extended no longer fits in a uint16), the code is left as it was.
+ */
+
+#define MAX_ARGS 4
+
+struct ins {
+	RhoOpcode opcode;
+	unsigned int args[MAX_ARGS];  /* arguments, in order (see above) */
+	size_t target;   /* jumps: index of target instruction */
+	size_t target2;  /* TRY_BEGIN: index of handler */
+	unsigned int lineno;
+	bool removed;
+};
+
+struct peephole {
+	struct ins *ins;
+	size_t n;
+	bool *is_target;
+};
+
+static bool is_jump(const RhoOpcode opcode)
+{
+	switch (opcode) {
+	case RHO_INS_JMP:
+	case RHO_INS_JMP_IF_TRUE:
+	case RHO_INS_JMP_IF_FALSE:
+	case RHO_INS_JMP_IF_TRUE_ELSE_POP:
+	case RHO_INS_JMP_IF_FALSE_ELSE_POP:
+	case RHO_INS_JMP_IF_EXC_MISMATCH:
+	case RHO_INS_LOOP_ITER:
+	case RHO_INS_TRY_BEGIN:
+	case RHO_INS_COMPARE_AND_BRANCH:
+	case RHO_INS_FOR_ITER_STORE:
+	case RHO_INS_REG_CMP_BRANCH:
+	case RHO_INS_FOR_RANGE:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/*
+ * Which of a jump's arguments holds its offset (TRY_BEGIN has two
+ * offsets and is handled separately).
+ */
+static unsigned int jump_arg(const RhoOpcode opcode)
+{
+	switch (opcode) {
+	case RHO_INS_COMPARE_AND_BRANCH:
+		return 1;
+	case RHO_INS_REG_CMP_BRANCH:
+		return 3;
+	default:
+		return 0;
+	}
+}
+
+static RhoOpcode forward_opcode(const RhoOpcode opcode)
+{
+	switch (opcode) {
+	case RHO_INS_JMP_BACK:
+		return RHO_INS_JMP;
+	case RHO_INS_JMP_BACK_IF_TRUE:
+		return RHO_INS_JMP_IF_TRUE;
+	case RHO_INS_JMP_BACK_IF_FALSE:
+		return RHO_INS_JMP_IF_FALSE;
+	default:
+		return opcode;
+	}
+}
+
+/*
+ * Returns the backward counterpart of the given forward
+ * jump opcode, or the opcode itself if it has none.
+ */
+static RhoOpcode backward_opcode(const RhoOpcode opcode)
+{
+	switch (opcode) {
+	case RHO_INS_JMP:
+		return RHO_INS_JMP_BACK;
+	case RHO_INS_JMP_IF_TRUE:
+		return RHO_INS_JMP_BACK_IF_TRUE;
+	case RHO_INS_JMP_IF_FALSE:
+		return RHO_INS_JMP_BACK_IF_FALSE;
+	default:
+		return opcode;
+	}
+}
+
+static bool is_backward(const RhoOpcode opcode)
+{
+	return forward_opcode(opcode) != opcode;
+}
+
+/*
+ * Index of the first live instruction at or after `i`.
+ */
+static size_t resolve(struct peephole *ph, size_t i)
+{
+	while (i < ph->n && ph->ins[i].removed) {
+		++i;
+	}
+	return i;
+}
+
+static size_t next_live(struct peephole *ph, const size_t i)
+{
+	return resolve(ph, i + 1);
+}
+
+static bool decode(struct peephole *ph,
+                   byte *bc,
+                   const size_t len,
+                   const byte *lno_table,
+                   const size_t lno_table_size,
+                   const unsigned int first_lineno)
+{
+	const size_t none = (size_t)-1;
+	size_t *index_at = rho_malloc((len + 1) * sizeof(size_t));
+	size_t n = 0;
+
+	for (size_t i = 0; i <= len; i++) {
+		index_at[i] = none;
+	}
+
+	/* a prefixed instruction starts at its prefix */
+	bool prefixed = false;
+
+	for (size_t pos = 0; pos < len;) {
+		const int size = rho_opcode_arg_size(bc[pos]);
+
+		if (size < 0) {
+			RHO_INTERNAL_ERROR();
+		}
+
+		if (bc[pos] == RHO_INS_EXTENDED_ARG) {
+			if (prefixed) {
+				RHO_INTERNAL_ERROR();
+			}
+			index_at[pos] = n;
+			prefixed = true;
+		} else {
+			if (!prefixed) {
+				index_at[pos] = n;
+			}
+			++n;
+			prefixed = false;
+		}
+
+		pos += 1 + size;
+	}
+	index_at[len] = n;
+
+	struct ins *ins = rho_malloc((n + 1) * sizeof(struct ins));
+
+	/* offset of each instruction, including its prefix */
+	size_t *start_pos = rho_malloc((n + 1) * sizeof(size_t));
+	bool ok = true;
+
+	for (size_t pos = 0, i = 0; pos < len; i++) {
+		unsigned int ext = 0;
+		start_pos[i] = pos;
+
+		if (bc[pos] == RHO_INS_EXTENDED_ARG) {
+			ext = rho_util_read_uint16_from_stream(&bc[pos + 1]) << 16;
+			pos += 3;
+		}
+
+		const RhoOpcode raw_opcode = bc[pos];
+		const RhoOpcode opcode = forward_opcode(raw_opcode);
+		const int size = rho_opcode_arg_size(raw_opcode);
+		const size_t next = pos + 1 + size;
+
+		ins[i].opcode = opcode;
+		for (size_t k = 0; k < MAX_ARGS; k++) {
+			ins[i].args[k] = (2*k + 2 <= (size_t)size) ?
+			                   rho_util_read_uint16_from_stream(&bc[pos + 1 + 2*k]) : 0;
+		}
+		ins[i].args[rho_opcode_extended_arg(opcode)] |= ext;
+		ins[i].target = 0;
+		ins[i].target2 = 0;
+		ins[i].removed = false;
+
+		if (opcode == RHO_INS_TRY_BEGIN) {
+			/* the handler's offset is relative to the end of the try block */
+			const size_t end_pos = next + ins[i].args[0];
+			const size_t handler_pos = end_pos + ins[i].args[1];
+
+			if (end_pos > len || handler_pos > len ||
+			    index_at[end_pos] == none || index_at[handler_pos] == none) {
+				ok = false;
+				break;
+			}
+
+			ins[i].target = index_at[end_pos];
+			ins[i].target2 = index_at[handler_pos];
+		} else if (is_jump(opcode)) {
+			const size_t jmp = ins[i].args[jump_arg(opcode)];
+			size_t target_pos;
+
+			if (is_backward(raw_opcode)) {
+				if (jmp > next) {
+					ok = false;
+					break;
+				}
+				target_pos = next - jmp;
+			} else {
+				target_pos = next + jmp;
+			}
+
+			if (target_pos > len || index_at[target_pos] == none) {
+				ok = false;
+				break;
+			}
+
+			ins[i].target = index_at[target_pos];
+		}
+
+		pos = next;
+	}
+
+	free(index_at);
+
+	if (!ok) {
+		free(ins);
+		free(start_pos);
+		return false;
+	}
+
+	/* see `get_lineno` in vm.c for how the line number table is read */
+	unsigned int lineno = first_lineno;
+	size_t pos_offset = 0;
+	size_t i = 0;
+
+	for (size_t j = 0; j + 1 < lno_table_size; j += 2) {
+		pos_offset += lno_table[j];
+
+		while (i < n && start_pos[i] < pos_offset) {
+			ins[i++].lineno = lineno;
+		}
+
+		lineno += lno_table[j + 1];
+	}
+
+	while (i < n) {
+		ins[i++].lineno = lineno;
+	}
+
+	free(start_pos);
+
+	ph->ins = ins;
+	ph->n = n;
+	ph->is_target = rho_malloc((n + 1) * sizeof(bool));
+	return true;
+}
+
+static void find_targets(struct peephole *ph)
+{
+	struct ins *ins = ph->ins;
+	const size_t n = ph->n;
+	bool *is_target = ph->is_target;
+
+	for (size_t i = 0; i <= n; i++) {
+		is_target[i] = false;
+	}
+
+	for (size_t i = 0; i < n; i++) {
+		if (ins[i].removed || !is_jump(ins[i].opcode)) {
+			continue;
+		}
+
+		is_target[resolve(ph, ins[i].target)] = true;
+
+		if (ins[i].opcode == RHO_INS_TRY_BEGIN) {
+			is_target[resolve(ph, ins[i].target2)] = true;
+		}
+	}
+}
+
+/*
+ * Redirects jumps whose target is another jump that's certain to
+ * be taken. In particular, JMP_IF_FALSE_ELSE_POP (as produced by
+ * `&&`) jumps with a falsy value on the stack, so when its target
+ * is another conditional jump, the outcome of that jump is known.
+ */
+static bool thread_jumps(struct peephole *ph)
+{
+	struct ins *ins = ph->ins;
+	const size_t n = ph->n;
+	bool changed = false;
+
+	for (size_t i = 0; i < n; i++) {
+		RhoOpcode opcode = ins[i].opcode;
+
+		if (ins[i].removed || !is_jump(opcode) || opcode == RHO_INS_TRY_BEGIN) {
+			continue;
+		}
+
+		size_t target = resolve(ph, ins[i].target);
+
+		for (size_t hops = 0; hops < n && target < n; hops++) {
+			const RhoOpcode target_opcode = ins[target].opcode;
+			RhoOpcode new_opcode = opcode;
+			size_t new_target;
+
+			if (target_opcode == RHO_INS_JMP) {
+				new_target = ins[target].target;
+			} else if (opcode == RHO_INS_JMP_IF_FALSE_ELSE_POP) {
+				switch (target_opcode) {
+				case RHO_INS_JMP_IF_FALSE_ELSE_POP:
+					new_target = ins[target].target;
+					break;
+				case RHO_INS_JMP_IF_FALSE:
+					new_opcode = RHO_INS_JMP_IF_FALSE;
+					new_target = ins[target].target;
+					break;
+				case RHO_INS_JMP_IF_TRUE_ELSE_POP:
+				case RHO_INS_JMP_IF_TRUE:
+					new_opcode = RHO_INS_JMP_IF_FALSE;
+					new_target = target + 1;
+					break;
+				default:
+					goto done;
+				}
+			} else if (opcode == RHO_INS_JMP_IF_TRUE_ELSE_POP) {
+				switch (target_opcode) {
+				case RHO_INS_JMP_IF_TRUE_ELSE_POP:
+					new_target = ins[target].target;
+					break;
+				case RHO_INS_JMP_IF_TRUE:
+					new_opcode = RHO_INS_JMP_IF_TRUE;
+					new_target = ins[target].target;
+					break;
+				case RHO_INS_JMP_IF_FALSE_ELSE_POP:
+				case RHO_INS_JMP_IF_FALSE:
+					new_opcode = RHO_INS_JMP_IF_TRUE;
+					new_target = target + 1;
+					break;
+				default:
+					goto done;
+				}
+			} else {
+				break;
+			}
+
+			new_target = resolve(ph, new_target);
+
+			if (new_target == target) {
+				break;
+			}
+
+			/* these can only jump forward */
+			if (backward_opcode(new_opcode) == new_opcode && new_target <= i) {
+				break;
+			}
+
+			opcode = new_opcode;
+			target = new_target;
+		}
+
+		done:
+		if (opcode != ins[i].opcode || target != resolve(ph, ins[i].target)) {
+			ins[i].opcode = opcode;
+			ins[i].target = target;
+			changed = true;
+		}
+	}
+
+	return changed;
+}
+
+/*
+ * Removes jumps to the instruction that follows them anyway, as
+ * produced by e.g. an `if` without an `else`.
+ */
+static bool remove_null_jumps(struct peephole *ph)
+{
+	struct ins *ins = ph->ins;
+	const size_t n = ph->n;
+	bool changed = false;
+
+	for (size_t i = 0; i < n; i++) {
+		switch (ins[i].opcode) {
+		case RHO_INS_JMP:
+		case RHO_INS_JMP_IF_TRUE:
+		case RHO_INS_JMP_IF_FALSE:
+			break;
+		default:
+			continue;
+		}
+
+		if (ins[i].removed || resolve(ph, ins[i].target) != next_live(ph, i)) {
+			continue;
+		}
+
+		if (ins[i].opcode == RHO_INS_JMP) {
+			ins[i].removed = true;
+		} else {
+			ins[i].opcode = RHO_INS_POP;
+			ins[i].args[0] = 0;
+		}
+
+		changed = true;
+	}
+
+	return changed;
+}
+
+static bool rewrite_pairs(struct peephole *ph)
+{
+	struct ins *ins = ph->ins;
+	const size_t n = ph->n;
+	bool changed = false;
+
+	find_targets(ph);
+
+	for (size_t i = resolve(ph, 0); i < n; i = next_live(ph, i)) {
+		const size_t j = next_live(ph, i);
+
+		if (j == n || ph->is_target[j]) {
+			continue;
+		}
+
+		struct ins *a = &ins[i];
+		struct ins *b = &ins[j];
+
+		switch (a->opcode) {
+		case RHO_INS_LOAD_CONST:
+		case RHO_INS_LOAD_NULL:
+		case RHO_INS_DUP:
+			/* LOAD_CONST; POP -> (nothing) */
+			if (b->opcode == RHO_INS_POP) {
+				a->removed = true;
+				b->removed = true;
+				changed = true;
+			} else if (a->opcode == RHO_INS_DUP && b->opcode == RHO_INS_ROT) {
+				b->removed = true;
+				changed = true;
+			}
+			break;
+		case RHO_INS_ROT:
+			if (b->opcode == RHO_INS_ROT) {
+				a->removed = true;
+				b->removed = true;
+				changed = true;
+			}
+			break;
+		case RHO_INS_STORE:
+		case RHO_INS_STORE_GLOBAL: {
+			/* STORE x; LOAD x -> DUP; STORE x */
+			const RhoOpcode load = (a->opcode == RHO_INS_STORE) ? RHO_INS_LOAD : RHO_INS_LOAD_GLOBAL;
+			if (b->opcode == load && b->args[0] == a->args[0]) {
+				b->opcode = a->opcode;
+				a->opcode = RHO_INS_DUP;
+				a->args[0] = 0;
+				changed = true;
+			}
+			break;
+		}
+		case RHO_INS_NOT:
+			/* NOT; JMP_IF_FALSE -> JMP_IF_TRUE */
+			if (b->opcode == RHO_INS_JMP_IF_FALSE) {
+				a->removed = true;
+				b->opcode = RHO_INS_JMP_IF_TRUE;
+				changed = true;
+			} else if (b->opcode == RHO_INS_JMP_IF_TRUE) {
+				a->removed = true;
+				b->opcode = RHO_INS_JMP_IF_FALSE;
+				changed = true;
+			}
+			break;
+		default:
+			break;
+		}
+	}
+
+	return changed;
+}
+
+/*
+ * Removes instructions that follow an unconditional transfer of
+ * control and can't be jumped to, such as the jump out of an `if`
+ * body that ends with `return`. TRY_END is kept even if it can't
+ * be reached, since `max_stack_depth` counts on it to account for
+ * the exception pushed before the handler runs.
+ */
+static bool remove_unreachable(struct peephole *ph)
+{
+	struct ins *ins = ph->ins;
+	const size_t n = ph->n;
+	bool changed = false;
+
+	find_targets(ph);
+
+	for (size_t i = resolve(ph, 0); i < n; i = next_live(ph, i)) {
+		switch (ins[i].opcode) {
+		case RHO_INS_JMP:
+		case RHO_INS_RETURN:
+		case RHO_INS_THROW:
+			break;
+		default:
+			continue;
+		}
+
+		for (size_t j = next_live(ph, i);
+		     j < n && !ph->is_target[j] && ins[j].opcode != RHO_INS_TRY_END;
+		     j = next_live(ph, j)) {
+			ins[j].removed = true;
+			changed = true;
+		}
+	}
+
+	return changed;
+}
+
+static bool is_comparison(const RhoOpcode opcode)
+{
+	switch (opcode) {
+	case RHO_INS_EQUAL:
+	case RHO_INS_NOTEQ:
+	case RHO_INS_LT:
+	case RHO_INS_GT:
+	case RHO_INS_LE:
+	case RHO_INS_GE:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/*
+ * Fuses the following sequences into superinstructions, which
+ * are implemented in vm.c:
+ *
+ *   LOAD a; LOAD_CONST c; IADD; STORE a  ->  INC_LOCAL_BY_CONST a c
+ *   LOAD a; LOAD_CONST c; ADD            ->  LOAD_ADD_CONST a c
+ *   LOAD a; LOAD_ATTR x                  ->  LOAD_ATTR_LOCAL a x
+ *   LOAD a; LOAD b                       ->  LOAD_LOAD a b
+ *   <comparison>; JMP_IF_FALSE (forward) ->  COMPARE_AND_BRANCH
+ *   LOOP_ITER; STORE a                   ->  FOR_ITER_STORE
+ *
+ * These are the most frequent sequences in the opcode-pair profiles
+ * produced by tools/opcode_pairs.py. Sequences are matched from left
+ * to right, longest first.
+ */
+static void fuse(struct peephole *ph)
+{
+	struct ins *ins = ph->ins;
+	const size_t n = ph->n;
+
+	find_targets(ph);
+
+	for (size_t i = resolve(ph, 0); i < n; i = next_live(ph, i)) {
+		/* the next 3 live instructions, or n if there aren't as many */
+		size_t next[3];
+		size_t j = i;
+
+		for (size_t k = 0; k < 3; k++) {
+			j = (j < n) ? next_live(ph, j) : n;
+			next[k] = j;
+		}
+
+		/* number of the following instructions that may take part */
+		size_t avail = 0;
+		while (avail < 3 && next[avail] < n && !ph->is_target[next[avail]]) {
+			++avail;
+		}
+
+		if (avail == 0) {
+			continue;
+		}
+
+		struct ins *a = &ins[i];
+		struct ins *b = &ins[next[0]];
+		struct ins *c = (avail >= 2) ? &ins[next[1]] : NULL;
+		struct ins *d = (avail >= 3) ? &ins[next[2]] : NULL;
+
+		switch (a->opcode) {
+		case RHO_INS_LOAD:
+			/* b's argument becomes a's second, which can't be extended */
+			if (b->args[0] > 0xffff) {
+				break;
+			}
+
+			if (c != NULL && b->opcode == RHO_INS_LOAD_CONST) {
+				if (d != NULL && c->opcode == RHO_INS_IADD &&
+				    d->opcode == RHO_INS_STORE && d->args[0] == a->args[0]) {
+					a->opcode = RHO_INS_INC_LOCAL_BY_CONST;
+					a->args[1] = b->args[0];
+					b->removed = c->removed = d->removed = true;
+				} else if (c->opcode == RHO_INS_ADD) {
+					a->opcode = RHO_INS_LOAD_ADD_CONST;
+					a->args[1] = b->args[0];
+					b->removed = c->removed = true;
+				}
+			} else if (b->opcode == RHO_INS_LOAD_ATTR) {
+				a->opcode = RHO_INS_LOAD_ATTR_LOCAL;
+				a->args[1] = b->args[0];
+				b->removed = true;
+			} else if (b->opcode == RHO_INS_LOAD) {
+				a->opcode = RHO_INS_LOAD_LOAD;
+				a->args[1] = b->args[0];
+				b->removed = true;
+			}
+			break;
+		case RHO_INS_LOOP_ITER:
+			if (b->opcode == RHO_INS_STORE && b->args[0] <= 0xffff) {
+				a->opcode = RHO_INS_FOR_ITER_STORE;
+				a->args[1] = b->args[0];
+				b->removed = true;
+			}
+			break;
+		default:
+			if (is_comparison(a->opcode) &&
+			    b->opcode == RHO_INS_JMP_IF_FALSE && b->target > next[0]) {
+				a->args[0] = a->opcode;
+				a->opcode = RHO_INS_COMPARE_AND_BRANCH;
+				a->target = b->target;
+				b->removed = true;
+			}
+			break;
+		}
+	}
+}
+
+/*
+ * Size of the given instruction when encoded, including its
+ * EXTENDED_ARG prefix if it has one.
+ */
+static size_t encoded_size(const struct ins *ins, const bool prefixed)
+{
+	return (prefixed ? 3 : 0) + 1 + rho_opcode_arg_size(ins->opcode);
+}
+
+static bool encode(struct peephole *ph,
+                   RhoCode *code,
+                   const size_t start,
+                   RhoCode *lno_table,
+                   const unsigned int first_lineno)
+{
+	struct ins *ins = ph->ins;
+	const size_t n = ph->n;
+
+	/* offset of each instruction, or of the next live one if removed */
+	size_t *offsets = rho_malloc((n + 1) * sizeof(size_t));
+	bool *prefixed = rho_malloc((n + 1) * sizeof(bool));
+	bool ok = true;
+
+	for (size_t i = 0; i < n; i++) {
+		const RhoOpcode opcode = ins[i].opcode;
+		prefixed[i] = !ins[i].removed && !is_jump(opcode) &&
+		              ins[i].args[rho_opcode_extended_arg(opcode)] > 0xffff;
+	}
+
+	/*
+	 * Jump offsets depend on which instructions have a prefix and
+	 * vice versa, so we go on until no more jumps need a new one.
+	 */
+	bool changed = true;
+
+	while (changed && ok) {
+		changed = false;
+		size_t offset = 0;
+
+		for (size_t i = 0; i < n; i++) {
+			offsets[i] = offset;
+			if (!ins[i].removed) {
+				offset += encoded_size(&ins[i], prefixed[i]);
+			}
+		}
+		offsets[n] = offset;
+
+		for (size_t i = 0; i < n; i++) {
+			const RhoOpcode opcode = ins[i].opcode;
+
+			if (ins[i].removed || !is_jump(opcode)) {
+				continue;
+			}
+
+			const size_t next = offsets[i] + encoded_size(&ins[i], prefixed[i]);
+			const size_t target = offsets[ins[i].target];
+			size_t jmp;
+
+			if (opcode == RHO_INS_TRY_BEGIN) {
+				const size_t handler = offsets[ins[i].target2];
+
+				if (ins[i].target <= i || handler < target || handler - target > 0xffff) {
+					ok = false;
+					break;
+				}
+
+				jmp = target - next;
+				ins[i].args[1] = handler - target;
+			} else if (ins[i].target > i) {
+				jmp = target - next;
+			} else {
+				if (backward_opcode(opcode) == opcode) {
+					ok = false;
+					break;
+				}
+
+				jmp = next - target;
+			}
+
+			ins[i].args[jump_arg(opcode)] = jmp;
+
+			if (jmp > 0xffff && !prefixed[i]) {
+				prefixed[i] = true;
+				changed = true;
+			}
+		}
+	}
+
+	RhoCode out;
+	rho_code_init(&out, offsets[n] + 1);
+
+	for (size_t i = 0; i < n && ok; i++) {
+		if (ins[i].removed) {
+			continue;
+		}
+
+		RhoOpcode opcode = ins[i].opcode;
+
+		if (is_jump(opcode) && ins[i].target <= i) {
+			opcode = backward_opcode(opcode);
+		}
+
+		const int size = rho_opcode_arg_size(opcode);
+
+		if (size % 2 != 0 || size > 2*MAX_ARGS) {
+			RHO_INTERNAL_ERROR();
+		}
+
+		unsigned int args[MAX_ARGS];
+		for (size_t k = 0; k < MAX_ARGS; k++) {
+			args[k] = ins[i].args[k];
+		}
+
+		if (prefixed[i]) {
+			const unsigned int e = rho_opcode_extended_arg(opcode);
+			rho_code_write_byte(&out, RHO_INS_EXTENDED_ARG);
+			rho_code_write_uint16(&out, args[e] >> 16);
+			args[e] &= 0xffff;
+		}
+
+		rho_code_write_byte(&out, opcode);
+		for (int k = 0; k < size/2; k++) {
+			if (args[k] > 0xffff) {
+				ok = false;
+				break;
+			}
+
+			rho_code_write_uint16(&out, args[k]);
+		}
+	}
+
+	free(prefixed);
+
+	if (!ok) {
+		free(offsets);
+		rho_code_dealloc(&out);
+		return false;
+	}
+
+	code->size = start;
+	rho_code_append(code, &out);
+	rho_code_dealloc(&out);
+
+	/* rebuild the line number table the same way `write_ins` does */
+	lno_table->size = 0;
+	unsigned int last_lineno = first_lineno;
+	size_t line_start = 0;
+
+	for (size_t i = 0; i < n; i++) {
+		if (ins[i].removed) {
+			continue;
+		}
+
+		const unsigned int lineno = ins[i].lineno;
+
+		if (lineno > last_lineno) {
+			rho_lno_write(lno_table, offsets[i] - line_start, lineno - last_lineno);
+			line_start = offsets[i];
+			last_lineno = lineno;
+		}
+	}
+
+	free(offsets);
+	return true;
+}
+
+void rho_peephole_optimize(RhoCode *code,
+                           const size_t start,
+                           RhoCode *lno_table,
+                           const unsigned int first_lineno)
+{
+	struct peephole ph;
+
+	if (!decode(&ph,
+	            code->bc + start,
+	            code->size - start,
+	            lno_table->bc,
+	            lno_table->size,
+	            first_lineno)) {
+		return;
+	}
+
+	bool changed;
+	do {
+		changed = false;
+		changed |= thread_jumps(&ph);
+		changed |= remove_null_jumps(&ph);
+		changed |= rewrite_pairs(&ph);
+		changed |= remove_unreachable(&ph);
+	} while (changed);
+
+	fuse(&ph);
+	encode(&ph, code, start, lno_table, first_lineno);
+
+	free(ph.ins);
+	free(ph.is_target);
+}
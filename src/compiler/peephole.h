@@ -0,0 +1,19 @@
+#ifndef RHO_PEEPHOLE_H
+#define RHO_PEEPHOLE_H
+
+#include <stddef.h>
+#include "code.h"
+
+/*
+ * Optimizes the instructions in `code` starting at byte offset
+ * `start` (i.e. just past the symbol and constant tables), in
+ * place. Jump offsets are fixed up for the new layout and the
+ * (unterminated) line number table `lno_table`, whose first
+ * line is `first_lineno`, is rewritten to match.
+ */
+void rho_peephole_optimize(RhoCode *code,
+                           const size_t start,
+                           RhoCode *lno_table,
+                           const unsigned int first_lineno);
+
+#endif /* RHO_PEEPHOLE_H */
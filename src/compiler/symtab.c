@@ -6,6 +6,7 @@
 #include "ast.h"
 #include "str.h"
 #include "util.h"
+#include "arena.h"
 #include "err.h"
 #include "symtab.h"
 
@@ -22,7 +23,7 @@
 
 #define HASH(ident) (rho_util_hash_secondary(rho_str_hash((ident))))
 
-static RhoSTEntry *ste_new(const char *name, RhoSTEContext context);
+static RhoSTEntry *ste_new(RhoSymTable *st, const char *name, RhoSTEContext context);
 
 static void ste_grow(RhoSTEntry *ste, const size_t new_capacity);
 static void ste_grow_attr(RhoSTEntry *ste, const size_t new_capacity);
@@ -38,17 +39,20 @@ static void ste_add_child(RhoSTEntry *ste, RhoSTEntry *child);
 static void clear_child_pos(RhoSymTable *st);
 static void clear_child_pos_of_entry(RhoSTEntry *ste);
 
-static void ste_free(RhoSTEntry *ste);
+/*
+ * Symbol tables are allocated in the arena of the program they're
+ * built from, so they're freed together with it; tables that grow
+ * simply leave their old arrays behind.
+ */
 
-RhoSymTable *rho_st_new(const char *filename)
+RhoSymTable *rho_st_new(const char *filename, RhoArena *arena)
 {
-	RhoSymTable *st = rho_malloc(sizeof(RhoSymTable));
+	RhoSymTable *st = rho_arena_alloc(arena, sizeof(RhoSymTable));
 	st->filename = filename;
+	st->arena = arena;
 
-	RhoSTEntry *ste_module = ste_new("<module>", RHO_MODULE);
-	RhoSTEntry *ste_attributes = ste_new("<attributes>", -1);
-
-	ste_module->sym_table = ste_attributes->sym_table = st;
+	RhoSTEntry *ste_module = ste_new(st, "<module>", RHO_MODULE);
+	RhoSTEntry *ste_attributes = ste_new(st, "<attributes>", -1);
 
 	st->ste_module = ste_module;
 	st->ste_current = st->ste_module;
@@ -57,34 +61,29 @@ RhoSymTable *rho_st_new(const char *filename)
 	return st;
 }
 
-static RhoSTEntry *ste_new(const char *name, RhoSTEContext context)
+static RhoSTEntry *ste_new(RhoSymTable *st, const char *name, RhoSTEContext context)
 {
 	// the capacity should always be a power of 2
 	assert((STE_INIT_CAPACITY & (STE_INIT_CAPACITY - 1)) == 0);
 
-	RhoSTEntry *ste = rho_malloc(sizeof(RhoSTEntry));
+	RhoSTEntry *ste = rho_arena_alloc(st->arena, sizeof(RhoSTEntry));
 	ste->name = name;
 	ste->context = context;
-	ste->table = rho_malloc(STE_INIT_CAPACITY * sizeof(RhoSTSymbol *));
-	for (size_t i = 0; i < STE_INIT_CAPACITY; i++) {
-		ste->table[i] = NULL;
-	}
+	ste->table = rho_arena_calloc(st->arena, STE_INIT_CAPACITY * sizeof(RhoSTSymbol *));
 	ste->table_size = 0;
 	ste->table_capacity = STE_INIT_CAPACITY;
 	ste->table_threshold = (size_t)(STE_INIT_CAPACITY * STE_LOADFACTOR);
 	ste->next_local_id = 0;
 	ste->n_locals = 0;
-	ste->attributes = rho_malloc(STE_INIT_CAPACITY * sizeof(RhoSTSymbol *));
-	for (size_t i = 0; i < STE_INIT_CAPACITY; i++) {
-		ste->attributes[i] = NULL;
-	}
+	ste->attributes = rho_arena_calloc(st->arena, STE_INIT_CAPACITY * sizeof(RhoSTSymbol *));
 	ste->attr_size = 0;
 	ste->attr_capacity = STE_INIT_CAPACITY;
 	ste->attr_threshold = (size_t)(STE_INIT_CAPACITY * STE_LOADFACTOR);
 	ste->next_attr_id = 0;
 	ste->next_free_var_id = 0;
 	ste->parent = NULL;
-	ste->children = rho_malloc(STE_INIT_CHILDVEC_CAPACITY * sizeof(RhoSTEntry));
+	ste->sym_table = st;
+	ste->children = rho_arena_alloc(st->arena, STE_INIT_CHILDVEC_CAPACITY * sizeof(RhoSTEntry *));
 	ste->n_children = 0;
 	ste->children_capacity = STE_INIT_CHILDVEC_CAPACITY;
 	ste->child_pos = 0;
@@ -153,7 +152,7 @@ static void populate_symtable_from_node(RhoSymTable *st, RhoAST *ast)
 		populate_symtable_from_node(st, ast->v.middle);
 		break;
 	case RHO_NODE_ASSIGN:
-		if (ast->left->type != RHO_NODE_IDENT) {
+		if (ast->left->type != RHO_NODE_IDENT && ast->left->type != RHO_NODE_TUPLE) {
 			populate_symtable_from_node(st, ast->left);
 		}
 		populate_symtable_from_node(st, ast->right);
@@ -227,6 +226,15 @@ static void populate_symtable_from_node(RhoSymTable *st, RhoAST *ast)
 	default:
 		populate_symtable_from_node(st, ast->left);
 		populate_symtable_from_node(st, ast->right);
+
+		/* compound assignments to globals can happen in any scope */
+		if (RHO_NODE_TYPE_IS_ASSIGNMENT(ast->type) && ast->left->type == RHO_NODE_IDENT) {
+			RhoSTSymbol *symbol = rho_ste_get_symbol(st->ste_current, ast->left->v.ident);
+
+			if (symbol != NULL && symbol->global_var && !symbol->bound_here) {
+				rho_ste_get_symbol(st->ste_module, ast->left->v.ident)->global_store = 1;
+			}
+		}
 		break;
 	}
 }
@@ -252,16 +260,24 @@ static void register_bindings_from_node(RhoSymTable *st, RhoAST *ast)
 
 	switch (ast->type) {
 	case RHO_NODE_ASSIGN:
-	case RHO_NODE_RECEIVE:
+	case RHO_NODE_RECEIVE: {
+		int flag = FLAG_BOUND_HERE;
+		if (global) {
+			flag |= FLAG_GLOBAL_VAR;
+		}
+
 		if (ast->left->type == RHO_NODE_IDENT) {
-			int flag = FLAG_BOUND_HERE;
-			if (global) {
-				flag |= FLAG_GLOBAL_VAR;
-			}
 			ste_register_ident(st->ste_current, ast->left->v.ident, flag);
 			register_bindings_from_node(st, ast->right);
+		} else if (ast->left->type == RHO_NODE_TUPLE) {
+			/* (a, b) = ... */
+			for (struct rho_ast_list *node = ast->left->v.list; node != NULL; node = node->next) {
+				ste_register_ident(st->ste_current, node->ast->v.ident, flag);
+			}
+			register_bindings_from_node(st, ast->right);
 		}
 		break;
+	}
 	case RHO_NODE_FOR:
 		if (ast->left->type == RHO_NODE_IDENT) {
 			ste_register_ident(st->ste_current, ast->left->v.ident, FLAG_BOUND_HERE);
@@ -283,10 +299,11 @@ static void register_bindings_from_node(RhoSymTable *st, RhoAST *ast)
 		break;
 	}
 	case RHO_NODE_IF:
-	case RHO_NODE_ELIF:
-		register_bindings_from_node(st, ast->left);
-		register_bindings_from_node(st, ast->right);
-		register_bindings_from_node(st, ast->v.middle);
+		/* elif chains can be long, so aren't walked recursively */
+		for (RhoAST *node = ast; node != NULL; node = node->v.middle) {
+			register_bindings_from_node(st, node->left);
+			register_bindings_from_node(st, node->right);
+		}
 		break;
 	case RHO_NODE_BLOCK:
 		for (struct rho_ast_list *node = ast->v.block; node != NULL; node = node->next) {
@@ -304,7 +321,7 @@ static void register_bindings_from_node(RhoSymTable *st, RhoAST *ast)
 		                   name,
 		                   (global ? FLAG_GLOBAL_VAR : 0) | FLAG_BOUND_HERE);
 
-		RhoSTEntry *child = ste_new(name->value, RHO_FUNCTION);
+		RhoSTEntry *child = ste_new(st, name->value, RHO_FUNCTION);
 
 		for (struct rho_ast_list *param = ast->v.params; param != NULL; param = param->next) {
 			RhoStr *ident = (param->ast->type == RHO_NODE_ASSIGN) ? param->ast->left->v.ident :
@@ -321,15 +338,14 @@ static void register_bindings_from_node(RhoSymTable *st, RhoAST *ast)
 		break;
 	}
 	case RHO_NODE_LAMBDA: {
-		RhoSTEntry *child = ste_new("<lambda>", RHO_FUNCTION);
+		RhoSTEntry *child = ste_new(st, "<lambda>", RHO_FUNCTION);
 		const unsigned int max_dollar_ident = ast->v.max_dollar_ident;
 		assert(max_dollar_ident <= 128);
 
 		char buf[4];
 		for (unsigned i = 1; i <= max_dollar_ident; i++) {
 			sprintf(buf, "$%u", i);
-			RhoStr *ident = rho_str_new_copy(buf, strlen(buf));
-			ident->freeable = 1;
+			RhoStr *ident = rho_str_new_copy_arena(st->arena, buf, strlen(buf));
 			ste_register_ident(child, ident, FLAG_BOUND_HERE | FLAG_FUNC_PARAM);
 		}
 
@@ -407,7 +423,7 @@ static bool ste_register_ident(RhoSTEntry *ste, RhoStr *ident, int flags)
 		const int hash = HASH(ident);
 		const size_t index = hash & (ste->table_capacity - 1);
 
-		symbol = rho_calloc(1, sizeof(RhoSTSymbol));
+		symbol = rho_arena_calloc(ste->sym_table->arena, sizeof(RhoSTSymbol));
 		symbol->key = ident;
 
 		if (flags & FLAG_BOUND_HERE) {
@@ -485,7 +501,7 @@ static bool ste_register_attr(RhoSTEntry *ste, RhoStr *attr)
 		const int hash = HASH(attr);
 		const size_t index = hash & (ste->attr_capacity - 1);
 
-		symbol = rho_calloc(1, sizeof(RhoSTSymbol));
+		symbol = rho_arena_calloc(ste->sym_table->arena, sizeof(RhoSTSymbol));
 		symbol->key = attr;
 		symbol->attribute = 1;
 		symbol->id = ste->next_attr_id++;
@@ -520,10 +536,7 @@ static void ste_grow(RhoSTEntry *ste, const size_t new_capacity)
 		}
 	}
 
-	RhoSTSymbol **new_table = rho_malloc(capacity_real * sizeof(RhoSTSymbol *));
-	for (size_t i = 0; i < capacity_real; i++) {
-		new_table[i] = NULL;
-	}
+	RhoSTSymbol **new_table = rho_arena_calloc(ste->sym_table->arena, capacity_real * sizeof(RhoSTSymbol *));
 
 	const size_t capacity = ste->table_capacity;
 
@@ -539,7 +552,6 @@ static void ste_grow(RhoSTEntry *ste, const size_t new_capacity)
 		}
 	}
 
-	free(ste->table);
 	ste->table = new_table;
 	ste->table_capacity = capacity_real;
 	ste->table_threshold = (size_t)(capacity_real * STE_LOADFACTOR);
@@ -564,10 +576,7 @@ static void ste_grow_attr(RhoSTEntry *ste, const size_t new_capacity)
 		}
 	}
 
-	RhoSTSymbol **new_attributes = rho_malloc(capacity_real * sizeof(RhoSTSymbol *));
-	for (size_t i = 0; i < capacity_real; i++) {
-		new_attributes[i] = NULL;
-	}
+	RhoSTSymbol **new_attributes = rho_arena_calloc(ste->sym_table->arena, capacity_real * sizeof(RhoSTSymbol *));
 
 	const size_t capacity = ste->attr_capacity;
 
@@ -583,7 +592,6 @@ static void ste_grow_attr(RhoSTEntry *ste, const size_t new_capacity)
 		}
 	}
 
-	free(ste->attributes);
 	ste->attributes = new_attributes;
 	ste->attr_capacity = capacity_real;
 	ste->attr_threshold = (size_t)(capacity_real * STE_LOADFACTOR);
@@ -591,11 +599,11 @@ static void ste_grow_attr(RhoSTEntry *ste, const size_t new_capacity)
 
 static void ste_add_child(RhoSTEntry *ste, RhoSTEntry *child)
 {
-	child->sym_table = ste->sym_table;
-
 	if (ste->n_children == ste->children_capacity) {
 		ste->children_capacity = (ste->children_capacity * 3)/2 + 1;
-		ste->children = rho_realloc(ste->children, ste->children_capacity);
+		RhoSTEntry **children = rho_arena_alloc(ste->sym_table->arena, ste->children_capacity * sizeof(RhoSTEntry *));
+		memcpy(children, ste->children, ste->n_children * sizeof(RhoSTEntry *));
+		ste->children = children;
 	}
 
 	ste->children[ste->n_children++] = child;
@@ -617,51 +625,3 @@ static void clear_child_pos_of_entry(RhoSTEntry *ste)
 		clear_child_pos_of_entry(ste->children[i]);
 	}
 }
-
-void rho_st_free(RhoSymTable *st)
-{
-	ste_free(st->ste_module);
-	ste_free(st->ste_attributes);
-	free(st);
-}
-
-static void stsymbol_free(RhoSTSymbol *entry)
-{
-	while (entry != NULL) {
-		RhoSTSymbol *temp = entry;
-		entry = entry->next;
-
-		if (temp->key->freeable) {
-			rho_str_free(temp->key);
-		}
-
-		free(temp);
-	}
-}
-
-static void ste_free(RhoSTEntry *ste)
-{
-	const size_t table_capacity = ste->table_capacity;
-	const size_t attr_capacity = ste->attr_capacity;
-
-	for (size_t i = 0; i < table_capacity; i++) {
-		stsymbol_free(ste->table[i]);
-	}
-
-	free(ste->table);
-
-	for (size_t i = 0; i < attr_capacity; i++) {
-		stsymbol_free(ste->attributes[i]);
-	}
-
-	free(ste->attributes);
-
-	RhoSTEntry **children = ste->children;
-	size_t n_children = ste->n_children;
-	for (size_t i = 0; i < n_children; i++) {
-		ste_free(children[i]);
-	}
-
-	free(ste->children);
-	free(ste);
-}
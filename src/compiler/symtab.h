@@ -4,6 +4,7 @@
 #include <stdlib.h>
 #include "ast.h"
 #include "str.h"
+#include "arena.h"
 
 typedef struct rho_st_symbol {
 	RhoStr *key;
@@ -19,6 +20,9 @@ typedef struct rho_st_symbol {
 	unsigned func_param : 1;
 	unsigned decl_const : 1;
 	unsigned attribute  : 1;
+
+	/* global assigned to from within a function (i.e. via STORE_GLOBAL) */
+	unsigned global_store : 1;
 } RhoSTSymbol;
 
 typedef enum {
@@ -68,13 +72,16 @@ typedef struct rho_st_entry {
 typedef struct rho_rho_sym_table {
 	const char *filename;
 
+	/* where the table and its entries are allocated */
+	RhoArena *arena;
+
 	RhoSTEntry *ste_module;
 	RhoSTEntry *ste_current;
 
 	RhoSTEntry *ste_attributes;
 } RhoSymTable;
 
-RhoSymTable *rho_st_new(const char *filename);
+RhoSymTable *rho_st_new(const char *filename, RhoArena *arena);
 
 void rho_st_populate(RhoSymTable *st, RhoProgram *program);
 
@@ -82,6 +89,4 @@ RhoSTSymbol *rho_ste_get_symbol(RhoSTEntry *ste, RhoStr *ident);
 
 RhoSTSymbol *rho_ste_get_attr_symbol(RhoSTEntry *ste, RhoStr *ident);
 
-void rho_st_free(RhoSymTable *st);
-
 #endif /* RHO_SYMTAB_H */
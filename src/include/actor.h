@@ -2,7 +2,9 @@
 #define RHO_ACTOR_H
 
 #include <stdlib.h>
+#include <stdbool.h>
 #include <stdatomic.h>
+#include <time.h>
 #include <pthread.h>
 #include "object.h"
 #include "codeobject.h"
@@ -20,6 +22,8 @@ struct rho_mailbox {
 
 	pthread_mutex_t mutex;
 	pthread_cond_t cond;
+
+	bool shared;  /* popped by more than one thread (actor pools) */
 };
 
 void rho_mailbox_init(struct rho_mailbox *mb);
@@ -30,6 +34,7 @@ void rho_mailbox_dealloc(struct rho_mailbox *mb);
 
 extern RhoClass rho_actor_proxy_class;
 extern RhoClass rho_actor_class;
+extern RhoClass rho_actor_pool_class;
 extern RhoClass rho_future_class;
 extern RhoClass rho_message_class;
 
@@ -39,6 +44,8 @@ typedef struct {
 	struct rho_value_array defaults;
 } RhoActorProxy;
 
+#define RHO_ACTOR_DEFAULT_RESTART_PERIOD 5000  /* ms */
+
 typedef struct rho_actor_object {
 	RhoObject base;
 	struct rho_mailbox mailbox;
@@ -48,6 +55,13 @@ typedef struct rho_actor_object {
 	RhoVM *vm;
 	RhoValue retval;
 
+	/* supervision (see `supervise()`) */
+	struct rho_value_array init_locals;
+	unsigned int max_restarts;
+	unsigned int n_restarts;
+	long restart_period;  /* ms */
+	struct timespec restart_window_start;
+
 	pthread_t thread;
 
 	enum {
@@ -58,8 +72,17 @@ typedef struct rho_actor_object {
 
 	struct rho_actor_object *prev;
 	struct rho_actor_object *next;
+
+	unsigned supervised : 1;
 } RhoActorObject;
 
+typedef struct {
+	RhoObject base;
+	struct rho_mailbox mailbox;  /* shared by all members */
+	RhoActorObject **members;
+	size_t n_members;
+} RhoActorPool;
+
 typedef struct {
 	RhoObject base;
 
@@ -72,6 +95,7 @@ typedef struct {
 	RhoObject base;
 	RhoValue contents;  /* empty contents = kill message */
 	RhoFutureObject *future;
+	unsigned moved : 1;  /* contents not yet claimed by receiving thread */
 } RhoMessage;
 
 RhoValue rho_actor_proxy_make(RhoCodeObject *co);
@@ -79,6 +103,13 @@ RhoValue rho_actor_make(RhoActorProxy *ap);
 void rho_actor_proxy_init_defaults(RhoActorProxy *ap, RhoValue *defaults, const size_t n_defaults);
 void rho_actor_join_all(void);
 
+/*
+ * Makes the calling thread the owner of every thread-confined
+ * container reachable from `v`. The caller must ensure that no
+ * other thread is using these containers.
+ */
+void rho_actor_claim(RhoValue *v);
+
 RhoValue rho_future_make(void);
 RhoValue rho_message_make(RhoValue *contents);
 RhoValue rho_kill_message_make(void);
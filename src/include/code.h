@@ -39,6 +39,8 @@ void rho_code_write_uint16(RhoCode *code, const size_t n);
 
 void rho_code_write_uint16_at(RhoCode *code, const size_t n, const size_t pos);
 
+void rho_code_write_uint32(RhoCode *code, const size_t n);
+
 void rho_code_write_double(RhoCode *code, const double d);
 
 void rho_code_write_str(RhoCode *code, const RhoStr *str);
@@ -51,6 +53,8 @@ int rho_code_read_int(RhoCode *code);
 
 unsigned int rho_code_read_uint16(RhoCode *code);
 
+size_t rho_code_read_uint32(RhoCode *code);
+
 double rho_code_read_double(RhoCode *code);
 
 const char *rho_code_read_str(RhoCode *code);
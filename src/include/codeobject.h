@@ -2,21 +2,27 @@
 #define RHO_CODEOBJECT_H
 
 #include <stdbool.h>
+#include <stdatomic.h>
 #include "code.h"
 #include "object.h"
 #include "str.h"
 
 struct rho_vm;
 struct rho_frame;
+struct rho_jit_code;
 
 extern RhoClass rho_co_class;
 
 struct rho_code_cache {
 	/* line number cache */
 	unsigned int lineno;
+
+	/* number of times execution entered here (see jit.h);
+	   atomic since threads may share the code object */
+	atomic_uint hotness;
 };
 
-typedef struct {
+typedef struct rho_code_object {
 	RhoObject base;
 
 	/* name of this code object */
@@ -24,6 +30,10 @@ typedef struct {
 
 	/* code segment */
 	byte *bc;
+	size_t bc_size;
+
+	/* constant table entry this was read out of, if any */
+	const byte *entry;
 
 	/* number of arguments */
 	unsigned int argcount;
@@ -49,8 +59,10 @@ typedef struct {
 	/* type hints */
 	RhoClass **hints;
 
-	/* line number table */
+	/* line number table and its checkpoint index */
 	byte *lno_table;
+	byte *lno_checkpoints;
+	size_t n_lno_checkpoints;
 
 	/* first line number */
 	unsigned int first_lineno;
@@ -61,6 +73,12 @@ typedef struct {
 	/* caches */
 	struct rho_frame *frame;
 	struct rho_code_cache *cache;
+
+	/* native code, if compiled (see jit.h) */
+	_Atomic(struct rho_jit_code *) jit;
+
+	/* whether the tables above have been read out of `bc` yet */
+	atomic_bool materialized;
 } RhoCodeObject;
 
 RhoCodeObject *rho_codeobj_make(RhoCode *code,
@@ -78,6 +96,20 @@ RhoCodeObject *rho_codeobj_make_toplevel(RhoCode *code,
                                          const char *name,
                                          struct rho_vm *vm);
 
+/*
+ * Code objects nested in a constant table are only decoded when they
+ * are first called (or made into a frame), as most functions of a
+ * large module never are; until then only the name, argument count
+ * and depths are set.
+ */
+void rho_codeobj_materialize(RhoCodeObject *co);
+
+/*
+ * Makes a (not yet materialized) code object out of a constant
+ * table entry, as recorded in `entry` above.
+ */
+RhoCodeObject *rho_codeobj_make_from_entry(const byte *entry, struct rho_vm *vm);
+
 RhoValue rho_codeobj_load_args(RhoCodeObject *co,
                                struct rho_value_array *default_args,
                                RhoValue *args,
@@ -88,6 +120,12 @@ RhoValue rho_codeobj_load_args(RhoCodeObject *co,
 
 RhoValue rho_codeobj_init_hints(RhoCodeObject *co, RhoValue *types);
 
+/*
+ * Returns the line of the instruction at byte offset `pos` of the
+ * (materialized) code object's bytecode.
+ */
+unsigned int rho_codeobj_lineno(RhoCodeObject *co, const size_t pos);
+
 #define RHO_CODEOBJ_NUM_HINTS(co) (((co)->hints != NULL) ? ((co)->argcount + 1) : 0)
 #define RHO_CODEOBJ_RET_HINT(co)  (((co)->hints != NULL) ? ((co)->hints[(co)->argcount]) : NULL)
 
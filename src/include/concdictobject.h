@@ -0,0 +1,37 @@
+#ifndef RHO_CONCDICT_H
+#define RHO_CONCDICT_H
+
+#include <stdlib.h>
+#include <pthread.h>
+#include "object.h"
+#include "dictobject.h"
+
+extern struct rho_seq_methods rho_concdict_seq_methods;
+extern RhoClass rho_concdict_class;
+
+#define RHO_CONCDICT_STRIPE_BITS 4
+#define RHO_CONCDICT_STRIPES     (1 << RHO_CONCDICT_STRIPE_BITS)
+
+struct rho_concdict_stripe {
+	pthread_mutex_t mutex;
+	RhoDictObject *dict;
+};
+
+/*
+ * A dict that may be shared between threads without being
+ * `safe()`'d. Keys are spread over a fixed number of stripes
+ * by hash, each an ordinary dict guarded by its own lock, so
+ * that operations on different stripes don't contend.
+ */
+typedef struct {
+	RhoObject base;
+	struct rho_concdict_stripe stripes[RHO_CONCDICT_STRIPES];
+} RhoConcDictObject;
+
+/*
+ * Index of the stripe holding keys with the given dict hash.
+ * `make test-concdict` checks that small keys use every stripe.
+ */
+unsigned int rho_concdict_stripe_index(const int hash);
+
+#endif /* RHO_CONCDICT_H */
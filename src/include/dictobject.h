@@ -3,6 +3,7 @@
 
 #include <stdlib.h>
 #include "object.h"
+#include "iter.h"
 
 extern struct rho_num_methods rho_dict_num_methods;
 extern struct rho_seq_methods rho_dict_seq_methods;
@@ -39,6 +40,16 @@ RhoValue rho_dict_contains_key(RhoDictObject *dict, RhoValue *key);
 RhoValue rho_dict_eq(RhoDictObject *dict, RhoDictObject *other);
 size_t rho_dict_len(RhoDictObject *dict);
 
+/*
+ * Variants of the above taking a hash already computed by
+ * `rho_dict_hash`, which returns the (integer) hash a dict
+ * uses for `key`, or an error.
+ */
+RhoValue rho_dict_hash(RhoValue *key);
+RhoValue rho_dict_get_hashed(RhoDictObject *dict, RhoValue *key, const int hash, RhoValue *dflt);
+RhoValue rho_dict_put_hashed(RhoDictObject *dict, RhoValue *key, const int hash, RhoValue *value);
+RhoValue rho_dict_remove_key_hashed(RhoDictObject *dict, RhoValue *key, const int hash);
+
 extern RhoClass rho_dict_iter_class;
 
 typedef struct {
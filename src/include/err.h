@@ -26,9 +26,16 @@ typedef enum {
 
 extern const char *rho_err_type_headers[];
 
+struct rho_code_object;
+
+/*
+ * Traceback entries hold on to the code object and position rather
+ * than a name and line, so that finding the line is left to when
+ * the traceback is printed.
+ */
 struct rho_traceback_stack_item {
-	const char *fn;
-	unsigned int lineno;
+	struct rho_code_object *co;
+	size_t pos;
 };
 
 struct rho_traceback_manager {
@@ -39,8 +46,8 @@ struct rho_traceback_manager {
 
 void rho_tb_manager_init(struct rho_traceback_manager *tbm);
 void rho_tb_manager_add(struct rho_traceback_manager *tbm,
-                        const char *fn,
-                        const unsigned int lineno);
+                        struct rho_code_object *co,
+                        const size_t pos);
 void rho_tb_manager_print(struct rho_traceback_manager *tbm, FILE *out);
 void rho_tb_manager_dealloc(struct rho_traceback_manager *tbm);
 
@@ -53,11 +60,15 @@ typedef struct rho_error {
 RhoError *rho_err_new(RhoErrorType type, const char *msg_format, ...);
 void rho_err_free(RhoError *error);
 void rho_err_traceback_append(RhoError *error,
-                                const char *fn,
-                                const unsigned int lineno);
+                                struct rho_code_object *co,
+                                const size_t pos);
 void rho_err_traceback_print(RhoError *error, FILE *out);
 
 RhoError *rho_err_invalid_file_signature_error(const char *module);
+RhoError *rho_err_rhoc_version_error(const char *module);
+RhoError *rho_err_module_syntax_error(const char *module, const char *msg);
+RhoError *rho_err_module_write_error(const char *module);
+RhoError *rho_err_snapshot_error(const char *var, const char *reason);
 RhoError *rho_err_unbound(const char *var);
 RhoError *rho_type_err_invalid_catch(const RhoClass *c1);
 RhoError *rho_type_err_invalid_throw(const RhoClass *c1);
@@ -7,12 +7,37 @@
 #include "err.h"
 #include "object.h"
 
-typedef struct {
+struct rho_exception;
+
+/* makes the message of an exception raised without one (see `rho_exc_msg`) */
+typedef const char *(*RhoExcMsgFunc)(struct rho_exception *e);
+
+typedef struct rho_exception {
 	RhoObject base;
 	const char *msg;
+
+	/*
+	 * Exceptions that are raised and caught often (e.g. index
+	 * exceptions) keep what their message is made from and only
+	 * make it if it is printed, since a caught exception's message
+	 * is never seen.
+	 */
+	RhoExcMsgFunc msg_func;
+	RhoValue msg_value;
+	const char *msg_str;
+	long msg_args[2];
+
 	struct rho_traceback_manager tbm;
 } RhoException;
 
+/*
+ * Initializer for preallocated exceptions, which are raised without
+ * allocating anything. These are shared, so are never modified: one
+ * that leaves a frame uncaught is first replaced by a copy that can
+ * hold a traceback (see `rho_exc_traceback_append`).
+ */
+#define RHO_EXC_INIT_STATIC(class_, msg_) { .base = RHO_OBJ_INIT_STATIC(class_), .msg = (msg_) }
+
 typedef struct {
 	RhoException base;
 } RhoIndexException;
@@ -61,9 +86,8 @@ extern RhoClass rho_actor_exception_class;
 extern RhoClass rho_conc_access_exception_class;
 
 RhoValue rho_exc_make(RhoClass *exc_class, bool active, const char *msg_format, ...);
-void rho_exc_traceback_append(RhoException *e,
-                              const char *fn,
-                              const unsigned int lineno);
+const char *rho_exc_msg(RhoException *e);
+void rho_exc_traceback_append(RhoValue *exc, struct rho_code_object *co, const size_t pos);
 void rho_exc_traceback_print(RhoException *e, FILE *out);
 void rho_exc_print_msg(RhoException *e, FILE *out);
 
@@ -78,6 +102,9 @@ void rho_exc_print_msg(RhoException *e, FILE *out);
 #define RHO_ACTOR_EXC(...)     rho_exc_make(&rho_actor_exception_class, true, __VA_ARGS__)
 #define RHO_CONC_ACCS_EXC(...) rho_exc_make(&rho_conc_access_exception_class, true, __VA_ARGS__)
 
+RhoValue rho_index_exc_list_range(const long index, const size_t len);
+RhoValue rho_index_exc_tuple_range(const long index, const size_t len);
+RhoValue rho_index_exc_no_key(RhoValue *key);
 RhoValue rho_type_exc_unsupported_1(const char *op, const RhoClass *c1);
 RhoValue rho_type_exc_unsupported_2(const char *op, const RhoClass *c1, const RhoClass *c2);
 RhoValue rho_type_exc_cannot_index(const RhoClass *c1);
@@ -89,6 +116,7 @@ RhoValue rho_type_exc_not_iterator(const RhoClass *c1);
 RhoValue rho_type_exc_hint_mismatch(const RhoClass *got, const RhoClass *expected);
 RhoValue rho_call_exc_num_args(const char *fn, unsigned int got, unsigned int expected);
 RhoValue rho_call_exc_num_args_at_most(const char *fn, unsigned int got, unsigned int expected);
+RhoValue rho_call_exc_num_args_at_least(const char *fn, unsigned int got, unsigned int expected);
 RhoValue rho_call_exc_num_args_between(const char *fn, unsigned int got, unsigned int min, unsigned int max);
 RhoValue rho_call_exc_named_args(const char *fn);
 RhoValue rho_call_exc_dup_arg(const char *fn, const char *name);
@@ -113,6 +141,9 @@ RhoValue rho_seq_exp_exc_inconsistent(const unsigned int got, const unsigned int
 #define RHO_ARG_COUNT_CHECK_AT_MOST(name, count, expected) \
 	if ((count) > (expected)) return rho_call_exc_num_args_at_most((name), (count), (expected));
 
+#define RHO_ARG_COUNT_CHECK_AT_LEAST(name, count, expected) \
+	if ((count) < (expected)) return rho_call_exc_num_args_at_least((name), (count), (expected));
+
 #define RHO_ARG_COUNT_CHECK_BETWEEN(name, count, min, max) \
 	if ((count) < (min) || (count) > (max)) return rho_call_exc_num_args_between((name), (count), (min), (max));
 
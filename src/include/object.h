@@ -36,7 +36,7 @@ typedef RhoValue (*RhoAttrSetFunc)(RhoValue *this, const char *attr, RhoValue *v
 struct rho_object {
 	struct rho_class *class;
 	atomic_uint refcnt;
-	unsigned int monitor;
+	atomic_uint monitor;  /* lock word; 0 if not `safe()`'d */
 };
 
 struct rho_num_methods;
@@ -318,9 +318,14 @@ void rho_class_init(RhoClass *class);
 #define RHO_INIT_SAVED_TID_FIELD(o) (o)->RHO_SAVED_TID_FIELD_NAME = pthread_self()
 #undef RHO_SAVED_TID_FIELD_NAME
 
+/*
+ * Heap monitor, used only once a `safe()`'d object's
+ * thin lock has been contended (see object.c).
+ */
 typedef struct {
 	pthread_mutex_t mutex;
 	pthread_cond_t cond;
+	bool held;
 } RhoMonitor;
 
 bool rho_object_set_monitor(RhoObject *o);
@@ -0,0 +1,15 @@
+#ifndef RHO_PAR_H
+#define RHO_PAR_H
+
+#include <stdlib.h>
+#include "object.h"
+
+/*
+ * Applies `fn` to each element of `seq` (a list or range),
+ * spreading the work over `n_threads` threads, each with
+ * its own VM. Returns a new list of the results, in order.
+ * If `n_threads` is 0, one thread per online CPU is used.
+ */
+RhoValue rho_par_apply(RhoValue *fn, RhoValue *seq, size_t n_threads);
+
+#endif /* RHO_PAR_H */
@@ -3,6 +3,7 @@
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include "arena.h"
 
 typedef struct {
 	const char *value;  // read-only; this should NEVER be mutated
@@ -17,12 +18,14 @@ typedef struct {
 
 RhoStr *rho_str_new(const char *value, const size_t len);
 RhoStr *rho_str_new_copy(const char *value, const size_t len);
+RhoStr *rho_str_new_copy_arena(RhoArena *arena, const char *value, const size_t len);
 
 bool rho_str_eq(RhoStr *s1, RhoStr *s2);
 int rho_str_cmp(RhoStr *s1, RhoStr *s2);
 int rho_str_hash(RhoStr *str);
 
 RhoStr *rho_str_cat(RhoStr *s1, RhoStr *s2);
+RhoStr *rho_str_cat_arena(RhoArena *arena, RhoStr *s1, RhoStr *s2);
 
 void rho_str_dealloc(RhoStr *str);
 void rho_str_free(RhoStr *str);
@@ -55,7 +55,7 @@ typedef struct rho_frame {
 } RhoFrame;
 
 typedef struct rho_vm {
-	byte *head;
+	RhoCode head;  // everything loaded for this VM (see loader.h)
 	RhoFrame *module;
 	RhoFrame *callstack;
 	struct rho_value_array globals;
@@ -70,10 +70,22 @@ typedef struct rho_vm {
 	 */
 	struct rho_vm *children;
 	struct rho_vm *sibling;
+
+	/* number of imports this module is nested in */
+	unsigned int depth;
 } RhoVM;
 
+/* whether imports report how long they took (see vm.c) */
+extern bool rho_import_time_enabled;
+
 RhoVM *rho_vm_new(void);
 int rho_vm_exec_code(RhoVM *vm, RhoCode *code);
+
+/*
+ * Restores the heap image `image` (see snapshot.h) instead of
+ * running its module, then calls its `main` function, if any.
+ */
+int rho_vm_exec_image(RhoVM *vm, RhoCode *image);
 void rho_vm_push_frame(RhoVM *vm, RhoCodeObject *co);
 void rho_vm_push_frame_direct(RhoVM *vm, RhoFrame *frame);
 void rho_vm_eval_frame(RhoVM *vm);
@@ -94,4 +106,8 @@ void rho_current_vm_set(RhoVM *vm);
 
 void rho_vm_register_module(const RhoModule *module);
 
+/* empty if there is no built-in of the given name */
+RhoValue rho_vm_get_builtin(const char *name);
+RhoValue rho_vm_import(RhoVM *vm, const char *name);
+
 #endif /* RHO_VM_H */
@@ -52,6 +52,10 @@ RhoValue rho_op_le(RhoValue *a, RhoValue *b);
 
 RhoValue rho_op_ge(RhoValue *a, RhoValue *b);
 
+RhoValue rho_op_int_binop(const int op, RhoValue *a, RhoValue *b);
+
+RhoValue rho_op_float_binop(const int op, RhoValue *a, RhoValue *b);
+
 RhoValue rho_op_plus(RhoValue *a);
 
 RhoValue rho_op_minus(RhoValue *a);
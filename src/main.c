@@ -2,10 +2,13 @@
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
-#include "parser.h"
 #include "compiler.h"
 #include "vm.h"
+#include "jit.h"
 #include "loader.h"
+#include "snapshot.h"
+#include "prefetch.h"
+#include "build.h"
 #include "err.h"
 #include "util.h"
 #include "main.h"
@@ -16,7 +19,14 @@ enum cmd_flags {
 	FLAG_HELP        = 1 << 2,
 	FLAG_VERSION     = 1 << 3,
 	FLAG_COMPILE     = 1 << 4,
-	FLAG_DISASSEMBLE = 1 << 5
+	FLAG_DISASSEMBLE = 1 << 5,
+	FLAG_REGISTERS   = 1 << 6,
+	FLAG_NO_JIT      = 1 << 7,
+	FLAG_COMPILE_ALL = 1 << 8,
+	FLAG_SNAPSHOT    = 1 << 9,
+	FLAG_IMPORT_TIME = 1 << 10,
+	FLAG_PREFETCH    = 1 << 11,
+	FLAG_COMPILE_TIME = 1 << 12
 };
 
 static const struct {
@@ -25,10 +35,17 @@ static const struct {
 	enum cmd_flags mask;
 	const char *description;
 } options[] = {
-	{'h', "help",        FLAG_HELP,        "print this message and exit"},
-	{'V', "version",     FLAG_VERSION,     "print version number and exit"},
-	{'c', "compile",     FLAG_COMPILE,     "compile (rho ==> rhoc)"},
-	{'d', "disassemble", FLAG_DISASSEMBLE, "dump disassembled bytecode"},
+	{'h', "help",             FLAG_HELP,        "print this message and exit"},
+	{'V', "version",          FLAG_VERSION,     "print version number and exit"},
+	{'c', "compile",          FLAG_COMPILE,     "compile (rho ==> rhoc)"},
+	{'d', "disassemble",      FLAG_DISASSEMBLE, "dump disassembled bytecode"},
+	{'r', "registers",        FLAG_REGISTERS,   "compile to register-based bytecode"},
+	{'J', "no-jit",           FLAG_NO_JIT,      "disable the JIT compiler"},
+	{'C', "compile-all",      FLAG_COMPILE_ALL, "compile every module under a directory ahead of time"},
+	{'S', "snapshot",         FLAG_SNAPSHOT,    "run the top level and save the resulting heap (rho ==> rhoi)"},
+	{'I', "import-time",      FLAG_IMPORT_TIME, "report how long each import takes to load, build and run"},
+	{'P', "prefetch-imports", FLAG_PREFETCH,    "load imported modules on background threads ahead of time"},
+	{'T', "compile-time",     FLAG_COMPILE_TIME, "report how long each phase of compiling a module takes"},
 	{'\0', NULL, 0, NULL}
 };
 
@@ -104,6 +121,66 @@ static int process_arg(const char *arg)
 #undef UNKNOWN_OPT_FMT_LONG
 }
 
+static void check_load_error(const int error, const char *filename, const char *error_msg)
+{
+	switch (error) {
+	case RHO_LOAD_ERR_NONE:
+		return;
+	case RHO_LOAD_ERR_NOT_FOUND:
+		fprintf(stderr, RHO_ERROR_HEADER "can't open file '%s'\n", filename);
+		break;
+	case RHO_LOAD_ERR_INVALID_SIGNATURE:
+		fprintf(stderr, RHO_ERROR_HEADER "rhoc file '%s' had an invalid signature\n", filename);
+		break;
+	case RHO_LOAD_ERR_VERSION:
+		fprintf(stderr, RHO_ERROR_HEADER "rhoc file '%s' was compiled for another version of rho; recompile it\n", filename);
+		break;
+	case RHO_LOAD_ERR_SYNTAX:
+		fprintf(stderr, RHO_ERROR_HEADER "%s\n", error_msg);
+		RHO_FREE(error_msg);
+		break;
+	case RHO_LOAD_ERR_WRITE:
+		fprintf(stderr, RHO_ERROR_HEADER "can't write compiled code of '%s'\n", filename);
+		break;
+	default:
+		RHO_INTERNAL_ERROR();
+	}
+
+	exit(EXIT_FAILURE);
+}
+
+/* saves the heap of `vm` next to `filename`, with the image extension */
+static void write_snapshot(RhoVM *vm, const char *filename)
+{
+	const char *ext = strrchr(filename, '.');
+	const size_t base_len = ext - filename;
+	char *out_filename = rho_malloc(base_len + strlen(RHOI_EXT) + 1);
+	memcpy(out_filename, filename, base_len);
+	strcpy(out_filename + base_len, RHOI_EXT);
+
+	FILE *out = fopen(out_filename, "wb");
+
+	if (out == NULL) {
+		fprintf(stderr, RHO_ERROR_HEADER "can't write image '%s'\n", out_filename);
+		free(out_filename);
+		exit(EXIT_FAILURE);
+	}
+
+	RhoValue status = rho_snapshot_write(vm, out);
+	fclose(out);
+
+	if (rho_iserror(&status)) {
+		RhoError *e = rho_errvalue(&status);
+		rho_err_print_msg(e, stderr);
+		rho_err_free(e);
+		remove(out_filename);
+		free(out_filename);
+		exit(EXIT_FAILURE);
+	}
+
+	free(out_filename);
+}
+
 int main(int argc, char *argv[])
 {
 	enum cmd_flags opts = 0;
@@ -132,103 +209,98 @@ int main(int argc, char *argv[])
 		print_not_implemented_and_exit(FLAG_DISASSEMBLE);
 	}
 
-	if (filename == NULL) {
-		fprintf(stderr, RHO_ERROR_HEADER "no input files\n");
-		exit(EXIT_FAILURE);
+	if (opts & FLAG_NO_JIT) {
+		rho_jit_enabled = false;
 	}
 
-	const char *ext = strrchr(filename, '.');
+	if (opts & FLAG_IMPORT_TIME) {
+		rho_import_time_enabled = true;
+	}
 
-	if (ext == NULL || !(strcmp(ext, ".rho") == 0 || strcmp(ext, ".rhoc") == 0)) {
-		fprintf(stderr, RHO_ERROR_HEADER "unknown file type\n");
-		fprintf(stderr, RHO_INFO_HEADER "input file should be either Rho source (.rho) or compiled bytecode (.rhoc)\n");
-		exit(EXIT_FAILURE);
+	if (opts & FLAG_PREFETCH) {
+		rho_prefetch_enabled = true;
 	}
 
-	if (strcmp(ext, ".rho") == 0) {
-		char *src = rho_util_file_to_str(filename);
+	if (opts & FLAG_COMPILE_TIME) {
+		rho_compile_time_enabled = true;
+	}
 
-		if (src == NULL) {
-			fprintf(stderr, RHO_ERROR_HEADER "can't open file '%s'\n", filename);
-			exit(EXIT_FAILURE);
-		}
+	if (filename == NULL) {
+		fprintf(stderr, RHO_ERROR_HEADER "no input files\n");
+		exit(EXIT_FAILURE);
+	}
 
-		RhoParser *p = rho_parser_new(src, filename);
+	const unsigned int flags = (opts & FLAG_REGISTERS) ? RHO_RHOC_FLAG_REGISTERS : 0;
 
-		if (RHO_PARSER_ERROR(p)) {
-			fprintf(stderr, RHO_ERROR_HEADER "%s\n", p->error_msg);
-			RHO_FREE(src);
-			rho_parser_free(p);
+	if (opts & FLAG_COMPILE_ALL) {
+		switch (rho_build_dir(filename, flags, 0)) {
+		case RHO_BUILD_OK:
+			exit(EXIT_SUCCESS);
+		case RHO_BUILD_ERR_NOT_FOUND:
+			fprintf(stderr, RHO_ERROR_HEADER "can't open directory '%s'\n", filename);
+			exit(EXIT_FAILURE);
+		default:
 			exit(EXIT_FAILURE);
 		}
+	}
 
-		RhoProgram *prog = rho_parse(p);
+	const char *ext = strrchr(filename, '.');
 
-		if (RHO_PARSER_ERROR(p)) {
-			fprintf(stderr, RHO_ERROR_HEADER "%s\n", p->error_msg);
-			RHO_FREE(src);
-			rho_parser_free(p);
-			exit(EXIT_FAILURE);
-		}
+	if (ext == NULL || !(strcmp(ext, RHO_EXT) == 0 || strcmp(ext, RHOC_EXT) == 0 || strcmp(ext, RHOI_EXT) == 0)) {
+		fprintf(stderr, RHO_ERROR_HEADER "unknown file type\n");
+		fprintf(stderr, RHO_INFO_HEADER "input file should be Rho source (.rho), compiled bytecode (.rhoc) or a heap image (.rhoi)\n");
+		exit(EXIT_FAILURE);
+	}
 
-		rho_parser_free(p);
-		RHO_FREE(src);
+	RhoCode code;
 
-		char *out_filename_buf = rho_malloc(strlen(filename) + 2);
-		strcpy(out_filename_buf, filename);
-		strcat(out_filename_buf, "c");
-		FILE *out_file = fopen(out_filename_buf, "w");
+	if (strcmp(ext, RHO_EXT) == 0) {
+		const char *error_msg = NULL;
 
-		if (out_file == NULL) {
-			fprintf(stderr, RHO_ERROR_HEADER "can't open file '%sc' for writing\n", out_filename_buf);
+		if (opts & FLAG_COMPILE) {
+			char *out_filename_buf = rho_malloc(strlen(filename) + 2);
+			strcpy(out_filename_buf, filename);
+			strcat(out_filename_buf, "c");
+			const int error = rho_compile_to_file(filename, flags, out_filename_buf, &error_msg);
 			free(out_filename_buf);
-			exit(EXIT_FAILURE);
-		}
-
-		rho_compile(filename, prog, out_file);
-		fclose(out_file);
-		rho_ast_list_free(prog);
-
-		if (!(opts & FLAG_COMPILE)) {
-			RhoCode code;
-			assert(rho_load_from_file(out_filename_buf, true, &code) == 0);
-			RhoVM *vm = rho_vm_new();
-			rho_current_vm_set(vm);
-			rho_vm_exec_code(vm, &code);
-			rho_vm_free(vm);
+			check_load_error(error, filename, error_msg);
+			exit(EXIT_SUCCESS);
 		}
 
-		free(out_filename_buf);
-		exit(EXIT_SUCCESS);
-	} else if (strcmp(ext, ".rhoc") == 0) {
+		const int error = rho_load_from_source(filename, flags, &code, &error_msg);
+		check_load_error(error, filename, error_msg);
+	} else if (strcmp(ext, RHOC_EXT) == 0) {
 		if (opts & FLAG_COMPILE) {
 			fprintf(stderr, RHO_INFO_HEADER "nothing to do\n");
 			exit(EXIT_SUCCESS);
 		}
 
-		RhoCode code;
-
-		switch (rho_load_from_file(filename, true, &code)) {
-		case RHO_LOAD_ERR_NONE:
-			break;
-		case RHO_LOAD_ERR_NOT_FOUND:
-			fprintf(stderr, RHO_ERROR_HEADER "can't open file '%s'\n", filename);
-			exit(EXIT_FAILURE);
-			break;
-		case RHO_LOAD_ERR_INVALID_SIGNATURE:
-			fprintf(stderr, RHO_ERROR_HEADER "rhoc file '%s' had an invalid signature\n", filename);
-			exit(EXIT_FAILURE);
-			break;
-		default:
-			RHO_INTERNAL_ERROR();
+		check_load_error(rho_load_from_file(filename, true, &code), filename, NULL);
+	} else if (strcmp(ext, RHOI_EXT) == 0) {
+		if (opts & (FLAG_COMPILE | FLAG_SNAPSHOT)) {
+			fprintf(stderr, RHO_INFO_HEADER "nothing to do\n");
+			exit(EXIT_SUCCESS);
 		}
 
+		check_load_error(rho_load_image(filename, &code), filename, NULL);
+
 		RhoVM *vm = rho_vm_new();
 		rho_current_vm_set(vm);
-		rho_vm_exec_code(vm, &code);
+		rho_vm_exec_image(vm, &code);
 		rho_vm_free(vm);
 		exit(EXIT_SUCCESS);
 	} else {
 		RHO_INTERNAL_ERROR();
 	}
+
+	RhoVM *vm = rho_vm_new();
+	rho_current_vm_set(vm);
+	const int status = rho_vm_exec_code(vm, &code);
+
+	if ((opts & FLAG_SNAPSHOT) && status == 0) {
+		write_snapshot(vm, filename);
+	}
+
+	rho_vm_free(vm);
+	exit(EXIT_SUCCESS);
 }
@@ -0,0 +1,308 @@
+#include "main.h"
+#if RHO_IS_POSIX
+#define _POSIX_C_SOURCE 200809L  /* for sysconf */
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+#include "ast.h"
+#include "strdict.h"
+#include "err.h"
+#include "util.h"
+#include "arena.h"
+#include "loader.h"
+#include "build.h"
+
+#if RHO_IS_POSIX
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+/*
+ * Ahead-of-time compilation
+ *
+ * Every source file under the given directory, along with every
+ * module these import at the top level (found by scanning their
+ * ASTs before they are compiled), is compiled into the bytecode
+ * cache (see loader.c), so that neither running nor importing them
+ * later compiles anything. Modules are compiled by a pool of one
+ * thread per core; each has its own parser and compiler, which
+ * share nothing with the others, so the only shared state is the
+ * queue of modules below.
+ */
+
+struct build {
+	/* every module found so far, in the order found */
+	char **modules;
+	size_t n_modules;
+	size_t modules_cap;
+	RhoStrDict seen;
+
+	/* index of the next module to compile */
+	size_t next;
+
+	/* number of threads compiling a module right now */
+	unsigned int busy;
+
+	unsigned int flags;
+	bool failed;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+};
+
+/* `build->mutex` must be held, if other threads are running */
+static void add_module(struct build *build, const char *filename)
+{
+	while (filename[0] == '.' && filename[1] == '/') {
+		filename += 2;
+	}
+
+	RhoValue seen = rho_strdict_get_cstr(&build->seen, filename);
+
+	if (!rho_isempty(&seen)) {
+		return;
+	}
+
+	if (build->n_modules == build->modules_cap) {
+		build->modules_cap = (build->modules_cap * 3)/2 + 16;
+		build->modules = rho_realloc(build->modules, build->modules_cap * sizeof(char *));
+	}
+
+	char *copy = rho_malloc(strlen(filename) + 1);
+	strcpy(copy, filename);
+	build->modules[build->n_modules++] = copy;
+
+	RhoValue one = rho_makeint(1);
+	rho_strdict_put(&build->seen, copy, &one, false);
+}
+
+static bool is_source(const char *name)
+{
+	const size_t name_len = strlen(name);
+	const size_t ext_len = strlen(RHO_EXT);
+	return name_len > ext_len && strcmp(name + name_len - ext_len, RHO_EXT) == 0;
+}
+
+#if RHO_IS_POSIX
+static bool add_dir(struct build *build, const char *path)
+{
+	DIR *dir = opendir(path);
+
+	if (!dir) {
+		return false;
+	}
+
+	struct dirent *ent;
+	while ((ent = readdir(dir)) != NULL) {
+		const char *name = ent->d_name;
+
+		/* skip ".", ".." and hidden files */
+		if (name[0] == '.') {
+			continue;
+		}
+
+		char *full_name = rho_malloc(strlen(path) + 1 + strlen(name) + 1);
+		sprintf(full_name, "%s/%s", path, name);
+
+		struct stat st;
+		if (stat(full_name, &st) == 0) {
+			if (S_ISDIR(st.st_mode)) {
+				add_dir(build, full_name);
+			} else if (S_ISREG(st.st_mode) && is_source(name)) {
+				add_module(build, full_name);
+			}
+		}
+
+		free(full_name);
+	}
+
+	closedir(dir);
+	return true;
+}
+#endif
+
+/*
+ * Queues the modules imported at the top level of `prog`,
+ * which are looked up against the working directory as
+ * `import` does.
+ */
+static void add_imports(struct build *build, RhoProgram *prog)
+{
+	for (struct rho_ast_list *node = prog; node != NULL; node = node->next) {
+		RhoAST *stmt = node->ast;
+
+		if (stmt == NULL || stmt->type != RHO_NODE_IMPORT) {
+			continue;
+		}
+
+		const RhoStr *ident = stmt->left->v.ident;
+		char *filename = rho_malloc(ident->len + strlen(RHO_EXT) + 1);
+		memcpy(filename, ident->value, ident->len);
+		strcpy(filename + ident->len, RHO_EXT);
+
+		FILE *source = fopen(filename, "r");
+
+		if (source != NULL) {
+			fclose(source);
+			pthread_mutex_lock(&build->mutex);
+			add_module(build, filename);
+			pthread_cond_broadcast(&build->cond);
+			pthread_mutex_unlock(&build->mutex);
+		}
+
+		free(filename);
+	}
+}
+
+static bool build_module(struct build *build, const char *filename)
+{
+	char *src = rho_util_file_to_str(filename);
+
+	if (src == NULL) {
+		fprintf(stderr, RHO_ERROR_HEADER "can't open file '%s'\n", filename);
+		return false;
+	}
+
+	const char *error_msg = NULL;
+	RhoArena arena;
+	rho_arena_init(&arena);
+	struct rho_compile_times times;
+	RhoProgram *prog = rho_parse_source(filename, src, &arena, &times, &error_msg);
+
+	if (prog == NULL) {
+		fprintf(stderr, RHO_ERROR_HEADER "%s\n", error_msg);
+		RHO_FREE(error_msg);
+		RHO_FREE(src);
+		rho_arena_dealloc(&arena);
+		return false;
+	}
+
+	add_imports(build, prog);
+
+	char *out_filename = rho_cache_filename(filename, src, build->flags);
+	RHO_FREE(src);
+	int error = RHO_LOAD_ERR_NONE;
+
+	if (!rho_is_compiled(out_filename)) {
+		error = rho_compile_program(filename, prog, &arena, build->flags, &times, out_filename);
+	}
+
+	if (error != RHO_LOAD_ERR_NONE) {
+		fprintf(stderr, RHO_ERROR_HEADER "can't write compiled code of '%s'\n", filename);
+	}
+
+	free(out_filename);
+	rho_arena_dealloc(&arena);
+	return error == RHO_LOAD_ERR_NONE;
+}
+
+static void *build_start_routine(void *args)
+{
+	struct build *build = args;
+	pthread_mutex_lock(&build->mutex);
+
+	while (true) {
+		/* modules being compiled may still import others */
+		while (build->next == build->n_modules && build->busy > 0) {
+			pthread_cond_wait(&build->cond, &build->mutex);
+		}
+
+		if (build->next == build->n_modules) {
+			break;
+		}
+
+		const char *filename = build->modules[build->next++];
+		++build->busy;
+		pthread_mutex_unlock(&build->mutex);
+
+		const bool ok = build_module(build, filename);
+
+		pthread_mutex_lock(&build->mutex);
+		--build->busy;
+
+		if (!ok) {
+			build->failed = true;
+		}
+
+		pthread_cond_broadcast(&build->cond);
+	}
+
+	pthread_mutex_unlock(&build->mutex);
+	return NULL;
+}
+
+int rho_build_dir(const char *path, const unsigned int flags, size_t n_threads)
+{
+	struct build build = {.modules = NULL,
+	                      .n_modules = 0,
+	                      .modules_cap = 0,
+	                      .next = 0,
+	                      .busy = 0,
+	                      .flags = flags,
+	                      .failed = false};
+	rho_strdict_init(&build.seen);
+	RHO_SAFE(pthread_mutex_init(&build.mutex, NULL));
+	RHO_SAFE(pthread_cond_init(&build.cond, NULL));
+
+	int status = RHO_BUILD_OK;
+
+#if RHO_IS_POSIX
+	if (!add_dir(&build, path)) {
+		status = RHO_BUILD_ERR_NOT_FOUND;
+	}
+
+	if (n_threads == 0) {
+		const long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		n_threads = (n_cpus > 0) ? (size_t)n_cpus : 1;
+	}
+#else
+	(void)path;
+	status = RHO_BUILD_ERR_NOT_FOUND;
+	n_threads = 1;
+#endif
+
+	if (status == RHO_BUILD_OK) {
+		if (n_threads > build.n_modules) {
+			n_threads = (build.n_modules > 0) ? build.n_modules : 1;
+		}
+
+		pthread_t *threads = rho_malloc(n_threads * sizeof(pthread_t));
+		bool *spawned = rho_calloc(n_threads, sizeof(bool));
+
+		for (size_t i = 1; i < n_threads; i++) {
+			spawned[i] = (pthread_create(&threads[i], NULL, build_start_routine, &build) == 0);
+		}
+
+		/* the calling thread takes part as well */
+		build_start_routine(&build);
+
+		for (size_t i = 1; i < n_threads; i++) {
+			if (spawned[i]) {
+				RHO_SAFE(pthread_join(threads[i], NULL));
+			}
+		}
+
+		free(spawned);
+		free(threads);
+
+		if (build.failed) {
+			status = RHO_BUILD_ERR_FAILED;
+		}
+	}
+
+	rho_strdict_dealloc(&build.seen);
+
+	for (size_t i = 0; i < build.n_modules; i++) {
+		free(build.modules[i]);
+	}
+
+	free(build.modules);
+	pthread_cond_destroy(&build.cond);
+	pthread_mutex_destroy(&build.mutex);
+	return status;
+}
@@ -0,0 +1,19 @@
+#ifndef RHO_BUILD_H
+#define RHO_BUILD_H
+
+#include <stdlib.h>
+
+enum {
+	RHO_BUILD_OK,
+	RHO_BUILD_ERR_NOT_FOUND,  // directory could not be read
+	RHO_BUILD_ERR_FAILED      // some module could not be compiled (reported on stderr)
+};
+
+/*
+ * Compiles every source file under the directory `path`, and every
+ * module these import, into the bytecode cache, with the given
+ * compiler flags on `n_threads` threads (0 for one per core).
+ */
+int rho_build_dir(const char *path, const unsigned int flags, size_t n_threads);
+
+#endif /* RHO_BUILD_H */
@@ -6,6 +6,7 @@
 #include "strdict.h"
 #include "exc.h"
 #include "module.h"
+#include "par.h"
 #include "builtins.h"
 
 static RhoValue hash(RhoValue *args, size_t nargs);
@@ -15,6 +16,7 @@ static RhoValue iter(RhoValue *args, size_t nargs);
 static RhoValue next(RhoValue *args, size_t nargs);
 static RhoValue type(RhoValue *args, size_t nargs);
 static RhoValue safe(RhoValue *args, size_t nargs);
+static RhoValue par(RhoValue *args, size_t nargs);
 
 static RhoNativeFuncObject hash_nfo = RHO_NFUNC_INIT(hash);
 static RhoNativeFuncObject str_nfo  = RHO_NFUNC_INIT(str);
@@ -23,6 +25,7 @@ static RhoNativeFuncObject iter_nfo = RHO_NFUNC_INIT(iter);
 static RhoNativeFuncObject next_nfo = RHO_NFUNC_INIT(next);
 static RhoNativeFuncObject type_nfo = RHO_NFUNC_INIT(type);
 static RhoNativeFuncObject safe_nfo = RHO_NFUNC_INIT(safe);
+static RhoNativeFuncObject par_nfo  = RHO_NFUNC_INIT(par);
 
 const struct rho_builtin rho_builtins[] = {
 		{"hash", RHO_MAKE_OBJ(&hash_nfo)},
@@ -32,6 +35,7 @@ const struct rho_builtin rho_builtins[] = {
 		{"next", RHO_MAKE_OBJ(&next_nfo)},
 		{"type", RHO_MAKE_OBJ(&type_nfo)},
 		{"safe", RHO_MAKE_OBJ(&safe_nfo)},
+		{"par",  RHO_MAKE_OBJ(&par_nfo)},
 		{NULL,   RHO_MAKE_EMPTY()},
 };
 
@@ -97,6 +101,22 @@ static RhoValue safe(RhoValue *args, size_t nargs)
 	}
 }
 
+static RhoValue par(RhoValue *args, size_t nargs)
+{
+	RHO_ARG_COUNT_CHECK_BETWEEN("par", nargs, 2, 3);
+	size_t n_threads = 0;
+
+	if (nargs == 3) {
+		if (!rho_isint(&args[2]) || rho_intvalue(&args[2]) <= 0) {
+			return RHO_TYPE_EXC("par() takes a positive integer thread count");
+		}
+
+		n_threads = rho_intvalue(&args[2]);
+	}
+
+	return rho_par_apply(&args[0], &args[1], n_threads);
+}
+
 /* Built-in modules */
 #include "iomodule.h"
 #include "mathmodule.h"
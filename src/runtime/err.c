@@ -8,6 +8,7 @@
 #include "floatobject.h"
 #include "object.h"
 #include "metaclass.h"
+#include "codeobject.h"
 #include "util.h"
 #include "exc.h"
 
@@ -20,23 +21,25 @@ const char *rho_err_type_headers[] = {
 #define TBM_INIT_CAPACITY 5
 void rho_tb_manager_init(struct rho_traceback_manager *tbm)
 {
-	tbm->tb = rho_malloc(TBM_INIT_CAPACITY * sizeof(struct rho_traceback_stack_item));
+	/* most exceptions are caught where they are raised, so allocate lazily */
+	tbm->tb = NULL;
 	tbm->tb_count = 0;
-	tbm->tb_cap = TBM_INIT_CAPACITY;
+	tbm->tb_cap = 0;
 }
 
 void rho_tb_manager_add(struct rho_traceback_manager *tbm,
-                    const char *fn,
-                    const unsigned int lineno)
+                    RhoCodeObject *co,
+                    const size_t pos)
 {
 	const size_t cap = tbm->tb_cap;
 	if (tbm->tb_count == cap) {
-		const size_t new_cap = (cap * 3)/2 + 1;
+		const size_t new_cap = (cap == 0) ? TBM_INIT_CAPACITY : (cap * 3)/2 + 1;
 		tbm->tb = rho_realloc(tbm->tb, new_cap * sizeof(struct rho_traceback_stack_item));
 		tbm->tb_cap = new_cap;
 	}
 
-	tbm->tb[tbm->tb_count++] = (struct rho_traceback_stack_item){rho_util_str_dup(fn), lineno};
+	rho_retaino(co);
+	tbm->tb[tbm->tb_count++] = (struct rho_traceback_stack_item){co, pos};
 }
 
 void rho_tb_manager_print(struct rho_traceback_manager *tbm, FILE *out)
@@ -45,7 +48,8 @@ void rho_tb_manager_print(struct rho_traceback_manager *tbm, FILE *out)
 	const size_t count = tbm->tb_count;
 
 	for (size_t i = 0; i < count; i++) {
-		fprintf(out, "  Line %u in %s\n", tbm->tb[i].lineno, tbm->tb[i].fn);
+		RhoCodeObject *co = tbm->tb[i].co;
+		fprintf(out, "  Line %u in %s\n", rho_codeobj_lineno(co, tbm->tb[i].pos), co->name);
 	}
 }
 
@@ -53,7 +57,7 @@ void rho_tb_manager_dealloc(struct rho_traceback_manager *tbm)
 {
 	const size_t count = tbm->tb_count;
 	for (size_t i = 0; i < count; i++) {
-		RHO_FREE(tbm->tb[i].fn);
+		rho_releaseo(tbm->tb[i].co);
 	}
 	free(tbm->tb);
 }
@@ -83,10 +87,10 @@ void rho_err_free(RhoError *error)
 }
 
 void rho_err_traceback_append(RhoError *error,
-                            const char *fn,
-                            const unsigned int lineno)
+                            RhoCodeObject *co,
+                            const size_t pos)
 {
-	rho_tb_manager_add(&error->tbm, fn, lineno);
+	rho_tb_manager_add(&error->tbm, co, pos);
 }
 
 void rho_err_traceback_print(RhoError *error, FILE *out)
@@ -105,6 +109,36 @@ RhoError *rho_err_invalid_file_signature_error(const char *module)
 	                   module);
 }
 
+RhoError *rho_err_rhoc_version_error(const char *module)
+{
+	return rho_err_new(RHO_ERR_TYPE_FATAL,
+	                   "module '%s' was compiled for another version of rho and must be recompiled",
+	                   module);
+}
+
+RhoError *rho_err_module_syntax_error(const char *module, const char *msg)
+{
+	return rho_err_new(RHO_ERR_TYPE_FATAL,
+	                   "could not compile module '%s':\n%s",
+	                   module,
+	                   msg);
+}
+
+RhoError *rho_err_module_write_error(const char *module)
+{
+	return rho_err_new(RHO_ERR_TYPE_FATAL,
+	                   "could not write compiled code of module '%s'",
+	                   module);
+}
+
+RhoError *rho_err_snapshot_error(const char *var, const char *reason)
+{
+	return rho_err_new(RHO_ERR_TYPE_TYPE,
+	                   "cannot snapshot global variable '%s': %s",
+	                   var,
+	                   reason);
+}
+
 RhoError *rho_err_unbound(const char *var)
 {
 	return rho_err_new(RHO_ERR_TYPE_NAME, "cannot reference unbound variable '%s'", var);
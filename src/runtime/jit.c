@@ -0,0 +1,1146 @@
+#if defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__))
+#define RHO_JIT_SUPPORTED 1
+#define _DEFAULT_SOURCE  /* for MAP_ANONYMOUS */
+#endif
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <assert.h>
+#include <pthread.h>
+#include "object.h"
+#include "codeobject.h"
+#include "iter.h"
+#include "vm.h"
+#include "vmops.h"
+#include "compiler.h"
+#include "opcodes.h"
+#include "exc.h"
+#include "err.h"
+#include "util.h"
+#include "jit.h"
+
+#ifdef RHO_JIT_SUPPORTED
+#include <sys/mman.h>
+#endif
+
+bool rho_jit_enabled = true;
+
+#ifdef RHO_JIT_SUPPORTED
+
+struct rho_jit_code {
+	byte *mem;
+	size_t mem_size;
+
+	/* native offset of the instruction at each bytecode position */
+	unsigned int *entry;
+};
+
+/* marks code objects that could not be compiled */
+static struct rho_jit_code jit_unavailable;
+
+static pthread_mutex_t jit_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Helpers
+ * -------
+ * Each of these performs one instruction on the frame state in
+ * `st`, exactly as the corresponding case in `rho_vm_eval_frame`
+ * does, and returns one of the following.
+ */
+enum {
+	JIT_NEXT  = 0,  /* continue with the next instruction */
+	JIT_TAKEN = 1,  /* take the instruction's jump */
+	JIT_EXIT  = 2   /* return to the interpreter (see `st->error`) */
+};
+
+#define PUSH(v)        (*st->stack++ = (v))
+#define POP()          (--st->stack)
+#define TOP()          (&st->stack[-1])
+#define SET_TOP(v)     (st->stack[-1] = (v))
+#define SECOND()       (&st->stack[-2])
+#define SET_SECOND(v)  (st->stack[-2] = (v))
+#define FAIL(err)      do { st->error = (err); return JIT_EXIT; } while (0)
+#define UNBOUND(name)  FAIL(rho_makeerr(rho_err_unbound(name)))
+#define LOCAL_NAME(id) (st->co->names.array[(id)].str)
+
+typedef RhoValue (*BinOp)(RhoValue *a, RhoValue *b);
+
+static const BinOp binops[] = {
+	[RHO_INS_ADD]     = rho_op_add,
+	[RHO_INS_SUB]     = rho_op_sub,
+	[RHO_INS_MUL]     = rho_op_mul,
+	[RHO_INS_DIV]     = rho_op_div,
+	[RHO_INS_MOD]     = rho_op_mod,
+	[RHO_INS_POW]     = rho_op_pow,
+	[RHO_INS_BITAND]  = rho_op_bitand,
+	[RHO_INS_BITOR]   = rho_op_bitor,
+	[RHO_INS_XOR]     = rho_op_xor,
+	[RHO_INS_SHIFTL]  = rho_op_shiftl,
+	[RHO_INS_SHIFTR]  = rho_op_shiftr,
+	[RHO_INS_EQUAL]   = rho_op_eq,
+	[RHO_INS_NOTEQ]   = rho_op_neq,
+	[RHO_INS_LT]      = rho_op_lt,
+	[RHO_INS_GT]      = rho_op_gt,
+	[RHO_INS_LE]      = rho_op_le,
+	[RHO_INS_GE]      = rho_op_ge,
+	[RHO_INS_IADD]    = rho_op_iadd,
+	[RHO_INS_ISUB]    = rho_op_isub,
+	[RHO_INS_IMUL]    = rho_op_imul,
+	[RHO_INS_IDIV]    = rho_op_idiv,
+	[RHO_INS_IMOD]    = rho_op_imod,
+	[RHO_INS_IPOW]    = rho_op_ipow,
+	[RHO_INS_IBITAND] = rho_op_ibitand,
+	[RHO_INS_IBITOR]  = rho_op_ibitor,
+	[RHO_INS_IXOR]    = rho_op_ixor,
+	[RHO_INS_ISHIFTL] = rho_op_ishiftl,
+	[RHO_INS_ISHIFTR] = rho_op_ishiftr
+};
+
+static BinOp binop_for(const unsigned int opcode)
+{
+	if (opcode >= sizeof(binops)/sizeof(binops[0])) {
+		return NULL;
+	}
+	return binops[opcode];
+}
+
+static bool truth(RhoValue *v)
+{
+	return rho_resolve_nonzero(rho_getclass(v))(v);
+}
+
+static int h_load_const(struct rho_jit_state *st, unsigned int id)
+{
+	RhoValue *v = &st->constants[id];
+	rho_retain(v);
+	PUSH(*v);
+	return JIT_NEXT;
+}
+
+static int h_load_null(struct rho_jit_state *st)
+{
+	PUSH(rho_makenull());
+	return JIT_NEXT;
+}
+
+static int h_load(struct rho_jit_state *st, unsigned int id)
+{
+	RhoValue *v = &st->locals[id];
+
+	if (rho_isempty(v)) {
+		UNBOUND(LOCAL_NAME(id));
+	}
+
+	rho_retain(v);
+	PUSH(*v);
+	return JIT_NEXT;
+}
+
+static int h_load_global(struct rho_jit_state *st, unsigned int id)
+{
+	RhoValue *v = &st->globals[id];
+
+	if (rho_isempty(v)) {
+		UNBOUND(st->co->vm->global_names.array[id].str);
+	}
+
+	rho_retain(v);
+	PUSH(*v);
+	return JIT_NEXT;
+}
+
+static int h_store(struct rho_jit_state *st, unsigned int id)
+{
+	RhoValue old = st->locals[id];
+	st->locals[id] = *POP();
+	rho_release(&old);
+	return JIT_NEXT;
+}
+
+static int h_store_global(struct rho_jit_state *st, unsigned int id)
+{
+	RhoValue old = st->globals[id];
+	st->globals[id] = *POP();
+	rho_release(&old);
+	return JIT_NEXT;
+}
+
+static int h_pop(struct rho_jit_state *st)
+{
+	rho_release(POP());
+	return JIT_NEXT;
+}
+
+static int h_dup(struct rho_jit_state *st)
+{
+	RhoValue *v = TOP();
+	rho_retain(v);
+	PUSH(*v);
+	return JIT_NEXT;
+}
+
+static int h_rot(struct rho_jit_state *st)
+{
+	RhoValue v = *SECOND();
+	SET_SECOND(*TOP());
+	SET_TOP(v);
+	return JIT_NEXT;
+}
+
+static int h_binop(struct rho_jit_state *st, unsigned int op)
+{
+	RhoValue *v2 = POP();
+	RhoValue *v1 = TOP();
+	RhoValue res = binops[op](v1, v2);
+
+	rho_release(v2);
+	if (rho_iserror(&res)) {
+		FAIL(res);
+	}
+	rho_release(v1);
+
+	SET_TOP(res);
+	return JIT_NEXT;
+}
+
+static int h_int_binop(struct rho_jit_state *st, unsigned int op)
+{
+	RhoValue *v2 = POP();
+	RhoValue *v1 = TOP();
+	SET_TOP(rho_op_int_binop(op, v1, v2));
+	return JIT_NEXT;
+}
+
+static int h_float_binop(struct rho_jit_state *st, unsigned int op)
+{
+	RhoValue *v2 = POP();
+	RhoValue *v1 = TOP();
+	SET_TOP(rho_op_float_binop(op, v1, v2));
+	return JIT_NEXT;
+}
+
+static int h_range_init(struct rho_jit_state *st)
+{
+	RhoValue *v1 = SECOND();
+	RhoValue *v2 = TOP();
+
+	if (!(rho_isint(v1) && rho_isint(v2))) {
+		RhoValue res = rho_type_exc_unsupported_2("..", rho_getclass(v1), rho_getclass(v2));
+		rho_release(POP());
+		FAIL(res);
+	}
+
+	const long from = rho_intvalue(v1);
+	const long to = rho_intvalue(v2);
+	SET_TOP(rho_makeint(to >= from ? to : to - 1));
+	return JIT_NEXT;
+}
+
+static int h_not(struct rho_jit_state *st)
+{
+	RhoValue *v = TOP();
+	RhoValue res = rho_op_not(v);
+
+	if (rho_iserror(&res)) {
+		FAIL(res);
+	}
+	rho_release(v);
+
+	SET_TOP(res);
+	return JIT_NEXT;
+}
+
+static int h_uminus(struct rho_jit_state *st)
+{
+	RhoValue *v = TOP();
+	RhoValue res = rho_op_minus(v);
+
+	if (rho_iserror(&res)) {
+		FAIL(res);
+	}
+	rho_release(v);
+
+	SET_TOP(res);
+	return JIT_NEXT;
+}
+
+static int h_load_attr(struct rho_jit_state *st, unsigned int id)
+{
+	RhoValue *v = TOP();
+	RhoValue res = rho_op_get_attr(v, st->co->attrs.array[id].str);
+
+	if (rho_iserror(&res)) {
+		FAIL(res);
+	}
+	rho_release(v);
+
+	SET_TOP(res);
+	return JIT_NEXT;
+}
+
+static int h_load_index(struct rho_jit_state *st)
+{
+	RhoValue *v2 = POP();
+	RhoValue *v1 = TOP();
+	RhoValue res = rho_op_get(v1, v2);
+
+	rho_release(v2);
+	if (rho_iserror(&res)) {
+		FAIL(res);
+	}
+	rho_release(v1);
+
+	SET_TOP(res);
+	return JIT_NEXT;
+}
+
+static int h_set_index(struct rho_jit_state *st)
+{
+	/* X[N] = Y */
+	RhoValue *v3 = POP();  /* N */
+	RhoValue *v2 = POP();  /* X */
+	RhoValue *v1 = POP();  /* Y */
+	RhoValue res = rho_op_set(v2, v3, v1);
+
+	rho_release(v1);
+	rho_release(v2);
+	rho_release(v3);
+
+	if (rho_iserror(&res)) {
+		FAIL(res);
+	}
+
+	rho_release(&res);
+	return JIT_NEXT;
+}
+
+static int h_jump_if(struct rho_jit_state *st, unsigned int when)
+{
+	RhoValue *v = POP();
+	const bool taken = (truth(v) == (bool)when);
+	rho_release(v);
+	return taken ? JIT_TAKEN : JIT_NEXT;
+}
+
+static int h_jump_if_else_pop(struct rho_jit_state *st, unsigned int when)
+{
+	RhoValue *v = TOP();
+
+	if (truth(v) == (bool)when) {
+		return JIT_TAKEN;
+	}
+
+	POP();
+	rho_release(v);
+	return JIT_NEXT;
+}
+
+static int h_call(struct rho_jit_state *st, unsigned int nargs, unsigned int nargs_named)
+{
+	RhoValue *v = POP();
+	RhoValue res = rho_op_call(v,
+	                           st->stack - nargs_named*2 - nargs,
+	                           st->stack - nargs_named*2,
+	                           nargs,
+	                           nargs_named);
+
+	rho_release(v);
+	if (rho_iserror(&res)) {
+		FAIL(res);
+	}
+
+	for (unsigned int i = 0; i < nargs_named; i++) {
+		rho_release(POP());  // value
+		rho_release(POP());  // name
+	}
+
+	for (unsigned int i = 0; i < nargs; i++) {
+		rho_release(POP());
+	}
+
+	PUSH(res);
+	return JIT_NEXT;
+}
+
+static int h_get_iter(struct rho_jit_state *st)
+{
+	RhoValue *v = TOP();
+	RhoValue res = rho_op_iter(v);
+
+	if (rho_iserror(&res)) {
+		FAIL(res);
+	}
+	rho_release(v);
+
+	SET_TOP(res);
+	return JIT_NEXT;
+}
+
+static int h_loop_iter(struct rho_jit_state *st)
+{
+	RhoValue res = rho_op_iternext(TOP());
+
+	if (rho_iserror(&res)) {
+		FAIL(res);
+	}
+
+	if (rho_is_iter_stop(&res)) {
+		return JIT_TAKEN;
+	}
+
+	PUSH(res);
+	return JIT_NEXT;
+}
+
+static int h_load_load(struct rho_jit_state *st, unsigned int id1, unsigned int id2)
+{
+	RhoValue *v1 = &st->locals[id1];
+	RhoValue *v2 = &st->locals[id2];
+
+	if (rho_isempty(v1)) {
+		UNBOUND(LOCAL_NAME(id1));
+	}
+
+	if (rho_isempty(v2)) {
+		UNBOUND(LOCAL_NAME(id2));
+	}
+
+	rho_retain(v1);
+	rho_retain(v2);
+	PUSH(*v1);
+	PUSH(*v2);
+	return JIT_NEXT;
+}
+
+static int h_load_add_const(struct rho_jit_state *st, unsigned int id, unsigned int const_id)
+{
+	RhoValue *v = &st->locals[id];
+
+	if (rho_isempty(v)) {
+		UNBOUND(LOCAL_NAME(id));
+	}
+
+	RhoValue res = rho_op_add(v, &st->constants[const_id]);
+
+	if (rho_iserror(&res)) {
+		FAIL(res);
+	}
+
+	PUSH(res);
+	return JIT_NEXT;
+}
+
+static int h_load_attr_local(struct rho_jit_state *st, unsigned int id, unsigned int attr_id)
+{
+	RhoValue *v = &st->locals[id];
+
+	if (rho_isempty(v)) {
+		UNBOUND(LOCAL_NAME(id));
+	}
+
+	RhoValue res = rho_op_get_attr(v, st->co->attrs.array[attr_id].str);
+
+	if (rho_iserror(&res)) {
+		FAIL(res);
+	}
+
+	PUSH(res);
+	return JIT_NEXT;
+}
+
+static int h_inc_local_by_const(struct rho_jit_state *st, unsigned int id, unsigned int const_id)
+{
+	RhoValue *v = &st->locals[id];
+
+	if (rho_isempty(v)) {
+		UNBOUND(LOCAL_NAME(id));
+	}
+
+	RhoValue res = rho_op_iadd(v, &st->constants[const_id]);
+
+	if (rho_iserror(&res)) {
+		FAIL(res);
+	}
+
+	RhoValue old = *v;
+	*v = res;
+	rho_release(&old);
+	return JIT_NEXT;
+}
+
+static int h_compare_and_branch(struct rho_jit_state *st, unsigned int cmp)
+{
+	RhoValue *v2 = POP();
+	RhoValue *v1 = TOP();
+	RhoValue res = binops[cmp](v1, v2);
+
+	rho_release(v2);
+	if (rho_iserror(&res)) {
+		FAIL(res);
+	}
+	rho_release(v1);
+	POP();
+
+	const bool taken = !truth(&res);
+	rho_release(&res);
+	return taken ? JIT_TAKEN : JIT_NEXT;
+}
+
+static int h_for_iter_store(struct rho_jit_state *st, unsigned int id)
+{
+	RhoValue res = rho_op_iternext(TOP());
+
+	if (rho_iserror(&res)) {
+		FAIL(res);
+	}
+
+	if (rho_is_iter_stop(&res)) {
+		return JIT_TAKEN;
+	}
+
+	RhoValue old = st->locals[id];
+	st->locals[id] = res;
+	rho_release(&old);
+	return JIT_NEXT;
+}
+
+static int h_for_range(struct rho_jit_state *st, unsigned int id)
+{
+	const long i = rho_intvalue(SECOND());
+	const long stop = rho_intvalue(TOP());
+
+	if (i == stop) {
+		return JIT_TAKEN;
+	}
+
+	RhoValue old = st->locals[id];
+	st->locals[id] = rho_makeint(i);
+	rho_release(&old);
+	SET_SECOND(rho_makeint(i < stop ? i + 1 : i - 1));
+	return JIT_NEXT;
+}
+
+#define REG_SLOT(op) (((op) & RHO_REG_CONST) ? &st->constants[(op) & RHO_REG_INDEX_MASK] : \
+                                               &st->locals[(op) & RHO_REG_INDEX_MASK])
+
+#define REG_CHECK_BOUND(v, op) \
+	if (rho_isempty(v)) { \
+		UNBOUND(LOCAL_NAME((op) & RHO_REG_INDEX_MASK)); \
+	}
+
+#define REG_CONSUME(op) \
+	if ((op) & RHO_REG_TEMP) { \
+		rho_release(&st->locals[(op) & RHO_REG_INDEX_MASK]); \
+		st->locals[(op) & RHO_REG_INDEX_MASK] = rho_makeempty(); \
+	}
+
+static int h_reg_move(struct rho_jit_state *st, unsigned int dst, unsigned int src)
+{
+	RhoValue *v = REG_SLOT(src);
+	REG_CHECK_BOUND(v, src);
+
+	rho_retain(v);
+	RhoValue old = st->locals[dst];
+	st->locals[dst] = *v;
+	rho_release(&old);
+	return JIT_NEXT;
+}
+
+static int h_reg_binop(struct rho_jit_state *st, unsigned int op, unsigned int dst, unsigned int a, unsigned int b)
+{
+	RhoValue *v1 = REG_SLOT(a);
+	RhoValue *v2 = REG_SLOT(b);
+	REG_CHECK_BOUND(v1, a);
+	REG_CHECK_BOUND(v2, b);
+
+	RhoValue res = binops[op](v1, v2);
+	REG_CONSUME(a);
+	REG_CONSUME(b);
+
+	if (rho_iserror(&res)) {
+		FAIL(res);
+	}
+
+	RhoValue old = st->locals[dst];
+	st->locals[dst] = res;
+	rho_release(&old);
+	return JIT_NEXT;
+}
+
+static int h_reg_cmp_branch(struct rho_jit_state *st, unsigned int op, unsigned int a, unsigned int b)
+{
+	RhoValue *v1 = REG_SLOT(a);
+	RhoValue *v2 = REG_SLOT(b);
+	REG_CHECK_BOUND(v1, a);
+	REG_CHECK_BOUND(v2, b);
+
+	RhoValue res = binops[op](v1, v2);
+	REG_CONSUME(a);
+	REG_CONSUME(b);
+
+	if (rho_iserror(&res)) {
+		FAIL(res);
+	}
+
+	const bool taken = !truth(&res);
+	rho_release(&res);
+	return taken ? JIT_TAKEN : JIT_NEXT;
+}
+
+#undef REG_SLOT
+#undef REG_CHECK_BOUND
+#undef REG_CONSUME
+
+#undef PUSH
+#undef POP
+#undef TOP
+#undef SET_TOP
+#undef SECOND
+#undef SET_SECOND
+#undef FAIL
+#undef UNBOUND
+#undef LOCAL_NAME
+
+/*
+ * Code generation
+ * ---------------
+ * The generated function has the signature of `JitFunc` below: it
+ * keeps `st` in rbx and starts by jumping to the native code of the
+ * instruction to resume at. Each instruction is then one of:
+ *
+ *   - a call to a helper (arguments in esi, edx, ecx, r8d), followed
+ *     by a check of its result if it can jump or return JIT_EXIT;
+ *   - a native jump, for unconditional jumps;
+ *   - an exit, which returns the instruction's position so that the
+ *     interpreter executes it, for instructions we have no template
+ *     for.
+ */
+typedef unsigned int (*JitFunc)(struct rho_jit_state *st, const byte *entry);
+
+/* upper bound on the size of any single instruction's native code */
+#define MAX_TEMPLATE_SIZE 64
+
+struct emitter {
+	byte *buf;
+	size_t size;
+
+	/* rel32 fields to be patched with the native offset of a bytecode position */
+	struct fixup {
+		size_t at;
+		size_t target_pos;
+	} *fixups;
+	size_t n_fixups;
+};
+
+static void emit_byte(struct emitter *e, const byte b)
+{
+	e->buf[e->size++] = b;
+}
+
+static void emit_u32(struct emitter *e, const uint32_t x)
+{
+	for (int i = 0; i < 4; i++) {
+		emit_byte(e, (x >> (8*i)) & 0xff);
+	}
+}
+
+static void emit_u64(struct emitter *e, const uint64_t x)
+{
+	for (int i = 0; i < 8; i++) {
+		emit_byte(e, (x >> (8*i)) & 0xff);
+	}
+}
+
+static void emit_rel32_to(struct emitter *e, const size_t target_pos)
+{
+	e->fixups[e->n_fixups++] = (struct fixup){e->size, target_pos};
+	emit_u32(e, 0);
+}
+
+/* mov eax, pos; pop rbx; ret */
+static void emit_exit(struct emitter *e, const size_t pos)
+{
+	emit_byte(e, 0xb8);
+	emit_u32(e, pos);
+	emit_byte(e, 0x5b);
+	emit_byte(e, 0xc3);
+}
+
+#define EXIT_SIZE 7
+
+typedef void (*AnyFunc)(void);
+
+static void emit_call(struct emitter *e, AnyFunc helper, const unsigned int *args, const unsigned int nargs)
+{
+	/* mov rdi, rbx */
+	emit_byte(e, 0x48);
+	emit_byte(e, 0x89);
+	emit_byte(e, 0xdf);
+
+	static const byte mov_arg[][2] = {
+		{0x00, 0xbe},  /* mov esi, imm32 */
+		{0x00, 0xba},  /* mov edx, imm32 */
+		{0x00, 0xb9},  /* mov ecx, imm32 */
+		{0x41, 0xb8}   /* mov r8d, imm32 */
+	};
+
+	for (unsigned int i = 0; i < nargs; i++) {
+		if (mov_arg[i][0]) {
+			emit_byte(e, mov_arg[i][0]);
+		}
+		emit_byte(e, mov_arg[i][1]);
+		emit_u32(e, args[i]);
+	}
+
+	uint64_t addr;
+	memcpy(&addr, &helper, sizeof(addr));
+
+	/* mov rax, imm64; call rax */
+	emit_byte(e, 0x48);
+	emit_byte(e, 0xb8);
+	emit_u64(e, addr);
+	emit_byte(e, 0xff);
+	emit_byte(e, 0xd0);
+}
+
+struct template {
+	AnyFunc helper;         /* NULL if there's no template */
+	unsigned int args[4];
+	unsigned int nargs;
+	bool may_exit;          /* helper may return JIT_EXIT */
+	bool jumps;             /* helper may return JIT_TAKEN */
+};
+
+/*
+ * Fills in the template for the given instruction; `args` are the
+ * instruction's arguments, including the high bits supplied by an
+ * EXTENDED_ARG prefix. Returns false if there is none.
+ */
+static bool template_for(const RhoOpcode opcode, const unsigned int *args, struct template *t)
+{
+#define T(h, n, exits, jmps) \
+	do { t->helper = (AnyFunc)(h); t->nargs = (n); t->may_exit = (exits); t->jumps = (jmps); } while (0)
+
+	switch (opcode) {
+	case RHO_INS_LOAD_CONST:
+		T(h_load_const, 1, false, false);
+		t->args[0] = args[0];
+		break;
+	case RHO_INS_LOAD_NULL:
+		T(h_load_null, 0, false, false);
+		break;
+	case RHO_INS_LOAD:
+		T(h_load, 1, true, false);
+		t->args[0] = args[0];
+		break;
+	case RHO_INS_LOAD_GLOBAL:
+		T(h_load_global, 1, true, false);
+		t->args[0] = args[0];
+		break;
+	case RHO_INS_STORE:
+		T(h_store, 1, false, false);
+		t->args[0] = args[0];
+		break;
+	case RHO_INS_STORE_GLOBAL:
+		T(h_store_global, 1, false, false);
+		t->args[0] = args[0];
+		break;
+	case RHO_INS_POP:
+		T(h_pop, 0, false, false);
+		break;
+	case RHO_INS_DUP:
+		T(h_dup, 0, false, false);
+		break;
+	case RHO_INS_ROT:
+		T(h_rot, 0, false, false);
+		break;
+	case RHO_INS_NOT:
+		T(h_not, 0, true, false);
+		break;
+	case RHO_INS_UMINUS:
+		T(h_uminus, 0, true, false);
+		break;
+	case RHO_INS_LOAD_ATTR:
+		T(h_load_attr, 1, true, false);
+		t->args[0] = args[0];
+		break;
+	case RHO_INS_LOAD_INDEX:
+		T(h_load_index, 0, true, false);
+		break;
+	case RHO_INS_SET_INDEX:
+		T(h_set_index, 0, true, false);
+		break;
+	case RHO_INS_JMP_IF_TRUE:
+	case RHO_INS_JMP_BACK_IF_TRUE:
+	case RHO_INS_JMP_IF_FALSE:
+	case RHO_INS_JMP_BACK_IF_FALSE:
+		T(h_jump_if, 1, false, true);
+		t->args[0] = (opcode == RHO_INS_JMP_IF_TRUE || opcode == RHO_INS_JMP_BACK_IF_TRUE);
+		break;
+	case RHO_INS_JMP_IF_TRUE_ELSE_POP:
+	case RHO_INS_JMP_IF_FALSE_ELSE_POP:
+		T(h_jump_if_else_pop, 1, false, true);
+		t->args[0] = (opcode == RHO_INS_JMP_IF_TRUE_ELSE_POP);
+		break;
+	case RHO_INS_CALL:
+		T(h_call, 2, true, false);
+		t->args[0] = args[0];
+		t->args[1] = args[1];
+		break;
+	case RHO_INS_GET_ITER:
+		T(h_get_iter, 0, true, false);
+		break;
+	case RHO_INS_LOOP_ITER:
+		T(h_loop_iter, 0, true, true);
+		break;
+	case RHO_INS_LOAD_LOAD:
+		T(h_load_load, 2, true, false);
+		t->args[0] = args[0];
+		t->args[1] = args[1];
+		break;
+	case RHO_INS_LOAD_ADD_CONST:
+		T(h_load_add_const, 2, true, false);
+		t->args[0] = args[0];
+		t->args[1] = args[1];
+		break;
+	case RHO_INS_LOAD_ATTR_LOCAL:
+		T(h_load_attr_local, 2, true, false);
+		t->args[0] = args[0];
+		t->args[1] = args[1];
+		break;
+	case RHO_INS_INC_LOCAL_BY_CONST:
+		T(h_inc_local_by_const, 2, true, false);
+		t->args[0] = args[0];
+		t->args[1] = args[1];
+		break;
+	case RHO_INS_COMPARE_AND_BRANCH:
+		if (binop_for(args[0]) == NULL) {
+			return false;
+		}
+		T(h_compare_and_branch, 1, true, true);
+		t->args[0] = args[0];
+		break;
+	case RHO_INS_FOR_ITER_STORE:
+		T(h_for_iter_store, 1, true, true);
+		t->args[0] = args[1];
+		break;
+	case RHO_INS_REG_MOVE:
+		T(h_reg_move, 2, true, false);
+		t->args[0] = args[0];
+		t->args[1] = args[1];
+		break;
+	case RHO_INS_REG_BINOP:
+		if (binop_for(args[0]) == NULL) {
+			return false;
+		}
+		T(h_reg_binop, 4, true, false);
+		memcpy(t->args, args, 4 * sizeof(unsigned int));
+		break;
+	case RHO_INS_REG_CMP_BRANCH:
+		if (binop_for(args[0]) == NULL) {
+			return false;
+		}
+		T(h_reg_cmp_branch, 3, true, true);
+		memcpy(t->args, args, 3 * sizeof(unsigned int));
+		break;
+	case RHO_INS_INT_BINOP:
+		T(h_int_binop, 1, false, false);
+		t->args[0] = args[0];
+		break;
+	case RHO_INS_FLOAT_BINOP:
+		T(h_float_binop, 1, false, false);
+		t->args[0] = args[0];
+		break;
+	case RHO_INS_RANGE_INIT:
+		T(h_range_init, 0, true, false);
+		break;
+	case RHO_INS_FOR_RANGE:
+		T(h_for_range, 1, false, true);
+		t->args[0] = args[1];
+		break;
+	default:
+		if (binop_for(opcode) != NULL) {
+			T(h_binop, 1, true, false);
+			t->args[0] = opcode;
+			break;
+		}
+		return false;
+	}
+
+	return true;
+
+#undef T
+}
+
+/*
+ * Bytecode position that the jump at `pos` leads to, or -1 if the
+ * instruction is not a (single-target) jump.
+ */
+static long jump_target(const byte *bc, const size_t pos, const unsigned int *args)
+{
+	const RhoOpcode opcode = bc[pos];
+	const long next = pos + 1 + rho_opcode_arg_size(opcode);
+
+	switch (opcode) {
+	case RHO_INS_JMP:
+	case RHO_INS_JMP_IF_TRUE:
+	case RHO_INS_JMP_IF_FALSE:
+	case RHO_INS_JMP_IF_TRUE_ELSE_POP:
+	case RHO_INS_JMP_IF_FALSE_ELSE_POP:
+	case RHO_INS_LOOP_ITER:
+	case RHO_INS_FOR_ITER_STORE:
+	case RHO_INS_FOR_RANGE:
+		return next + args[0];
+	case RHO_INS_COMPARE_AND_BRANCH:
+		return next + args[1];
+	case RHO_INS_REG_CMP_BRANCH:
+		return next + args[3];
+	case RHO_INS_JMP_BACK:
+	case RHO_INS_JMP_BACK_IF_TRUE:
+	case RHO_INS_JMP_BACK_IF_FALSE:
+		return next - args[0];
+	default:
+		return -1;
+	}
+}
+
+static struct rho_jit_code *jit_compile(RhoCodeObject *co)
+{
+	const byte *bc = co->bc;
+	const size_t len = co->bc_size;
+
+	if (len == 0 || len >= UINT_MAX) {
+		return NULL;
+	}
+
+	size_t n_ins = 0;
+	for (size_t pos = 0; pos < len; pos += 1 + rho_opcode_arg_size(bc[pos])) {
+		if (rho_opcode_arg_size(bc[pos]) < 0) {
+			return NULL;
+		}
+		++n_ins;
+	}
+
+	const size_t mem_size = 16 + n_ins * MAX_TEMPLATE_SIZE;
+	byte *mem = mmap(NULL, mem_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if (mem == MAP_FAILED) {
+		return NULL;
+	}
+
+	unsigned int *entry = rho_malloc(len * sizeof(unsigned int));
+	for (size_t i = 0; i < len; i++) {
+		entry[i] = UINT_MAX;
+	}
+
+	struct emitter e = {
+		.buf = mem,
+		.size = 0,
+		.fixups = rho_malloc(n_ins * sizeof(struct fixup)),
+		.n_fixups = 0
+	};
+
+	/* push rbx; mov rbx, rdi; jmp rsi */
+	emit_byte(&e, 0x53);
+	emit_byte(&e, 0x48);
+	emit_byte(&e, 0x89);
+	emit_byte(&e, 0xfb);
+	emit_byte(&e, 0xff);
+	emit_byte(&e, 0xe6);
+
+	bool ok = true;
+
+	for (size_t pos = 0; pos < len && ok;) {
+		/*
+		 * A prefixed instruction is compiled as one with its prefix,
+		 * and is where execution resumes if the template exits.
+		 */
+		const size_t start = pos;
+		unsigned int ext = 0;
+
+		if (bc[pos] == RHO_INS_EXTENDED_ARG) {
+			ext = ((bc[pos + 2] << 8) | bc[pos + 1]) << 16;
+			pos += 3;
+
+			if (pos >= len) {
+				ok = false;
+				break;
+			}
+		}
+
+		const RhoOpcode opcode = bc[pos];
+		const int size = rho_opcode_arg_size(opcode);
+		unsigned int args[4] = {0, 0, 0, 0};
+
+		for (int k = 0; k < size/2 && k < 4; k++) {
+			args[k] = (bc[pos + 2 + 2*k] << 8) | bc[pos + 1 + 2*k];
+		}
+		args[rho_opcode_extended_arg(opcode)] |= ext;
+
+		const long target = jump_target(bc, pos, args);
+
+		if (target != -1 && (target < 0 || (size_t)target >= len)) {
+			ok = false;
+			break;
+		}
+
+		entry[start] = e.size;
+		struct template t;
+
+		if (opcode == RHO_INS_NOP) {
+			/* nothing to do */
+		} else if (opcode == RHO_INS_JMP || opcode == RHO_INS_JMP_BACK) {
+			/* jmp rel32 */
+			emit_byte(&e, 0xe9);
+			emit_rel32_to(&e, target);
+		} else if (template_for(opcode, args, &t)) {
+			emit_call(&e, t.helper, t.args, t.nargs);
+
+			if (t.jumps && t.may_exit) {
+				/* test eax, eax; jz next; cmp eax, 1; je target; <exit> */
+				emit_byte(&e, 0x85);
+				emit_byte(&e, 0xc0);
+				emit_byte(&e, 0x74);
+				emit_byte(&e, 3 + 6 + EXIT_SIZE);
+				emit_byte(&e, 0x83);
+				emit_byte(&e, 0xf8);
+				emit_byte(&e, JIT_TAKEN);
+				emit_byte(&e, 0x0f);
+				emit_byte(&e, 0x84);
+				emit_rel32_to(&e, target);
+				emit_exit(&e, start);
+			} else if (t.jumps) {
+				/* test eax, eax; jnz target */
+				emit_byte(&e, 0x85);
+				emit_byte(&e, 0xc0);
+				emit_byte(&e, 0x0f);
+				emit_byte(&e, 0x85);
+				emit_rel32_to(&e, target);
+			} else if (t.may_exit) {
+				/* test eax, eax; jz next; <exit> */
+				emit_byte(&e, 0x85);
+				emit_byte(&e, 0xc0);
+				emit_byte(&e, 0x74);
+				emit_byte(&e, EXIT_SIZE);
+				emit_exit(&e, start);
+			}
+		} else {
+			emit_exit(&e, start);
+		}
+
+		pos += 1 + size;
+	}
+
+	/* ud2 (control can't fall off the end: the last instruction is a RETURN) */
+	emit_byte(&e, 0x0f);
+	emit_byte(&e, 0x0b);
+
+	for (size_t i = 0; i < e.n_fixups && ok; i++) {
+		const unsigned int target = entry[e.fixups[i].target_pos];
+
+		if (target == UINT_MAX) {
+			ok = false;
+			break;
+		}
+
+		const int32_t rel = (int32_t)target - (int32_t)(e.fixups[i].at + 4);
+		memcpy(&mem[e.fixups[i].at], &rel, sizeof(rel));
+	}
+
+	free(e.fixups);
+
+	if (!ok || mprotect(mem, mem_size, PROT_READ | PROT_EXEC) != 0) {
+		munmap(mem, mem_size);
+		free(entry);
+		return NULL;
+	}
+
+	struct rho_jit_code *jit = rho_malloc(sizeof(struct rho_jit_code));
+	jit->mem = mem;
+	jit->mem_size = mem_size;
+	jit->entry = entry;
+	return jit;
+}
+
+bool rho_jit_hot(RhoCodeObject *co, const size_t pos)
+{
+	struct rho_jit_code *jit = atomic_load_explicit(&co->jit, memory_order_acquire);
+
+	if (jit != NULL) {
+		return jit != &jit_unavailable;
+	}
+
+	if (atomic_fetch_add_explicit(&co->cache[pos].hotness, 1, memory_order_relaxed) + 1 < RHO_JIT_THRESHOLD) {
+		return false;
+	}
+
+	pthread_mutex_lock(&jit_mutex);
+
+	jit = atomic_load_explicit(&co->jit, memory_order_acquire);
+
+	if (jit == NULL) {
+		jit = jit_compile(co);
+
+		if (jit == NULL) {
+			jit = &jit_unavailable;
+		}
+
+		atomic_store_explicit(&co->jit, jit, memory_order_release);
+	}
+
+	pthread_mutex_unlock(&jit_mutex);
+	return jit != &jit_unavailable;
+}
+
+size_t rho_jit_run(RhoCodeObject *co, const size_t pos, struct rho_jit_state *st)
+{
+	struct rho_jit_code *jit = atomic_load_explicit(&co->jit, memory_order_acquire);
+	assert(jit != NULL && jit != &jit_unavailable);
+	assert(pos < co->bc_size && jit->entry[pos] != UINT_MAX);
+
+	JitFunc func;
+	void *mem = jit->mem;
+	memcpy(&func, &mem, sizeof(func));
+
+	return func(st, jit->mem + jit->entry[pos]);
+}
+
+void rho_jit_free(RhoCodeObject *co)
+{
+	struct rho_jit_code *jit = atomic_load_explicit(&co->jit, memory_order_acquire);
+
+	if (jit == NULL || jit == &jit_unavailable) {
+		return;
+	}
+
+	munmap(jit->mem, jit->mem_size);
+	free(jit->entry);
+	free(jit);
+}
+
+#else /* !RHO_JIT_SUPPORTED */
+
+bool rho_jit_hot(RhoCodeObject *co, const size_t pos)
+{
+	(void)co;
+	(void)pos;
+	return false;
+}
+
+size_t rho_jit_run(RhoCodeObject *co, const size_t pos, struct rho_jit_state *st)
+{
+	(void)co;
+	(void)pos;
+	(void)st;
+	RHO_INTERNAL_ERROR();
+	return 0;
+}
+
+void rho_jit_free(RhoCodeObject *co)
+{
+	(void)co;
+}
+
+#endif /* RHO_JIT_SUPPORTED */
@@ -0,0 +1,61 @@
+#ifndef RHO_JIT_H
+#define RHO_JIT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "object.h"
+#include "codeobject.h"
+
+/*
+ * Baseline template JIT
+ * ---------------------
+ * Once a code object is entered (via a call or a backward jump)
+ * RHO_JIT_THRESHOLD times at the same position, its bytecode is
+ * translated to x86-64 machine code by stitching together a native
+ * template for each instruction. Most templates simply call a small
+ * helper that performs the instruction on the frame's value stack
+ * and locals, exactly like the corresponding case in
+ * `rho_vm_eval_frame`; jumps become native jumps.
+ *
+ * Native code runs on the same frame state as the interpreter, so
+ * control can pass between the two at any instruction boundary:
+ * instructions that have no template (and anything that raises an
+ * error) make the native code return to the interpreter, which then
+ * carries on from that instruction. Native code is never entered
+ * inside a try-block.
+ *
+ * On platforms other than x86-64 Linux/macOS, nothing is ever
+ * compiled and the interpreter is always used.
+ */
+
+#define RHO_JIT_THRESHOLD 1000
+
+struct rho_jit_state {
+	RhoValue *stack;     /* top of the frame's value stack */
+	RhoValue *locals;
+	RhoValue *constants;
+	RhoValue *globals;
+	RhoCodeObject *co;
+	RhoValue error;      /* set if the native code returned due to an error */
+};
+
+extern bool rho_jit_enabled;
+
+/*
+ * Counts an entry into `co` at bytecode position `pos`, compiling
+ * the code object if it's become hot. Returns whether native code
+ * is available for `co`.
+ */
+bool rho_jit_hot(RhoCodeObject *co, const size_t pos);
+
+/*
+ * Runs the native code of `co` from bytecode position `pos` with
+ * the given state, and returns the position at which execution
+ * should continue in the interpreter. If `st->error` is not empty
+ * on return, the instruction at that position raised it.
+ */
+size_t rho_jit_run(RhoCodeObject *co, const size_t pos, struct rho_jit_state *st);
+
+void rho_jit_free(RhoCodeObject *co);
+
+#endif /* RHO_JIT_H */
@@ -1,11 +1,105 @@
+#include "main.h"
+#if RHO_IS_POSIX
+#define _POSIX_C_SOURCE 200809L  /* for fileno, mmap and mkdir */
+#endif
+
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
 #include <string.h>
+#include <pthread.h>
 #include "code.h"
+#include "parser.h"
+#include "opt.h"
 #include "compiler.h"
 #include "err.h"
 #include "util.h"
+#include "arena.h"
 #include "loader.h"
+#include "snapshot.h"
+
+#if RHO_IS_POSIX
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+/*
+ * Compiled files are mapped read-only where possible, so that only
+ * the parts of a module that are actually executed are ever paged
+ * in; string constants and symbol tables point straight into the
+ * mapping (see codeobject.c). A mapped Code has no capacity, as it
+ * can't grow; otherwise the file is read into a heap buffer.
+ */
+static byte *map_file(FILE *compiled, const size_t file_size)
+{
+#if RHO_IS_POSIX
+	if (file_size > 0) {
+		void *map = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fileno(compiled), 0);
+
+		if (map != MAP_FAILED) {
+			return map;
+		}
+	}
+#else
+	(void)compiled;
+	(void)file_size;
+#endif
+	return NULL;
+}
+
+/* the last magic byte is the format version */
+static int check_signature(FILE *compiled, const byte *magic)
+{
+	for (size_t i = 0; i < rho_magic_size; i++) {
+		const byte c = fgetc(compiled);
+		if (c != magic[i]) {
+			return (i == rho_magic_size - 1) ? RHO_LOAD_ERR_VERSION : RHO_LOAD_ERR_INVALID_SIGNATURE;
+		}
+	}
+
+	return RHO_LOAD_ERR_NONE;
+}
+
+/*
+ * Heap images (see snapshot.c) are loaded just like compiled files;
+ * their magic bytes are of the same length, so they are released
+ * the same way too.
+ */
+static int load_file(FILE *compiled, const byte *magic, RhoCode *dest)
+{
+	if (compiled == NULL) {
+		return RHO_LOAD_ERR_NOT_FOUND;
+	}
+
+	fseek(compiled, 0L, SEEK_END);
+	const size_t file_size = ftell(compiled);
+	const size_t code_size = file_size - rho_magic_size;
+	fseek(compiled, 0L, SEEK_SET);
+
+	const int error = check_signature(compiled, magic);
+
+	if (error != RHO_LOAD_ERR_NONE) {
+		fclose(compiled);
+		return error;
+	}
+
+	byte *map = map_file(compiled, file_size);
+
+	if (map != NULL) {
+		dest->bc = map + rho_magic_size;
+		dest->size = code_size;
+		dest->capacity = 0;
+	} else {
+		rho_code_init(dest, code_size);
+		fread(dest->bc, 1, code_size, compiled);
+		dest->size = code_size;
+	}
+
+	fclose(compiled);
+	return RHO_LOAD_ERR_NONE;
+}
 
 int rho_load_from_file(const char *name, const bool name_has_ext, RhoCode *dest)
 {
@@ -21,25 +115,334 @@ int rho_load_from_file(const char *name, const bool name_has_ext, RhoCode *dest)
 		free(filename_buf);
 	}
 
+	return load_file(compiled, rho_magic, dest);
+}
+
+int rho_load_image(const char *filename, RhoCode *dest)
+{
+	return load_file(fopen(filename, "rb"), rho_image_magic, dest);
+}
+
+void rho_load_release(RhoCode *code)
+{
+	if (code->bc == NULL) {
+		return;
+	}
+
+#if RHO_IS_POSIX
+	if (code->capacity == 0) {
+		munmap(code->bc - rho_magic_size, code->size + rho_magic_size);
+		return;
+	}
+#endif
+
+	rho_code_dealloc(code);
+}
+
+bool rho_is_compiled(const char *filename)
+{
+	FILE *compiled = fopen(filename, "rb");
+
 	if (compiled == NULL) {
+		return false;
+	}
+
+	const int error = check_signature(compiled, rho_magic);
+	fclose(compiled);
+	return error == RHO_LOAD_ERR_NONE;
+}
+
+/*
+ * Compile-time reporting
+ * ----------------------
+ * With --compile-time, every module compiled reports how long its
+ * parsing, symbol table, code generation and stack depth analysis
+ * took; tools/compile_bench.py uses this to see how each phase
+ * scales with the size of the source.
+ */
+
+bool rho_compile_time_enabled = false;
+
+static pthread_once_t compile_time_header_once = PTHREAD_ONCE_INIT;
+
+static void compile_time_header(void)
+{
+	fprintf(stderr, "compile time: parse [us] | symtab [us] | codegen [us] | stack [us] | file\n");
+}
+
+static void compile_time_report(const char *filename, const struct rho_compile_times *times)
+{
+	pthread_once(&compile_time_header_once, compile_time_header);
+	fprintf(stderr,
+	        "compile time: %10.0f | %11.0f | %12.0f | %10.0f | %s\n",
+	        times->parse * 1e6,
+	        times->symtab * 1e6,
+	        times->codegen * 1e6,
+	        times->stack * 1e6,
+	        filename);
+}
+
+RhoProgram *rho_parse_source(const char *filename,
+                             char *src,
+                             RhoArena *arena,
+                             struct rho_compile_times *times,
+                             const char **error_msg)
+{
+	const double start = rho_compile_time_enabled ? rho_util_time() : 0;
+	times->parse = times->symtab = times->codegen = times->stack = 0;
+
+	RhoParser *p = rho_parser_new(src, filename, arena);
+	RhoProgram *prog = rho_parse(p);
+
+	if (RHO_PARSER_ERROR(p)) {
+		*error_msg = rho_util_str_dup(p->error_msg);
+		rho_parser_free(p);
+		return NULL;
+	}
+
+	rho_parser_free(p);
+	rho_opt_program(prog, arena);
+
+	if (rho_compile_time_enabled) {
+		times->parse = rho_util_time() - start;
+	}
+
+	return prog;
+}
+
+int rho_compile_program(const char *filename,
+                        RhoProgram *prog,
+                        RhoArena *arena,
+                        const unsigned int flags,
+                        struct rho_compile_times *times,
+                        const char *out_filename)
+{
+	/*
+	 * The code is written to a temporary file and renamed into
+	 * place once complete, so that concurrent runs never load
+	 * partially written files.
+	 */
+#if RHO_IS_POSIX
+	char *tmp_filename = rho_malloc(strlen(out_filename) + 32);
+	sprintf(tmp_filename, "%s.%ld.tmp", out_filename, (long)getpid());
+#else
+	char *tmp_filename = rho_malloc(strlen(out_filename) + 1);
+	strcpy(tmp_filename, out_filename);
+#endif
+
+	FILE *out_file = fopen(tmp_filename, "wb");
+
+	if (out_file == NULL) {
+		free(tmp_filename);
+		return RHO_LOAD_ERR_WRITE;
+	}
+
+	rho_compile(filename, prog, arena, flags, rho_compile_time_enabled ? times : NULL, out_file);
+	int error = (fclose(out_file) == 0) ? RHO_LOAD_ERR_NONE : RHO_LOAD_ERR_WRITE;
+
+	if (error == RHO_LOAD_ERR_NONE && strcmp(tmp_filename, out_filename) != 0) {
+		if (rename(tmp_filename, out_filename) != 0) {
+			error = RHO_LOAD_ERR_WRITE;
+		}
+	}
+
+	if (error != RHO_LOAD_ERR_NONE) {
+		remove(tmp_filename);
+	}
+
+	free(tmp_filename);
+
+	if (rho_compile_time_enabled) {
+		compile_time_report(filename, times);
+	}
+
+	return error;
+}
+
+int rho_compile_to_file(const char *filename,
+                        const unsigned int flags,
+                        const char *out_filename,
+                        const char **error_msg)
+{
+	char *src = rho_util_file_to_str(filename);
+
+	if (src == NULL) {
 		return RHO_LOAD_ERR_NOT_FOUND;
 	}
 
-	fseek(compiled, 0L, SEEK_END);
-	const size_t code_size = ftell(compiled) - rho_magic_size;
-	fseek(compiled, 0L, SEEK_SET);
+	RhoArena arena;
+	rho_arena_init(&arena);
+	struct rho_compile_times times;
+	RhoProgram *prog = rho_parse_source(filename, src, &arena, &times, error_msg);
+	RHO_FREE(src);
 
-	/* verify file signature */
-	for (size_t i = 0; i < rho_magic_size; i++) {
-		const byte c = fgetc(compiled);
-		if (c != rho_magic[i]) {
-			return RHO_LOAD_ERR_INVALID_SIGNATURE;
+	const int error = (prog != NULL) ?
+	                  rho_compile_program(filename, prog, &arena, flags, &times, out_filename) :
+	                  RHO_LOAD_ERR_SYNTAX;
+	rho_arena_dealloc(&arena);
+	return error;
+}
+
+/*
+ * Bytecode cache
+ * --------------
+ * Running or importing a source file compiles it into the cache
+ * directory, under a name derived from the source text and size,
+ * the versions of rho and of the rhoc format and the compiler flags.
+ * Unchanged sources are thus never compiled twice, and entries that
+ * went stale are simply never looked up again. Without a cache
+ * directory, sources are compiled next to themselves, as `rho -c`
+ * does.
+ */
+
+#if RHO_IS_POSIX
+static bool make_dir(const char *path)
+{
+	return mkdir(path, 0755) == 0 || errno == EEXIST;
+}
+#endif
+
+static char *path_join(const char *dir, const char *name)
+{
+	const size_t dir_len = strlen(dir);
+	char *path = rho_malloc(dir_len + 1 + strlen(name) + 1);
+	strcpy(path, dir);
+	path[dir_len] = '/';
+	strcpy(path + dir_len + 1, name);
+	return path;
+}
+
+static const char *cache_dir(void)
+{
+#if RHO_IS_POSIX
+	const char *dir = getenv(RHO_CACHE_DIR_ENV);
+
+	if (dir != NULL && dir[0] != '\0') {
+		return make_dir(dir) ? rho_util_str_dup(dir) : NULL;
+	}
+
+	const char *base = getenv("XDG_CACHE_HOME");
+	char *base_buf = NULL;
+
+	if (base == NULL || base[0] == '\0') {
+		const char *home = getenv("HOME");
+
+		if (home == NULL || home[0] == '\0') {
+			return NULL;
 		}
+
+		base = base_buf = path_join(home, ".cache");
 	}
 
-	rho_code_init(dest, code_size);
-	fread(dest->bc, 1, code_size, compiled);
-	dest->size = code_size;
-	fclose(compiled);
-	return RHO_LOAD_ERR_NONE;
+	char *path = NULL;
+
+	if (make_dir(base)) {
+		path = path_join(base, "rho");
+
+		if (!make_dir(path)) {
+			free(path);
+			path = NULL;
+		}
+	}
+
+	free(base_buf);
+	return path;
+#else
+	return NULL;
+#endif
+}
+
+/* 64-bit FNV-1a */
+static uint64_t hash_bytes(uint64_t hash, const void *bytes, const size_t len)
+{
+	const byte *b = bytes;
+
+	for (size_t i = 0; i < len; i++) {
+		hash ^= b[i];
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
+char *rho_cache_filename(const char *filename, const char *src, const unsigned int flags)
+{
+	const char *dir = cache_dir();
+
+	if (dir == NULL) {
+		char *out_filename = rho_malloc(strlen(filename) + 2);
+		strcpy(out_filename, filename);
+		strcat(out_filename, "c");
+		return out_filename;
+	}
+
+	const size_t src_len = strlen(src);
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	hash = hash_bytes(hash, src, src_len);
+	hash = hash_bytes(hash, &src_len, sizeof(src_len));
+	hash = hash_bytes(hash, RHO_VERSION, sizeof(RHO_VERSION));
+	hash = hash_bytes(hash, rho_magic, rho_magic_size);
+	hash = hash_bytes(hash, &flags, sizeof(flags));
+
+	char entry[16 + sizeof(RHOC_EXT)];
+	sprintf(entry, "%016llx" RHOC_EXT, (unsigned long long)hash);
+	char *out_filename = path_join(dir, entry);
+	RHO_FREE(dir);
+	return out_filename;
+}
+
+int rho_load_from_source(const char *filename,
+                         const unsigned int flags,
+                         RhoCode *dest,
+                         const char **error_msg)
+{
+	char *src = rho_util_file_to_str(filename);
+
+	if (src == NULL) {
+		return RHO_LOAD_ERR_NOT_FOUND;
+	}
+
+	char *out_filename = rho_cache_filename(filename, src, flags);
+
+	if (rho_load_from_file(out_filename, true, dest) == RHO_LOAD_ERR_NONE) {
+		free(out_filename);
+		RHO_FREE(src);
+		return RHO_LOAD_ERR_NONE;
+	}
+
+	RhoArena arena;
+	rho_arena_init(&arena);
+	struct rho_compile_times times;
+	RhoProgram *prog = rho_parse_source(filename, src, &arena, &times, error_msg);
+	RHO_FREE(src);
+	int error = RHO_LOAD_ERR_SYNTAX;
+
+	if (prog != NULL) {
+		error = rho_compile_program(filename, prog, &arena, flags, &times, out_filename);
+	}
+
+	rho_arena_dealloc(&arena);
+
+	if (error == RHO_LOAD_ERR_NONE) {
+		error = rho_load_from_file(out_filename, true, dest);
+	}
+
+	free(out_filename);
+	return error;
+}
+
+int rho_load_module(const char *name, RhoCode *dest, const char **error_msg)
+{
+	/* sources take precedence over whatever was compiled from them */
+	char *source_name = rho_malloc(strlen(name) + strlen(RHO_EXT) + 1);
+	strcpy(source_name, name);
+	strcat(source_name, RHO_EXT);
+	int error = rho_load_from_source(source_name, 0, dest, error_msg);
+	free(source_name);
+
+	if (error == RHO_LOAD_ERR_NOT_FOUND) {
+		error = rho_load_from_file(name, false, dest);
+	}
+
+	return error;
 }
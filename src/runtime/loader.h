@@ -1,17 +1,87 @@
 #ifndef RHO_LOADER_H
 #define RHO_LOADER_H
 
+#include <stdbool.h>
 #include "code.h"
+#include "ast.h"
+#include "arena.h"
+#include "compiler.h"
 
 #define RHO_EXT  ".rho"
 #define RHOC_EXT ".rhoc"
+#define RHOI_EXT ".rhoi"
 
 enum {
 	RHO_LOAD_ERR_NONE,
 	RHO_LOAD_ERR_NOT_FOUND,
-	RHO_LOAD_ERR_INVALID_SIGNATURE
+	RHO_LOAD_ERR_INVALID_SIGNATURE,
+	RHO_LOAD_ERR_VERSION,  // compiled for another version of the rhoc format
+	RHO_LOAD_ERR_SYNTAX,   // source could not be parsed (see `error_msg` below)
+	RHO_LOAD_ERR_WRITE     // compiled code could not be written
 };
 
+/* whether to report how long each phase of compiling takes (see loader.c) */
+extern bool rho_compile_time_enabled;
+
+/* overrides the bytecode cache directory (see loader.c) */
+#define RHO_CACHE_DIR_ENV "RHO_CACHE_DIR"
+
+/*
+ * On success, `dest` holds the code following the magic bytes, which
+ * stays valid until it is passed to `rho_load_release`.
+ */
 int rho_load_from_file(const char *name, const bool name_has_ext, RhoCode *dest);
+void rho_load_release(RhoCode *code);
+
+/*
+ * Loads the module imported as `name`: its source `<name>.rho` if
+ * there is one (see above), otherwise `<name>.rhoc`.
+ */
+int rho_load_module(const char *name, RhoCode *dest, const char **error_msg);
+
+/* like `rho_load_from_file`, for a heap image (see snapshot.h) */
+int rho_load_image(const char *filename, RhoCode *dest);
+
+/*
+ * Like `rho_load_from_file`, but for the source file `filename`,
+ * which is compiled with the given flags unless the bytecode cache
+ * already holds it. On `RHO_LOAD_ERR_SYNTAX`, `*error_msg` is set to
+ * a description of the error, which the caller must free.
+ */
+int rho_load_from_source(const char *filename,
+                         const unsigned int flags,
+                         RhoCode *dest,
+                         const char **error_msg);
+
+/* compiles the source file `filename` into `out_filename` */
+int rho_compile_to_file(const char *filename,
+                        const unsigned int flags,
+                        const char *out_filename,
+                        const char **error_msg);
+
+/*
+ * Lower-level steps of the above. `rho_parse_source` returns NULL
+ * and sets `*error_msg` on a syntax error; the program is allocated
+ * in `arena`, which the caller frees once it has been compiled (even
+ * if there was an error). Both record how long their phases take in
+ * `times` if `rho_compile_time_enabled` is set, the latter reporting
+ * them once the program is compiled. `rho_cache_filename`
+ * returns the (freshly allocated) name of the file that the source
+ * text `src` of `filename` is compiled to, which is up to date if
+ * `rho_is_compiled` holds for it.
+ */
+RhoProgram *rho_parse_source(const char *filename,
+                             char *src,
+                             RhoArena *arena,
+                             struct rho_compile_times *times,
+                             const char **error_msg);
+int rho_compile_program(const char *filename,
+                        RhoProgram *prog,
+                        RhoArena *arena,
+                        const unsigned int flags,
+                        struct rho_compile_times *times,
+                        const char *out_filename);
+char *rho_cache_filename(const char *filename, const char *src, const unsigned int flags);
+bool rho_is_compiled(const char *filename);
 
 #endif /* RHO_LOADER_H */
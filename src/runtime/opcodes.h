@@ -88,9 +88,47 @@ typedef enum {
 	RHO_INS_DUP,
 	RHO_INS_DUP_TWO,
 	RHO_INS_ROT,
-	RHO_INS_ROT_THREE
+	RHO_INS_ROT_THREE,
+
+	/* superinstructions, emitted by the peephole optimizer */
+	RHO_INS_LOAD_LOAD,
+	RHO_INS_LOAD_ADD_CONST,
+	RHO_INS_LOAD_ATTR_LOCAL,
+	RHO_INS_INC_LOCAL_BY_CONST,
+	RHO_INS_COMPARE_AND_BRANCH,
+	RHO_INS_FOR_ITER_STORE,
+
+	/* register instructions, emitted in register mode (see compiler.c) */
+	RHO_INS_REG_MOVE,
+	RHO_INS_REG_BINOP,
+	RHO_INS_REG_CMP_BRANCH,
+
+	/* loop-invariant loads, emitted ahead of loops (see compiler.c) */
+	RHO_INS_HOIST_GLOBAL,
+	RHO_INS_HOIST_NAME,
+
+	/* typed arithmetic on hinted parameters (see compiler.c) */
+	RHO_INS_INT_BINOP,
+	RHO_INS_FLOAT_BINOP,
+
+	/* `for` loops over range literals (see compiler.c) */
+	RHO_INS_RANGE_INIT,
+	RHO_INS_FOR_RANGE,
+
+	/* high 16 bits of the next instruction's argument (see compiler.c) */
+	RHO_INS_EXTENDED_ARG
 } RhoOpcode;
 
+/*
+ * Register instruction operands are uint16 values. The low
+ * bits index either the frame's locals or, if RHO_REG_CONST
+ * is set, its constants. RHO_REG_TEMP marks a temporary slot
+ * whose value is consumed (released and cleared) when read.
+ */
+#define RHO_REG_CONST      0x8000
+#define RHO_REG_TEMP       0x4000
+#define RHO_REG_INDEX_MASK 0x3fff
+
 typedef enum {
 	RHO_ST_ENTRY_BEGIN = 0x10,
 	RHO_ST_ENTRY_END
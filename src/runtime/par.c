@@ -0,0 +1,303 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "object.h"
+#include "exc.h"
+#include "err.h"
+#include "vmops.h"
+#include "listobject.h"
+#include "tupleobject.h"
+#include "setobject.h"
+#include "dictobject.h"
+#include "iter.h"
+#include "generator.h"
+#include "funcobject.h"
+#include "method.h"
+#include "actor.h"
+#include "vm.h"
+#include "util.h"
+#include "par.h"
+
+/*
+ * Parallel apply
+ *
+ * The elements of the input sequence are split into one
+ * contiguous chunk per thread. The calling thread handles
+ * the first chunk itself, while each of the others is run
+ * on a new thread with its own VM (functions still see the
+ * globals of their defining module, since those belong to
+ * the code object's VM, not the calling VM).
+ *
+ * Lists, dicts, sets and so on are confined to the thread
+ * that created them, so a function that refers to one of
+ * these cannot be run in parallel unless it's `safe()`'d.
+ * Default arguments and bound method receivers are checked
+ * before any work begins; other accesses (e.g. through
+ * globals) are detected by the usual concurrent access
+ * check, and reported as a failure of the whole call.
+ *
+ * Containers created by the workers are handed over to the
+ * calling thread once all workers have finished.
+ */
+
+#define CONFINED_MAX_DEPTH 100
+
+struct par_chunk {
+	RhoValue *fn;
+	RhoValue *args;
+	RhoValue *results;
+	size_t count;
+	size_t n_done;
+	RhoValue status;  /* empty, or the error that stopped this chunk */
+
+	pthread_t thread;
+	bool spawned;
+};
+
+static bool is_confined(RhoValue *v, unsigned int depth)
+{
+	if (!rho_isobject(v) || depth > CONFINED_MAX_DEPTH) {
+		return false;
+	}
+
+	RhoObject *o = rho_objvalue(v);
+	RhoClass *class = o->class;
+
+	if (o->monitor != 0) {
+		return false;
+	}
+
+	if (class == &rho_list_class ||
+	    class == &rho_dict_class ||
+	    class == &rho_set_class ||
+	    class == &rho_range_class ||
+	    class == &rho_gen_class) {
+		return true;
+	}
+
+	if (class == &rho_tuple_class) {
+		RhoTupleObject *tup = (RhoTupleObject *)o;
+		for (size_t i = 0; i < tup->count; i++) {
+			if (is_confined(&tup->elements[i], depth + 1)) {
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+static RhoValue confined_exc(RhoValue *v)
+{
+	return RHO_CONC_ACCS_EXC("par(): function refers to a thread-confined %s (use safe() to share it)",
+	                         rho_getclass(v)->name);
+}
+
+static RhoValue check_fn(RhoValue *fn)
+{
+	RhoClass *class = rho_getclass(fn);
+
+	if (!rho_resolve_call(class)) {
+		return rho_type_exc_not_callable(class);
+	}
+
+	if (class == &rho_method_class) {
+		RhoMethod *meth = rho_objvalue(fn);
+
+		if (is_confined(&meth->binder, 0)) {
+			return confined_exc(&meth->binder);
+		}
+	} else if (class == &rho_fn_class) {
+		RhoFuncObject *fo = rho_objvalue(fn);
+		struct rho_value_array *defaults = &fo->defaults;
+
+		for (size_t i = 0; i < defaults->length; i++) {
+			if (is_confined(&defaults->array[i], 0)) {
+				return confined_exc(&defaults->array[i]);
+			}
+		}
+	}
+
+	return rho_makenull();
+}
+
+/*
+ * Reads the elements of `seq` into a new array of new
+ * references, storing its length in `count`.
+ */
+static RhoValue load_elements(RhoValue *seq, RhoValue **elements, size_t *count)
+{
+	RhoClass *class = rho_getclass(seq);
+
+	if (class == &rho_list_class) {
+		RhoListObject *list = rho_objvalue(seq);
+		RHO_ENTER(list);
+		*count = list->count;
+		*elements = rho_malloc(list->count * sizeof(RhoValue));
+		for (size_t i = 0; i < list->count; i++) {
+			(*elements)[i] = list->elements[i];
+			rho_retain(&list->elements[i]);
+		}
+		RHO_EXIT(list);
+	} else if (class == &rho_range_class) {
+		RhoRange *range = rho_objvalue(seq);
+		RHO_ENTER(range);
+		const long from = range->i;
+		const long to = range->to;
+		RHO_EXIT(range);
+
+		*count = (to > from) ? (size_t)(to - from) : 0;
+		*elements = rho_malloc(*count * sizeof(RhoValue));
+		for (size_t i = 0; i < *count; i++) {
+			(*elements)[i] = rho_makeint(from + (long)i);
+		}
+	} else {
+		return RHO_TYPE_EXC("par() takes a list or range (got a %s)", class->name);
+	}
+
+	return rho_makenull();
+}
+
+static void release_all(RhoValue *values, const size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		rho_release(&values[i]);
+	}
+}
+
+static void discard_error(RhoValue *err)
+{
+	if (rho_isexc(err)) {
+		rho_release(err);
+	} else if (rho_iserror(err)) {
+		rho_err_free(rho_errvalue(err));
+	}
+}
+
+static void chunk_run(struct par_chunk *chunk)
+{
+	RhoValue *fn = chunk->fn;
+	RhoValue *args = chunk->args;
+	RhoValue *results = chunk->results;
+	const size_t count = chunk->count;
+
+	for (size_t i = 0; i < count; i++) {
+		RhoValue r = rho_op_call(fn, &args[i], NULL, 1, 0);
+
+		if (rho_iserror(&r)) {
+			chunk->status = r;
+			return;
+		}
+
+		results[i] = r;
+		++chunk->n_done;
+	}
+}
+
+static void *chunk_start_routine(void *args)
+{
+	struct par_chunk *chunk = args;
+	RhoVM *vm = rho_vm_new();
+	rho_current_vm_set(vm);
+	chunk_run(chunk);
+	rho_vm_free(vm);
+	return NULL;
+}
+
+RhoValue rho_par_apply(RhoValue *fn, RhoValue *seq, size_t n_threads)
+{
+	RhoValue status = check_fn(fn);
+
+	if (rho_iserror(&status)) {
+		return status;
+	}
+
+	RhoValue *args = NULL;
+	size_t count = 0;
+	status = load_elements(seq, &args, &count);
+
+	if (rho_iserror(&status)) {
+		return status;
+	}
+
+	if (n_threads == 0) {
+		const long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		n_threads = (n_cpus > 0) ? (size_t)n_cpus : 1;
+	}
+
+	if (n_threads > count) {
+		n_threads = (count > 0) ? count : 1;
+	}
+
+	RhoValue *results = rho_malloc(count * sizeof(RhoValue));
+	struct par_chunk *chunks = rho_malloc(n_threads * sizeof(struct par_chunk));
+
+	for (size_t i = 0; i < n_threads; i++) {
+		const size_t start = (i * count) / n_threads;
+		const size_t end = ((i + 1) * count) / n_threads;
+		chunks[i] = (struct par_chunk){.fn = fn,
+		                               .args = &args[start],
+		                               .results = &results[start],
+		                               .count = end - start,
+		                               .n_done = 0,
+		                               .status = rho_makeempty(),
+		                               .spawned = false};
+	}
+
+	for (size_t i = 1; i < n_threads; i++) {
+		chunks[i].spawned = (pthread_create(&chunks[i].thread, NULL, chunk_start_routine, &chunks[i]) == 0);
+	}
+
+	/* the calling thread does the first chunk, plus any that couldn't be spawned */
+	for (size_t i = 0; i < n_threads; i++) {
+		if (!chunks[i].spawned) {
+			chunk_run(&chunks[i]);
+		}
+	}
+
+	RhoValue ret = rho_makeempty();
+
+	for (size_t i = 0; i < n_threads; i++) {
+		struct par_chunk *chunk = &chunks[i];
+
+		if (chunk->spawned) {
+			RHO_SAFE(pthread_join(chunk->thread, NULL));
+		}
+
+		/* report the error from the earliest chunk */
+		if (rho_iserror(&chunk->status)) {
+			if (rho_isempty(&ret)) {
+				ret = chunk->status;
+			} else {
+				discard_error(&chunk->status);
+			}
+		}
+	}
+
+	if (rho_isempty(&ret)) {
+		for (size_t i = 0; i < count; i++) {
+			rho_actor_claim(&results[i]);
+		}
+
+		ret = rho_list_make(results, count);
+	} else {
+		for (size_t i = 0; i < n_threads; i++) {
+			release_all(chunks[i].results, chunks[i].n_done);
+		}
+
+		if (rho_isexc(&ret) && rho_getclass(&ret) == &rho_conc_access_exception_class) {
+			rho_release(&ret);
+			ret = RHO_CONC_ACCS_EXC("par(): function accessed an object owned by another thread "
+			                        "(use safe() to share it)");
+		}
+	}
+
+	release_all(args, count);
+	free(args);
+	free(results);
+	free(chunks);
+	return ret;
+}
+
+#undef CONFINED_MAX_DEPTH
@@ -0,0 +1,272 @@
+#include "main.h"
+#if RHO_IS_POSIX
+#define _POSIX_C_SOURCE 200809L  /* for sysconf */
+#endif
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+#include "code.h"
+#include "compiler.h"
+#include "opcodes.h"
+#include "codeobject.h"
+#include "vm.h"
+#include "loader.h"
+#include "err.h"
+#include "util.h"
+#include "prefetch.h"
+
+#if RHO_IS_POSIX
+#include <unistd.h>
+#endif
+
+/*
+ * Import prefetching
+ *
+ * Once a module's top-level code object is made, the modules it
+ * imports (found by scanning its bytecode for IMPORT instructions)
+ * are queued up, and a pool of threads loads each of them, compiling
+ * it if need be, and makes its top-level code object, all while the
+ * importer keeps running. Imports then only have to run the module;
+ * one that comes before its module was picked up from the queue
+ * does the work itself rather than wait.
+ *
+ * Prefetched modules are scanned in turn, so that whole import
+ * graphs are loaded in parallel. Nothing here runs Rho code, so
+ * the order in which modules are run is unchanged.
+ */
+
+bool rho_prefetch_enabled = false;
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+
+/* every module prefetched so far, and those not yet started */
+static struct rho_prefetch *prefetches = NULL;
+static struct rho_prefetch *queue_head = NULL;
+static struct rho_prefetch *queue_tail = NULL;
+
+static pthread_t *threads = NULL;
+static size_t n_threads = 0;
+static bool stopping = false;
+
+static void prefetch_run(struct rho_prefetch *pf);
+
+/* `mutex` must be held */
+static struct rho_prefetch *find(const char *name)
+{
+	for (struct rho_prefetch *pf = prefetches; pf != NULL; pf = pf->next) {
+		if (strcmp(pf->name, name) == 0) {
+			return pf;
+		}
+	}
+
+	return NULL;
+}
+
+static void *prefetch_start_routine(void *args)
+{
+	RHO_UNUSED(args);
+	pthread_mutex_lock(&mutex);
+
+	while (true) {
+		while (queue_head == NULL && !stopping) {
+			pthread_cond_wait(&cond, &mutex);
+		}
+
+		if (stopping) {
+			break;
+		}
+
+		struct rho_prefetch *pf = queue_head;
+		queue_head = pf->next_queued;
+
+		if (queue_head == NULL) {
+			queue_tail = NULL;
+		}
+
+		pf->started = true;
+		pthread_mutex_unlock(&mutex);
+
+		prefetch_run(pf);
+
+		pthread_mutex_lock(&mutex);
+		pf->done = true;
+		pthread_cond_broadcast(&cond);
+	}
+
+	pthread_mutex_unlock(&mutex);
+	return NULL;
+}
+
+static void prefetch_shutdown(void)
+{
+	pthread_mutex_lock(&mutex);
+	stopping = true;
+	pthread_cond_broadcast(&cond);
+	pthread_mutex_unlock(&mutex);
+
+	for (size_t i = 0; i < n_threads; i++) {
+		RHO_SAFE(pthread_join(threads[i], NULL));
+	}
+
+	free(threads);
+
+	for (struct rho_prefetch *pf = prefetches; pf != NULL;) {
+		struct rho_prefetch *next = pf->next;
+
+		if (!pf->taken) {
+			if (pf->co != NULL) {
+				rho_releaseo(pf->co);
+			}
+
+			rho_vm_free(pf->vm);
+			RHO_FREE(pf->error_msg);
+		}
+
+		free(pf->name);
+		free(pf);
+		pf = next;
+	}
+}
+
+/* `mutex` must be held */
+static void start_threads(void)
+{
+#if RHO_IS_POSIX
+	const long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	const size_t n = (n_cpus > 0) ? (size_t)n_cpus : 1;
+#else
+	const size_t n = 1;
+#endif
+
+	threads = rho_malloc(n * sizeof(pthread_t));
+
+	for (size_t i = 0; i < n; i++) {
+		if (pthread_create(&threads[n_threads], NULL, prefetch_start_routine, NULL) == 0) {
+			++n_threads;
+		}
+	}
+
+	atexit(prefetch_shutdown);
+}
+
+/* `mutex` must be held */
+static void enqueue(const char *name)
+{
+	if (find(name) != NULL) {
+		return;
+	}
+
+	if (threads == NULL) {
+		start_threads();
+	}
+
+	struct rho_prefetch *pf = rho_calloc(1, sizeof(struct rho_prefetch));
+	pf->name = rho_malloc(strlen(name) + 1);
+	strcpy(pf->name, name);
+	pf->next = prefetches;
+	prefetches = pf;
+
+	if (queue_tail != NULL) {
+		queue_tail->next_queued = pf;
+	} else {
+		queue_head = pf;
+	}
+
+	queue_tail = pf;
+	pthread_cond_signal(&cond);
+}
+
+void rho_prefetch_imports(RhoCodeObject *co)
+{
+	const byte *bc = co->bc;
+	const size_t size = co->bc_size;
+	unsigned int ext = 0;
+
+	pthread_mutex_lock(&mutex);
+
+	for (size_t pos = 0; pos < size;) {
+		const RhoOpcode opcode = bc[pos];
+		const int arg_size = rho_opcode_arg_size(opcode);
+
+		if (arg_size < 0) {
+			RHO_INTERNAL_ERROR();
+		}
+
+		if (opcode == RHO_INS_EXTENDED_ARG) {
+			ext = rho_util_read_uint16_from_stream((byte *)&bc[pos + 1]) << 16;
+		} else {
+			if (opcode == RHO_INS_IMPORT) {
+				const unsigned int id = ext | rho_util_read_uint16_from_stream((byte *)&bc[pos + 1]);
+				enqueue(co->names.array[id].str);
+			}
+
+			ext = 0;
+		}
+
+		pos += arg_size + 1;
+	}
+
+	pthread_mutex_unlock(&mutex);
+}
+
+static void prefetch_run(struct rho_prefetch *pf)
+{
+	const double start = rho_util_time();
+	pf->error = rho_load_module(pf->name, &pf->code, &pf->error_msg);
+	const double loaded = rho_util_time();
+	pf->load_time = loaded - start;
+
+	if (pf->error != RHO_LOAD_ERR_NONE) {
+		return;
+	}
+
+	RhoCode code = pf->code;
+	pf->vm = rho_vm_new();
+	pf->co = rho_codeobj_make_toplevel(&code, "<module>", pf->vm);
+	rho_prefetch_imports(pf->co);
+	pf->build_time = rho_util_time() - loaded;
+}
+
+struct rho_prefetch *rho_prefetch_take(const char *name)
+{
+	pthread_mutex_lock(&mutex);
+	struct rho_prefetch *pf = find(name);
+
+	if (pf == NULL || pf->taken) {
+		pthread_mutex_unlock(&mutex);
+		return NULL;
+	}
+
+	pf->taken = true;
+
+	if (!pf->started) {
+		/* not picked up yet, so do it here rather than wait */
+		struct rho_prefetch **link = &queue_head;
+		queue_tail = NULL;
+
+		while (*link != NULL) {
+			if (*link == pf) {
+				*link = pf->next_queued;
+			} else {
+				queue_tail = *link;
+				link = &(*link)->next_queued;
+			}
+		}
+
+		pf->started = true;
+		pthread_mutex_unlock(&mutex);
+		prefetch_run(pf);
+		pthread_mutex_lock(&mutex);
+		pf->done = true;
+	}
+
+	while (!pf->done) {
+		pthread_cond_wait(&cond, &mutex);
+	}
+
+	pthread_mutex_unlock(&mutex);
+	return pf;
+}
@@ -0,0 +1,48 @@
+#ifndef RHO_PREFETCH_H
+#define RHO_PREFETCH_H
+
+#include <stdbool.h>
+#include "code.h"
+#include "codeobject.h"
+#include "vm.h"
+
+extern bool rho_prefetch_enabled;
+
+/* a module loaded ahead of its import (see prefetch.c) */
+struct rho_prefetch {
+	char *name;
+
+	/* result of `rho_load_module` */
+	int error;
+	const char *error_msg;
+	RhoCode code;
+
+	/* VM and top-level code object to run the module with */
+	RhoVM *vm;
+	RhoCodeObject *co;
+
+	/* seconds spent loading and building the above */
+	double load_time;
+	double build_time;
+
+	bool started;
+	bool done;
+	bool taken;
+	struct rho_prefetch *next_queued;
+	struct rho_prefetch *next;
+};
+
+/*
+ * Starts loading the modules imported at the top level of the
+ * module code `co` in the background, along with theirs in turn.
+ */
+void rho_prefetch_imports(RhoCodeObject *co);
+
+/*
+ * Returns the prefetched module `name`, once it's ready, or NULL if
+ * it wasn't prefetched. The caller takes over the VM, code object
+ * and error message; the rest stays owned by the prefetcher.
+ */
+struct rho_prefetch *rho_prefetch_take(const char *name);
+
+#endif /* RHO_PREFETCH_H */
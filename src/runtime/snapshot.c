@@ -0,0 +1,829 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "code.h"
+#include "compiler.h"
+#include "object.h"
+#include "strobject.h"
+#include "listobject.h"
+#include "tupleobject.h"
+#include "dictobject.h"
+#include "setobject.h"
+#include "codeobject.h"
+#include "funcobject.h"
+#include "generator.h"
+#include "actor.h"
+#include "module.h"
+#include "metaclass.h"
+#include "nativefunc.h"
+#include "builtins.h"
+#include "vm.h"
+#include "err.h"
+#include "util.h"
+#include "snapshot.h"
+
+/*
+ * Heap images
+ *
+ * An image holds a module's code along with the values its global
+ * variables had once its top level finished running, so that a later
+ * run can skip the initialization altogether:
+ *
+ *   +-----------------+
+ *   | magic           |
+ *   +-----------------+
+ *   | code size       |  (uint32)
+ *   +-----------------+
+ *   | module code     |  (the rhoc payload, as compiled)
+ *   +-----------------+
+ *   | global count    |  (uint32)
+ *   +-----------------+
+ *   | globals         |  (one value each, in symbol table order)
+ *   +-----------------+
+ *
+ * Objects are reference counted and so can't live in a read-only
+ * mapping; the image is instead a compact, pointer-free encoding of
+ * the object graph that restoring rebuilds in a single pass. Each
+ * value is a tag byte followed by its contents:
+ *
+ *   - Ints are two uint32 halves (low first), floats are doubles,
+ *     and strings are a uint32 length followed by their bytes and
+ *     a null byte; restored strings point into the image.
+ *   - Lists, tuples, dicts and sets are a uint32 count followed by
+ *     their elements (key, then value, for dicts).
+ *   - Code objects are the offset of their constant table entry in
+ *     the module code, followed by a byte telling whether type hints
+ *     (argument count + 1 classes or nulls) follow. Functions are
+ *     their code object followed by a uint32 count of defaults and
+ *     the defaults themselves, and likewise for generator and actor
+ *     definitions.
+ *   - Modules are their name, and are imported again on restore;
+ *     built-in functions and classes are their name (which is how
+ *     built-ins referred to by the module end up among its globals).
+ *
+ * Objects are numbered in the order they are first written (before
+ * their contents), and written as a `SNAP_REF` to that number when
+ * seen again, which preserves sharing and cycles; only a tuple can't
+ * contain itself, as it's made once its elements are.
+ */
+
+const byte rho_image_magic[] = {0xFE, 0xED, 0xF1, RHO_RHOC_VERSION};
+
+enum {
+	SNAP_EMPTY,
+	SNAP_NULL,
+	SNAP_FALSE,
+	SNAP_TRUE,
+	SNAP_INT,
+	SNAP_FLOAT,
+	SNAP_STR,
+	SNAP_LIST,
+	SNAP_TUPLE,
+	SNAP_DICT,
+	SNAP_SET,
+	SNAP_CODE,
+	SNAP_FUNC,
+	SNAP_GEN_FUNC,
+	SNAP_ACTOR_FUNC,
+	SNAP_MODULE,
+	SNAP_BUILTIN,
+	SNAP_REF
+};
+
+struct memo_entry {
+	const void *obj;
+	size_t index;
+	bool open;  // tuple still being written
+};
+
+struct writer {
+	RhoVM *vm;
+	RhoCode out;
+
+	/* objects written so far, hashed by address */
+	struct memo_entry *memo;
+	size_t memo_count;
+	size_t memo_capacity;
+
+	/* global variable being written, for errors */
+	const char *global;
+	RhoError *error;
+};
+
+static struct memo_entry *memo_find(struct writer *w, const void *obj)
+{
+	const size_t mask = w->memo_capacity - 1;
+	size_t i = rho_util_hash_ptr(obj) & mask;
+
+	while (w->memo[i].obj != NULL && w->memo[i].obj != obj) {
+		i = (i + 1) & mask;
+	}
+
+	return &w->memo[i];
+}
+
+static void memo_add(struct writer *w, const void *obj)
+{
+	if (2 * (w->memo_count + 1) > w->memo_capacity) {
+		struct memo_entry *old = w->memo;
+		const size_t old_capacity = w->memo_capacity;
+
+		w->memo_capacity = 2 * old_capacity;
+		w->memo = rho_calloc(w->memo_capacity, sizeof(struct memo_entry));
+
+		for (size_t i = 0; i < old_capacity; i++) {
+			if (old[i].obj != NULL) {
+				*memo_find(w, old[i].obj) = old[i];
+			}
+		}
+
+		free(old);
+	}
+
+	struct memo_entry *entry = memo_find(w, obj);
+	entry->obj = obj;
+	entry->index = w->memo_count++;
+	entry->open = false;
+}
+
+static bool fail(struct writer *w, const char *reason)
+{
+	w->error = rho_err_snapshot_error(w->global, reason);
+	return false;
+}
+
+static bool fail_type(struct writer *w, const RhoClass *class)
+{
+	char reason[256];
+	snprintf(reason, sizeof(reason), "values of type '%s' can't be saved", class->name);
+	return fail(w, reason);
+}
+
+/* NULL unless `obj` is a built-in function or class */
+static const char *builtin_name(const void *obj)
+{
+	for (size_t i = 0; rho_builtins[i].name != NULL; i++) {
+		if (rho_objvalue(&rho_builtins[i].value) == obj) {
+			return rho_builtins[i].name;
+		}
+	}
+
+	const RhoObject *o = obj;
+
+	if (o->class == &rho_meta_class) {
+		const char *name = ((const RhoClass *)obj)->name;
+		RhoValue builtin = rho_vm_get_builtin(name);
+
+		if (rho_isobject(&builtin) && rho_objvalue(&builtin) == obj) {
+			return name;
+		}
+	}
+
+	return NULL;
+}
+
+static void write_long(RhoCode *out, const long l)
+{
+	const uint64_t u = (uint64_t)l;
+	rho_code_write_uint32(out, u & 0xFFFFFFFF);
+	rho_code_write_uint32(out, u >> 32);
+}
+
+static bool write_value(struct writer *w, RhoValue *v);
+
+static bool write_values(struct writer *w, RhoValue *values, const size_t count)
+{
+	rho_code_write_uint32(&w->out, count);
+
+	for (size_t i = 0; i < count; i++) {
+		if (!write_value(w, &values[i])) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool write_code(struct writer *w, RhoCodeObject *co)
+{
+	const RhoCode *head = &w->vm->head;
+
+	if (co->vm != w->vm || co->entry == NULL ||
+	    co->entry < head->bc || co->entry >= head->bc + head->size) {
+		char reason[256];
+		snprintf(reason, sizeof(reason), "function '%s' is not defined by this module", co->name);
+		return fail(w, reason);
+	}
+
+	rho_code_write_byte(&w->out, SNAP_CODE);
+	rho_code_write_uint32(&w->out, co->entry - head->bc);
+
+	const size_t n_hints = RHO_CODEOBJ_NUM_HINTS(co);
+	rho_code_write_byte(&w->out, n_hints > 0);
+
+	for (size_t i = 0; i < n_hints; i++) {
+		RhoValue hint = (co->hints[i] != NULL) ? rho_makeobj(co->hints[i]) : rho_makenull();
+
+		if (!write_value(w, &hint)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool write_func(struct writer *w,
+                       const byte tag,
+                       RhoCodeObject *co,
+                       const struct rho_value_array *defaults)
+{
+	RhoValue co_v = rho_makeobj(co);
+	rho_code_write_byte(&w->out, tag);
+	return write_value(w, &co_v) && write_values(w, defaults->array, defaults->length);
+}
+
+static bool write_object(struct writer *w, RhoValue *v)
+{
+	const void *obj = rho_objvalue(v);
+	struct memo_entry *seen = memo_find(w, obj);
+
+	if (seen->obj != NULL) {
+		if (seen->open) {
+			return fail(w, "it holds a tuple that contains itself");
+		}
+
+		rho_code_write_byte(&w->out, SNAP_REF);
+		rho_code_write_uint32(&w->out, seen->index);
+		return true;
+	}
+
+	RhoClass *class = rho_getclass(v);
+	memo_add(w, obj);
+
+	if (class == &rho_str_class) {
+		const RhoStrObject *str = obj;
+		rho_code_write_byte(&w->out, SNAP_STR);
+		rho_code_write_uint32(&w->out, str->str.len);
+		rho_code_write_str(&w->out, &str->str);
+		return true;
+	}
+
+	if (class == &rho_list_class) {
+		const RhoListObject *list = obj;
+		rho_code_write_byte(&w->out, SNAP_LIST);
+		return write_values(w, list->elements, list->count);
+	}
+
+	if (class == &rho_tuple_class) {
+		RhoTupleObject *tup = (RhoTupleObject *)obj;
+		rho_code_write_byte(&w->out, SNAP_TUPLE);
+		memo_find(w, obj)->open = true;
+
+		if (!write_values(w, tup->elements, tup->count)) {
+			return false;
+		}
+
+		memo_find(w, obj)->open = false;
+		return true;
+	}
+
+	if (class == &rho_dict_class) {
+		const RhoDictObject *dict = obj;
+		rho_code_write_byte(&w->out, SNAP_DICT);
+		rho_code_write_uint32(&w->out, dict->count);
+
+		for (size_t i = 0; i < dict->capacity; i++) {
+			for (struct rho_dict_entry *e = dict->entries[i]; e != NULL; e = e->next) {
+				if (!write_value(w, &e->key) || !write_value(w, &e->value)) {
+					return false;
+				}
+			}
+		}
+
+		return true;
+	}
+
+	if (class == &rho_set_class) {
+		const RhoSetObject *set = obj;
+		rho_code_write_byte(&w->out, SNAP_SET);
+		rho_code_write_uint32(&w->out, set->count);
+
+		for (size_t i = 0; i < set->capacity; i++) {
+			for (struct rho_set_entry *e = set->entries[i]; e != NULL; e = e->next) {
+				if (!write_value(w, &e->element)) {
+					return false;
+				}
+			}
+		}
+
+		return true;
+	}
+
+	if (class == &rho_co_class) {
+		return write_code(w, (RhoCodeObject *)obj);
+	}
+
+	if (class == &rho_fn_class) {
+		const RhoFuncObject *fn = obj;
+		return write_func(w, SNAP_FUNC, fn->co, &fn->defaults);
+	}
+
+	if (class == &rho_gen_proxy_class) {
+		const RhoGeneratorProxy *gp = obj;
+		return write_func(w, SNAP_GEN_FUNC, gp->co, &gp->defaults);
+	}
+
+	if (class == &rho_actor_proxy_class) {
+		const RhoActorProxy *ap = obj;
+		return write_func(w, SNAP_ACTOR_FUNC, ap->co, &ap->defaults);
+	}
+
+	if (class == &rho_module_class || class == &rho_builtin_module_class) {
+		const RhoModule *module = obj;
+		const RhoStr name = RHO_STR_INIT(module->name, strlen(module->name), 0);
+		rho_code_write_byte(&w->out, SNAP_MODULE);
+		rho_code_write_str(&w->out, &name);
+		return true;
+	}
+
+	if (class == &rho_meta_class || class == &rho_native_func_class) {
+		const char *name = builtin_name(obj);
+
+		if (name == NULL) {
+			return fail_type(w, class);
+		}
+
+		const RhoStr name_str = RHO_STR_INIT(name, strlen(name), 0);
+		rho_code_write_byte(&w->out, SNAP_BUILTIN);
+		rho_code_write_str(&w->out, &name_str);
+		return true;
+	}
+
+	return fail_type(w, class);
+}
+
+static bool write_value(struct writer *w, RhoValue *v)
+{
+	switch (v->type) {
+	case RHO_VAL_TYPE_EMPTY:
+		rho_code_write_byte(&w->out, SNAP_EMPTY);
+		return true;
+	case RHO_VAL_TYPE_NULL:
+		rho_code_write_byte(&w->out, SNAP_NULL);
+		return true;
+	case RHO_VAL_TYPE_BOOL:
+		rho_code_write_byte(&w->out, rho_boolvalue(v) ? SNAP_TRUE : SNAP_FALSE);
+		return true;
+	case RHO_VAL_TYPE_INT:
+		rho_code_write_byte(&w->out, SNAP_INT);
+		write_long(&w->out, rho_intvalue(v));
+		return true;
+	case RHO_VAL_TYPE_FLOAT:
+		rho_code_write_byte(&w->out, SNAP_FLOAT);
+		rho_code_write_double(&w->out, rho_floatvalue(v));
+		return true;
+	case RHO_VAL_TYPE_OBJECT:
+		return write_object(w, v);
+	default:
+		RHO_INTERNAL_ERROR();
+		return false;
+	}
+}
+
+RhoValue rho_snapshot_write(RhoVM *vm, FILE *out)
+{
+	struct writer w = {.vm = vm,
+	                   .memo = rho_calloc(64, sizeof(struct memo_entry)),
+	                   .memo_count = 0,
+	                   .memo_capacity = 64,
+	                   .global = NULL,
+	                   .error = NULL};
+
+	rho_code_init(&w.out, 4096);
+	rho_code_write_uint32(&w.out, vm->head.size);
+	rho_code_append(&w.out, &vm->head);
+
+	const size_t n_globals = vm->globals.length;
+	rho_code_write_uint32(&w.out, n_globals);
+
+	for (size_t i = 0; i < n_globals; i++) {
+		w.global = vm->global_names.array[i].str;
+
+		if (!write_value(&w, &vm->globals.array[i])) {
+			break;
+		}
+	}
+
+	if (w.error == NULL) {
+		fwrite(rho_image_magic, 1, rho_magic_size, out);
+		fwrite(w.out.bc, 1, w.out.size, out);
+	}
+
+	free(w.memo);
+	rho_code_dealloc(&w.out);
+	return (w.error != NULL) ? rho_makeerr(w.error) : rho_makeempty();
+}
+
+void rho_snapshot_code(const RhoCode *image, RhoCode *code)
+{
+	RhoCode in = *image;
+	const size_t code_size = rho_code_read_uint32(&in);
+	code->bc = in.bc;
+	code->size = code_size;
+	code->capacity = 0;
+}
+
+struct reader {
+	RhoVM *vm;
+	RhoCode in;
+
+	/* start of the module code, which code objects are read out of */
+	const byte *code;
+
+	/* objects restored so far, by number (borrowed references) */
+	RhoValue *objs;
+	size_t n_objs;
+	size_t objs_capacity;
+};
+
+static size_t reserve(struct reader *r)
+{
+	if (r->n_objs == r->objs_capacity) {
+		r->objs_capacity = (r->objs_capacity * 3)/2 + 64;
+		r->objs = rho_realloc(r->objs, r->objs_capacity * sizeof(RhoValue));
+	}
+
+	r->objs[r->n_objs] = rho_makeempty();
+	return r->n_objs++;
+}
+
+static long read_long(RhoCode *in)
+{
+	const uint64_t lo = rho_code_read_uint32(in);
+	const uint64_t hi = rho_code_read_uint32(in);
+	return (long)((hi << 32) | lo);
+}
+
+/* returns a new reference */
+static RhoValue read_value(struct reader *r);
+
+static RhoValue read_list(struct reader *r)
+{
+	const size_t idx = reserve(r);
+	RhoValue list_v = rho_list_make(NULL, 0);
+	RhoListObject *list = rho_objvalue(&list_v);
+	r->objs[idx] = list_v;
+
+	const size_t count = rho_code_read_uint32(&r->in);
+
+	for (size_t i = 0; i < count; i++) {
+		RhoValue v = read_value(r);
+
+		if (rho_iserror(&v)) {
+			rho_release(&list_v);
+			return v;
+		}
+
+		rho_list_append(list, &v);
+		rho_release(&v);
+	}
+
+	return list_v;
+}
+
+static RhoValue read_tuple(struct reader *r)
+{
+	const size_t idx = reserve(r);
+	const size_t count = rho_code_read_uint32(&r->in);
+	RhoValue *elements = rho_malloc(count * sizeof(RhoValue));
+
+	for (size_t i = 0; i < count; i++) {
+		elements[i] = read_value(r);
+
+		if (rho_iserror(&elements[i])) {
+			RhoValue error = elements[i];
+
+			for (size_t j = 0; j < i; j++) {
+				rho_release(&elements[j]);
+			}
+
+			free(elements);
+			return error;
+		}
+	}
+
+	RhoValue tup = rho_tuple_make(elements, count);
+	free(elements);
+	r->objs[idx] = tup;
+	return tup;
+}
+
+static RhoValue read_dict(struct reader *r)
+{
+	const size_t idx = reserve(r);
+	RhoValue dict_v = rho_dict_make(NULL, 0);
+	RhoDictObject *dict = rho_objvalue(&dict_v);
+	r->objs[idx] = dict_v;
+
+	const size_t count = rho_code_read_uint32(&r->in);
+
+	for (size_t i = 0; i < count; i++) {
+		RhoValue key = read_value(r);
+
+		if (rho_iserror(&key)) {
+			rho_release(&dict_v);
+			return key;
+		}
+
+		RhoValue value = read_value(r);
+
+		if (rho_iserror(&value)) {
+			rho_release(&key);
+			rho_release(&dict_v);
+			return value;
+		}
+
+		RhoValue old = rho_dict_put(dict, &key, &value);
+		rho_release(&key);
+		rho_release(&value);
+
+		if (rho_iserror(&old)) {
+			rho_release(&dict_v);
+			return old;
+		}
+
+		rho_release(&old);
+	}
+
+	return dict_v;
+}
+
+static RhoValue read_set(struct reader *r)
+{
+	const size_t idx = reserve(r);
+	RhoValue set_v = rho_set_make(NULL, 0);
+	RhoSetObject *set = rho_objvalue(&set_v);
+	r->objs[idx] = set_v;
+
+	const size_t count = rho_code_read_uint32(&r->in);
+
+	for (size_t i = 0; i < count; i++) {
+		RhoValue v = read_value(r);
+
+		if (rho_iserror(&v)) {
+			rho_release(&set_v);
+			return v;
+		}
+
+		RhoValue added = rho_set_add(set, &v);
+		rho_release(&v);
+
+		if (rho_iserror(&added)) {
+			rho_release(&set_v);
+			return added;
+		}
+	}
+
+	return set_v;
+}
+
+static RhoValue read_code(struct reader *r)
+{
+	const size_t idx = reserve(r);
+	const size_t offset = rho_code_read_uint32(&r->in);
+	RhoCodeObject *co = rho_codeobj_make_from_entry(r->code + offset, r->vm);
+	RhoValue co_v = rho_makeobj(co);
+	r->objs[idx] = co_v;
+
+	if (!rho_code_read_byte(&r->in)) {
+		return co_v;
+	}
+
+	const size_t n_hints = co->argcount + 1;
+	RhoValue *types = rho_malloc(n_hints * sizeof(RhoValue));
+	RhoValue ret = co_v;
+
+	for (size_t i = 0; i < n_hints; i++) {
+		types[i] = read_value(r);
+
+		if (rho_iserror(&types[i])) {
+			ret = types[i];
+
+			for (size_t j = 0; j < i; j++) {
+				rho_release(&types[j]);
+			}
+
+			rho_release(&co_v);
+			free(types);
+			return ret;
+		}
+	}
+
+	RhoValue status = rho_codeobj_init_hints(co, types);
+
+	for (size_t i = 0; i < n_hints; i++) {
+		rho_release(&types[i]);
+	}
+
+	free(types);
+
+	if (rho_iserror(&status)) {
+		rho_release(&co_v);
+		return status;
+	}
+
+	return co_v;
+}
+
+static RhoValue read_func(struct reader *r, const byte tag)
+{
+	const size_t idx = reserve(r);
+	RhoValue co_v = read_value(r);
+
+	if (rho_iserror(&co_v)) {
+		return co_v;
+	}
+
+	RhoCodeObject *co = rho_objvalue(&co_v);
+	RhoValue fn_v;
+
+	switch (tag) {
+	case SNAP_FUNC:
+		fn_v = rho_funcobj_make(co);
+		break;
+	case SNAP_GEN_FUNC:
+		fn_v = rho_gen_proxy_make(co);
+		break;
+	case SNAP_ACTOR_FUNC:
+		fn_v = rho_actor_proxy_make(co);
+		break;
+	default:
+		RHO_INTERNAL_ERROR();
+		return rho_makeempty();
+	}
+
+	rho_release(&co_v);
+	r->objs[idx] = fn_v;
+
+	const size_t n_defaults = rho_code_read_uint32(&r->in);
+
+	if (n_defaults == 0) {
+		return fn_v;
+	}
+
+	RhoValue *defaults = rho_malloc(n_defaults * sizeof(RhoValue));
+	size_t n_read = 0;
+	RhoValue ret = fn_v;
+
+	while (n_read < n_defaults) {
+		defaults[n_read] = read_value(r);
+
+		if (rho_iserror(&defaults[n_read])) {
+			ret = defaults[n_read];
+			rho_release(&fn_v);
+			break;
+		}
+
+		++n_read;
+	}
+
+	if (n_read == n_defaults) {
+		switch (tag) {
+		case SNAP_FUNC:
+			rho_funcobj_init_defaults(rho_objvalue(&fn_v), defaults, n_defaults);
+			break;
+		case SNAP_GEN_FUNC:
+			rho_gen_proxy_init_defaults(rho_objvalue(&fn_v), defaults, n_defaults);
+			break;
+		case SNAP_ACTOR_FUNC:
+			rho_actor_proxy_init_defaults(rho_objvalue(&fn_v), defaults, n_defaults);
+			break;
+		}
+	}
+
+	for (size_t i = 0; i < n_read; i++) {
+		rho_release(&defaults[i]);
+	}
+
+	free(defaults);
+	return ret;
+}
+
+static RhoValue read_module(struct reader *r)
+{
+	const size_t idx = reserve(r);
+	const char *name = rho_code_read_str(&r->in);
+	RhoValue mod = rho_vm_import(r->vm, name);
+
+	if (!rho_iserror(&mod)) {
+		r->objs[idx] = mod;
+	}
+
+	return mod;
+}
+
+static RhoValue read_builtin(struct reader *r)
+{
+	const size_t idx = reserve(r);
+	const char *name = rho_code_read_str(&r->in);
+	RhoValue builtin = rho_vm_get_builtin(name);
+
+	if (rho_isempty(&builtin)) {
+		return rho_makeerr(rho_err_unbound(name));
+	}
+
+	rho_retain(&builtin);
+	r->objs[idx] = builtin;
+	return builtin;
+}
+
+static RhoValue read_value(struct reader *r)
+{
+	const byte tag = rho_code_read_byte(&r->in);
+
+	switch (tag) {
+	case SNAP_EMPTY:
+		return rho_makeempty();
+	case SNAP_NULL:
+		return rho_makenull();
+	case SNAP_FALSE:
+		return rho_makefalse();
+	case SNAP_TRUE:
+		return rho_maketrue();
+	case SNAP_INT:
+		return rho_makeint(read_long(&r->in));
+	case SNAP_FLOAT:
+		return rho_makefloat(rho_code_read_double(&r->in));
+	case SNAP_STR: {
+		const size_t idx = reserve(r);
+		const size_t len = rho_code_read_uint32(&r->in);
+		const char *value = (const char *)r->in.bc;
+		rho_code_skip_ahead(&r->in, len + 1);
+		RhoValue str = rho_strobj_make(RHO_STR_INIT(value, len, 0));
+		r->objs[idx] = str;
+		return str;
+	}
+	case SNAP_LIST:
+		return read_list(r);
+	case SNAP_TUPLE:
+		return read_tuple(r);
+	case SNAP_DICT:
+		return read_dict(r);
+	case SNAP_SET:
+		return read_set(r);
+	case SNAP_CODE:
+		return read_code(r);
+	case SNAP_FUNC:
+	case SNAP_GEN_FUNC:
+	case SNAP_ACTOR_FUNC:
+		return read_func(r, tag);
+	case SNAP_MODULE:
+		return read_module(r);
+	case SNAP_BUILTIN:
+		return read_builtin(r);
+	case SNAP_REF: {
+		const size_t idx = rho_code_read_uint32(&r->in);
+		assert(idx < r->n_objs && !rho_isempty(&r->objs[idx]));
+		RhoValue v = r->objs[idx];
+		rho_retain(&v);
+		return v;
+	}
+	default:
+		RHO_INTERNAL_ERROR();
+		return rho_makeempty();
+	}
+}
+
+RhoValue rho_snapshot_restore(RhoVM *vm, const RhoCode *image)
+{
+	RhoCode code;
+	rho_snapshot_code(image, &code);
+
+	const size_t code_end = 4 + code.size;
+	struct reader r = {.vm = vm,
+	                   .in = {.bc = image->bc + code_end, .size = image->size - code_end, .capacity = 0},
+	                   .code = code.bc,
+	                   .objs = NULL,
+	                   .n_objs = 0,
+	                   .objs_capacity = 0};
+
+	const size_t n_globals = rho_code_read_uint32(&r.in);
+	assert(n_globals == vm->globals.length);
+	RhoValue ret = rho_makeempty();
+
+	for (size_t i = 0; i < n_globals; i++) {
+		RhoValue v = read_value(&r);
+
+		if (rho_iserror(&v)) {
+			ret = v;
+			break;
+		}
+
+		vm->globals.array[i] = v;
+	}
+
+	free(r.objs);
+	return ret;
+}
@@ -0,0 +1,34 @@
+#ifndef RHO_SNAPSHOT_H
+#define RHO_SNAPSHOT_H
+
+#include <stdio.h>
+#include "code.h"
+#include "object.h"
+#include "vm.h"
+
+/* function called once an image is restored */
+#define RHO_MAIN_FUNC "main"
+
+/* same length as the rhoc magic bytes; the last is the format version */
+extern const byte rho_image_magic[];
+
+/*
+ * Writes the code and global variables of `vm`, whose module has
+ * finished running, to `out` as a heap image. Returns an error if
+ * some global holds a value that can't be saved.
+ */
+RhoValue rho_snapshot_write(RhoVM *vm, FILE *out);
+
+/*
+ * Sets `code` to the module code held by the given image (as loaded
+ * by `rho_load_image`), which the module frame is made from.
+ */
+void rho_snapshot_code(const RhoCode *image, RhoCode *code);
+
+/*
+ * Restores the global variables saved in `image` into `vm`, whose
+ * module frame must have been made from the image's code.
+ */
+RhoValue rho_snapshot_restore(RhoVM *vm, const RhoCode *image);
+
+#endif /* RHO_SNAPSHOT_H */
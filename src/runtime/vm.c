@@ -16,6 +16,7 @@
 #include "tupleobject.h"
 #include "setobject.h"
 #include "dictobject.h"
+#include "concdictobject.h"
 #include "fileobject.h"
 #include "codeobject.h"
 #include "funcobject.h"
@@ -33,10 +34,13 @@
 #include "compiler.h"
 #include "builtins.h"
 #include "loader.h"
+#include "snapshot.h"
+#include "prefetch.h"
 #include "plugins.h"
 #include "util.h"
 #include "main.h"
 #include "vmops.h"
+#include "jit.h"
 #include "vm.h"
 
 static pthread_key_t vm_key;
@@ -62,10 +66,13 @@ static RhoClass *classes[] = {
 	&rho_tuple_class,
 	&rho_set_class,
 	&rho_dict_class,
+	&rho_concdict_class,
 	&rho_file_class,
 	&rho_co_class,
 	&rho_fn_class,
+	&rho_actor_proxy_class,
 	&rho_actor_class,
+	&rho_actor_pool_class,
 	&rho_future_class,
 	&rho_message_class,
 	&rho_method_class,
@@ -87,6 +94,8 @@ static RhoClass *classes[] = {
 	NULL
 };
 
+bool rho_import_time_enabled = false;
+
 static RhoStrDict builtins_dict;
 static RhoStrDict builtin_modules_dict;
 static RhoStrDict import_cache;
@@ -113,9 +122,44 @@ static void import_cache_dealloc(void)
 	rho_strdict_dealloc(&import_cache);
 }
 
-static unsigned int get_lineno(RhoFrame *frame);
+#ifdef RHO_PROFILE_OPCODES
+/*
+ * Instrumented builds count how often each opcode is executed
+ * directly after each other opcode in the same frame (the first
+ * opcode executed by a frame is counted as following opcode 0).
+ * The counts are written out at exit to the file named by the
+ * RHO_OPCODE_PROFILE environment variable, or to stderr, as lines
+ * of the form "<first> <second> <count>"; tools/opcode_pairs.py
+ * aggregates them.
+ */
+static atomic_ulong opcode_pair_counts[256][256];
+
+static void opcode_profile_dump(void)
+{
+	const char *path = getenv("RHO_OPCODE_PROFILE");
+	FILE *out = (path != NULL) ? fopen(path, "a") : stderr;
+
+	if (out == NULL) {
+		return;
+	}
+
+	for (size_t i = 0; i < 256; i++) {
+		for (size_t j = 0; j < 256; j++) {
+			const unsigned long count = atomic_load(&opcode_pair_counts[i][j]);
+			if (count > 0) {
+				fprintf(out, "%zu %zu %lu\n", i, j, count);
+			}
+		}
+	}
+
+	if (out != stderr) {
+		fclose(out);
+	}
+}
+#endif
 
-static void vm_push_module_frame(RhoVM *vm, RhoCode *code);
+static void vm_push_module_frame(RhoVM *vm, RhoCodeObject *co);
+static int vm_exec_module(RhoVM *vm);
 static void vm_load_builtins(void);
 static void vm_load_builtin_modules(void);
 static RhoValue vm_import(RhoVM *vm, const char *name);
@@ -141,6 +185,10 @@ RhoVM *rho_vm_new(void)
 		atexit(builtin_modules_dealloc);
 		atexit(import_cache_dealloc);
 
+#ifdef RHO_PROFILE_OPCODES
+		atexit(opcode_profile_dump);
+#endif
+
 #if RHO_IS_POSIX
 		const char *path = getenv(RHO_PLUGIN_PATH_ENV);
 		if (path != NULL) {
@@ -156,20 +204,20 @@ RhoVM *rho_vm_new(void)
 	}
 
 	RhoVM *vm = rho_malloc(sizeof(RhoVM));
-	vm->head = NULL;
+	vm->head = (RhoCode){.bc = NULL, .size = 0, .capacity = 0};
 	vm->module = NULL;
 	vm->callstack = NULL;
 	vm->globals = (struct rho_value_array){.array = NULL, .length = 0};
 	vm->global_names = (struct rho_str_array){.array = NULL, .length = 0};
 	vm->children = NULL;
 	vm->sibling = NULL;
+	vm->depth = 0;
 	rho_strdict_init(&vm->exports);
 	return vm;
 }
 
 static void vm_free_helper(RhoVM *vm)
 {
-	free(vm->head);
 	const size_t n_globals = vm->globals.length;
 	RhoValue *globals = vm->globals.array;
 
@@ -179,6 +227,7 @@ static void vm_free_helper(RhoVM *vm)
 
 	free(globals);
 	free(vm->global_names.array);
+	rho_load_release(&vm->head);
 
 	for (RhoVM *child = vm->children; child != NULL;) {
 		RhoVM *temp = child;
@@ -211,16 +260,9 @@ static void vm_link(RhoVM *parent, RhoVM *child)
 	parent->children = child;
 }
 
-int rho_vm_exec_code(RhoVM *vm, RhoCode *code)
+/* prints the error that ended the module, if any */
+static int report_result(RhoValue *ret)
 {
-	vm->head = code->bc;
-
-	vm_push_module_frame(vm, code);
-	rho_vm_eval_frame(vm);
-	rho_actor_join_all();
-
-	RhoValue *ret = &vm->callstack->return_value;
-
 	int status = 0;
 	if (rho_isexc(ret)) {
 		status = 1;
@@ -236,6 +278,57 @@ int rho_vm_exec_code(RhoVM *vm, RhoCode *code)
 		rho_err_free(e);
 	}
 
+	return status;
+}
+
+/* runs the module frame pushed on `vm`, then pops it */
+static int vm_exec_module(RhoVM *vm)
+{
+	rho_vm_eval_frame(vm);
+	rho_actor_join_all();
+
+	const int status = report_result(&vm->callstack->return_value);
+	rho_vm_pop_frame(vm);
+	return status;
+}
+
+int rho_vm_exec_code(RhoVM *vm, RhoCode *code)
+{
+	vm->head = *code;
+	vm_push_module_frame(vm, rho_codeobj_make_toplevel(code, "<module>", vm));
+	return vm_exec_module(vm);
+}
+
+int rho_vm_exec_image(RhoVM *vm, RhoCode *image)
+{
+	vm->head = *image;
+
+	RhoCode code;
+	rho_snapshot_code(image, &code);
+	vm_push_module_frame(vm, rho_codeobj_make_toplevel(&code, "<module>", vm));
+
+	RhoValue ret = rho_snapshot_restore(vm, image);
+
+	if (!rho_iserror(&ret)) {
+		const size_t n_globals = vm->globals.length;
+
+		for (size_t i = 0; i < n_globals; i++) {
+			if (strcmp(vm->global_names.array[i].str, RHO_MAIN_FUNC) == 0 &&
+			    !rho_isempty(&vm->globals.array[i])) {
+				ret = rho_op_call(&vm->globals.array[i], NULL, NULL, 0, 0);
+				break;
+			}
+		}
+	}
+
+	rho_actor_join_all();
+
+	const int status = report_result(&ret);
+
+	if (status == 0) {
+		rho_release(&ret);
+	}
+
 	rho_vm_pop_frame(vm);
 	return status;
 }
@@ -315,6 +408,7 @@ void rho_vm_pop_frame(RhoVM *vm)
 
 RhoFrame *rho_frame_make(RhoCodeObject *co)
 {
+	rho_codeobj_materialize(co);
 	RhoFrame *frame = rho_malloc(sizeof(RhoFrame));
 
 	const size_t n_locals = co->names.length;
@@ -423,10 +517,14 @@ void rho_frame_free(RhoFrame *frame)
 /*
  * Assumes the symbol table and constant table have not yet been read.
  */
-static void vm_push_module_frame(RhoVM *vm, RhoCode *code)
+static void vm_push_module_frame(RhoVM *vm, RhoCodeObject *co)
 {
 	assert(vm->module == NULL);
-	RhoCodeObject *co = rho_codeobj_make_toplevel(code, "<module>", vm);
+
+	if (rho_prefetch_enabled) {
+		rho_prefetch_imports(co);
+	}
+
 	rho_vm_push_frame(vm, co);
 	vm->module = vm->callstack;
 	vm->globals = (struct rho_value_array){.array = vm->module->locals,
@@ -434,11 +532,83 @@ static void vm_push_module_frame(RhoVM *vm, RhoCode *code)
 	rho_util_str_array_dup(&co->names, &vm->global_names);
 }
 
+/*
+ * Applies the binary operator corresponding to the given opcode,
+ * for instructions that carry the operator as an argument.
+ */
+static RhoValue binop_for_opcode(const RhoOpcode op, RhoValue *v1, RhoValue *v2)
+{
+	switch (op) {
+	case RHO_INS_ADD:
+		return rho_op_add(v1, v2);
+	case RHO_INS_SUB:
+		return rho_op_sub(v1, v2);
+	case RHO_INS_MUL:
+		return rho_op_mul(v1, v2);
+	case RHO_INS_DIV:
+		return rho_op_div(v1, v2);
+	case RHO_INS_MOD:
+		return rho_op_mod(v1, v2);
+	case RHO_INS_POW:
+		return rho_op_pow(v1, v2);
+	case RHO_INS_BITAND:
+		return rho_op_bitand(v1, v2);
+	case RHO_INS_BITOR:
+		return rho_op_bitor(v1, v2);
+	case RHO_INS_XOR:
+		return rho_op_xor(v1, v2);
+	case RHO_INS_SHIFTL:
+		return rho_op_shiftl(v1, v2);
+	case RHO_INS_SHIFTR:
+		return rho_op_shiftr(v1, v2);
+	case RHO_INS_EQUAL:
+		return rho_op_eq(v1, v2);
+	case RHO_INS_NOTEQ:
+		return rho_op_neq(v1, v2);
+	case RHO_INS_LT:
+		return rho_op_lt(v1, v2);
+	case RHO_INS_GT:
+		return rho_op_gt(v1, v2);
+	case RHO_INS_LE:
+		return rho_op_le(v1, v2);
+	case RHO_INS_GE:
+		return rho_op_ge(v1, v2);
+	case RHO_INS_IADD:
+		return rho_op_iadd(v1, v2);
+	case RHO_INS_ISUB:
+		return rho_op_isub(v1, v2);
+	case RHO_INS_IMUL:
+		return rho_op_imul(v1, v2);
+	case RHO_INS_IDIV:
+		return rho_op_idiv(v1, v2);
+	case RHO_INS_IMOD:
+		return rho_op_imod(v1, v2);
+	case RHO_INS_IPOW:
+		return rho_op_ipow(v1, v2);
+	case RHO_INS_IBITAND:
+		return rho_op_ibitand(v1, v2);
+	case RHO_INS_IBITOR:
+		return rho_op_ibitor(v1, v2);
+	case RHO_INS_IXOR:
+		return rho_op_ixor(v1, v2);
+	case RHO_INS_ISHIFTL:
+		return rho_op_ishiftl(v1, v2);
+	case RHO_INS_ISHIFTR:
+		return rho_op_ishiftr(v1, v2);
+	default:
+		RHO_INTERNAL_ERROR();
+		return rho_makeempty();
+	}
+}
+
 void rho_vm_eval_frame(RhoVM *vm)
 {
 #define GET_BYTE()    (bc[pos++])
 #define GET_UINT16()  (pos += 2, ((bc[pos - 1] << 8) | bc[pos - 2]))
 
+/* the argument that a preceding EXTENDED_ARG extends (see compiler.c) */
+#define GET_ARG()     (ext_arg = ext | GET_UINT16(), ext = 0, ext_arg)
+
 #define IN_TOP_FRAME()  (vm->callstack == vm->module)
 
 #define STACK_POP()          (--stack)
@@ -458,6 +628,21 @@ void rho_vm_eval_frame(RhoVM *vm)
 #define EXC_STACK_TOP()       (&exc_stack[-1])
 #define EXC_STACK_EMPTY()     (exc_stack == exc_stack_base)
 
+/* runs native code from `pos` if there is any (see jit.h) */
+#define JIT_ENTER() \
+	do { \
+		if (rho_jit_enabled && EXC_STACK_EMPTY() && rho_jit_hot(co, pos)) { \
+			struct rho_jit_state st = {stack, locals, constants, globals, co, rho_makeempty()}; \
+			pos = rho_jit_run(co, pos, &st); \
+			stack = st.stack; \
+			if (!rho_isempty(&st.error)) { \
+				frame->pos = pos; \
+				res = st.error; \
+				goto error; \
+			} \
+		} \
+	} while (0)
+
 	RhoFrame *frame = vm->callstack;
 
 	RhoValue *locals = frame->locals;
@@ -486,6 +671,17 @@ void rho_vm_eval_frame(RhoVM *vm)
 	RhoValue *v1, *v2, *v3;
 	RhoValue res;
 
+	/* high bits from an EXTENDED_ARG prefix */
+	unsigned int ext = 0, ext_arg;
+
+#ifdef RHO_PROFILE_OPCODES
+	byte prev_opcode = 0;
+#endif
+
+	if (pos == 0) {
+		JIT_ENTER();
+	}
+
 	head:
 	while (true) {
 		frame->pos = pos;
@@ -496,11 +692,16 @@ void rho_vm_eval_frame(RhoVM *vm)
 
 		const byte opcode = GET_BYTE();
 
+#ifdef RHO_PROFILE_OPCODES
+		atomic_fetch_add_explicit(&opcode_pair_counts[prev_opcode][opcode], 1, memory_order_relaxed);
+		prev_opcode = opcode;
+#endif
+
 		switch (opcode) {
 		case RHO_INS_NOP:
 			break;
 		case RHO_INS_LOAD_CONST: {
-			const unsigned int id = GET_UINT16();
+			const unsigned int id = GET_ARG();
 			v1 = &constants[id];
 			rho_retain(v1);
 			STACK_PUSH(*v1);
@@ -1024,7 +1225,7 @@ void rho_vm_eval_frame(RhoVM *vm)
 		}
 		case RHO_INS_STORE: {
 			v1 = STACK_POP();
-			const unsigned int id = GET_UINT16();
+			const unsigned int id = GET_ARG();
 			RhoValue old = locals[id];
 			locals[id] = *v1;
 			rho_release(&old);
@@ -1032,14 +1233,14 @@ void rho_vm_eval_frame(RhoVM *vm)
 		}
 		case RHO_INS_STORE_GLOBAL: {
 			v1 = STACK_POP();
-			const unsigned int id = GET_UINT16();
+			const unsigned int id = GET_ARG();
 			RhoValue old = globals[id];
 			globals[id] = *v1;
 			rho_release(&old);
 			break;
 		}
 		case RHO_INS_LOAD: {
-			const unsigned int id = GET_UINT16();
+			const unsigned int id = GET_ARG();
 			v1 = &locals[id];
 
 			if (rho_isempty(v1)) {
@@ -1052,7 +1253,7 @@ void rho_vm_eval_frame(RhoVM *vm)
 			break;
 		}
 		case RHO_INS_LOAD_GLOBAL: {
-			const unsigned int id = GET_UINT16();
+			const unsigned int id = GET_ARG();
 			v1 = &globals[id];
 
 			if (rho_isempty(v1)) {
@@ -1066,7 +1267,7 @@ void rho_vm_eval_frame(RhoVM *vm)
 		}
 		case RHO_INS_LOAD_ATTR: {
 			v1 = STACK_TOP();
-			const unsigned int id = GET_UINT16();
+			const unsigned int id = GET_ARG();
 			const char *attr = attrs.array[id].str;
 			res = rho_op_get_attr(v1, attr);
 
@@ -1081,7 +1282,7 @@ void rho_vm_eval_frame(RhoVM *vm)
 		case RHO_INS_SET_ATTR: {
 			v1 = STACK_POP();
 			v2 = STACK_POP();
-			const unsigned int id = GET_UINT16();
+			const unsigned int id = GET_ARG();
 			const char *attr = attrs.array[id].str;
 			res = rho_op_set_attr(v1, attr, v2);
 
@@ -1154,7 +1355,7 @@ void rho_vm_eval_frame(RhoVM *vm)
 			break;
 		}
 		case RHO_INS_LOAD_NAME: {
-			const unsigned int id = GET_UINT16();
+			const unsigned int id = GET_ARG();
 			RhoStr *key = &frees[id];
 			res = rho_strdict_get(&builtins_dict, key);
 
@@ -1182,18 +1383,19 @@ void rho_vm_eval_frame(RhoVM *vm)
 			break;
 		}
 		case RHO_INS_JMP: {
-			const unsigned int jmp = GET_UINT16();
+			const unsigned int jmp = GET_ARG();
 			pos += jmp;
 			break;
 		}
 		case RHO_INS_JMP_BACK: {
-			const unsigned int jmp = GET_UINT16();
+			const unsigned int jmp = GET_ARG();
 			pos -= jmp;
+			JIT_ENTER();
 			break;
 		}
 		case RHO_INS_JMP_IF_TRUE: {
 			v1 = STACK_POP();
-			const unsigned int jmp = GET_UINT16();
+			const unsigned int jmp = GET_ARG();
 			if (rho_resolve_nonzero(rho_getclass(v1))(v1)) {
 				pos += jmp;
 			}
@@ -1202,7 +1404,7 @@ void rho_vm_eval_frame(RhoVM *vm)
 		}
 		case RHO_INS_JMP_IF_FALSE: {
 			v1 = STACK_POP();
-			const unsigned int jmp = GET_UINT16();
+			const unsigned int jmp = GET_ARG();
 			if (!rho_resolve_nonzero(rho_getclass(v1))(v1)) {
 				pos += jmp;
 			}
@@ -1211,25 +1413,31 @@ void rho_vm_eval_frame(RhoVM *vm)
 		}
 		case RHO_INS_JMP_BACK_IF_TRUE: {
 			v1 = STACK_POP();
-			const unsigned int jmp = GET_UINT16();
+			const unsigned int jmp = GET_ARG();
 			if (rho_resolve_nonzero(rho_getclass(v1))(v1)) {
 				pos -= jmp;
+				rho_release(v1);
+				JIT_ENTER();
+			} else {
+				rho_release(v1);
 			}
-			rho_release(v1);
 			break;
 		}
 		case RHO_INS_JMP_BACK_IF_FALSE: {
 			v1 = STACK_POP();
-			const unsigned int jmp = GET_UINT16();
+			const unsigned int jmp = GET_ARG();
 			if (!rho_resolve_nonzero(rho_getclass(v1))(v1)) {
 				pos -= jmp;
+				rho_release(v1);
+				JIT_ENTER();
+			} else {
+				rho_release(v1);
 			}
-			rho_release(v1);
 			break;
 		}
 		case RHO_INS_JMP_IF_TRUE_ELSE_POP: {
 			v1 = STACK_TOP();
-			const unsigned int jmp = GET_UINT16();
+			const unsigned int jmp = GET_ARG();
 			if (rho_resolve_nonzero(rho_getclass(v1))(v1)) {
 				pos += jmp;
 			} else {
@@ -1240,7 +1448,7 @@ void rho_vm_eval_frame(RhoVM *vm)
 		}
 		case RHO_INS_JMP_IF_FALSE_ELSE_POP: {
 			v1 = STACK_TOP();
-			const unsigned int jmp = GET_UINT16();
+			const unsigned int jmp = GET_ARG();
 			if (!rho_resolve_nonzero(rho_getclass(v1))(v1)) {
 				pos += jmp;
 			} else {
@@ -1250,9 +1458,8 @@ void rho_vm_eval_frame(RhoVM *vm)
 			break;
 		}
 		case RHO_INS_CALL: {
-			const unsigned int x = GET_UINT16();
-			const unsigned int nargs = (x & 0xff);
-			const unsigned int nargs_named = (x >> 8);
+			const unsigned int nargs = GET_ARG();
+			const unsigned int nargs_named = GET_UINT16();
 			v1 = STACK_POP();
 			res = rho_op_call(v1,
 			                  stack - nargs_named*2 - nargs,
@@ -1305,8 +1512,8 @@ void rho_vm_eval_frame(RhoVM *vm)
 			goto done;
 		}
 		case RHO_INS_TRY_BEGIN: {
-			const unsigned int try_block_len = GET_UINT16();
-			const unsigned int handler_offset = GET_UINT16();
+			const unsigned int try_block_len = GET_ARG();
+			const unsigned int handler_offset = try_block_len + GET_UINT16();
 
 			EXC_STACK_PUSH(pos, pos + try_block_len, pos + handler_offset, stack);
 
@@ -1317,7 +1524,7 @@ void rho_vm_eval_frame(RhoVM *vm)
 			break;
 		}
 		case RHO_INS_JMP_IF_EXC_MISMATCH: {
-			const unsigned int jmp = GET_UINT16();
+			const unsigned int jmp = GET_ARG();
 
 			v1 = STACK_POP();  // exception type
 			v2 = STACK_POP();  // exception
@@ -1341,7 +1548,7 @@ void rho_vm_eval_frame(RhoVM *vm)
 			break;
 		}
 		case RHO_INS_MAKE_LIST: {
-			const unsigned int len = GET_UINT16();
+			const unsigned int len = GET_ARG();
 
 			if (len > 0) {
 				res = rho_list_make(stack - len, len);
@@ -1354,7 +1561,7 @@ void rho_vm_eval_frame(RhoVM *vm)
 			break;
 		}
 		case RHO_INS_MAKE_TUPLE: {
-			const unsigned int len = GET_UINT16();
+			const unsigned int len = GET_ARG();
 
 			if (len > 0) {
 				res = rho_tuple_make(stack - len, len);
@@ -1367,7 +1574,7 @@ void rho_vm_eval_frame(RhoVM *vm)
 			break;
 		}
 		case RHO_INS_MAKE_SET: {
-			const unsigned int len = GET_UINT16();
+			const unsigned int len = GET_ARG();
 
 			if (len > 0) {
 				res = rho_set_make(stack - len, len);
@@ -1385,7 +1592,7 @@ void rho_vm_eval_frame(RhoVM *vm)
 			break;
 		}
 		case RHO_INS_MAKE_DICT: {
-			const unsigned int len = GET_UINT16();
+			const unsigned int len = GET_ARG();
 
 			if (len > 0) {
 				res = rho_dict_make(stack - len, len);
@@ -1403,7 +1610,7 @@ void rho_vm_eval_frame(RhoVM *vm)
 			break;
 		}
 		case RHO_INS_IMPORT: {
-			const unsigned int id = GET_UINT16();
+			const unsigned int id = GET_ARG();
 			res = vm_import(vm, symbols.array[id].str);
 
 			if (rho_iserror(&res)) {
@@ -1414,7 +1621,7 @@ void rho_vm_eval_frame(RhoVM *vm)
 			break;
 		}
 		case RHO_INS_EXPORT: {
-			const unsigned int id = GET_UINT16();
+			const unsigned int id = GET_ARG();
 			v1 = STACK_POP();
 
 			/* no need to do a bounds check on `id`, since
@@ -1428,7 +1635,7 @@ void rho_vm_eval_frame(RhoVM *vm)
 			break;
 		}
 		case RHO_INS_EXPORT_GLOBAL: {
-			const unsigned int id = GET_UINT16();
+			const unsigned int id = GET_ARG();
 			v1 = STACK_POP();
 
 			/* no need to do a bounds check on `id`, since
@@ -1442,7 +1649,7 @@ void rho_vm_eval_frame(RhoVM *vm)
 			break;
 		}
 		case RHO_INS_EXPORT_NAME: {
-			const unsigned int id = GET_UINT16();
+			const unsigned int id = GET_ARG();
 			v1 = STACK_POP();
 
 			/* no need to do a bounds check on `id`, since
@@ -1494,7 +1701,7 @@ void rho_vm_eval_frame(RhoVM *vm)
 		}
 		case RHO_INS_LOOP_ITER: {
 			v1 = STACK_TOP();
-			const unsigned int jmp = GET_UINT16();
+			const unsigned int jmp = GET_ARG();
 
 			res = rho_op_iternext(v1);
 
@@ -1511,7 +1718,7 @@ void rho_vm_eval_frame(RhoVM *vm)
 			break;
 		}
 		case RHO_INS_MAKE_FUNCOBJ: {
-			const unsigned int arg          = GET_UINT16();
+			const unsigned int arg          = GET_ARG();
 			const unsigned int num_hints    = (arg >> 8);
 			const unsigned int num_defaults = (arg & 0xff);
 			const unsigned int offset = num_defaults + num_hints;
@@ -1540,7 +1747,7 @@ void rho_vm_eval_frame(RhoVM *vm)
 			break;
 		}
 		case RHO_INS_MAKE_GENERATOR: {
-			const unsigned int arg          = GET_UINT16();
+			const unsigned int arg          = GET_ARG();
 			const unsigned int num_hints    = (arg >> 8);
 			const unsigned int num_defaults = (arg & 0xff);
 			const unsigned int offset = num_defaults + num_hints;
@@ -1569,7 +1776,7 @@ void rho_vm_eval_frame(RhoVM *vm)
 			break;
 		}
 		case RHO_INS_MAKE_ACTOR: {
-			const unsigned int arg          = GET_UINT16();
+			const unsigned int arg          = GET_ARG();
 			const unsigned int num_hints    = (arg >> 8);
 			const unsigned int num_defaults = (arg & 0xff);
 			const unsigned int offset = num_defaults + num_hints;
@@ -1597,7 +1804,7 @@ void rho_vm_eval_frame(RhoVM *vm)
 			break;
 		}
 		case RHO_INS_SEQ_EXPAND: {
-			const unsigned int n = GET_UINT16();
+			const unsigned int n = GET_ARG();
 			v1 = STACK_POP();
 
 			/* common case */
@@ -1695,6 +1902,310 @@ void rho_vm_eval_frame(RhoVM *vm)
 			STACK_SET_THIRD(v1);
 			break;
 		}
+		/*
+		 * Superinstructions
+		 * -----------------
+		 * Each of these behaves exactly like the sequence of
+		 * instructions it stands for (see peephole.c), but is
+		 * dispatched only once.
+		 */
+		case RHO_INS_LOAD_LOAD: {
+			/* LOAD a; LOAD b */
+			const unsigned int id1 = GET_ARG();
+			const unsigned int id2 = GET_UINT16();
+			v1 = &locals[id1];
+			v2 = &locals[id2];
+
+			if (rho_isempty(v1)) {
+				res = rho_makeerr(rho_err_unbound(symbols.array[id1].str));
+				goto error;
+			}
+
+			if (rho_isempty(v2)) {
+				res = rho_makeerr(rho_err_unbound(symbols.array[id2].str));
+				goto error;
+			}
+
+			rho_retain(v1);
+			rho_retain(v2);
+			STACK_PUSH(*v1);
+			STACK_PUSH(*v2);
+			break;
+		}
+		case RHO_INS_LOAD_ADD_CONST: {
+			/* LOAD a; LOAD_CONST c; ADD */
+			const unsigned int id = GET_ARG();
+			const unsigned int const_id = GET_UINT16();
+			v1 = &locals[id];
+
+			if (rho_isempty(v1)) {
+				res = rho_makeerr(rho_err_unbound(symbols.array[id].str));
+				goto error;
+			}
+
+			res = rho_op_add(v1, &constants[const_id]);
+
+			if (rho_iserror(&res)) {
+				goto error;
+			}
+
+			STACK_PUSH(res);
+			break;
+		}
+		case RHO_INS_LOAD_ATTR_LOCAL: {
+			/* LOAD a; LOAD_ATTR x */
+			const unsigned int id = GET_ARG();
+			const unsigned int attr_id = GET_UINT16();
+			v1 = &locals[id];
+
+			if (rho_isempty(v1)) {
+				res = rho_makeerr(rho_err_unbound(symbols.array[id].str));
+				goto error;
+			}
+
+			res = rho_op_get_attr(v1, attrs.array[attr_id].str);
+
+			if (rho_iserror(&res)) {
+				goto error;
+			}
+
+			STACK_PUSH(res);
+			break;
+		}
+		case RHO_INS_INC_LOCAL_BY_CONST: {
+			/* LOAD a; LOAD_CONST c; IADD; STORE a */
+			const unsigned int id = GET_ARG();
+			const unsigned int const_id = GET_UINT16();
+			v1 = &locals[id];
+
+			if (rho_isempty(v1)) {
+				res = rho_makeerr(rho_err_unbound(symbols.array[id].str));
+				goto error;
+			}
+
+			res = rho_op_iadd(v1, &constants[const_id]);
+
+			if (rho_iserror(&res)) {
+				goto error;
+			}
+
+			RhoValue old = locals[id];
+			locals[id] = res;
+			rho_release(&old);
+			break;
+		}
+		case RHO_INS_COMPARE_AND_BRANCH: {
+			/* <comparison>; JMP_IF_FALSE */
+			const unsigned int cmp = GET_UINT16();
+			const unsigned int jmp = GET_ARG();
+			v2 = STACK_POP();
+			v1 = STACK_TOP();
+			res = binop_for_opcode(cmp, v1, v2);
+
+			rho_release(v2);
+			if (rho_iserror(&res)) {
+				goto error;
+			}
+			rho_release(v1);
+			STACK_POP();
+
+			if (!rho_resolve_nonzero(rho_getclass(&res))(&res)) {
+				pos += jmp;
+			}
+			rho_release(&res);
+			break;
+		}
+		case RHO_INS_FOR_ITER_STORE: {
+			/* LOOP_ITER; STORE a */
+			v1 = STACK_TOP();
+			const unsigned int jmp = GET_ARG();
+			const unsigned int id = GET_UINT16();
+
+			res = rho_op_iternext(v1);
+
+			if (rho_iserror(&res)) {
+				goto error;
+			}
+
+			if (rho_is_iter_stop(&res)) {
+				pos += jmp;
+			} else {
+				RhoValue old = locals[id];
+				locals[id] = res;
+				rho_release(&old);
+			}
+
+			break;
+		}
+		/*
+		 * Register instructions
+		 * ---------------------
+		 * These operate on frame slots directly rather than on the
+		 * value stack (see compiler.c and opcodes.h for the operand
+		 * encoding). A temporary operand is consumed once read.
+		 */
+#define REG_SLOT(op) (((op) & RHO_REG_CONST) ? &constants[(op) & RHO_REG_INDEX_MASK] : \
+                                               &locals[(op) & RHO_REG_INDEX_MASK])
+
+#define REG_CHECK_BOUND(v, op) \
+	if (rho_isempty(v)) { \
+		res = rho_makeerr(rho_err_unbound(symbols.array[(op) & RHO_REG_INDEX_MASK].str)); \
+		goto error; \
+	}
+
+#define REG_CONSUME(op) \
+	if ((op) & RHO_REG_TEMP) { \
+		rho_release(&locals[(op) & RHO_REG_INDEX_MASK]); \
+		locals[(op) & RHO_REG_INDEX_MASK] = rho_makeempty(); \
+	}
+
+		case RHO_INS_REG_MOVE: {
+			const unsigned int dst = GET_ARG();
+			const unsigned int src = GET_UINT16();
+			v1 = REG_SLOT(src);
+			REG_CHECK_BOUND(v1, src);
+
+			rho_retain(v1);
+			RhoValue old = locals[dst];
+			locals[dst] = *v1;
+			rho_release(&old);
+			break;
+		}
+		case RHO_INS_REG_BINOP: {
+			const unsigned int op = GET_ARG();
+			const unsigned int dst = GET_UINT16();
+			const unsigned int a = GET_UINT16();
+			const unsigned int b = GET_UINT16();
+			v1 = REG_SLOT(a);
+			v2 = REG_SLOT(b);
+			REG_CHECK_BOUND(v1, a);
+			REG_CHECK_BOUND(v2, b);
+
+			res = binop_for_opcode(op, v1, v2);
+			REG_CONSUME(a);
+			REG_CONSUME(b);
+
+			if (rho_iserror(&res)) {
+				goto error;
+			}
+
+			RhoValue old = locals[dst];
+			locals[dst] = res;
+			rho_release(&old);
+			break;
+		}
+		case RHO_INS_REG_CMP_BRANCH: {
+			const unsigned int op = GET_UINT16();
+			const unsigned int a = GET_UINT16();
+			const unsigned int b = GET_UINT16();
+			const unsigned int jmp = GET_ARG();
+			v1 = REG_SLOT(a);
+			v2 = REG_SLOT(b);
+			REG_CHECK_BOUND(v1, a);
+			REG_CHECK_BOUND(v2, b);
+
+			res = binop_for_opcode(op, v1, v2);
+			REG_CONSUME(a);
+			REG_CONSUME(b);
+
+			if (rho_iserror(&res)) {
+				goto error;
+			}
+
+			if (!rho_resolve_nonzero(rho_getclass(&res))(&res)) {
+				pos += jmp;
+			}
+			rho_release(&res);
+			break;
+		}
+#undef REG_SLOT
+#undef REG_CHECK_BOUND
+#undef REG_CONSUME
+		/*
+		 * Hoisted loads copy a global or builtin into a local slot
+		 * ahead of a loop. An unbound name leaves the slot empty, so
+		 * the error is raised by the LOAD that uses it, if any.
+		 */
+		case RHO_INS_HOIST_GLOBAL: {
+			const unsigned int slot = GET_ARG();
+			const unsigned int id = GET_UINT16();
+			v1 = &globals[id];
+			rho_retain(v1);
+			RhoValue old = locals[slot];
+			locals[slot] = *v1;
+			rho_release(&old);
+			break;
+		}
+		case RHO_INS_HOIST_NAME: {
+			const unsigned int slot = GET_ARG();
+			const unsigned int id = GET_UINT16();
+			res = rho_strdict_get(&builtins_dict, &frees[id]);
+			rho_retain(&res);
+			RhoValue old = locals[slot];
+			locals[slot] = res;
+			rho_release(&old);
+			break;
+		}
+		/*
+		 * Typed arithmetic: both operands are known to be Ints (or
+		 * Floats), which are never reference counted, so no release
+		 * is needed and the operation can't fail.
+		 */
+		case RHO_INS_INT_BINOP: {
+			const unsigned int op = GET_ARG();
+			v2 = STACK_POP();
+			v1 = STACK_TOP();
+			STACK_SET_TOP(rho_op_int_binop(op, v1, v2));
+			break;
+		}
+		case RHO_INS_FLOAT_BINOP: {
+			const unsigned int op = GET_ARG();
+			v2 = STACK_POP();
+			v1 = STACK_TOP();
+			STACK_SET_TOP(rho_op_float_binop(op, v1, v2));
+			break;
+		}
+		case RHO_INS_RANGE_INIT: {
+			/*
+			 * Replaces the range bounds on the stack with the loop
+			 * variable's first value and the value that ends the loop
+			 * (i.e. exclusive upper bound or inclusive lower bound).
+			 */
+			v1 = STACK_SECOND();
+			v2 = STACK_TOP();
+
+			if (!(rho_isint(v1) && rho_isint(v2))) {
+				res = rho_type_exc_unsupported_2("..", rho_getclass(v1), rho_getclass(v2));
+				rho_release(STACK_POP());
+				goto error;
+			}
+
+			const long from = rho_intvalue(v1);
+			const long to = rho_intvalue(v2);
+			STACK_SET_TOP(rho_makeint(to >= from ? to : to - 1));
+			break;
+		}
+		case RHO_INS_FOR_RANGE: {
+			const unsigned int jmp = GET_ARG();
+			const unsigned int id = GET_UINT16();
+			const long i = rho_intvalue(STACK_SECOND());
+			const long stop = rho_intvalue(STACK_TOP());
+
+			if (i == stop) {
+				pos += jmp;
+			} else {
+				RhoValue old = locals[id];
+				locals[id] = rho_makeint(i);
+				rho_release(&old);
+				STACK_SET_SECOND(rho_makeint(i < stop ? i + 1 : i - 1));
+			}
+
+			break;
+		}
+		case RHO_INS_EXTENDED_ARG: {
+			ext = GET_UINT16() << 16;
+			break;
+		}
 		default: {
 			RHO_INTERNAL_ERROR();
 			break;
@@ -1707,9 +2218,8 @@ void rho_vm_eval_frame(RhoVM *vm)
 	case RHO_VAL_TYPE_EXC: {
 		if (EXC_STACK_EMPTY()) {
 			STACK_PURGE(stack_base);
+			rho_exc_traceback_append(&res, co, frame->pos);
 			rho_retain(&res);
-			RhoException *e = rho_objvalue(&res);
-			rho_exc_traceback_append(e, co->name, get_lineno(frame));
 			rho_frame_reset(frame);
 			frame->return_value = res;
 			return;
@@ -1724,7 +2234,7 @@ void rho_vm_eval_frame(RhoVM *vm)
 	}
 	case RHO_VAL_TYPE_ERROR: {
 		RhoError *e = rho_errvalue(&res);
-		rho_err_traceback_append(e, co->name, get_lineno(frame));
+		rho_err_traceback_append(e, co, frame->pos);
 		rho_frame_reset(frame);
 		STACK_PURGE(stack_base);
 		frame->return_value = res;
@@ -1747,6 +2257,7 @@ void rho_vm_eval_frame(RhoVM *vm)
 #undef STACK_POP
 #undef STACK_TOP
 #undef STACK_PUSH
+#undef JIT_ENTER
 }
 
 void rho_vm_register_module(const RhoModule *module)
@@ -1774,6 +2285,46 @@ static void vm_load_builtin_modules(void)
 	}
 }
 
+RhoValue rho_vm_get_builtin(const char *name)
+{
+	return rho_strdict_get_cstr(&builtins_dict, name);
+}
+
+RhoValue rho_vm_import(RhoVM *vm, const char *name)
+{
+	return vm_import(vm, name);
+}
+
+static pthread_once_t import_time_header_once = PTHREAD_ONCE_INIT;
+
+static void import_time_header(void)
+{
+	fprintf(stderr, "import time: load [us] | build [us] | exec [us] | module\n");
+}
+
+/*
+ * Reports how long importing a module took, as it completes (so
+ * after everything it imported); execution times include those of
+ * nested imports, which are indented under it.
+ */
+static void import_time_report(const char *name,
+                               const unsigned int depth,
+                               const double load_time,
+                               const double build_time,
+                               const double exec_time,
+                               const bool prefetched)
+{
+	pthread_once(&import_time_header_once, import_time_header);
+	fprintf(stderr,
+	        "import time: %9.0f | %10.0f | %9.0f | %*s%s%s\n",
+	        load_time * 1e6,
+	        build_time * 1e6,
+	        exec_time * 1e6,
+	        2 * (depth - 1), "",
+	        name,
+	        prefetched ? " (prefetched)" : "");
+}
+
 static RhoValue vm_import(RhoVM *vm, const char *name)
 {
 	RhoValue cached = rho_strdict_get_cstr(&import_cache, name);
@@ -1784,7 +2335,28 @@ static RhoValue vm_import(RhoVM *vm, const char *name)
 	}
 
 	RhoCode code;
-	int error = rho_load_from_file(name, false, &code);
+	const char *error_msg = NULL;
+	RhoVM *vm2 = NULL;
+	RhoCodeObject *co = NULL;
+	double load_time;
+	double build_time = 0;
+	int error;
+
+	struct rho_prefetch *pf = rho_prefetch_enabled ? rho_prefetch_take(name) : NULL;
+
+	if (pf != NULL) {
+		error = pf->error;
+		error_msg = pf->error_msg;
+		code = pf->code;
+		vm2 = pf->vm;
+		co = pf->co;
+		load_time = pf->load_time;
+		build_time = pf->build_time;
+	} else {
+		const double start = rho_util_time();
+		error = rho_load_module(name, &code, &error_msg);
+		load_time = rho_util_time() - start;
+	}
 
 	switch (error) {
 	case RHO_LOAD_ERR_NONE:
@@ -1800,76 +2372,45 @@ static RhoValue vm_import(RhoVM *vm, const char *name)
 	}
 	case RHO_LOAD_ERR_INVALID_SIGNATURE:
 		return rho_makeerr(rho_err_invalid_file_signature_error(name));
+	case RHO_LOAD_ERR_VERSION:
+		return rho_makeerr(rho_err_rhoc_version_error(name));
+	case RHO_LOAD_ERR_SYNTAX: {
+		RhoError *e = rho_err_module_syntax_error(name, error_msg);
+		RHO_FREE(error_msg);
+		return rho_makeerr(e);
+	}
+	case RHO_LOAD_ERR_WRITE:
+		return rho_makeerr(rho_err_module_write_error(name));
+	}
+
+	const double build_start = rho_util_time();
+
+	if (vm2 == NULL) {
+		vm2 = rho_vm_new();
+		RhoCode module_code = code;
+		co = rho_codeobj_make_toplevel(&module_code, "<module>", vm2);
 	}
 
-	RhoVM *vm2 = rho_vm_new();
+	vm2->head = code;
+	vm2->depth = vm->depth + 1;
 	rho_current_vm_set(vm2);
-	rho_vm_exec_code(vm2, &code);
+	vm_push_module_frame(vm2, co);
+	const double exec_start = rho_util_time();
+	vm_exec_module(vm2);
+	const double exec_end = rho_util_time();
+
 	RhoStrDict *exports = &vm2->exports;
 	RhoValue mod = rho_module_make(name, exports);
 	rho_strdict_put(&import_cache, name, &mod, false);
 	rho_current_vm_set(vm);
 	vm_link(vm, vm2);
 
-	rho_retain(&mod);
-	return mod;
-}
-
-static unsigned int get_lineno(RhoFrame *frame)
-{
-	const size_t raw_pos = frame->pos;
-	RhoCodeObject *co = frame->co;
-	struct rho_code_cache *cache = co->cache;
-
-	if (cache[raw_pos].lineno != 0) {
-		return cache[raw_pos].lineno;
+	if (rho_import_time_enabled) {
+		build_time += exec_start - build_start;
+		import_time_report(name, vm2->depth, load_time, build_time, exec_end - exec_start, pf != NULL);
 	}
 
-	byte *bc = co->bc;
-	const byte *lno_table = co->lno_table;
-	const size_t first_lineno = co->first_lineno;
-
-	byte *p = bc;
-	byte *dest = &bc[raw_pos];
-	size_t ins_pos = 0;
-
-	/* translate raw position into actual instruction position */
-	while (p != dest) {
-		++ins_pos;
-		const int size = rho_opcode_arg_size(*p);
-
-		if (size < 0) {
-			RHO_INTERNAL_ERROR();
-		}
-
-		p += size + 1;
-
-		if (p > dest) {
-			RHO_INTERNAL_ERROR();
-		}
-	}
-
-	unsigned int lineno_offset = 0;
-	size_t ins_offset = 0;
-	while (true) {
-		const byte ins_delta = *lno_table++;
-		const byte lineno_delta = *lno_table++;
-
-		if (ins_delta == 0 && lineno_delta == 0) {
-			break;
-		}
-
-		ins_offset += ins_delta;
-
-		if (ins_offset >= ins_pos) {
-			break;
-		}
-
-		lineno_offset += lineno_delta;
-	}
-
-	unsigned int lineno = first_lineno + lineno_offset;
-	cache[raw_pos].lineno = lineno;
-	return lineno;
+	rho_retain(&mod);
+	return mod;
 }
 
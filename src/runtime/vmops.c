@@ -10,6 +10,7 @@
 #include "exc.h"
 #include "err.h"
 #include "util.h"
+#include "opcodes.h"
 #include "vmops.h"
 
 /*
@@ -93,8 +94,8 @@ RhoValue rho_op_print(RhoValue *v, FILE *out)
 		break;
 	}
 	case RHO_VAL_TYPE_EXC: {
-		const RhoException *exc = rho_objvalue(v);
-		fprintf(out, "%s\n", exc->msg);
+		RhoException *exc = rho_objvalue(v);
+		fprintf(out, "%s\n", rho_exc_msg(exc));
 		break;
 	}
 	case RHO_VAL_TYPE_EMPTY:
@@ -317,6 +318,93 @@ MAKE_VM_CMPOP(gt, >)
 MAKE_VM_CMPOP(le, <=)
 MAKE_VM_CMPOP(ge, >=)
 
+/*
+ * Typed binary operations
+ * -----------------------
+ * These implement INT_BINOP and FLOAT_BINOP, which the compiler emits
+ * when both operands are known to be Ints (resp. Floats), so there is
+ * nothing to resolve. `op` is the opcode of the generic operation,
+ * whose result they reproduce exactly.
+ */
+
+static int float_cmp3(const double x, const double y)
+{
+	return (x < y) ? -1 : ((x == y) ? 0 : 1);
+}
+
+RhoValue rho_op_int_binop(const int op, RhoValue *a, RhoValue *b)
+{
+	const long x = rho_intvalue(a);
+	const long y = rho_intvalue(b);
+
+	switch (op) {
+	case RHO_INS_ADD:
+		return rho_makeint(x + y);
+	case RHO_INS_SUB:
+		return rho_makeint(x - y);
+	case RHO_INS_MUL:
+		return rho_makeint(x * y);
+	case RHO_INS_BITAND:
+		return rho_makeint(x & y);
+	case RHO_INS_BITOR:
+		return rho_makeint(x | y);
+	case RHO_INS_XOR:
+		return rho_makeint(x ^ y);
+	case RHO_INS_SHIFTL:
+		return rho_makeint(x << y);
+	case RHO_INS_SHIFTR:
+		return rho_makeint(x >> y);
+	case RHO_INS_EQUAL:
+		return rho_makebool(x == y);
+	case RHO_INS_NOTEQ:
+		return rho_makebool(x != y);
+	case RHO_INS_LT:
+		return rho_makeint(x < y);
+	case RHO_INS_GT:
+		return rho_makeint(x > y);
+	case RHO_INS_LE:
+		return rho_makeint(x <= y);
+	case RHO_INS_GE:
+		return rho_makeint(x >= y);
+	default:
+		RHO_INTERNAL_ERROR();
+		return rho_makeempty();
+	}
+}
+
+RhoValue rho_op_float_binop(const int op, RhoValue *a, RhoValue *b)
+{
+	const double x = rho_floatvalue(a);
+	const double y = rho_floatvalue(b);
+
+	switch (op) {
+	case RHO_INS_ADD:
+		return rho_makefloat(x + y);
+	case RHO_INS_SUB:
+		return rho_makefloat(x - y);
+	case RHO_INS_MUL:
+		return rho_makefloat(x * y);
+	case RHO_INS_DIV:
+		return rho_makefloat(x / y);
+	case RHO_INS_EQUAL:
+		return rho_makebool(x == y);
+	case RHO_INS_NOTEQ:
+		return rho_makebool(!(x == y));
+	/* ordering goes through a three-way comparison, as Float's `cmp` does */
+	case RHO_INS_LT:
+		return rho_makeint(float_cmp3(x, y) < 0);
+	case RHO_INS_GT:
+		return rho_makeint(float_cmp3(x, y) > 0);
+	case RHO_INS_LE:
+		return rho_makeint(float_cmp3(x, y) <= 0);
+	case RHO_INS_GE:
+		return rho_makeint(float_cmp3(x, y) >= 0);
+	default:
+		RHO_INTERNAL_ERROR();
+		return rho_makeempty();
+	}
+}
+
 /*
  * Other unary operations
  * ----------------------
@@ -9,6 +9,11 @@
 #include "object.h"
 #include "exc.h"
 #include "util.h"
+#include "listobject.h"
+#include "tupleobject.h"
+#include "setobject.h"
+#include "dictobject.h"
+#include "iter.h"
 #include "actor.h"
 
 static struct rho_mailbox_node *make_node(RhoValue *v)
@@ -29,6 +34,7 @@ void rho_mailbox_init(struct rho_mailbox *mb)
 
 	RHO_SAFE(pthread_mutex_init(&mb->mutex, NULL));
 	RHO_SAFE(pthread_cond_init(&mb->cond, NULL));
+	mb->shared = false;
 }
 
 void rho_mailbox_push(struct rho_mailbox *mb, RhoValue *v)
@@ -42,8 +48,35 @@ void rho_mailbox_push(struct rho_mailbox *mb, RhoValue *v)
 	RHO_SAFE(pthread_mutex_unlock(&mb->mutex));
 }
 
+/*
+ * A shared mailbox can be popped by several threads at
+ * once, so the lock-free fast path below can't be used.
+ * The value also has to be read out before unlocking,
+ * since another consumer may free its node right after.
+ */
+static RhoValue mailbox_pop_shared(struct rho_mailbox *mb)
+{
+	RHO_SAFE(pthread_mutex_lock(&mb->mutex));
+	while (mb->tail->next == NULL) {
+		RHO_SAFE(pthread_cond_wait(&mb->cond, &mb->mutex));
+	}
+
+	struct rho_mailbox_node *tail = mb->tail;
+	struct rho_mailbox_node *next = tail->next;
+	RhoValue value = next->value;
+	mb->tail = next;
+	RHO_SAFE(pthread_mutex_unlock(&mb->mutex));
+
+	free(tail);
+	return value;
+}
+
 RhoValue rho_mailbox_pop(struct rho_mailbox *mb)
 {
+	if (mb->shared) {
+		return mailbox_pop_shared(mb);
+	}
+
 	struct rho_mailbox_node *tail = mb->tail;
 	struct rho_mailbox_node *next = tail->next;
 
@@ -174,13 +207,19 @@ RhoValue rho_actor_make(RhoActorProxy *gp)
 	ao->frame = frame;
 	ao->vm = rho_vm_new();
 	ao->retval = rho_makeempty();
+	ao->init_locals = (struct rho_value_array){.array = NULL, .length = 0};
+	ao->max_restarts = 0;
+	ao->n_restarts = 0;
+	ao->restart_period = 0;
 	ao->state = RHO_ACTOR_STATE_READY;
 	ao->next = NULL;
 	ao->prev = NULL;
+	ao->supervised = 0;
 	return rho_makeobj(ao);
 }
 
 static void release_defaults(RhoActorProxy *ap);
+static void release_init_locals(RhoActorObject *ao);
 
 static void actor_proxy_free(RhoValue *this)
 {
@@ -203,6 +242,7 @@ static void actor_free(RhoValue *this)
 	rho_releaseo(ao->co);
 	rho_frame_free(ao->frame);
 	rho_vm_free(ao->vm);
+	release_init_locals(ao);
 
 	if (ao->retval.type == RHO_VAL_TYPE_ERROR) {
 		rho_err_free(rho_errvalue(&ao->retval));
@@ -268,6 +308,107 @@ static RhoValue actor_proxy_call(RhoValue *this,
 	return rho_makeobj(go);
 }
 
+/*
+ * Supervision
+ *
+ * A supervised actor that fails (i.e. whose code results in
+ * an uncaught error or exception) is restarted in place: its
+ * frame is reset and re-evaluated on the same thread and VM,
+ * with the arguments it was originally called with. Nothing
+ * is reallocated, so a restart costs little more than the
+ * initial call. Restarts are "one-for-one": only the failed
+ * actor is restarted, even if it is a member of a pool.
+ *
+ * If an actor fails more than `max_restarts` times within
+ * `restart_period` milliseconds, it is not restarted again,
+ * and finishes with the error as its return value.
+ */
+
+static void release_init_locals(RhoActorObject *ao)
+{
+	RhoValue *init_locals = ao->init_locals.array;
+
+	if (init_locals == NULL) {
+		return;
+	}
+
+	const size_t n_locals = ao->init_locals.length;
+	for (size_t i = 0; i < n_locals; i++) {
+		rho_release(&init_locals[i]);
+	}
+
+	free(init_locals);
+	ao->init_locals = (struct rho_value_array){.array = NULL, .length = 0};
+}
+
+static void save_init_locals(RhoActorObject *ao)
+{
+	release_init_locals(ao);
+
+	RhoFrame *frame = ao->frame;
+	const size_t n_locals = frame->n_locals;
+	ao->init_locals.array = rho_malloc(n_locals * sizeof(RhoValue));
+	ao->init_locals.length = n_locals;
+
+	for (size_t i = 0; i < n_locals; i++) {
+		ao->init_locals.array[i] = frame->locals[i];
+		rho_retain(&frame->locals[i]);
+	}
+}
+
+static void restore_init_locals(RhoActorObject *ao)
+{
+	RhoFrame *frame = ao->frame;
+	const size_t n_locals = ao->init_locals.length;
+
+	for (size_t i = 0; i < n_locals; i++) {
+		rho_release(&frame->locals[i]);
+		frame->locals[i] = ao->init_locals.array[i];
+		rho_retain(&frame->locals[i]);
+	}
+}
+
+static long elapsed_ms(struct timespec *from, struct timespec *to)
+{
+	return (to->tv_sec - from->tv_sec)*1000 + (to->tv_nsec - from->tv_nsec)/1000000;
+}
+
+static bool should_restart(RhoActorObject *ao)
+{
+	if (!ao->supervised) {
+		return false;
+	}
+
+	struct timespec now;
+	RHO_SAFE(clock_gettime(CLOCK_MONOTONIC, &now));
+
+	if (ao->n_restarts == 0 || elapsed_ms(&ao->restart_window_start, &now) > ao->restart_period) {
+		ao->restart_window_start = now;
+		ao->n_restarts = 0;
+	}
+
+	return ++ao->n_restarts <= ao->max_restarts;
+}
+
+static void report_failure(RhoActorObject *ao, RhoValue *err)
+{
+	fprintf(stderr, "Actor '%s' failed (restarting):\n", ao->co->name);
+
+	if (rho_isexc(err)) {
+		RhoException *e = (RhoException *)rho_objvalue(err);
+		rho_exc_traceback_print(e, stderr);
+		rho_exc_print_msg(e, stderr);
+		rho_release(err);
+	} else {
+		RhoError *e = rho_errvalue(err);
+		rho_err_traceback_print(e, stderr);
+		rho_err_print_msg(e, stderr);
+		rho_err_free(e);
+	}
+
+	*err = rho_makeempty();
+}
+
 static void *actor_start_routine(void *args)
 {
 	RhoActorObject *ao = args;
@@ -280,7 +421,17 @@ static void *actor_start_routine(void *args)
 	frame->co = co;
 
 	rho_vm_push_frame_direct(vm, frame);
-	rho_vm_eval_frame(vm);
+	while (true) {
+		rho_vm_eval_frame(vm);
+
+		if (!rho_iserror(&frame->return_value) || !should_restart(ao)) {
+			break;
+		}
+
+		/* the error path has already reset the frame */
+		report_failure(ao, &frame->return_value);
+		restore_init_locals(ao);
+	}
 	ao->retval = frame->return_value;
 	rho_vm_pop_frame(vm);
 
@@ -391,6 +542,22 @@ static RhoValue actor_join(RhoValue *this,
 #undef NAME
 }
 
+/*
+ * Pushes a message with the given contents onto `mb`,
+ * and returns a new reference to the message's future.
+ */
+static RhoValue send_message(struct rho_mailbox *mb, RhoValue *contents, const bool moved)
+{
+	RhoValue msg_v = rho_message_make(contents);
+	RhoMessage *msg = rho_objvalue(&msg_v);
+	msg->moved = moved;
+	RhoFutureObject *future = msg->future;
+	rho_retaino(future);  /* retain before the receiver can reply and release */
+	rho_mailbox_push(mb, &msg_v);
+	rho_releaseo(msg);
+	return rho_makeobj(future);
+}
+
 static RhoValue actor_send(RhoValue *this,
                            RhoValue *args,
                            RhoValue *args_named,
@@ -405,13 +572,396 @@ static RhoValue actor_send(RhoValue *this,
 
 	RhoActorObject *ao = rho_objvalue(this);
 	STATE_CHECK_NOT_FINISHED(ao);
-	RhoValue msg_v = rho_message_make(&args[0]);
-	RhoMessage *msg = rho_objvalue(&msg_v);
-	rho_mailbox_push(&ao->mailbox, &msg_v);
-	RhoFutureObject *future = msg->future;
-	rho_retaino(future);
-	rho_releaseo(msg);
-	return rho_makeobj(future);
+	return send_message(&ao->mailbox, &args[0], false);
+
+#undef NAME
+}
+
+/*
+ * Move semantics for messages
+ *
+ * A value sent via `send_move()` is handed over to the receiving actor
+ * rather than shared with it. If the sender holds the only reference to
+ * every mutable container reachable from the value, the containers are
+ * transferred as-is; otherwise, a deep copy of the mutable part of the
+ * object graph is made and that copy is transferred instead. Either way,
+ * the receiving thread claims ownership of the containers (by rewriting
+ * their saved thread IDs) when it first reads the message contents.
+ *
+ * Immutable values (strings, tuples of immutable values, etc.) and
+ * objects that have been `safe()`'d are shared as usual.
+ */
+
+#define MOVE_MAX_DEPTH 1000
+
+static bool is_movable_class(RhoClass *class)
+{
+	return class == &rho_list_class ||
+	       class == &rho_dict_class ||
+	       class == &rho_set_class ||
+	       class == &rho_tuple_class ||
+	       class == &rho_range_class;
+}
+
+static bool move_is_unique(RhoValue *v, unsigned int depth)
+{
+	if (!rho_isobject(v)) {
+		return true;
+	}
+
+	RhoObject *o = rho_objvalue(v);
+	RhoClass *class = o->class;
+
+	if (!is_movable_class(class) || o->monitor != 0) {
+		return true;
+	}
+
+	if (o->refcnt != 1 || depth > MOVE_MAX_DEPTH) {
+		return false;
+	}
+
+	if (class == &rho_list_class) {
+		RhoListObject *list = (RhoListObject *)o;
+		for (size_t i = 0; i < list->count; i++) {
+			if (!move_is_unique(&list->elements[i], depth + 1)) {
+				return false;
+			}
+		}
+	} else if (class == &rho_tuple_class) {
+		RhoTupleObject *tup = (RhoTupleObject *)o;
+		for (size_t i = 0; i < tup->count; i++) {
+			if (!move_is_unique(&tup->elements[i], depth + 1)) {
+				return false;
+			}
+		}
+	} else if (class == &rho_dict_class) {
+		RhoDictObject *dict = (RhoDictObject *)o;
+		for (size_t i = 0; i < dict->capacity; i++) {
+			for (struct rho_dict_entry *e = dict->entries[i]; e != NULL; e = e->next) {
+				if (!move_is_unique(&e->key, depth + 1) || !move_is_unique(&e->value, depth + 1)) {
+					return false;
+				}
+			}
+		}
+	} else if (class == &rho_set_class) {
+		RhoSetObject *set = (RhoSetObject *)o;
+		for (size_t i = 0; i < set->capacity; i++) {
+			for (struct rho_set_entry *e = set->entries[i]; e != NULL; e = e->next) {
+				if (!move_is_unique(&e->element, depth + 1)) {
+					return false;
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+static RhoValue move_copy(RhoValue *v, unsigned int depth);
+
+static RhoValue move_copy_array(RhoValue *src, const size_t count, RhoValue *dst, unsigned int depth)
+{
+	for (size_t i = 0; i < count; i++) {
+		RhoValue copy = move_copy(&src[i], depth + 1);
+
+		if (rho_iserror(&copy)) {
+			for (size_t j = 0; j < i; j++) {
+				rho_release(&dst[j]);
+			}
+			return copy;
+		}
+
+		dst[i] = copy;
+	}
+
+	return rho_makeempty();
+}
+
+/*
+ * Returns a new reference to a copy of `v` that shares no
+ * mutable, thread-confined state with the original.
+ */
+static RhoValue move_copy(RhoValue *v, unsigned int depth)
+{
+	if (!rho_isobject(v)) {
+		return *v;
+	}
+
+	RhoObject *o = rho_objvalue(v);
+	RhoClass *class = o->class;
+
+	if (!is_movable_class(class) || o->monitor != 0) {
+		rho_retain(v);
+		return *v;
+	}
+
+	if (depth > MOVE_MAX_DEPTH) {
+		return RHO_ACTOR_EXC("message is too deeply nested (or cyclic) to be copied");
+	}
+
+	if (class == &rho_list_class) {
+		RhoListObject *list = (RhoListObject *)o;
+		RHO_ENTER(list);
+		const size_t count = list->count;
+		RhoValue *elements = rho_malloc(count * sizeof(RhoValue));
+		RhoValue status = move_copy_array(list->elements, count, elements, depth);
+		RHO_EXIT(list);
+
+		if (rho_iserror(&status)) {
+			free(elements);
+			return status;
+		}
+
+		RhoValue copy = rho_list_make(elements, count);
+		free(elements);
+		return copy;
+	} else if (class == &rho_tuple_class) {
+		RhoTupleObject *tup = (RhoTupleObject *)o;
+		const size_t count = tup->count;
+		RhoValue *elements = rho_malloc(count * sizeof(RhoValue));
+		RhoValue status = move_copy_array(tup->elements, count, elements, depth);
+
+		if (rho_iserror(&status)) {
+			free(elements);
+			return status;
+		}
+
+		RhoValue copy = rho_tuple_make(elements, count);
+		free(elements);
+		return copy;
+	} else if (class == &rho_dict_class) {
+		RhoDictObject *dict = (RhoDictObject *)o;
+		RHO_ENTER(dict);
+		const size_t size = 2*dict->count;
+		RhoValue *entries = rho_malloc(size * sizeof(RhoValue));
+		size_t n = 0;
+
+		for (size_t i = 0; i < dict->capacity; i++) {
+			for (struct rho_dict_entry *e = dict->entries[i]; e != NULL; e = e->next) {
+				RhoValue status = move_copy_array(&e->key, 1, &entries[n], depth);
+
+				if (!rho_iserror(&status)) {
+					status = move_copy_array(&e->value, 1, &entries[n + 1], depth);
+
+					if (rho_iserror(&status)) {
+						rho_release(&entries[n]);
+					}
+				}
+
+				if (rho_iserror(&status)) {
+					RHO_EXIT(dict);
+					for (size_t j = 0; j < n; j++) {
+						rho_release(&entries[j]);
+					}
+					free(entries);
+					return status;
+				}
+
+				n += 2;
+			}
+		}
+		RHO_EXIT(dict);
+
+		RhoValue copy = rho_dict_make(entries, size);
+		free(entries);
+		return copy;
+	} else if (class == &rho_set_class) {
+		RhoSetObject *set = (RhoSetObject *)o;
+		RHO_ENTER(set);
+		const size_t size = set->count;
+		RhoValue *elements = rho_malloc(size * sizeof(RhoValue));
+		size_t n = 0;
+
+		for (size_t i = 0; i < set->capacity; i++) {
+			for (struct rho_set_entry *e = set->entries[i]; e != NULL; e = e->next) {
+				RhoValue status = move_copy_array(&e->element, 1, &elements[n], depth);
+
+				if (rho_iserror(&status)) {
+					RHO_EXIT(set);
+					for (size_t j = 0; j < n; j++) {
+						rho_release(&elements[j]);
+					}
+					free(elements);
+					return status;
+				}
+
+				++n;
+			}
+		}
+		RHO_EXIT(set);
+
+		RhoValue copy = rho_set_make(elements, size);
+		free(elements);
+		return copy;
+	} else {
+		RhoRange *range = (RhoRange *)o;
+		RhoValue from = rho_makeint(range->i);
+		RhoValue to = rho_makeint(range->to);
+		return rho_range_make(&from, &to);
+	}
+}
+
+/*
+ * Rewrites the owner of every thread-confined container
+ * reachable from `v` to be the calling thread.
+ */
+static void move_claim(RhoValue *v, unsigned int depth)
+{
+	if (!rho_isobject(v) || depth > MOVE_MAX_DEPTH) {
+		return;
+	}
+
+	RhoObject *o = rho_objvalue(v);
+	RhoClass *class = o->class;
+
+	if (!is_movable_class(class) || o->monitor != 0) {
+		return;
+	}
+
+	if (class == &rho_list_class) {
+		RhoListObject *list = (RhoListObject *)o;
+		RHO_INIT_SAVED_TID_FIELD(list);
+		for (size_t i = 0; i < list->count; i++) {
+			move_claim(&list->elements[i], depth + 1);
+		}
+	} else if (class == &rho_tuple_class) {
+		RhoTupleObject *tup = (RhoTupleObject *)o;
+		for (size_t i = 0; i < tup->count; i++) {
+			move_claim(&tup->elements[i], depth + 1);
+		}
+	} else if (class == &rho_dict_class) {
+		RhoDictObject *dict = (RhoDictObject *)o;
+		RHO_INIT_SAVED_TID_FIELD(dict);
+		for (size_t i = 0; i < dict->capacity; i++) {
+			for (struct rho_dict_entry *e = dict->entries[i]; e != NULL; e = e->next) {
+				move_claim(&e->key, depth + 1);
+				move_claim(&e->value, depth + 1);
+			}
+		}
+	} else if (class == &rho_set_class) {
+		RhoSetObject *set = (RhoSetObject *)o;
+		RHO_INIT_SAVED_TID_FIELD(set);
+		for (size_t i = 0; i < set->capacity; i++) {
+			for (struct rho_set_entry *e = set->entries[i]; e != NULL; e = e->next) {
+				move_claim(&e->element, depth + 1);
+			}
+		}
+	} else {
+		RhoRange *range = (RhoRange *)o;
+		RHO_INIT_SAVED_TID_FIELD(range);
+	}
+}
+
+void rho_actor_claim(RhoValue *v)
+{
+	move_claim(v, 0);
+}
+
+static RhoValue send_message_move(struct rho_mailbox *mb, RhoValue *v)
+{
+	RhoValue contents;
+
+	if (move_is_unique(v, 0)) {
+		contents = *v;
+		rho_retain(&contents);
+	} else {
+		contents = move_copy(v, 0);
+
+		if (rho_iserror(&contents)) {
+			return contents;
+		}
+	}
+
+	RhoValue future = send_message(mb, &contents, true);
+	rho_release(&contents);
+	return future;
+}
+
+static RhoValue actor_send_move(RhoValue *this,
+                                RhoValue *args,
+                                RhoValue *args_named,
+                                size_t nargs,
+                                size_t nargs_named)
+{
+#define NAME "send_move"
+
+	RHO_UNUSED(args_named);
+	RHO_NO_NAMED_ARGS_CHECK(NAME, nargs_named);
+	RHO_ARG_COUNT_CHECK(NAME, nargs, 1);
+
+	RhoActorObject *ao = rho_objvalue(this);
+	STATE_CHECK_NOT_FINISHED(ao);
+	return send_message_move(&ao->mailbox, &args[0]);
+
+#undef NAME
+}
+
+#undef MOVE_MAX_DEPTH
+
+/*
+ * Validates the arguments of `supervise()`, which are the
+ * maximum number of restarts and, optionally, the period
+ * in milliseconds over which they are counted.
+ */
+static RhoValue supervise_args(const char *name,
+                               RhoValue *args,
+                               size_t nargs,
+                               unsigned int *max_restarts,
+                               long *restart_period)
+{
+	for (size_t i = 0; i < nargs; i++) {
+		if (!rho_isint(&args[i])) {
+			RhoClass *class = rho_getclass(&args[i]);
+			return RHO_TYPE_EXC("%s() takes integer arguments (got a %s)", name, class->name);
+		}
+
+		if (rho_intvalue(&args[i]) < 0) {
+			return RHO_TYPE_EXC("%s() got a negative argument", name);
+		}
+	}
+
+	*max_restarts = rho_intvalue(&args[0]);
+	*restart_period = (nargs > 1) ? rho_intvalue(&args[1]) : RHO_ACTOR_DEFAULT_RESTART_PERIOD;
+	return rho_makenull();
+}
+
+static void actor_supervise_direct(RhoActorObject *ao, const unsigned int max_restarts, const long restart_period)
+{
+	save_init_locals(ao);
+	ao->max_restarts = max_restarts;
+	ao->restart_period = restart_period;
+	ao->n_restarts = 0;
+	ao->supervised = 1;
+}
+
+static RhoValue actor_supervise(RhoValue *this,
+                                RhoValue *args,
+                                RhoValue *args_named,
+                                size_t nargs,
+                                size_t nargs_named)
+{
+#define NAME "supervise"
+
+	RHO_UNUSED(args_named);
+	RHO_NO_NAMED_ARGS_CHECK(NAME, nargs_named);
+	RHO_ARG_COUNT_CHECK_BETWEEN(NAME, nargs, 1, 2);
+
+	RhoActorObject *ao = rho_objvalue(this);
+
+	if (ao->state != RHO_ACTOR_STATE_READY) {
+		return RHO_ACTOR_EXC("cannot supervise an actor that has already been started");
+	}
+
+	unsigned int max_restarts;
+	long restart_period;
+	RhoValue status = supervise_args(NAME, args, nargs, &max_restarts, &restart_period);
+
+	if (rho_iserror(&status)) {
+		return status;
+	}
+
+	actor_supervise_direct(ao, max_restarts, restart_period);
+	return rho_makenull();
 
 #undef NAME
 }
@@ -446,11 +996,315 @@ struct rho_attr_method actor_methods[] = {
 	{"check", actor_check},
 	{"join", actor_join},
 	{"send", actor_send},
+	{"send_move", actor_send_move},
+	{"supervise", actor_supervise},
 	{"stop", actor_stop},
 	{NULL, NULL}
 };
 
 
+/*
+ * Actor pools
+ *
+ * A pool is a group of identical actors that are all fed
+ * from one shared mailbox, so that each message is received
+ * by whichever member gets to it first. Pools are created
+ * via the `pool()` method of an actor definition, e.g.:
+ *
+ *     p = worker.pool(4, arg1, arg2)
+ *
+ * creates a pool of 4 `worker(arg1, arg2)` actors.
+ */
+
+static RhoValue actor_proxy_pool(RhoValue *this,
+                                 RhoValue *args,
+                                 RhoValue *args_named,
+                                 size_t nargs,
+                                 size_t nargs_named)
+{
+#define NAME "pool"
+
+	RHO_ARG_COUNT_CHECK_AT_LEAST(NAME, nargs, 1);
+
+	if (!rho_isint(&args[0])) {
+		RhoClass *class = rho_getclass(&args[0]);
+		return RHO_TYPE_EXC(NAME "() takes an integer as its first argument (got a %s)", class->name);
+	}
+
+	const long n_members = rho_intvalue(&args[0]);
+
+	if (n_members <= 0) {
+		return RHO_TYPE_EXC(NAME "() got a non-positive pool size");
+	}
+
+	RhoActorPool *pool = rho_obj_alloc(&rho_actor_pool_class);
+	rho_mailbox_init(&pool->mailbox);
+	pool->mailbox.shared = true;
+	pool->members = rho_malloc(n_members * sizeof(RhoActorObject *));
+	pool->n_members = 0;
+
+	for (long i = 0; i < n_members; i++) {
+		RhoValue member_v = actor_proxy_call(this, &args[1], args_named, nargs - 1, nargs_named);
+
+		if (rho_iserror(&member_v)) {
+			rho_releaseo(pool);
+			return member_v;
+		}
+
+		RhoActorObject *member = rho_objvalue(&member_v);
+		member->frame->mailbox = &pool->mailbox;
+		pool->members[pool->n_members++] = member;
+	}
+
+	return rho_makeobj(pool);
+
+#undef NAME
+}
+
+static void actor_pool_free(RhoValue *this)
+{
+	RhoActorPool *pool = rho_objvalue(this);
+	RhoActorObject **members = pool->members;
+	const size_t n_members = pool->n_members;
+
+	/*
+	 * Running members still refer to the shared mailbox,
+	 * so they must be stopped before it is deallocated.
+	 * Any member may take any kill message, so send one
+	 * for every member that was started; surplus ones are
+	 * simply released along with the mailbox.
+	 */
+	for (size_t i = 0; i < n_members; i++) {
+		if (members[i]->state != RHO_ACTOR_STATE_READY) {
+			RhoValue msg_v = rho_kill_message_make();
+			rho_mailbox_push(&pool->mailbox, &msg_v);
+			rho_release(&msg_v);
+		}
+	}
+
+	for (size_t i = 0; i < n_members; i++) {
+		RhoActorObject *member = members[i];
+
+		if (member->state == RHO_ACTOR_STATE_RUNNING) {
+			RHO_SAFE(pthread_join(member->thread, NULL));
+			actor_unlink(member);
+		}
+
+		rho_releaseo(member);
+	}
+
+	free(members);
+	rho_mailbox_dealloc(&pool->mailbox);
+	rho_obj_class.del(this);
+}
+
+#define POOL_CHECK_NOT_FINISHED(pool) \
+	if (pool_finished(pool)) \
+		return RHO_ACTOR_EXC("actor pool has been stopped")
+
+static bool pool_finished(RhoActorPool *pool)
+{
+	for (size_t i = 0; i < pool->n_members; i++) {
+		if (pool->members[i]->state != RHO_ACTOR_STATE_FINISHED) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static RhoValue actor_pool_start(RhoValue *this,
+                                 RhoValue *args,
+                                 RhoValue *args_named,
+                                 size_t nargs,
+                                 size_t nargs_named)
+{
+#define NAME "start"
+
+	RHO_UNUSED(args);
+	RHO_UNUSED(args_named);
+	RHO_NO_NAMED_ARGS_CHECK(NAME, nargs_named);
+	RHO_ARG_COUNT_CHECK(NAME, nargs, 0);
+
+	RhoActorPool *pool = rho_objvalue(this);
+
+	for (size_t i = 0; i < pool->n_members; i++) {
+		RhoValue status = rho_actor_start(pool->members[i]);
+
+		if (rho_iserror(&status)) {
+			return status;
+		}
+	}
+
+	return rho_makenull();
+
+#undef NAME
+}
+
+static RhoValue actor_pool_join(RhoValue *this,
+                                RhoValue *args,
+                                RhoValue *args_named,
+                                size_t nargs,
+                                size_t nargs_named)
+{
+#define NAME "join"
+
+	RHO_UNUSED(args);
+	RHO_UNUSED(args_named);
+	RHO_NO_NAMED_ARGS_CHECK(NAME, nargs_named);
+	RHO_ARG_COUNT_CHECK(NAME, nargs, 0);
+
+	RhoActorPool *pool = rho_objvalue(this);
+	RhoValue ret = rho_makenull();
+
+	for (size_t i = 0; i < pool->n_members; i++) {
+		if (pool->members[i]->state == RHO_ACTOR_STATE_READY) {
+			return RHO_ACTOR_EXC("cannot join non-running actor pool");
+		}
+	}
+
+	/* join every member, but only report the first failure */
+	for (size_t i = 0; i < pool->n_members; i++) {
+		RhoActorObject *ao = pool->members[i];
+		RHO_SAFE(pthread_join(ao->thread, NULL));
+		actor_unlink(ao);
+
+		if (rho_iserror(&ao->retval) && !rho_iserror(&ret)) {
+			ret = ao->retval;
+			if (ret.type == RHO_VAL_TYPE_ERROR) {
+				ao->retval = rho_makeempty();
+			} else {
+				rho_retain(&ret);
+			}
+		}
+	}
+
+	return ret;
+
+#undef NAME
+}
+
+static RhoValue actor_pool_send(RhoValue *this,
+                                RhoValue *args,
+                                RhoValue *args_named,
+                                size_t nargs,
+                                size_t nargs_named)
+{
+#define NAME "send"
+
+	RHO_UNUSED(args_named);
+	RHO_NO_NAMED_ARGS_CHECK(NAME, nargs_named);
+	RHO_ARG_COUNT_CHECK(NAME, nargs, 1);
+
+	RhoActorPool *pool = rho_objvalue(this);
+	POOL_CHECK_NOT_FINISHED(pool);
+	return send_message(&pool->mailbox, &args[0], false);
+
+#undef NAME
+}
+
+static RhoValue actor_pool_send_move(RhoValue *this,
+                                     RhoValue *args,
+                                     RhoValue *args_named,
+                                     size_t nargs,
+                                     size_t nargs_named)
+{
+#define NAME "send_move"
+
+	RHO_UNUSED(args_named);
+	RHO_NO_NAMED_ARGS_CHECK(NAME, nargs_named);
+	RHO_ARG_COUNT_CHECK(NAME, nargs, 1);
+
+	RhoActorPool *pool = rho_objvalue(this);
+	POOL_CHECK_NOT_FINISHED(pool);
+	return send_message_move(&pool->mailbox, &args[0]);
+
+#undef NAME
+}
+
+static RhoValue actor_pool_supervise(RhoValue *this,
+                                     RhoValue *args,
+                                     RhoValue *args_named,
+                                     size_t nargs,
+                                     size_t nargs_named)
+{
+#define NAME "supervise"
+
+	RHO_UNUSED(args_named);
+	RHO_NO_NAMED_ARGS_CHECK(NAME, nargs_named);
+	RHO_ARG_COUNT_CHECK_BETWEEN(NAME, nargs, 1, 2);
+
+	RhoActorPool *pool = rho_objvalue(this);
+
+	for (size_t i = 0; i < pool->n_members; i++) {
+		if (pool->members[i]->state != RHO_ACTOR_STATE_READY) {
+			return RHO_ACTOR_EXC("cannot supervise an actor pool that has already been started");
+		}
+	}
+
+	unsigned int max_restarts;
+	long restart_period;
+	RhoValue status = supervise_args(NAME, args, nargs, &max_restarts, &restart_period);
+
+	if (rho_iserror(&status)) {
+		return status;
+	}
+
+	for (size_t i = 0; i < pool->n_members; i++) {
+		actor_supervise_direct(pool->members[i], max_restarts, restart_period);
+	}
+
+	return rho_makenull();
+
+#undef NAME
+}
+
+static RhoValue actor_pool_stop(RhoValue *this,
+                                RhoValue *args,
+                                RhoValue *args_named,
+                                size_t nargs,
+                                size_t nargs_named)
+{
+#define NAME "stop"
+
+	RHO_UNUSED(args);
+	RHO_UNUSED(args_named);
+	RHO_NO_NAMED_ARGS_CHECK(NAME, nargs_named);
+	RHO_ARG_COUNT_CHECK(NAME, nargs, 0);
+
+	RhoActorPool *pool = rho_objvalue(this);
+	POOL_CHECK_NOT_FINISHED(pool);
+
+	/* one kill message per member; each member consumes exactly one */
+	for (size_t i = 0; i < pool->n_members; i++) {
+		RhoValue msg_v = rho_kill_message_make();
+		rho_mailbox_push(&pool->mailbox, &msg_v);
+		rho_release(&msg_v);
+	}
+
+	return rho_makenull();
+
+#undef NAME
+}
+
+#undef POOL_CHECK_NOT_FINISHED
+
+struct rho_attr_method actor_proxy_methods[] = {
+	{"pool", actor_proxy_pool},
+	{NULL, NULL}
+};
+
+struct rho_attr_method actor_pool_methods[] = {
+	{"start", actor_pool_start},
+	{"join", actor_pool_join},
+	{"send", actor_pool_send},
+	{"send_move", actor_pool_send_move},
+	{"supervise", actor_pool_supervise},
+	{"stop", actor_pool_stop},
+	{NULL, NULL}
+};
+
+
 /* messages and futures */
 
 RhoValue rho_future_make(void)
@@ -467,6 +1321,7 @@ RhoValue rho_message_make(RhoValue *contents)
 	RhoMessage *msg = rho_obj_alloc(&rho_message_class);
 	rho_retain(contents);
 	msg->contents = *contents;
+	msg->moved = 0;
 	RhoValue future = rho_future_make();
 	msg->future = rho_objvalue(&future);
 	return rho_makeobj(msg);
@@ -549,6 +1404,11 @@ static RhoValue future_get(RhoValue *this,
 		ts.tv_sec += ms/1000;
 		ts.tv_nsec += (ms % 1000) * 1000000;
 
+		if (ts.tv_nsec >= 1000000000) {
+			ts.tv_sec += 1;
+			ts.tv_nsec -= 1000000000;
+		}
+
 		RHO_SAFE(pthread_mutex_lock(&future->mutex));
 		while (rho_isempty(&future->value)) {
 			int n = pthread_cond_timedwait(&future->cond, &future->mutex, &ts);
@@ -593,6 +1453,12 @@ static RhoValue message_contents(RhoValue *this,
 	RHO_ARG_COUNT_CHECK(NAME, nargs, 0);
 
 	RhoMessage *msg = rho_objvalue(this);
+
+	if (msg->moved) {
+		move_claim(&msg->contents, 0);
+		msg->moved = 0;
+	}
+
 	rho_retain(&msg->contents);
 	return msg->contents;
 
@@ -613,20 +1479,20 @@ static RhoValue message_reply(RhoValue *this,
 
 	RhoMessage *msg = rho_objvalue(this);
 	RhoFutureObject *future = msg->future;
-	RhoValue ret;
 
-	RHO_SAFE(pthread_mutex_lock(&future->mutex));
-	if (future != NULL) {
-		future_set_value(future, &args[0]);
-		RHO_SAFE(pthread_cond_broadcast(&future->cond));
-		rho_releaseo(future);
-		msg->future = NULL;
-		ret = rho_makenull();
-	} else {
-		ret = RHO_ACTOR_EXC("cannot reply to the same message twice");
+	if (future == NULL) {
+		return RHO_ACTOR_EXC("cannot reply to the same message twice");
 	}
+
+	RHO_SAFE(pthread_mutex_lock(&future->mutex));
+	future_set_value(future, &args[0]);
+	RHO_SAFE(pthread_cond_broadcast(&future->cond));
 	RHO_SAFE(pthread_mutex_unlock(&future->mutex));
-	return ret;
+
+	/* release only after unlocking, since this may be the last reference */
+	msg->future = NULL;
+	rho_releaseo(future);
+	return rho_makenull();
 
 #undef NAME
 }
@@ -670,7 +1536,7 @@ RhoClass rho_actor_proxy_class = {
 	.seq_methods = NULL,
 
 	.members = NULL,
-	.methods = NULL,
+	.methods = actor_proxy_methods,
 
 	.attr_get = NULL,
 	.attr_set = NULL
@@ -707,6 +1573,37 @@ RhoClass rho_actor_class = {
 	.attr_set = NULL
 };
 
+RhoClass rho_actor_pool_class = {
+	.base = RHO_CLASS_BASE_INIT(),
+	.name = "ActorPool",
+	.super = &rho_obj_class,
+
+	.instance_size = sizeof(RhoActorPool),
+
+	.init = NULL,
+	.del = actor_pool_free,
+
+	.eq = NULL,
+	.hash = NULL,
+	.cmp = NULL,
+	.str = NULL,
+	.call = NULL,
+
+	.print = NULL,
+
+	.iter = NULL,
+	.iternext = NULL,
+
+	.num_methods = NULL,
+	.seq_methods = NULL,
+
+	.members = NULL,
+	.methods = actor_pool_methods,
+
+	.attr_get = NULL,
+	.attr_set = NULL
+};
+
 RhoClass rho_future_class = {
 	.base = RHO_CLASS_BASE_INIT(),
 	.name = "Future",
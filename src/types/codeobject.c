@@ -1,6 +1,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <pthread.h>
 #include "code.h"
 #include "compiler.h"
 #include "opcodes.h"
@@ -10,6 +11,7 @@
 #include "util.h"
 #include "exc.h"
 #include "err.h"
+#include "jit.h"
 #include "codeobject.h"
 
 /*
@@ -32,16 +34,100 @@
  *
  * Metadata layout:
  *
- *   - Code length in bytes, excluding metadata (uint16)
+ *   - Code length in bytes, excluding metadata (uint32)
  *   - Name (null-terminated string)
  *   - Argument count (uint16)
- *   - Value stack size (uint16)
+ *   - Value stack size (uint32)
+ *   - Try-catch depth (uint16)
  */
 
 static void read_lno_table(RhoCodeObject *co, RhoCode *code);
 static void read_sym_table(RhoCodeObject *co, RhoCode *code);
 static void read_const_table(RhoCodeObject *co, RhoCode *code);
 
+static pthread_mutex_t materialize_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static RhoCodeObject *codeobj_make_lazy(RhoCode *code,
+                                        const char *name,
+                                        unsigned int argcount,
+                                        int stack_depth,
+                                        int try_catch_depth,
+                                        RhoVM *vm)
+{
+	RhoCodeObject *co = rho_obj_alloc(&rho_co_class);
+	co->name = name;
+	co->vm = vm;
+	co->names = (struct rho_str_array){.array = NULL, .length = 0};
+	co->attrs = (struct rho_str_array){.array = NULL, .length = 0};
+	co->frees = (struct rho_str_array){.array = NULL, .length = 0};
+	co->consts = (struct rho_value_array){.array = NULL, .length = 0};
+	co->lno_table = NULL;
+	co->lno_checkpoints = NULL;
+	co->n_lno_checkpoints = 0;
+	co->first_lineno = 0;
+	co->hints = NULL;
+	co->bc = code->bc;
+	co->bc_size = code->size;
+	co->entry = NULL;
+	co->argcount = argcount;
+	co->stack_depth = stack_depth;
+	co->try_catch_depth = try_catch_depth;
+	co->frame = NULL;
+	co->cache = NULL;
+	atomic_init(&co->jit, NULL);
+	atomic_init(&co->materialized, false);
+	return co;
+}
+
+/*
+ * Reads a code object out of a constant table entry (see the
+ * metadata layout above), advancing `code` past it.
+ */
+static RhoCodeObject *read_codeobj_entry(RhoCode *code, RhoVM *vm)
+{
+	const byte *entry = code->bc;
+	const size_t code_len = rho_code_read_uint32(code);
+	const char *name = rho_code_read_str(code);
+	const unsigned int argcount = rho_code_read_uint16(code);
+	const unsigned int stack_depth = rho_code_read_uint32(code);
+	const unsigned int try_catch_depth = rho_code_read_uint16(code);
+
+	RhoCode sub;
+	sub.bc = code->bc;
+	sub.size = code_len;
+	sub.capacity = 0;
+	rho_code_skip_ahead(code, code_len);
+
+	RhoCodeObject *co = codeobj_make_lazy(&sub,
+	                                      name,
+	                                      argcount,
+	                                      stack_depth,
+	                                      try_catch_depth,
+	                                      vm);
+	co->entry = entry;
+	return co;
+}
+
+RhoCodeObject *rho_codeobj_make_from_entry(const byte *entry, RhoVM *vm)
+{
+	const size_t code_len = rho_util_read_uint32_from_stream((byte *)entry);
+	const size_t name_len = strlen((const char *)entry + 4);
+	const size_t entry_len = 4 + (name_len + 1) + 2 + 4 + 2 + code_len;
+	RhoCode code = {.bc = (byte *)entry, .size = entry_len, .capacity = 0};
+	return read_codeobj_entry(&code, vm);
+}
+
+static void codeobj_read_tables(RhoCodeObject *co)
+{
+	RhoCode code = {.bc = co->bc, .size = co->bc_size, .capacity = 0};
+	read_lno_table(co, &code);
+	read_sym_table(co, &code);
+	read_const_table(co, &code);
+	co->bc = code.bc;
+	co->bc_size = code.size;
+	co->cache = rho_calloc(code.size, sizeof(struct rho_code_cache));
+}
+
 /*
  * stack_depth = -1 means that the depth must be read
  * out of `code`.
@@ -53,28 +139,43 @@ RhoCodeObject *rho_codeobj_make(RhoCode *code,
                                 int try_catch_depth,
                                 RhoVM *vm)
 {
-	RhoCodeObject *co = rho_obj_alloc(&rho_co_class);
-	co->name = name;
-	co->vm = vm;
-	read_lno_table(co, code);
-	read_sym_table(co, code);
-	read_const_table(co, code);
-	co->hints = NULL;
-	co->bc = code->bc;
-	co->argcount = argcount;
-	co->stack_depth = stack_depth;
-	co->try_catch_depth = try_catch_depth;
-	co->frame = NULL;
-	co->cache = rho_calloc(code->size, sizeof(struct rho_code_cache));
+	RhoCodeObject *co = codeobj_make_lazy(code, name, argcount, stack_depth, try_catch_depth, vm);
+	codeobj_read_tables(co);
+	atomic_init(&co->materialized, true);
+	rho_code_skip_ahead(code, code->size - co->bc_size);
 	return co;
 }
 
+void rho_codeobj_materialize(RhoCodeObject *co)
+{
+	if (atomic_load_explicit(&co->materialized, memory_order_acquire)) {
+		return;
+	}
+
+	/* functions can be called by several actors at once */
+	pthread_mutex_lock(&materialize_mutex);
+
+	if (!atomic_load_explicit(&co->materialized, memory_order_relaxed)) {
+		codeobj_read_tables(co);
+		atomic_store_explicit(&co->materialized, true, memory_order_release);
+	}
+
+	pthread_mutex_unlock(&materialize_mutex);
+}
+
 RhoCodeObject *rho_codeobj_make_toplevel(RhoCode *code,
                                          const char *name,
                                          RhoVM *vm)
 {
-	unsigned int stack_depth = rho_code_read_uint16(code);
+	unsigned int stack_depth = rho_code_read_uint32(code);
 	unsigned int try_catch_depth = rho_code_read_uint16(code);
+
+	/*
+	 * The header flags only describe how the code was compiled;
+	 * the VM can execute register and stack instructions alike.
+	 */
+	rho_code_read_uint16(code);
+
 	return rho_codeobj_make(code, name, 0, stack_depth, try_catch_depth, vm);
 }
 
@@ -108,6 +209,68 @@ RhoValue rho_codeobj_init_hints(RhoCodeObject *co, RhoValue *types)
 	return rho_makeempty();
 }
 
+/*
+ * The line number table is keyed by byte offset, so the position is
+ * looked up directly: a binary search of the checkpoint index finds
+ * where to start reading the table, from which point at most
+ * RHO_LNO_CHECKPOINT_INTERVAL pairs need to be read.
+ */
+unsigned int rho_codeobj_lineno(RhoCodeObject *co, const size_t raw_pos)
+{
+	struct rho_code_cache *cache = co->cache;
+
+	if (cache[raw_pos].lineno != 0) {
+		return cache[raw_pos].lineno;
+	}
+
+	const byte *lno_table = co->lno_table;
+	size_t pos_offset = 0;
+	size_t lineno_offset = 0;
+
+	/* last checkpoint at or before `raw_pos`, if any */
+	byte *checkpoints = co->lno_checkpoints;
+	size_t lo = 0;
+	size_t hi = co->n_lno_checkpoints;
+
+	while (lo < hi) {
+		const size_t mid = lo + (hi - lo)/2;
+
+		if (rho_util_read_uint32_from_stream(&checkpoints[mid*RHO_LNO_CHECKPOINT_SIZE + 4]) <= raw_pos) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	if (lo > 0) {
+		byte *checkpoint = &checkpoints[(lo - 1)*RHO_LNO_CHECKPOINT_SIZE];
+		lno_table += rho_util_read_uint32_from_stream(checkpoint);
+		pos_offset = rho_util_read_uint32_from_stream(checkpoint + 4);
+		lineno_offset = rho_util_read_uint32_from_stream(checkpoint + 8);
+	}
+
+	while (true) {
+		const byte pos_delta = *lno_table++;
+		const byte lineno_delta = *lno_table++;
+
+		if (pos_delta == 0 && lineno_delta == 0) {
+			break;
+		}
+
+		pos_offset += pos_delta;
+
+		if (pos_offset > raw_pos) {
+			break;
+		}
+
+		lineno_offset += lineno_delta;
+	}
+
+	unsigned int lineno = co->first_lineno + lineno_offset;
+	cache[raw_pos].lineno = lineno;
+	return lineno;
+}
+
 static void codeobj_free(RhoValue *this)
 {
 	RhoCodeObject *co = rho_objvalue(this);
@@ -139,21 +302,24 @@ static void codeobj_free(RhoValue *this)
 	rho_frame_free(co->frame);
 
 	free(co->cache);
+	rho_jit_free(co);
 
 	rho_obj_class.del(this);
 }
 
 static void read_lno_table(RhoCodeObject *co, RhoCode *code)
 {
-	const unsigned int first_lineno = rho_code_read_uint16(code);
+	const unsigned int first_lineno = rho_code_read_uint32(code);
 
-	const size_t lno_table_size = rho_code_read_uint16(code);
+	const size_t lno_table_size = rho_code_read_uint32(code);
 	co->lno_table = code->bc;
 	co->first_lineno = first_lineno;
+	rho_code_skip_ahead(code, lno_table_size);
 
-	for (size_t i = 0; i < lno_table_size; i++) {
-		rho_code_read_byte(code);
-	}
+	const size_t n_checkpoints = rho_code_read_uint32(code);
+	co->lno_checkpoints = code->bc;
+	co->n_lno_checkpoints = n_checkpoints;
+	rho_code_skip_ahead(code, n_checkpoints * RHO_LNO_CHECKPOINT_SIZE);
 }
 
 /*
@@ -165,7 +331,7 @@ static void read_lno_table(RhoCodeObject *co, RhoCode *code)
  *
  * "Table" in this context refers to the following format:
  *
- *   - 2 bytes: number of table entries (N)
+ *   - 4 bytes: number of table entries (N)
  *   - N null-terminated strings
  *
  * Example table: 2 0 'f' 'o' 'o' 0 'b' 'a' 'r' 0
@@ -175,13 +341,10 @@ static void read_sym_table(RhoCodeObject *co, RhoCode *code)
 	assert(rho_code_read_byte(code) == RHO_ST_ENTRY_BEGIN);
 
 	byte *symtab_bc = code->bc;  /* this is where the table is located */
-
-	while (rho_code_read_byte(code) != RHO_ST_ENTRY_END);  /* get past the symbol table */
-
 	size_t off = 0;
 
-	const size_t n_locals = rho_util_read_uint16_from_stream(symtab_bc);
-	off += 2;
+	const size_t n_locals = rho_util_read_uint32_from_stream(symtab_bc);
+	off += 4;
 
 	struct rho_str_array names;
 	names.array = rho_malloc(sizeof(*names.array) * n_locals);
@@ -201,8 +364,8 @@ static void read_sym_table(RhoCodeObject *co, RhoCode *code)
 		off += len + 1;
 	}
 
-	const size_t n_attrs = rho_util_read_uint16_from_stream(symtab_bc + off);
-	off += 2;
+	const size_t n_attrs = rho_util_read_uint32_from_stream(symtab_bc + off);
+	off += 4;
 
 	struct rho_str_array attrs;
 	attrs.array = rho_malloc(sizeof(*attrs.array) * n_attrs);
@@ -222,8 +385,8 @@ static void read_sym_table(RhoCodeObject *co, RhoCode *code)
 		off += len + 1;
 	}
 
-	const size_t n_frees = rho_util_read_uint16_from_stream(symtab_bc + off);
-	off += 2;
+	const size_t n_frees = rho_util_read_uint32_from_stream(symtab_bc + off);
+	off += 4;
 
 	struct rho_str_array frees;
 	frees.array = rho_malloc(sizeof(*frees.array) * n_frees);
@@ -243,6 +406,10 @@ static void read_sym_table(RhoCodeObject *co, RhoCode *code)
 		off += len + 1;
 	}
 
+	/* get past the symbol table (the counts may contain ST_ENTRY_END bytes) */
+	assert(symtab_bc[off] == RHO_ST_ENTRY_END);
+	rho_code_skip_ahead(code, off + 1);
+
 	co->names = names;
 	co->attrs = attrs;
 	co->frees = frees;
@@ -253,7 +420,7 @@ static void read_const_table(RhoCodeObject *co, RhoCode *code)
 	/* read the constant table */
 	assert(rho_code_read_byte(code) == RHO_CT_ENTRY_BEGIN);
 
-	const size_t ct_size = rho_code_read_uint16(code);
+	const size_t ct_size = rho_code_read_uint32(code);
 	RhoValue *constants = rho_malloc(ct_size * sizeof(RhoValue));
 
 	for (size_t i = 0; i < ct_size; i++) {
@@ -275,44 +442,18 @@ static void read_const_table(RhoCodeObject *co, RhoCode *code)
 			constants[i].type = RHO_VAL_TYPE_OBJECT;
 
 			/*
-			 * We read this string manually so we have
-			 * access to its length:
+			 * The string is used in place, as the code outlives
+			 * everything that is made out of it (see loader.c):
 			 */
-			size_t str_len = 0;
-
-			while (code->bc[str_len] != '\0') {
-				++str_len;
-			}
-
-			char *str = rho_malloc(str_len + 1);
-			for (size_t j = 0; j < str_len; j++) {
-				str[j] = rho_code_read_byte(code);
-			}
-			str[str_len] = '\0';
-			rho_code_read_byte(code);  /* skip the string termination byte */
-			constants[i] = rho_strobj_make(RHO_STR_INIT(str, str_len, 1));
+			const char *str = (const char *)code->bc;
+			const size_t str_len = strlen(str);
+			rho_code_skip_ahead(code, str_len + 1);
+			constants[i] = rho_strobj_make(RHO_STR_INIT(str, str_len, 0));
 			break;
 		}
 		case RHO_CT_ENTRY_CODEOBJ: {
 			constants[i].type = RHO_VAL_TYPE_OBJECT;
-			const size_t code_len = rho_code_read_uint16(code);
-			const char *name = rho_code_read_str(code);
-			const unsigned int argcount = rho_code_read_uint16(code);
-			const unsigned int stack_depth = rho_code_read_uint16(code);
-			const unsigned int try_catch_depth = rho_code_read_uint16(code);
-
-			RhoCode sub;
-			sub.bc = code->bc;
-			sub.size = code_len;
-			sub.capacity = 0;
-			rho_code_skip_ahead(code, code_len);
-
-			constants[i].data.o = rho_codeobj_make(&sub,
-			                                       name,
-			                                       argcount,
-			                                       stack_depth,
-			                                       try_catch_depth,
-			                                       co->vm);
+			constants[i].data.o = read_codeobj_entry(code, co->vm);
 			break;
 		}
 		case RHO_CT_ENTRY_END:
@@ -343,6 +484,7 @@ RhoValue rho_codeobj_load_args(RhoCodeObject *co,
 				rho_release(&locals[i]); \
 	} while (0)
 
+	rho_codeobj_materialize(co);
 	const unsigned int argcount = co->argcount;
 
 	if (nargs > argcount) {
@@ -0,0 +1,598 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <pthread.h>
+#include "exc.h"
+#include "err.h"
+#include "vmops.h"
+#include "object.h"
+#include "dictobject.h"
+#include "util.h"
+#include "concdictobject.h"
+
+/*
+ * Concurrent dicts
+ *
+ * Each key belongs to the stripe selected by the top bits of
+ * its hash after mixing (the bottom bits select the bucket
+ * within that stripe's dict), and every access to a stripe
+ * holds its lock.
+ * Stripe dicts are only ever accessed through the `_hashed`
+ * dict functions, so the key is hashed once per operation and
+ * the thread-confinement checks of ordinary dicts don't apply.
+ *
+ * Whole-dict operations (len, str, iteration) visit the stripes
+ * one at a time, so they observe a consistent view of each
+ * stripe but not necessarily of the dict as a whole. Iteration
+ * runs over a snapshot taken when the iterator is created.
+ */
+
+typedef struct rho_concdict_stripe Stripe;
+
+static void stripes_dealloc(RhoConcDictObject *cd);
+
+unsigned int rho_concdict_stripe_index(const int hash)
+{
+	/*
+	 * Dict hashes leave the top bits of small Int and short Str
+	 * hashes all but unchanged, so they are spread across all bits
+	 * (by Fibonacci hashing) before the stripe is taken from them.
+	 */
+	const unsigned int shift = (sizeof(unsigned int) * CHAR_BIT) - RHO_CONCDICT_STRIPE_BITS;
+	return ((unsigned int)hash * 0x9E3779B9u) >> shift;
+}
+
+static Stripe *stripe_for(RhoConcDictObject *cd, const int hash)
+{
+	return &cd->stripes[rho_concdict_stripe_index(hash)];
+}
+
+static void stripe_lock(Stripe *stripe)
+{
+	RHO_SAFE(pthread_mutex_lock(&stripe->mutex));
+}
+
+static void stripe_unlock(Stripe *stripe)
+{
+	RHO_SAFE(pthread_mutex_unlock(&stripe->mutex));
+}
+
+/*
+ * Whether `a` and `b` are the very same value (as opposed to
+ * merely equal ones).
+ */
+static bool same_value(RhoValue *a, RhoValue *b)
+{
+	if (a->type != b->type) {
+		return false;
+	}
+
+	switch (a->type) {
+	case RHO_VAL_TYPE_EMPTY:
+	case RHO_VAL_TYPE_NULL:
+		return true;
+	case RHO_VAL_TYPE_BOOL:
+		return rho_boolvalue(a) == rho_boolvalue(b);
+	case RHO_VAL_TYPE_INT:
+		return rho_intvalue(a) == rho_intvalue(b);
+	case RHO_VAL_TYPE_FLOAT:
+		return rho_floatvalue(a) == rho_floatvalue(b);
+	default:
+		return rho_objvalue(a) == rho_objvalue(b);
+	}
+}
+
+static RhoValue concdict_init(RhoValue *this, RhoValue *args, size_t nargs)
+{
+	RhoConcDictObject *cd = rho_objvalue(this);
+	RhoDictObject *src = NULL;
+
+	/* so that the stripes can be deallocated whether or not they were made */
+	for (size_t i = 0; i < RHO_CONCDICT_STRIPES; i++) {
+		cd->stripes[i].dict = NULL;
+	}
+
+	RHO_ARG_COUNT_CHECK_AT_MOST("ConcurrentDict", nargs, 1);
+
+	if (nargs == 1) {
+		if (!rho_is_a(&args[0], &rho_dict_class)) {
+			return RHO_TYPE_EXC("ConcurrentDict constructor takes a Dict argument, not a %s",
+			                    rho_getclass(&args[0])->name);
+		}
+
+		src = rho_objvalue(&args[0]);
+		RHO_ENTER(src);
+	}
+
+	for (size_t i = 0; i < RHO_CONCDICT_STRIPES; i++) {
+		Stripe *stripe = &cd->stripes[i];
+		RHO_SAFE(pthread_mutex_init(&stripe->mutex, NULL));
+		RhoValue dict_v = rho_dict_make(NULL, 0);
+		stripe->dict = rho_objvalue(&dict_v);
+	}
+
+	if (src == NULL) {
+		return *this;
+	}
+
+	for (size_t i = 0; i < src->capacity; i++) {
+		for (struct rho_dict_entry *e = src->entries[i]; e != NULL; e = e->next) {
+			RhoValue old = rho_dict_put_hashed(stripe_for(cd, e->hash)->dict, &e->key, e->hash, &e->value);
+
+			if (rho_iserror(&old)) {
+				RHO_EXIT(src);
+				stripes_dealloc(cd);
+				return old;
+			}
+
+			rho_release(&old);
+		}
+	}
+
+	RHO_EXIT(src);
+	return *this;
+}
+
+/*
+ * Copies the contents of `cd` into a new ordinary dict.
+ */
+static RhoValue concdict_snapshot(RhoConcDictObject *cd)
+{
+	RhoValue snapshot_v = rho_dict_make(NULL, 0);
+	RhoDictObject *snapshot = rho_objvalue(&snapshot_v);
+
+	for (size_t i = 0; i < RHO_CONCDICT_STRIPES; i++) {
+		Stripe *stripe = &cd->stripes[i];
+		RhoDictObject *dict = stripe->dict;
+		stripe_lock(stripe);
+
+		for (size_t j = 0; j < dict->capacity; j++) {
+			for (struct rho_dict_entry *e = dict->entries[j]; e != NULL; e = e->next) {
+				RhoValue old = rho_dict_put_hashed(snapshot, &e->key, e->hash, &e->value);
+
+				if (rho_iserror(&old)) {
+					stripe_unlock(stripe);
+					rho_releaseo(snapshot);
+					return old;
+				}
+
+				rho_release(&old);
+			}
+		}
+
+		stripe_unlock(stripe);
+	}
+
+	return snapshot_v;
+}
+
+static RhoValue concdict_get(RhoValue *this, RhoValue *key)
+{
+	RhoConcDictObject *cd = rho_objvalue(this);
+	const RhoValue hash_v = rho_dict_hash(key);
+
+	if (rho_iserror(&hash_v)) {
+		return hash_v;
+	}
+
+	const int hash = rho_intvalue(&hash_v);
+	Stripe *stripe = stripe_for(cd, hash);
+	stripe_lock(stripe);
+	RhoValue ret = rho_dict_get_hashed(stripe->dict, key, hash, NULL);
+	stripe_unlock(stripe);
+	return ret;
+}
+
+static RhoValue concdict_set(RhoValue *this, RhoValue *key, RhoValue *value)
+{
+	RhoConcDictObject *cd = rho_objvalue(this);
+	const RhoValue hash_v = rho_dict_hash(key);
+
+	if (rho_iserror(&hash_v)) {
+		return hash_v;
+	}
+
+	const int hash = rho_intvalue(&hash_v);
+	Stripe *stripe = stripe_for(cd, hash);
+	stripe_lock(stripe);
+	RhoValue ret = rho_dict_put_hashed(stripe->dict, key, hash, value);
+	stripe_unlock(stripe);
+	return ret;
+}
+
+static RhoValue concdict_contains(RhoValue *this, RhoValue *key)
+{
+	RhoConcDictObject *cd = rho_objvalue(this);
+	RhoValue hash_v = rho_dict_hash(key);
+
+	if (rho_iserror(&hash_v)) {
+		rho_release(&hash_v);
+		return rho_makefalse();
+	}
+
+	static RhoValue empty = RHO_MAKE_EMPTY();
+	const int hash = rho_intvalue(&hash_v);
+	Stripe *stripe = stripe_for(cd, hash);
+	stripe_lock(stripe);
+	RhoValue v = rho_dict_get_hashed(stripe->dict, key, hash, &empty);
+	stripe_unlock(stripe);
+
+	if (rho_iserror(&v)) {
+		return v;
+	}
+
+	const bool found = !rho_isempty(&v);
+	rho_release(&v);
+	return rho_makebool(found);
+}
+
+static RhoValue concdict_len(RhoValue *this)
+{
+	RhoConcDictObject *cd = rho_objvalue(this);
+	size_t len = 0;
+
+	for (size_t i = 0; i < RHO_CONCDICT_STRIPES; i++) {
+		Stripe *stripe = &cd->stripes[i];
+		stripe_lock(stripe);
+		len += rho_dict_len(stripe->dict);
+		stripe_unlock(stripe);
+	}
+
+	return rho_makeint(len);
+}
+
+static RhoValue concdict_str(RhoValue *this)
+{
+	RhoValue snapshot = concdict_snapshot(rho_objvalue(this));
+
+	if (rho_iserror(&snapshot)) {
+		return snapshot;
+	}
+
+	RhoValue ret = rho_op_str(&snapshot);
+	rho_release(&snapshot);
+	return ret;
+}
+
+static RhoValue concdict_iter(RhoValue *this)
+{
+	RhoValue snapshot = concdict_snapshot(rho_objvalue(this));
+
+	if (rho_iserror(&snapshot)) {
+		return snapshot;
+	}
+
+	RhoValue ret = rho_op_iter(&snapshot);
+	rho_release(&snapshot);
+	return ret;
+}
+
+static RhoValue concdict_get_method(RhoValue *this,
+                                    RhoValue *args,
+                                    RhoValue *args_named,
+                                    size_t nargs,
+                                    size_t nargs_named)
+{
+#define NAME "get"
+	RHO_UNUSED(args_named);
+	RHO_NO_NAMED_ARGS_CHECK(NAME, nargs_named);
+	RHO_ARG_COUNT_CHECK_BETWEEN(NAME, nargs, 1, 2);
+
+	if (nargs == 1) {
+		return concdict_get(this, &args[0]);
+	}
+
+	RhoConcDictObject *cd = rho_objvalue(this);
+	const RhoValue hash_v = rho_dict_hash(&args[0]);
+
+	if (rho_iserror(&hash_v)) {
+		return hash_v;
+	}
+
+	const int hash = rho_intvalue(&hash_v);
+	Stripe *stripe = stripe_for(cd, hash);
+	stripe_lock(stripe);
+	RhoValue ret = rho_dict_get_hashed(stripe->dict, &args[0], hash, &args[1]);
+	stripe_unlock(stripe);
+	return ret;
+#undef NAME
+}
+
+static RhoValue concdict_put_method(RhoValue *this,
+                                    RhoValue *args,
+                                    RhoValue *args_named,
+                                    size_t nargs,
+                                    size_t nargs_named)
+{
+#define NAME "put"
+	RHO_UNUSED(args_named);
+	RHO_NO_NAMED_ARGS_CHECK(NAME, nargs_named);
+	RHO_ARG_COUNT_CHECK(NAME, nargs, 2);
+
+	RhoValue old = concdict_set(this, &args[0], &args[1]);
+	return rho_isempty(&old) ? rho_makenull() : old;
+#undef NAME
+}
+
+static RhoValue concdict_remove_method(RhoValue *this,
+                                       RhoValue *args,
+                                       RhoValue *args_named,
+                                       size_t nargs,
+                                       size_t nargs_named)
+{
+#define NAME "remove"
+	RHO_UNUSED(args_named);
+	RHO_NO_NAMED_ARGS_CHECK(NAME, nargs_named);
+	RHO_ARG_COUNT_CHECK(NAME, nargs, 1);
+
+	RhoConcDictObject *cd = rho_objvalue(this);
+	const RhoValue hash_v = rho_dict_hash(&args[0]);
+
+	if (rho_iserror(&hash_v)) {
+		return hash_v;
+	}
+
+	const int hash = rho_intvalue(&hash_v);
+	Stripe *stripe = stripe_for(cd, hash);
+	stripe_lock(stripe);
+	RhoValue v = rho_dict_remove_key_hashed(stripe->dict, &args[0], hash);
+	stripe_unlock(stripe);
+	return rho_isempty(&v) ? rho_makenull() : v;
+#undef NAME
+}
+
+static RhoValue concdict_get_or_put_method(RhoValue *this,
+                                           RhoValue *args,
+                                           RhoValue *args_named,
+                                           size_t nargs,
+                                           size_t nargs_named)
+{
+#define NAME "get_or_put"
+	RHO_UNUSED(args_named);
+	RHO_NO_NAMED_ARGS_CHECK(NAME, nargs_named);
+	RHO_ARG_COUNT_CHECK(NAME, nargs, 2);
+
+	RhoConcDictObject *cd = rho_objvalue(this);
+	RhoValue *key = &args[0];
+	RhoValue *value = &args[1];
+	const RhoValue hash_v = rho_dict_hash(key);
+
+	if (rho_iserror(&hash_v)) {
+		return hash_v;
+	}
+
+	static RhoValue empty = RHO_MAKE_EMPTY();
+	const int hash = rho_intvalue(&hash_v);
+	Stripe *stripe = stripe_for(cd, hash);
+	stripe_lock(stripe);
+	RhoValue ret = rho_dict_get_hashed(stripe->dict, key, hash, &empty);
+
+	if (rho_isempty(&ret)) {
+		ret = rho_dict_put_hashed(stripe->dict, key, hash, value);
+
+		if (!rho_iserror(&ret)) {
+			rho_retain(value);
+			ret = *value;
+		}
+	}
+
+	stripe_unlock(stripe);
+	return ret;
+#undef NAME
+}
+
+/*
+ * `compute` doesn't hold the stripe's lock while calling the
+ * given function, since the function could itself access the
+ * dict. Instead, the new value is only stored if the key's
+ * value is still the one the function was given; otherwise the
+ * function is called again with the key's current value.
+ */
+static RhoValue concdict_compute_method(RhoValue *this,
+                                        RhoValue *args,
+                                        RhoValue *args_named,
+                                        size_t nargs,
+                                        size_t nargs_named)
+{
+#define NAME "compute"
+	RHO_UNUSED(args_named);
+	RHO_NO_NAMED_ARGS_CHECK(NAME, nargs_named);
+	RHO_ARG_COUNT_CHECK(NAME, nargs, 2);
+
+	RhoConcDictObject *cd = rho_objvalue(this);
+	RhoValue *key = &args[0];
+	RhoValue *fn = &args[1];
+	RhoClass *fn_class = rho_getclass(fn);
+
+	if (!rho_resolve_call(fn_class)) {
+		return rho_type_exc_not_callable(fn_class);
+	}
+
+	const RhoValue hash_v = rho_dict_hash(key);
+
+	if (rho_iserror(&hash_v)) {
+		return hash_v;
+	}
+
+	static RhoValue empty = RHO_MAKE_EMPTY();
+	const int hash = rho_intvalue(&hash_v);
+	Stripe *stripe = stripe_for(cd, hash);
+
+	while (true) {
+		stripe_lock(stripe);
+		RhoValue old = rho_dict_get_hashed(stripe->dict, key, hash, &empty);
+		stripe_unlock(stripe);
+
+		if (rho_iserror(&old)) {
+			return old;
+		}
+
+		RhoValue arg = rho_isempty(&old) ? rho_makenull() : old;
+		RhoValue new = rho_op_call(fn, &arg, NULL, 1, 0);
+
+		if (rho_iserror(&new)) {
+			rho_release(&old);
+			return new;
+		}
+
+		stripe_lock(stripe);
+		RhoValue current = rho_dict_get_hashed(stripe->dict, key, hash, &empty);
+		RhoValue replaced = rho_makeempty();
+		const bool unchanged = !rho_iserror(&current) && same_value(&current, &old);
+
+		if (unchanged) {
+			replaced = rho_dict_put_hashed(stripe->dict, key, hash, &new);
+		}
+		stripe_unlock(stripe);
+
+		rho_release(&old);
+
+		if (rho_iserror(&current)) {
+			rho_release(&new);
+			return current;
+		}
+
+		rho_release(&current);
+
+		if (rho_iserror(&replaced)) {
+			rho_release(&new);
+			return replaced;
+		}
+
+		if (unchanged) {
+			rho_release(&replaced);
+			return new;
+		}
+
+		/* changed in the meantime; try again */
+		rho_release(&new);
+	}
+#undef NAME
+}
+
+static RhoValue concdict_increment_method(RhoValue *this,
+                                          RhoValue *args,
+                                          RhoValue *args_named,
+                                          size_t nargs,
+                                          size_t nargs_named)
+{
+#define NAME "increment"
+	RHO_UNUSED(args_named);
+	RHO_NO_NAMED_ARGS_CHECK(NAME, nargs_named);
+	RHO_ARG_COUNT_CHECK_BETWEEN(NAME, nargs, 1, 2);
+
+	RhoConcDictObject *cd = rho_objvalue(this);
+	RhoValue *key = &args[0];
+	RhoValue delta = (nargs == 2) ? args[1] : rho_makeint(1);
+	const RhoValue hash_v = rho_dict_hash(key);
+
+	if (rho_iserror(&hash_v)) {
+		return hash_v;
+	}
+
+	static RhoValue zero = RHO_MAKE_INT(0);
+	const int hash = rho_intvalue(&hash_v);
+	Stripe *stripe = stripe_for(cd, hash);
+	stripe_lock(stripe);
+	RhoValue old = rho_dict_get_hashed(stripe->dict, key, hash, &zero);
+
+	if (rho_iserror(&old)) {
+		stripe_unlock(stripe);
+		return old;
+	}
+
+	RhoValue new = rho_op_add(&old, &delta);
+	rho_release(&old);
+
+	if (rho_iserror(&new)) {
+		stripe_unlock(stripe);
+		return new;
+	}
+
+	RhoValue replaced = rho_dict_put_hashed(stripe->dict, key, hash, &new);
+	stripe_unlock(stripe);
+
+	if (rho_iserror(&replaced)) {
+		rho_release(&new);
+		return replaced;
+	}
+
+	rho_release(&replaced);
+	return new;
+#undef NAME
+}
+
+/*
+ * Safe to call more than once: a failed constructor deallocates the
+ * stripes itself, as the object may be freed without its `del`.
+ */
+static void stripes_dealloc(RhoConcDictObject *cd)
+{
+	for (size_t i = 0; i < RHO_CONCDICT_STRIPES; i++) {
+		Stripe *stripe = &cd->stripes[i];
+
+		if (stripe->dict == NULL) {
+			continue;
+		}
+
+		RHO_SAFE(pthread_mutex_destroy(&stripe->mutex));
+		rho_releaseo(stripe->dict);
+		stripe->dict = NULL;
+	}
+}
+
+static void concdict_free(RhoValue *this)
+{
+	stripes_dealloc(rho_objvalue(this));
+	rho_obj_class.del(this);
+}
+
+struct rho_seq_methods rho_concdict_seq_methods = {
+	concdict_len,    /* len */
+	concdict_get,    /* get */
+	concdict_set,    /* set */
+	concdict_contains,    /* contains */
+	NULL,    /* apply */
+	NULL,    /* iapply */
+};
+
+struct rho_attr_method concdict_methods[] = {
+	{"get", concdict_get_method},
+	{"put", concdict_put_method},
+	{"remove", concdict_remove_method},
+	{"get_or_put", concdict_get_or_put_method},
+	{"compute", concdict_compute_method},
+	{"increment", concdict_increment_method},
+	{NULL, NULL}
+};
+
+RhoClass rho_concdict_class = {
+	.base = RHO_CLASS_BASE_INIT(),
+	.name = "ConcurrentDict",
+	.super = &rho_obj_class,
+
+	.instance_size = sizeof(RhoConcDictObject),
+
+	.init = concdict_init,
+	.del = concdict_free,
+
+	.eq = NULL,
+	.hash = NULL,
+	.cmp = NULL,
+	.str = concdict_str,
+	.call = NULL,
+
+	.print = NULL,
+
+	.iter = concdict_iter,
+	.iternext = NULL,
+
+	.num_methods = NULL,
+	.seq_methods = &rho_concdict_seq_methods,
+
+	.members = NULL,
+	.methods = concdict_methods,
+
+	.attr_get = NULL,
+	.attr_set = NULL
+};
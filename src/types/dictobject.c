@@ -17,8 +17,6 @@
 
 typedef struct rho_dict_entry Entry;
 
-#define KEY_EXC(key) RHO_INDEX_EXC("dict has no key '%s'", (key));
-
 static Entry **make_empty_table(const size_t capacity);
 static void dict_resize(RhoDictObject *dict, const size_t new_capacity);
 static void dict_free(RhoValue *this);
@@ -71,7 +69,7 @@ static Entry *make_entry(RhoValue *key, RhoValue *value, const int hash)
 	return entry;
 }
 
-RhoValue rho_dict_get(RhoDictObject *dict, RhoValue *key, RhoValue *dflt)
+RhoValue rho_dict_hash(RhoValue *key)
 {
 	const RhoValue hash_v = rho_op_hash(key);
 
@@ -79,8 +77,22 @@ RhoValue rho_dict_get(RhoDictObject *dict, RhoValue *key, RhoValue *dflt)
 		return hash_v;
 	}
 
-	const int hash = rho_util_hash_secondary(rho_intvalue(&hash_v));
+	return rho_makeint(rho_util_hash_secondary(rho_intvalue(&hash_v)));
+}
+
+RhoValue rho_dict_get(RhoDictObject *dict, RhoValue *key, RhoValue *dflt)
+{
+	const RhoValue hash_v = rho_dict_hash(key);
+
+	if (rho_iserror(&hash_v)) {
+		return hash_v;
+	}
+
+	return rho_dict_get_hashed(dict, key, rho_intvalue(&hash_v), dflt);
+}
 
+RhoValue rho_dict_get_hashed(RhoDictObject *dict, RhoValue *key, const int hash, RhoValue *dflt)
+{
 	/* every value should have a valid `eq` */
 	const RhoBinOp eq = rho_resolve_eq(rho_getclass(key));
 
@@ -106,31 +118,27 @@ RhoValue rho_dict_get(RhoDictObject *dict, RhoValue *key, RhoValue *dflt)
 		rho_retain(dflt);
 		return *dflt;
 	} else {
-		RhoValue str_v = rho_op_str(key);
-
-		if (rho_iserror(&str_v)) {
-			return str_v;
-		}
-
-		RhoStrObject *str = rho_objvalue(&str_v);
-		RhoValue exc = KEY_EXC(str->str.value);
-		rho_releaseo(str);
-		return exc;
+		return rho_index_exc_no_key(key);
 	}
 }
 
 RhoValue rho_dict_put(RhoDictObject *dict, RhoValue *key, RhoValue *value)
 {
-	Entry **table = dict->entries;
-	const size_t capacity = dict->capacity;
-	const RhoValue hash_v = rho_op_hash(key);
+	const RhoValue hash_v = rho_dict_hash(key);
 
 	if (rho_iserror(&hash_v)) {
 		return hash_v;
 	}
 
+	return rho_dict_put_hashed(dict, key, rho_intvalue(&hash_v), value);
+}
+
+RhoValue rho_dict_put_hashed(RhoDictObject *dict, RhoValue *key, const int hash, RhoValue *value)
+{
+	Entry **table = dict->entries;
+	const size_t capacity = dict->capacity;
+
 	++dict->state_id;
-	const int hash = rho_util_hash_secondary(rho_intvalue(&hash_v));
 	const size_t index = hash & (capacity - 1);
 
 	/* every value should have a valid `eq` */
@@ -174,14 +182,17 @@ RhoValue rho_dict_put(RhoDictObject *dict, RhoValue *key, RhoValue *value)
 
 RhoValue rho_dict_remove_key(RhoDictObject *dict, RhoValue *key)
 {
-	const RhoValue hash_v = rho_op_hash(key);
+	const RhoValue hash_v = rho_dict_hash(key);
 
 	if (rho_iserror(&hash_v)) {
 		return hash_v;
 	}
 
-	const int hash = rho_util_hash_secondary(rho_intvalue(&hash_v));
+	return rho_dict_remove_key_hashed(dict, key, rho_intvalue(&hash_v));
+}
 
+RhoValue rho_dict_remove_key_hashed(RhoDictObject *dict, RhoValue *key, const int hash)
+{
 	/* every value should have a valid `eq` */
 	const RhoBinOp eq = rho_resolve_eq(rho_getclass(key));
 
@@ -685,8 +696,10 @@ static RhoValue iter_next(RhoValue *this)
 	RHO_ENTER(iter->source);
 
 	if (iter->saved_state_id != iter->source->state_id) {
+		static RhoException isc_exc = RHO_EXC_INIT_STATIC(&rho_isc_exception_class,
+		                                                  "dict changed state during iteration");
 		RHO_EXIT(iter->source);
-		return RHO_ISC_EXC("dict changed state during iteration");
+		return rho_makeexc(&isc_exc);
 	}
 
 	Entry **entries = iter->source->entries;
@@ -5,42 +5,93 @@
 #include <assert.h>
 #include "object.h"
 #include "strobject.h"
+#include "vmops.h"
 #include "util.h"
 #include "err.h"
+#include "codeobject.h"
 #include "exc.h"
 
-RhoValue rho_exc_make(RhoClass *exc_class, bool active, const char *msg_format, ...)
-{
 #define EXC_MSG_BUF_SIZE 200
 
+static const char *exc_vformat(const char *msg_format, va_list args)
+{
 	char msg_static[EXC_MSG_BUF_SIZE];
 
-	RhoException *exc = rho_obj_alloc(exc_class);
-	rho_tb_manager_init(&exc->tbm);
-
-	va_list args;
-	va_start(args, msg_format);
 	int size = vsnprintf(msg_static, EXC_MSG_BUF_SIZE, msg_format, args);
 	assert(size >= 0);
-	va_end(args);
 
 	if (size >= EXC_MSG_BUF_SIZE)
 		size = EXC_MSG_BUF_SIZE;
 
 	char *msg = rho_malloc(size + 1);
 	strcpy(msg, msg_static);
-	exc->msg = msg;
+	return msg;
+}
 
-	return active ? rho_makeexc(exc) : rho_makeobj(exc);
+static const char *exc_format(const char *msg_format, ...)
+{
+	va_list args;
+	va_start(args, msg_format);
+	const char *msg = exc_vformat(msg_format, args);
+	va_end(args);
+	return msg;
+}
 
 #undef EXC_MSG_BUF_SIZE
+
+static void exc_init_fields(RhoException *e, const char *msg)
+{
+	e->msg = msg;
+	e->msg_func = NULL;
+	e->msg_value = rho_makeempty();
+	e->msg_str = NULL;
+	e->msg_args[0] = e->msg_args[1] = 0;
+	rho_tb_manager_init(&e->tbm);
+}
+
+RhoValue rho_exc_make(RhoClass *exc_class, bool active, const char *msg_format, ...)
+{
+	RhoException *exc = rho_obj_alloc(exc_class);
+
+	va_list args;
+	va_start(args, msg_format);
+	exc_init_fields(exc, exc_vformat(msg_format, args));
+	va_end(args);
+
+	return active ? rho_makeexc(exc) : rho_makeobj(exc);
+}
+
+/* makes an active exception whose message is made by `msg_func` if it is needed */
+static RhoException *exc_make_lazy(RhoClass *exc_class, RhoExcMsgFunc msg_func)
+{
+	RhoException *exc = rho_obj_alloc(exc_class);
+	exc_init_fields(exc, NULL);
+	exc->msg_func = msg_func;
+	return exc;
+}
+
+const char *rho_exc_msg(RhoException *e)
+{
+	if (e->msg == NULL && e->msg_func != NULL) {
+		e->msg = e->msg_func(e);
+	}
+
+	return e->msg;
 }
 
-void rho_exc_traceback_append(RhoException *e,
-                              const char *fn,
-                              const unsigned int lineno)
+void rho_exc_traceback_append(RhoValue *exc, RhoCodeObject *co, const size_t pos)
 {
-	rho_tb_manager_add(&e->tbm, fn, lineno);
+	RhoException *e = rho_objvalue(exc);
+
+	if (e->base.refcnt == (unsigned)(-1)) {
+		/* preallocated, so get a copy of our own to put the traceback in */
+		RhoException *copy = rho_obj_alloc(e->base.class);
+		exc_init_fields(copy, rho_util_str_dup(e->msg));
+		*exc = rho_makeexc(copy);
+		e = copy;
+	}
+
+	rho_tb_manager_add(&e->tbm, co, pos);
 }
 
 void rho_exc_traceback_print(RhoException *e, FILE *out)
@@ -50,8 +101,10 @@ void rho_exc_traceback_print(RhoException *e, FILE *out)
 
 void rho_exc_print_msg(RhoException *e, FILE *out)
 {
-	if (e->msg != NULL) {
-		fprintf(out, "%s: %s\n", e->base.class->name, e->msg);
+	const char *msg = rho_exc_msg(e);
+
+	if (msg != NULL) {
+		fprintf(out, "%s: %s\n", e->base.class->name, msg);
 	} else {
 		fprintf(out, "%s\n", e->base.class->name);
 	}
@@ -68,11 +121,9 @@ static RhoValue exc_init(RhoValue *this, RhoValue *args, size_t nargs)
 	}
 
 	RhoException *e = rho_objvalue(this);
-	rho_tb_manager_init(&e->tbm);
+	exc_init_fields(e, NULL);
 
-	if (nargs == 0) {
-		e->msg = NULL;
-	} else {
+	if (nargs > 0) {
 		if (!rho_is_a(&args[0], &rho_str_class)) {
 			RhoClass *class = rho_getclass(&args[0]);
 			return rho_makeerr(rho_err_new(RHO_ERR_TYPE_TYPE,
@@ -93,6 +144,8 @@ static void exc_free(RhoValue *this)
 {
 	RhoException *exc = rho_objvalue(this);
 	RHO_FREE(exc->msg);
+	rho_release(&exc->msg_value);
+	RHO_FREE(exc->msg_str);
 	rho_tb_manager_dealloc(&exc->tbm);
 	rho_obj_class.del(this);
 }
@@ -420,6 +473,70 @@ RhoClass rho_conc_access_exception_class = {
 
 /* Common exceptions */
 
+static const char *list_range_msg(RhoException *e)
+{
+	return exc_format("list index out of range (index = %li, len = %li)", e->msg_args[0], e->msg_args[1]);
+}
+
+static const char *tuple_range_msg(RhoException *e)
+{
+	return exc_format("tuple index out of range (index = %li, len = %li)", e->msg_args[0], e->msg_args[1]);
+}
+
+static const char *no_key_msg(RhoException *e)
+{
+	RhoValue str_v = rho_op_str(&e->msg_value);
+	assert(!rho_iserror(&str_v));
+	RhoStrObject *str = rho_objvalue(&str_v);
+	const char *msg = exc_format("dict has no key '%s'", str->str.value);
+	rho_releaseo(str);
+	return msg;
+}
+
+static const char *attr_not_found_msg(RhoException *e)
+{
+	const RhoClass *type = rho_objvalue(&e->msg_value);
+	return exc_format("object of type '%s' has no attribute '%s'", type->name, e->msg_str);
+}
+
+RhoValue rho_index_exc_list_range(const long index, const size_t len)
+{
+	RhoException *exc = exc_make_lazy(&rho_index_exception_class, list_range_msg);
+	exc->msg_args[0] = index;
+	exc->msg_args[1] = len;
+	return rho_makeexc(exc);
+}
+
+RhoValue rho_index_exc_tuple_range(const long index, const size_t len)
+{
+	RhoException *exc = exc_make_lazy(&rho_index_exception_class, tuple_range_msg);
+	exc->msg_args[0] = index;
+	exc->msg_args[1] = len;
+	return rho_makeexc(exc);
+}
+
+RhoValue rho_index_exc_no_key(RhoValue *key)
+{
+	if (rho_isobject(key) && rho_getclass(key) != &rho_str_class) {
+		/* converting the key can run (and fail in) Rho code, so it is done right away */
+		RhoValue str_v = rho_op_str(key);
+
+		if (rho_iserror(&str_v)) {
+			return str_v;
+		}
+
+		RhoStrObject *str = rho_objvalue(&str_v);
+		RhoValue exc = RHO_INDEX_EXC("dict has no key '%s'", str->str.value);
+		rho_releaseo(str);
+		return exc;
+	}
+
+	RhoException *exc = exc_make_lazy(&rho_index_exception_class, no_key_msg);
+	rho_retain(key);
+	exc->msg_value = *key;
+	return rho_makeexc(exc);
+}
+
 RhoValue rho_type_exc_unsupported_1(const char *op, const RhoClass *c1)
 {
 	return RHO_TYPE_EXC("unsupported operand type for %s: '%s'", op, c1->name);
@@ -485,6 +602,14 @@ RhoValue rho_call_exc_num_args_at_most(const char *fn, unsigned int got, unsigne
 	                    got);
 }
 
+RhoValue rho_call_exc_num_args_at_least(const char *fn, unsigned int got, unsigned int expected)
+{
+	return RHO_TYPE_EXC("function %s(): expected at least %u arguments, got %u",
+	                    fn,
+	                    expected,
+	                    got);
+}
+
 RhoValue rho_call_exc_num_args_between(const char *fn, unsigned int got, unsigned int min, unsigned int max)
 {
 	return RHO_TYPE_EXC("function %s(): expected %u-%u arguments, got %u",
@@ -551,9 +676,11 @@ RhoValue rho_io_exc_file_closed(const char *filename)
 
 RhoValue rho_attr_exc_not_found(const RhoClass *type, const char *attr)
 {
-	return RHO_ATTR_EXC("object of type '%s' has no attribute '%s'",
-	                type->name,
-	                attr);
+	RhoException *exc = exc_make_lazy(&rho_attr_exception_class, attr_not_found_msg);
+	rho_retaino((RhoClass *)type);
+	exc->msg_value = rho_makeobj((RhoClass *)type);
+	exc->msg_str = rho_util_str_dup(attr);
+	return rho_makeexc(exc);
 }
 
 RhoValue rho_attr_exc_readonly(const RhoClass *type, const char *attr)
@@ -13,7 +13,7 @@ static RhoValue iter_make(RhoListObject *list);
 
 #define INDEX_CHECK(index, count) \
 	if ((index) < 0 || ((size_t)(index)) >= (count)) { \
-		return RHO_INDEX_EXC("list index out of range (index = %li, len = %lu)", (index), (count)); \
+		return rho_index_exc_list_range((index), (count)); \
 	}
 
 static void list_ensure_capacity(RhoListObject *list, const size_t min_capacity);
@@ -238,7 +238,9 @@ static RhoValue list_pop(RhoValue *this,
 		if (count > 0) {
 			return elements[--list->count];
 		} else {
-			return RHO_INDEX_EXC("cannot invoke " NAME "() on an empty list");
+			static RhoException empty_exc = RHO_EXC_INIT_STATIC(&rho_index_exception_class,
+			                                                    "cannot invoke " NAME "() on an empty list");
+			return rho_makeexc(&empty_exc);
 		}
 	} else {
 		RhoValue *idx = &args[0];
@@ -53,9 +53,13 @@ static bool obj_nonzero(RhoValue *this)
 	return true;
 }
 
+static void monitor_free(RhoObject *o);
+
 static void obj_free(RhoValue *this)
 {
-	free(rho_objvalue(this));
+	RhoObject *o = rho_objvalue(this);
+	monitor_free(o);
+	free(o);
 }
 
 struct rho_num_methods obj_num_methods = {
@@ -429,88 +433,235 @@ void rho_class_init(RhoClass *class)
 	rho_attr_dict_register_methods(&class->attr_dict, class->methods);
 }
 
+/*
+ * Monitors
+ *
+ * The `monitor` field of a `safe()`'d object is a lock word.
+ * It starts out as a "thin" lock that is acquired and released
+ * with a single compare-and-swap, and is only "inflated" to a
+ * RhoMonitor once a thread has had to wait for it. The lock
+ * word is one of:
+ *
+ *   - 0: the object is not `safe()`'d
+ *   - LOCK_THIN_UNLOCKED: thin lock, not held
+ *   - LOCK_THIN_LOCKED: thin lock, held
+ *   - otherwise: LOCK_INFLATED(id), where `id` identifies
+ *     the object's RhoMonitor
+ *
+ * A thread that finds the thin lock held for too long inflates
+ * it by swapping in a new monitor whose `held` flag stands for
+ * the current owner. The owner's own release will then fail to
+ * swap LOCK_THIN_LOCKED back to LOCK_THIN_UNLOCKED, and release
+ * via the monitor instead. Since a monitor can thus be released
+ * by a thread other than the one that acquired it, its `held`
+ * flag (rather than its mutex) is what represents the lock.
+ *
+ * Monitors live in fixed-size segments that are never moved,
+ * so a monitor stays put for as long as its object is alive.
+ * Inflated locks are never deflated, but an object's monitor
+ * is recycled once the object itself is freed. Keeping the
+ * lock word to 32 bits (rather than storing a pointer) keeps
+ * every object's header the same size.
+ */
+
+#define LOCK_THIN_UNLOCKED 1u
+#define LOCK_THIN_LOCKED   3u
+#define LOCK_IS_THIN(w)    ((w) & 1u)
+#define LOCK_INFLATED(id)  ((id) << 1)
+#define LOCK_MONITOR_ID(w) ((w) >> 1)
+#define LOCK_SPIN_LIMIT    100
+
+#define MONITOR_SEGMENT_BITS  8
+#define MONITOR_SEGMENT_SIZE  (1u << MONITOR_SEGMENT_BITS)
+#define MONITOR_SEGMENTS_MAX  (1u << 16)
+
+static RhoMonitor *monitor_segments[MONITOR_SEGMENTS_MAX];
+static unsigned int monitors_next = 1;  /* id 0 is unused, as LOCK_INFLATED(0) == 0 */
+static unsigned int *monitors_free = NULL;
+static size_t monitors_free_count = 0;
+static size_t monitors_free_capacity = 0;
 static pthread_mutex_t monitor_management_mutex = PTHREAD_MUTEX_INITIALIZER;
 
-static void monotir_init(RhoMonitor *monitor)
+static RhoMonitor *monitor_get(const unsigned int id)
 {
-	RHO_SAFE(pthread_mutex_init(&monitor->mutex, NULL));
-	RHO_SAFE(pthread_cond_init(&monitor->cond, NULL));
+	return &monitor_segments[id >> MONITOR_SEGMENT_BITS][id & (MONITOR_SEGMENT_SIZE - 1)];
 }
 
-static void monitor_destroy(RhoMonitor *monitor)
+static void free_monitors(void)
 {
-	RHO_SAFE(pthread_mutex_destroy(&monitor->mutex));
-	RHO_SAFE(pthread_cond_destroy(&monitor->cond));
-}
+	for (unsigned int i = 1; i < monitors_next; i++) {
+		RhoMonitor *monitor = monitor_get(i);
+		RHO_SAFE(pthread_mutex_destroy(&monitor->mutex));
+		RHO_SAFE(pthread_cond_destroy(&monitor->cond));
+	}
+
+	for (size_t i = 0; i < MONITOR_SEGMENTS_MAX && monitor_segments[i] != NULL; i++) {
+		free(monitor_segments[i]);
+	}
 
-static RhoMonitor *volatile monitors;
-#define MONITORS_INIT_CAPACITY (1 << 4)
-#define MONITORS_MAX_CAPACITY  (1 << 16)
-static size_t monotirs_capacity = 0;
-static unsigned int monitors_next = 0;
-static bool monitors_full = false;
+	free(monitors_free);
+}
 
-static void free_monitors(void)
+/*
+ * Returns the ID of an unused monitor, whose `held`
+ * flag is set, to be installed into a lock word.
+ */
+static unsigned int monitor_alloc(void)
 {
-	for (size_t i = 1; i < monitors_next; i++) {
-		monitor_destroy(&monitors[i]);
+	unsigned int id;
+	RhoMonitor *monitor;
+
+	RHO_SAFE(pthread_mutex_lock(&monitor_management_mutex));
+	if (monitors_free_count > 0) {
+		id = monitors_free[--monitors_free_count];
+		monitor = monitor_get(id);
+	} else {
+		id = monitors_next++;
+		const unsigned int segment = id >> MONITOR_SEGMENT_BITS;
+
+		if (segment >= MONITOR_SEGMENTS_MAX) {
+			RHO_INTERNAL_ERROR();
+		}
+
+		if (monitor_segments[segment] == NULL) {
+			if (segment == 0) {
+				atexit(free_monitors);
+			}
+
+			monitor_segments[segment] = rho_malloc(MONITOR_SEGMENT_SIZE * sizeof(RhoMonitor));
+		}
+
+		monitor = monitor_get(id);
+		RHO_SAFE(pthread_mutex_init(&monitor->mutex, NULL));
+		RHO_SAFE(pthread_cond_init(&monitor->cond, NULL));
 	}
+	RHO_SAFE(pthread_mutex_unlock(&monitor_management_mutex));
 
-	free(monitors);
+	monitor->held = true;
+	return id;
 }
 
-bool rho_object_set_monitor(RhoObject *o)
+static void monitor_dealloc(const unsigned int id)
 {
-	if (o->refcnt > 1 || o->monitor != 0) {
-		return false;
+	RHO_SAFE(pthread_mutex_lock(&monitor_management_mutex));
+	if (monitors_free_count == monitors_free_capacity) {
+		monitors_free_capacity = (monitors_free_capacity == 0) ? 16 : 2*monitors_free_capacity;
+		monitors_free = rho_realloc(monitors_free, monitors_free_capacity * sizeof(unsigned int));
 	}
 
-	RHO_SAFE(pthread_mutex_lock(&monitor_management_mutex));
-	if (monotirs_capacity == 0) {
-		monitors = rho_malloc(MONITORS_INIT_CAPACITY * sizeof(RhoMonitor));
-		monotirs_capacity = MONITORS_INIT_CAPACITY;
-		monitors_next = 1;
-		monitors_full = false;
-		atexit(free_monitors);
+	monitors_free[monitors_free_count++] = id;
+	RHO_SAFE(pthread_mutex_unlock(&monitor_management_mutex));
+}
+
+static void monitor_free(RhoObject *o)
+{
+	const unsigned int word = atomic_load_explicit(&o->monitor, memory_order_relaxed);
+
+	if (word != 0 && !LOCK_IS_THIN(word)) {
+		monitor_dealloc(LOCK_MONITOR_ID(word));
 	}
+}
 
-	if (monitors_next == monotirs_capacity) {
-		if (monotirs_capacity < MONITORS_MAX_CAPACITY) {
-			monotirs_capacity *= 2;
-			monitors = rho_realloc(monitors, monotirs_capacity * sizeof(RhoMonitor));
-		} else {
-			monitors_next = 1;
-			monitors_full = true;
-		}
+static void monitor_acquire(RhoMonitor *monitor)
+{
+	RHO_SAFE(pthread_mutex_lock(&monitor->mutex));
+	while (monitor->held) {
+		RHO_SAFE(pthread_cond_wait(&monitor->cond, &monitor->mutex));
 	}
+	monitor->held = true;
+	RHO_SAFE(pthread_mutex_unlock(&monitor->mutex));
+}
 
-	if (!monitors_full) {
-		monotir_init(&monitors[monitors_next]);
+static void monitor_release(RhoMonitor *monitor)
+{
+	RHO_SAFE(pthread_mutex_lock(&monitor->mutex));
+	monitor->held = false;
+	RHO_SAFE(pthread_cond_signal(&monitor->cond));
+	RHO_SAFE(pthread_mutex_unlock(&monitor->mutex));
+}
+
+bool rho_object_set_monitor(RhoObject *o)
+{
+	if (o->refcnt > 1) {
+		return false;
 	}
 
-	o->monitor = monitors_next++;
-	RHO_SAFE(pthread_mutex_unlock(&monitor_management_mutex));
-	return true;
+	unsigned int expected = 0;
+	return atomic_compare_exchange_strong(&o->monitor, &expected, LOCK_THIN_UNLOCKED);
 }
 
 bool rho_object_enter(RhoObject *o)
 {
-	if (o->monitor == 0) {
+	unsigned int word = atomic_load_explicit(&o->monitor, memory_order_acquire);
+
+	if (word == 0) {
 		return false;
 	}
 
-	RhoMonitor *monitor = &monitors[o->monitor];
-	RHO_SAFE(pthread_mutex_lock(&monitor->mutex));
+	unsigned int spins = 0;
+
+	while (LOCK_IS_THIN(word)) {
+		if (word == LOCK_THIN_UNLOCKED) {
+			if (atomic_compare_exchange_weak_explicit(&o->monitor,
+			                                          &word,
+			                                          LOCK_THIN_LOCKED,
+			                                          memory_order_acquire,
+			                                          memory_order_acquire)) {
+				return true;
+			}
+		} else if (++spins < LOCK_SPIN_LIMIT) {
+			word = atomic_load_explicit(&o->monitor, memory_order_acquire);
+		} else {
+			const unsigned int id = monitor_alloc();
+			const unsigned int inflated = LOCK_INFLATED(id);
+
+			if (atomic_compare_exchange_strong_explicit(&o->monitor,
+			                                            &word,
+			                                            inflated,
+			                                            memory_order_acq_rel,
+			                                            memory_order_acquire)) {
+				word = inflated;
+			} else {
+				monitor_dealloc(id);
+				spins = 0;
+			}
+		}
+	}
+
+	monitor_acquire(monitor_get(LOCK_MONITOR_ID(word)));
 	return true;
 }
 
 bool rho_object_exit(RhoObject *o)
 {
-	if (o->monitor == 0) {
+	unsigned int word = LOCK_THIN_LOCKED;
+
+	if (atomic_compare_exchange_strong_explicit(&o->monitor,
+	                                            &word,
+	                                            LOCK_THIN_UNLOCKED,
+	                                            memory_order_release,
+	                                            memory_order_acquire)) {
+		return true;
+	}
+
+	if (word == 0) {
 		return false;
 	}
 
-	RhoMonitor *monitor = &monitors[o->monitor];
-	RHO_SAFE(pthread_mutex_unlock(&monitor->mutex));
+	if (LOCK_IS_THIN(word)) {
+		RHO_INTERNAL_ERROR();  /* exit without matching enter */
+	}
+
+	monitor_release(monitor_get(LOCK_MONITOR_ID(word)));
 	return true;
 }
+
+#undef LOCK_THIN_UNLOCKED
+#undef LOCK_THIN_LOCKED
+#undef LOCK_IS_THIN
+#undef LOCK_INFLATED
+#undef LOCK_MONITOR_ID
+#undef LOCK_SPIN_LIMIT
+#undef MONITOR_SEGMENT_BITS
+#undef MONITOR_SEGMENT_SIZE
+#undef MONITOR_SEGMENTS_MAX
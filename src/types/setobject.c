@@ -604,8 +604,10 @@ static RhoValue iter_next(RhoValue *this)
 	RHO_ENTER(iter->source);
 
 	if (iter->saved_state_id != iter->source->state_id) {
+		static RhoException isc_exc = RHO_EXC_INIT_STATIC(&rho_isc_exception_class,
+		                                                  "set changed state during iteration");
 		RHO_EXIT(iter->source);
-		return RHO_ISC_EXC("set changed state during iteration");
+		return rho_makeexc(&isc_exc);
 	}
 
 	Entry **entries = iter->source->entries;
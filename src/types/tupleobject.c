@@ -10,7 +10,7 @@
 
 #define INDEX_CHECK(index, count) \
 	if ((index) < 0 || ((size_t)(index)) >= (count)) { \
-		return RHO_INDEX_EXC("tuple index out of range (index = %li, len = %lu)", (index), (count)); \
+		return rho_index_exc_tuple_range((index), (count)); \
 	}
 
 /* Does not retain elements; direct transfer from value stack. */
@@ -0,0 +1,74 @@
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include "util.h"
+#include "arena.h"
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+/* allocations at least this big get a block of their own */
+#define ARENA_LARGE_SIZE (ARENA_BLOCK_SIZE / 4)
+
+#define ARENA_ALIGN(n) (((n) + _Alignof(max_align_t) - 1) & ~(_Alignof(max_align_t) - 1))
+
+struct rho_arena_block {
+	struct rho_arena_block *next;
+	max_align_t data[];
+};
+
+static struct rho_arena_block *block_new(RhoArena *arena, const size_t size)
+{
+	struct rho_arena_block *block = rho_malloc(sizeof(struct rho_arena_block) + size);
+	block->next = arena->blocks;
+	arena->blocks = block;
+	return block;
+}
+
+void rho_arena_init(RhoArena *arena)
+{
+	arena->blocks = NULL;
+	arena->next = NULL;
+	arena->left = 0;
+}
+
+void *rho_arena_alloc(RhoArena *arena, const size_t n)
+{
+	const size_t size = ARENA_ALIGN(n);
+
+	if (size <= arena->left) {
+		void *p = arena->next;
+		arena->next += size;
+		arena->left -= size;
+		return p;
+	}
+
+	/* the rest of the current block is still used after this */
+	if (size >= ARENA_LARGE_SIZE) {
+		return block_new(arena, size)->data;
+	}
+
+	struct rho_arena_block *block = block_new(arena, ARENA_BLOCK_SIZE);
+	arena->next = (char *)block->data + size;
+	arena->left = ARENA_BLOCK_SIZE - size;
+	return block->data;
+}
+
+void *rho_arena_calloc(RhoArena *arena, const size_t n)
+{
+	void *p = rho_arena_alloc(arena, n);
+	memset(p, 0, n);
+	return p;
+}
+
+void rho_arena_dealloc(RhoArena *arena)
+{
+	struct rho_arena_block *block = arena->blocks;
+
+	while (block != NULL) {
+		struct rho_arena_block *next = block->next;
+		free(block);
+		block = next;
+	}
+
+	rho_arena_init(arena);
+}
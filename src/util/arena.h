@@ -0,0 +1,24 @@
+#ifndef RHO_ARENA_H
+#define RHO_ARENA_H
+
+#include <stdlib.h>
+
+/*
+ * Bump-pointer allocator for memory that is all freed at once, like
+ * the syntax tree and tables made while compiling a module.
+ */
+
+struct rho_arena_block;
+
+typedef struct {
+	struct rho_arena_block *blocks;
+	char *next;
+	size_t left;  // bytes free at `next`
+} RhoArena;
+
+void rho_arena_init(RhoArena *arena);
+void *rho_arena_alloc(RhoArena *arena, const size_t n);
+void *rho_arena_calloc(RhoArena *arena, const size_t n);
+void rho_arena_dealloc(RhoArena *arena);
+
+#endif /* RHO_ARENA_H */
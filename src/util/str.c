@@ -32,6 +32,16 @@ RhoStr *rho_str_new_copy(const char *value, const size_t len)
 	return str;
 }
 
+RhoStr *rho_str_new_copy_arena(RhoArena *arena, const char *value, const size_t len)
+{
+	RhoStr *str = rho_arena_alloc(arena, sizeof(RhoStr));
+	char *copy = rho_arena_alloc(arena, len + 1);
+	memcpy(copy, value, len);
+	copy[len] = '\0';
+	*str = RHO_STR_INIT(copy, len, 0);
+	return str;
+}
+
 bool rho_str_eq(RhoStr *s1, RhoStr *s2)
 {
 	if (s1->len != s2->len) {
@@ -76,6 +86,21 @@ RhoStr *rho_str_cat(RhoStr *s1, RhoStr *s2)
 	return rho_str_new(cat, len_cat);
 }
 
+RhoStr *rho_str_cat_arena(RhoArena *arena, RhoStr *s1, RhoStr *s2)
+{
+	const size_t len1 = s1->len, len2 = s2->len;
+	const size_t len_cat = len1 + len2;
+
+	char *cat = rho_arena_alloc(arena, len_cat + 1);
+	memcpy(cat, s1->value, len1);
+	memcpy(cat + len1, s2->value, len2);
+	cat[len_cat] = '\0';
+
+	RhoStr *str = rho_arena_alloc(arena, sizeof(RhoStr));
+	*str = RHO_STR_INIT(cat, len_cat, 0);
+	return str;
+}
+
 void rho_str_dealloc(RhoStr *str)
 {
 	RHO_FREE(str->value);
@@ -3,6 +3,7 @@
 #include <stdarg.h>
 #include <string.h>
 #include <assert.h>
+#include <time.h>
 #include "err.h"
 #include "util.h"
 
@@ -109,6 +110,23 @@ unsigned int rho_util_read_uint16_from_stream(unsigned char *stream)
 	return n;
 }
 
+void rho_util_write_uint32_to_stream(unsigned char *stream, const uint32_t n)
+{
+	stream[0] = (n >> 0 ) & 0xFF;
+	stream[1] = (n >> 8 ) & 0xFF;
+	stream[2] = (n >> 16) & 0xFF;
+	stream[3] = (n >> 24) & 0xFF;
+}
+
+uint32_t rho_util_read_uint32_from_stream(unsigned char *stream)
+{
+	const uint32_t n = ((uint32_t)stream[3] << 24) |
+	                   ((uint32_t)stream[2] << 16) |
+	                   ((uint32_t)stream[1] << 8 ) |
+	                   ((uint32_t)stream[0] << 0 );
+	return n;
+}
+
 /*
  * TODO: check endianness
  */
@@ -210,6 +228,13 @@ char *rho_util_file_to_str(const char *filename)
 	return str;
 }
 
+double rho_util_time(void)
+{
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
 size_t rho_smallest_pow_2_at_least(size_t x)
 {
 	--x;
@@ -2,6 +2,7 @@
 #define RHO_UTIL_H
 
 #include <stddef.h>
+#include <stdint.h>
 #include <stdbool.h>
 
 #define RHO_ANSI_CLR_RED     "\x1b[31m"
@@ -38,6 +39,8 @@ void rho_util_write_int32_to_stream(unsigned char *stream, const int n);
 int rho_util_read_int32_from_stream(unsigned char *stream);
 void rho_util_write_uint16_to_stream(unsigned char *stream, const unsigned int n);
 unsigned int rho_util_read_uint16_from_stream(unsigned char *stream);
+void rho_util_write_uint32_to_stream(unsigned char *stream, const uint32_t n);
+uint32_t rho_util_read_uint32_from_stream(unsigned char *stream);
 void rho_util_write_double_to_stream(unsigned char *stream, const double d);
 double rho_util_read_double_from_stream(unsigned char *stream);
 
@@ -51,6 +54,9 @@ const char *rho_util_str_format(const char *format, ...);
 
 char *rho_util_file_to_str(const char *filename);
 
+/* wall-clock time in seconds, for timing things */
+double rho_util_time(void);
+
 size_t rho_smallest_pow_2_at_least(size_t x);
 
 #endif /* RHO_UTIL_H */
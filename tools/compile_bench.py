@@ -0,0 +1,158 @@
+#!/usr/bin/env python3
+"""
+Benchmarks the compiler on synthetic sources of increasing size.
+
+Run this script from the repository root (or via `make bench-compiler`):
+
+    tools/compile_bench.py --sizes 6250,12500,25000,50000
+
+For each kind of source below, a program of roughly each given number
+of lines is generated and compiled with `rho -c --compile-time`, and
+the time spent parsing, building the symbol table, generating code
+and computing stack depths is listed (best of --runs). Phases whose
+time grows faster than the size of the source by more than
+--threshold (as the exponent k of time ~ lines^k between the smallest
+and largest size) are marked, and make the exit status non-zero.
+"""
+
+import argparse
+import math
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+PHASES = ['parse', 'symtab', 'codegen', 'stack']
+
+# phases taking less than this (in seconds) at the largest size are too noisy to judge
+MIN_TIME = 0.002
+
+
+def gen_machine(n):
+    """one function running an n-state machine as an if-elif chain"""
+    out = ['def machine(s, x) {\n', '  while s >= 0 {\n', '    if s == 0 { x += 1; s = 1 }\n']
+    for i in range(1, n):
+        out.append('    elif s == %d { x = (x * %d + %d) %% 1000003; s = %d }\n' %
+                   (i, i % 13 + 1, i + 7, i + 1 if i < n - 1 else -1))
+    out += ['    else { s = -1 }\n', '  }\n', '  return x\n', '}\n', 'print machine(0, 1)\n']
+    return out
+
+
+def gen_functions(n):
+    """n small top-level functions (all candidates for inlining) and a caller"""
+    out = ['def f%d(a) { return a * %d + 1 }\n' % (i, i) for i in range(n - 1)]
+    out.append('print f0(1) + f%d(2)\n' % (n - 2))
+    return out
+
+
+def gen_locals(n):
+    """one function with n distinct local variables"""
+    out = ['def f(a) {\n']
+    for i in range(n):
+        out.append('  v%d = a + %d\n' % (i, i % 100))
+    out += ['  return v0\n', '}\n']
+    return out
+
+
+def gen_constants(n):
+    """one function using n distinct int, float and string constants"""
+    out = ['def f() {\n', '  x = 0\n']
+    for i in range(n):
+        out.append('  x = [%d, %d.5, "s%d"]\n' % (i, i, i))
+    out += ['  return x\n', '}\n']
+    return out
+
+
+KINDS = {
+    'machine': gen_machine,
+    'functions': gen_functions,
+    'locals': gen_locals,
+    'constants': gen_constants,
+}
+
+REPORT_RE = re.compile(r'^compile time:\s*([0-9]+) \|\s*([0-9]+) \|\s*([0-9]+) \|\s*([0-9]+) \|')
+
+
+def compile_times(rho, filename, runs):
+    best = None
+    for _ in range(runs):
+        p = subprocess.run([rho, '-c', '--compile-time', filename], stdout=subprocess.PIPE,
+                           stderr=subprocess.PIPE, check=False)
+        if p.returncode != 0:
+            sys.exit('%s failed to compile %s (exit status %d):\n%s' %
+                     (rho, filename, p.returncode, p.stderr.decode(errors='replace')))
+
+        times = None
+        for line in p.stderr.decode().splitlines():
+            m = REPORT_RE.match(line)
+            if m:
+                times = [int(t) / 1e6 for t in m.groups()]
+
+        if times is None:
+            sys.exit('no compile times reported (is %s built with --compile-time?)' % rho)
+
+        best = times if best is None else [min(a, b) for a, b in zip(best, times)]
+
+    return best
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Time each compiler phase on sources of increasing size.')
+    parser.add_argument('--rho', default='./rho', help='rho binary (default: ./rho)')
+    parser.add_argument('--sizes', default='6250,12500,25000,50000',
+                        help='comma-separated source sizes in lines')
+    parser.add_argument('--kinds', default=','.join(KINDS),
+                        help='comma-separated kinds of source (default: all of %s)' % ', '.join(KINDS))
+    parser.add_argument('--runs', type=int, default=3, help='compilations per source')
+    parser.add_argument('--threshold', type=float, default=1.3,
+                        help='growth exponent above which a phase is marked')
+    args = parser.parse_args()
+
+    rho = os.path.abspath(args.rho)
+    sizes = sorted(int(n) for n in args.sizes.split(','))
+    flagged = []
+
+    print('%-10s %8s %10s %10s %10s %10s' % ('kind', 'lines', 'parse [ms]', 'symtab', 'codegen', 'stack'))
+
+    with tempfile.TemporaryDirectory() as tmp:
+        for kind in args.kinds.split(','):
+            if kind not in KINDS:
+                sys.exit('unknown kind of source: %s' % kind)
+
+            results = []
+            for n in sizes:
+                filename = os.path.join(tmp, '%s_%d.rho' % (kind, n))
+                with open(filename, 'w') as f:
+                    lines = KINDS[kind](n)
+                    f.writelines(lines)
+
+                times = compile_times(rho, filename, args.runs)
+                results.append((len(lines), times))
+                print('%-10s %8d %10.1f %10.1f %10.1f %10.1f' % ((kind, len(lines)) + tuple(t * 1e3 for t in times)))
+
+            if len(results) < 2:
+                continue
+
+            (n0, t0), (n1, t1) = results[0], results[-1]
+            exponents = []
+            for phase, a, b in zip(PHASES, t0, t1):
+                if b < MIN_TIME or a <= 0:
+                    exponents.append('%s -' % phase)
+                    continue
+
+                k = math.log(b / a) / math.log(n1 / n0)
+                mark = ''
+                if k > args.threshold:
+                    mark = ' (superlinear)'
+                    flagged.append('%s/%s' % (kind, phase))
+                exponents.append('%s %.2f%s' % (phase, k, mark))
+
+            print('%-10s growth: %s' % ('', ', '.join(exponents)))
+
+    if flagged:
+        sys.exit('superlinear phases: %s' % ', '.join(flagged))
+
+
+if __name__ == '__main__':
+    main()
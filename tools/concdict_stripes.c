@@ -0,0 +1,39 @@
+/*
+ * Checks that ConcurrentDict keys are spread across all stripes.
+ *
+ * Int keys 0..63 have to fill every stripe, or striping does
+ * nothing for them. Built and run by `make test-concdict`.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include "object.h"
+#include "dictobject.h"
+#include "concdictobject.h"
+
+int main(void)
+{
+	bool used[RHO_CONCDICT_STRIPES] = {false};
+
+	for (long i = 0; i < 4*RHO_CONCDICT_STRIPES; i++) {
+		RhoValue key = rho_makeint(i);
+		RhoValue hash = rho_dict_hash(&key);
+		used[rho_concdict_stripe_index(rho_intvalue(&hash))] = true;
+	}
+
+	int status = EXIT_SUCCESS;
+
+	for (size_t i = 0; i < RHO_CONCDICT_STRIPES; i++) {
+		if (!used[i]) {
+			fprintf(stderr, "stripe %zu holds none of Int keys 0..%d\n", i, 4*RHO_CONCDICT_STRIPES - 1);
+			status = EXIT_FAILURE;
+		}
+	}
+
+	if (status == EXIT_SUCCESS) {
+		printf("ok      %d stripes\n", RHO_CONCDICT_STRIPES);
+	}
+
+	return status;
+}
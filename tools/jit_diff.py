@@ -0,0 +1,68 @@
+#!/usr/bin/env python3
+"""
+Differential test of the JIT compiler against the interpreter.
+
+Run this script from the repository root on any number of Rho
+programs:
+
+    tools/jit_diff.py tools/jit_corpus/*.rho
+
+or simply `make test-jit`. The programs in tools/jit_corpus loop
+past RHO_JIT_THRESHOLD so that their hot functions are compiled,
+and between them execute every opcode the JIT has a template for.
+
+Each program is run once as usual and once with --no-jit, in both
+stack and register mode (-r), and the output (stdout and stderr)
+and exit status of the runs are compared. Programs that behave
+differently are listed along with a diff of their output; the exit
+status is non-zero if there were any.
+"""
+
+import argparse
+import difflib
+import subprocess
+import sys
+
+MODES = [[], ['-r']]
+
+
+def run(rho, flags, program, timeout):
+    try:
+        p = subprocess.run([rho] + flags + [program], stdout=subprocess.PIPE,
+                           stderr=subprocess.STDOUT, timeout=timeout, check=False)
+    except subprocess.TimeoutExpired:
+        return 'timed out after %ds\n' % timeout, None
+
+    return p.stdout.decode(errors='replace'), p.returncode
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Compare runs with and without the JIT.')
+    parser.add_argument('programs', nargs='+', help='Rho programs to run')
+    parser.add_argument('--rho', default='./rho', help='rho binary (default: ./rho)')
+    parser.add_argument('--timeout', type=int, default=60, help='per-run timeout in seconds')
+    args = parser.parse_args()
+
+    failures = 0
+
+    for program in args.programs:
+        for mode in MODES:
+            out_jit, status_jit = run(args.rho, mode, program, args.timeout)
+            out_int, status_int = run(args.rho, mode + ['--no-jit'], program, args.timeout)
+            name = ' '.join(mode + [program])
+
+            if out_jit == out_int and status_jit == status_int:
+                print('ok      %s' % name)
+                continue
+
+            failures += 1
+            print('FAILED  %s (exit status %s with JIT, %s without)' % (name, status_jit, status_int))
+            sys.stdout.writelines(difflib.unified_diff(out_int.splitlines(True), out_jit.splitlines(True),
+                                                       'no-jit', 'jit', n=2))
+
+    if failures:
+        sys.exit('%d run(s) differed' % failures)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,96 @@
+#!/usr/bin/env python3
+"""
+Mines opcode-pair frequencies from instrumented runs of rho.
+
+Build an instrumented interpreter first, e.g.
+
+    make clean
+    make CFLAGS="-std=c11 -O2 -pthread -DRHO_PROFILE_OPCODES"
+
+then run this script from the repository root on any number of
+Rho programs:
+
+    tools/opcode_pairs.py bench/*.rho
+
+Each program is run with RHO_OPCODE_PROFILE pointing at a temporary
+file, and the pair counts of all runs are summed. Counts written
+earlier (by setting RHO_OPCODE_PROFILE manually) can be included
+with --profile. Pairs are listed by how often they were executed,
+as a share of all executed instructions.
+"""
+
+import argparse
+import os
+import re
+import subprocess
+import sys
+import tempfile
+from collections import Counter
+
+OPCODES_H = os.path.join(os.path.dirname(__file__), '..', 'src', 'runtime', 'opcodes.h')
+
+
+def opcode_names():
+    with open(OPCODES_H) as f:
+        src = re.sub(r'/\*.*?\*/|//[^\n]*', '', f.read(), flags=re.S)
+
+    body = re.search(r'typedef enum \{(.*?)\} RhoOpcode;', src, re.S).group(1)
+    names = {}
+    value = 0
+
+    for entry in body.split(','):
+        entry = entry.strip()
+        if not entry:
+            continue
+        m = re.match(r'RHO_INS_(\w+)(?:\s*=\s*(\w+))?', entry)
+        if m.group(2) is not None:
+            value = int(m.group(2), 0)
+        names[value] = m.group(1)
+        value += 1
+
+    names[0] = '<entry>'
+    return names
+
+
+def read_profile(path, counts):
+    with open(path) as f:
+        for line in f:
+            a, b, n = line.split()
+            counts[int(a), int(b)] += int(n)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Mine opcode-pair frequencies.')
+    parser.add_argument('programs', nargs='*', help='Rho programs to run')
+    parser.add_argument('--rho', default='./rho', help='instrumented rho binary (default: ./rho)')
+    parser.add_argument('--profile', action='append', default=[],
+                        help='existing RHO_OPCODE_PROFILE output to include')
+    parser.add_argument('--top', type=int, default=25, help='number of pairs to list')
+    args = parser.parse_args()
+
+    counts = Counter()
+
+    for path in args.profile:
+        read_profile(path, counts)
+
+    for program in args.programs:
+        with tempfile.NamedTemporaryFile(suffix='.prof') as tmp:
+            env = dict(os.environ, RHO_OPCODE_PROFILE=tmp.name)
+            subprocess.run([args.rho, program], env=env, stdout=subprocess.DEVNULL, check=False)
+            read_profile(tmp.name, counts)
+
+    if not counts:
+        sys.exit('no counts collected (is the binary built with -DRHO_PROFILE_OPCODES?)')
+
+    names = opcode_names()
+    total = sum(counts.values())
+    print('%d instructions executed' % total)
+    print()
+    print('%-20s %-20s %12s %7s' % ('first', 'second', 'count', 'share'))
+
+    for (a, b), n in counts.most_common(args.top):
+        print('%-20s %-20s %12d %6.2f%%' % (names.get(a, a), names.get(b, b), n, 100.0 * n / total))
+
+
+if __name__ == '__main__':
+    main()